@@ -58,6 +58,7 @@
 #include "replay_ragdoll.h"
 
 #include "clientalphaproperty.h"
+#include "mathlib/transformbatch.h"
 
 #ifdef DEMOPOLISH_ENABLED
 #include "demo_polish/demo_polish.h"
@@ -1476,104 +1477,147 @@ void C_BaseAnimating::BuildTransformations(CStudioHdr *hdr, Vector *pos, Quatern
 	// For EF_BONEMERGE entities, copy the bone matrices for any bones that have matching names.
 	CalcBoneMerge(hdr, boneMask, boneComputed);
 
+	// Jiggle bones are queued and stepped together after each pass over the
+	// bones. Whatever depends on a queued bone waits for the next pass: its
+	// children, and other procedural bones, which can read any bone.
+	int boneList[MAXSTUDIOBONES];
+	bool bonePending[MAXSTUDIOBONES];
+	int nBones = 0;
 	for (int i = 0; i < hdr->numbones(); i++)
 	{
 		// Only update bones reference by the bone mask.
-		if (!(hdr->boneFlags(i) & boneMask))
-			continue;
-
-		PREFETCH360(&GetBoneForWrite(i), 0);
-
-		// skip bones that are already setup
-		if (boneComputed.IsBoneMarked(i))
+		if (hdr->boneFlags(i) & boneMask)
 		{
-			// dummy operation, just used to verify in debug that this should have happened
-			GetBoneForWrite(i);
+			boneList[nBones++] = i;
 		}
-		else if (boneSimulated[i])
+	}
+
+	for (int nPass = 0; nBones > 0; nPass++)
+	{
+		int nDeferred = 0;
+		memset(bonePending, 0, hdr->numbones() * sizeof(bool));
+
+		for (int iList = 0; iList < nBones; iList++)
 		{
-			ApplyBoneMatrixTransform(GetBoneForWrite(i));
-			if (bFixupSimulatedPositions && pbones[i].parent != -1)
+			int i = boneList[iList];
+
+			bool bJiggleQueued = m_pJiggleBones && m_pJiggleBones->HasQueuedJiggleTransformations();
+			if ((pbones[i].parent != -1 && bonePending[pbones[i].parent]) ||
+				(bJiggleQueued && (hdr->boneFlags(i) & BONE_ALWAYS_PROCEDURAL) && !(hdr->pBone(i)->proctype & STUDIO_PROC_JIGGLE)))
 			{
-				Vector boneOrigin;
-				VectorTransform(pos[i], GetBone(pbones[i].parent), boneOrigin);
-				PositionMatrix(boneOrigin, GetBoneForWrite(i));
+				boneList[nDeferred++] = i;
+				bonePending[i] = true;
+				continue;
 			}
-			continue;
-		}
-		else if (CalcProceduralBone(hdr, i, m_BoneAccessor))
-		{
-			continue;
-		}
-		else
-		{
-			// animate all non-simulated bones
-			QuaternionMatrix(q[i], pos[i], bonematrix);
 
-			Assert(fabs(pos[i].x) < 100000);
-			Assert(fabs(pos[i].y) < 100000);
-			Assert(fabs(pos[i].z) < 100000);
+			PREFETCH360(&GetBoneForWrite(i), 0);
 
-			if ((hdr->boneFlags(i) & BONE_ALWAYS_PROCEDURAL) &&
-				(hdr->pBone(i)->proctype & STUDIO_PROC_JIGGLE) &&
-				!r_jiggle_bones.GetBool())
+			// skip bones that are already setup
+			if (boneComputed.IsBoneMarked(i))
 			{
-				if (m_pJiggleBones)
+				// dummy operation, just used to verify in debug that this should have happened
+				GetBoneForWrite(i);
+			}
+			else if (boneSimulated[i])
+			{
+				ApplyBoneMatrixTransform(GetBoneForWrite(i));
+				if (bFixupSimulatedPositions && pbones[i].parent != -1)
 				{
-					delete m_pJiggleBones;
-					m_pJiggleBones = NULL;
+					Vector boneOrigin;
+					VectorTransform(pos[i], GetBone(pbones[i].parent), boneOrigin);
+					PositionMatrix(boneOrigin, GetBoneForWrite(i));
 				}
+				continue;
 			}
-
-			if ((hdr->boneFlags(i) & BONE_ALWAYS_PROCEDURAL) &&
-				(hdr->pBone(i)->proctype & STUDIO_PROC_JIGGLE) &&
-				r_jiggle_bones.GetBool() && m_isJiggleBonesEnabled)
+			else if (CalcProceduralBone(hdr, i, m_BoneAccessor))
+			{
+				continue;
+			}
+			else
 			{
-				//
-				// Physics-based "jiggle" bone
-				// Bone is assumed to be along the Z axis
-				// Pitch around X, yaw around Y
-				//
+				// animate all non-simulated bones
+				QuaternionMatrix(q[i], pos[i], bonematrix);
 
-				// compute desired bone orientation
-				matrix3x4a_t goalMX;
+				Assert(fabs(pos[i].x) < 100000);
+				Assert(fabs(pos[i].y) < 100000);
+				Assert(fabs(pos[i].z) < 100000);
 
-				if (pbones[i].parent == -1)
+				if ((hdr->boneFlags(i) & BONE_ALWAYS_PROCEDURAL) &&
+					(hdr->pBone(i)->proctype & STUDIO_PROC_JIGGLE) &&
+					!r_jiggle_bones.GetBool())
 				{
-					ConcatTransforms(cameraTransform, bonematrix, goalMX);
+					if (m_pJiggleBones)
+					{
+						delete m_pJiggleBones;
+						m_pJiggleBones = NULL;
+					}
 				}
-				else
+
+				if ((hdr->boneFlags(i) & BONE_ALWAYS_PROCEDURAL) &&
+					(hdr->pBone(i)->proctype & STUDIO_PROC_JIGGLE) &&
+					r_jiggle_bones.GetBool() && m_isJiggleBonesEnabled)
 				{
-					ConcatTransforms_Aligned(GetBone(pbones[i].parent), bonematrix, goalMX);
-				}
+					//
+					// Physics-based "jiggle" bone
+					// Bone is assumed to be along the Z axis
+					// Pitch around X, yaw around Y
+					//
 
-				// get jiggle properties from QC data
-				mstudiojigglebone_t *jiggleInfo = (mstudiojigglebone_t *)pbones[i].pProcedure();
+					// compute desired bone orientation
+					matrix3x4a_t goalMX;
 
-				if (!m_pJiggleBones)
-				{
-					m_pJiggleBones = new CJiggleBones;
-				}
+					if (pbones[i].parent == -1)
+					{
+						ConcatTransforms(cameraTransform, bonematrix, goalMX);
+					}
+					else
+					{
+						ConcatTransforms_Aligned(GetBone(pbones[i].parent), bonematrix, goalMX);
+					}
 
-				// do jiggle physics
-				m_pJiggleBones->BuildJiggleTransformations(i, gpGlobals->curtime, jiggleInfo, goalMX, GetBoneForWrite(i));
+					// get jiggle properties from QC data
+					mstudiojigglebone_t *jiggleInfo = (mstudiojigglebone_t *)pbones[i].pProcedure();
 
+					if (!m_pJiggleBones)
+					{
+						m_pJiggleBones = new CJiggleBones;
+					}
+
+					// do jiggle physics; jiggle bones with a parent are stepped together at the end of the pass
+					if (pbones[i].parent == -1)
+					{
+						m_pJiggleBones->BuildJiggleTransformations(i, gpGlobals->curtime, jiggleInfo, goalMX, GetBoneForWrite(i));
+					}
+					else
+					{
+						m_pJiggleBones->QueueJiggleTransformations(i, nPass, jiggleInfo, goalMX, &GetBoneForWrite(i));
+						bonePending[i] = true;
+						continue;
+					}
+				}
+				else if (hdr->boneParent(i) == -1)
+				{
+					ConcatTransforms(cameraTransform, bonematrix, GetBoneForWrite(i));
+				}
+				else
+				{
+					ConcatTransforms_Aligned(GetBone(hdr->boneParent(i)), bonematrix, GetBoneForWrite(i));
+				}
 			}
-			else if (hdr->boneParent(i) == -1)
-			{
-				ConcatTransforms(cameraTransform, bonematrix, GetBoneForWrite(i));
-			}
-			else
+
+			if (hdr->boneParent(i) == -1)
 			{
-				ConcatTransforms_Aligned(GetBone(hdr->boneParent(i)), bonematrix, GetBoneForWrite(i));
+				// Apply client-side effects to the transformation matrix
+				ApplyBoneMatrixTransform(GetBoneForWrite(i));
 			}
 		}
 
-		if (hdr->boneParent(i) == -1)
+		if (m_pJiggleBones && m_pJiggleBones->HasQueuedJiggleTransformations())
 		{
-			// Apply client-side effects to the transformation matrix
-			ApplyBoneMatrixTransform(GetBoneForWrite(i));
+			m_pJiggleBones->StepQueuedJiggleTransformations(gpGlobals->curtime);
 		}
+
+		nBones = nDeferred;
 	}
 }
 
@@ -6382,18 +6426,29 @@ bool C_BaseAnimating::ComputeHitboxSurroundingBox(Vector *pVecWorldMins, Vector
 	matrix3x4_t *hitboxbones[MAXSTUDIOBONES];
 	HitboxToWorldTransforms(hitboxbones);
 
+	// The hitbox bones all point into m_CachedBoneData, so the boxes can be
+	// transformed all at once from it by bone index
+	int *pBoneIndex = (int *)stackalloc(set->numhitboxes * sizeof(int));
+	Vector *pBoxMins = (Vector *)stackalloc(set->numhitboxes * sizeof(Vector));
+	Vector *pBoxMaxs = (Vector *)stackalloc(set->numhitboxes * sizeof(Vector));
+	for (int i = 0; i < set->numhitboxes; i++)
+	{
+		mstudiobbox_t *pbox = set->pHitbox(i);
+		pBoneIndex[i] = pbox->bone;
+		pBoxMins[i] = pbox->bbmin;
+		pBoxMaxs[i] = pbox->bbmax;
+	}
+
+	TransformAABBBatch(m_CachedBoneData.Base(), pBoneIndex, pBoxMins, pBoxMaxs, pBoxMins, pBoxMaxs, set->numhitboxes);
+
 	// Compute a box in world space that surrounds this entity
 	pVecWorldMins->Init(FLT_MAX, FLT_MAX, FLT_MAX);
 	pVecWorldMaxs->Init(-FLT_MAX, -FLT_MAX, -FLT_MAX);
 
-	Vector vecBoxAbsMins, vecBoxAbsMaxs;
 	for (int i = 0; i < set->numhitboxes; i++)
 	{
-		mstudiobbox_t *pbox = set->pHitbox(i);
-
-		TransformAABB(*hitboxbones[pbox->bone], pbox->bbmin, pbox->bbmax, vecBoxAbsMins, vecBoxAbsMaxs);
-		VectorMin(*pVecWorldMins, vecBoxAbsMins, *pVecWorldMins);
-		VectorMax(*pVecWorldMaxs, vecBoxAbsMaxs, *pVecWorldMaxs);
+		VectorMin(*pVecWorldMins, pBoxMins[i], *pVecWorldMins);
+		VectorMax(*pVecWorldMaxs, pBoxMaxs[i], *pVecWorldMaxs);
 	}
 	return true;
 }
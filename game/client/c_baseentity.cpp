@@ -80,6 +80,7 @@ static ConVar  report_cliententitysim( "report_cliententitysim", "0", FCVAR_CHEA
 static ConVar  cl_extrapolate( "cl_extrapolate", "1", FCVAR_CHEAT, "Enable/disable extrapolation if interpolation history runs out." );
 static ConVar  cl_interp_npcs( "cl_interp_npcs", "0.0", 0, "Interpolate NPC positions starting this many seconds in past (or cl_interp, if greater)" );  
 static ConVar  cl_interp_all( "cl_interp_all", "0", 0, "Disable interpolation list optimizations.", 0, 0, 0, 0, cc_cl_interp_all_changed );
+static ConVar  cl_interp_simd( "cl_interp_simd", "1", 0, "Interpolate float and vector array vars four floats at a time." );
 ConVar  r_drawmodeldecals( "r_drawmodeldecals", "1" );
 extern ConVar	cl_showerror;
 int C_BaseEntity::m_nPredictionRandomSeed = -1;
@@ -991,6 +992,8 @@ inline int C_BaseEntity::Interp_Interpolate( VarMapping_t *map, float currentTim
 	}
 	map->m_lastInterpolationTime = currentTime;
 
+	bool bSIMD = cl_interp_simd.GetBool();
+
 	for ( int i = 0; i < map->m_nInterpolatedEntries; i++ )
 	{
 		VarMapEntry_t *e = &map->m_Entries[ i ];
@@ -1001,8 +1004,8 @@ inline int C_BaseEntity::Interp_Interpolate( VarMapping_t *map, float currentTim
 		IInterpolatedVar *watcher = e->watcher;
 		Assert( !( watcher->GetType() & EXCLUDE_AUTO_INTERPOLATE ) );
 
-
-		if ( watcher->Interpolate( currentTime ) )
+		int nNoMoreChanges = bSIMD ? InterpolateSIMD( watcher, e->m_nSIMDType, currentTime ) : watcher->Interpolate( currentTime );
+		if ( nNoMoreChanges )
 			e->m_bNeedsToInterpolate = false;
 		else
 			bNoMoreChanges = 0;
@@ -6104,6 +6107,7 @@ void C_BaseEntity::AddVar( void *data, IInterpolatedVar *watcher, int type, bool
 		map.watcher = watcher;
 		map.type = type;
 		map.m_bNeedsToInterpolate = true;
+		map.m_nSIMDType = watcher->GetSIMDType();
 		if ( type & EXCLUDE_AUTO_INTERPOLATE )
 		{
 			m_VarMap.m_Entries.AddToTail( map );
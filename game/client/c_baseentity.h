@@ -100,6 +100,7 @@ public:
 	unsigned short		type;
 	unsigned short		m_bNeedsToInterpolate;	// Set to false when this var doesn't
 	// need Interpolate() called on it anymore.
+	int					m_nSIMDType;			// watcher->GetSIMDType()
 	void				*data;
 	IInterpolatedVar	*watcher;
 };
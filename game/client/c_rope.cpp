@@ -80,6 +80,7 @@ END_RECV_TABLE()
 static ConVar rope_shake( "rope_shake", "0" );
 static ConVar rope_subdiv( "rope_subdiv", "2", FCVAR_MATERIAL_SYSTEM_THREAD, "Rope subdivision amount", true, 0, true, MAX_ROPE_SUBDIVS );
 static ConVar rope_collide( "rope_collide", "1", 0, "Collide rope with the world" );
+static ConVar rope_batch_simulate( "rope_batch_simulate", "1", 0, "Simulate the ropes that need it four at a time after the client thinks, instead of one at a time in each rope's think" );
 
 static ConVar rope_smooth( "rope_smooth", "1", 0, "Do an antialiasing effect on ropes" );
 static ConVar rope_smooth_enlarge( "rope_smooth_enlarge", "1.4", 0, "How much to enlarge ropes in screen space for antialiasing effect" );
@@ -147,6 +148,10 @@ public:
 	enum { MAX_ROPE_RENDERCACHE	= 128 };
 
 	void RemoveRopeFromQueuedRenderCaches( C_RopeKeyframe *pRope );
+
+	void QueueSimulation( C_RopeKeyframe *pRope );
+	void RemoveRopeFromSimulationQueue( C_RopeKeyframe *pRope );
+	void SimulateQueuedRopes( void );
 	
 private:
 	struct RopeRenderData_t
@@ -172,6 +177,10 @@ private:
 	IMaterial* m_pDepthWriteMaterial;
 	CUtlLinkedList<RopeQueuedRenderCache_t> m_RopeQueuedRenderCaches;	
 	CThreadFastMutex		m_RopeQueuedRenderCaches_Mutex; //mutex just for changing m_RopeQueuedRenderCaches
+
+	// Ropes to simulate after the client thinks
+	CUtlVector<C_RopeKeyframe *>	m_SimulationQueue;
+	CRopePhysicsBatch				m_SimulationBatch;
 };
 
 static CRopeManager s_RopeManager;
@@ -646,6 +655,55 @@ void CRopeManager::RemoveRopeFromQueuedRenderCaches( C_RopeKeyframe *pRope )
 	}
 }
 
+//-----------------------------------------------------------------------------
+// Purpose:
+//-----------------------------------------------------------------------------
+void CRopeManager::QueueSimulation( C_RopeKeyframe *pRope )
+{
+	m_SimulationQueue.AddToTail( pRope );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose:
+//-----------------------------------------------------------------------------
+void CRopeManager::RemoveRopeFromSimulationQueue( C_RopeKeyframe *pRope )
+{
+	m_SimulationQueue.FindAndRemove( pRope );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Does the simulation the queued ropes skipped in ClientThink(), all
+//			of them at once through a CRopePhysicsBatch. It stays on this thread
+//			since the delegates trace and read the end point attachments.
+//-----------------------------------------------------------------------------
+void CRopeManager::SimulateQueuedRopes( void )
+{
+	int nRopes = m_SimulationQueue.Count();
+	if ( nRopes == 0 )
+		return;
+
+	VPROF_BUDGET( "CRopeManager::SimulateQueuedRopes", VPROF_BUDGETGROUP_ROPES );
+
+	m_SimulationBatch.RemoveAll();
+	for ( int i = 0; i < nRopes; ++i )
+	{
+		C_RopeKeyframe *pRope = m_SimulationQueue[i];
+		pRope->StartRopeSimulation();
+		m_SimulationBatch.AddRope( &pRope->m_RopePhysics );
+	}
+
+	m_SimulationBatch.Simulate( gpGlobals->frametime );
+
+	for ( int i = 0; i < nRopes; ++i )
+	{
+		C_RopeKeyframe *pRope = m_SimulationQueue[i];
+		pRope->EndRopeSimulation();
+		pRope->FinishSimulationThink();
+	}
+
+	m_SimulationQueue.RemoveAll();
+}
+
 //=============================================================================
 
 // ------------------------------------------------------------------------------------ //
@@ -876,6 +934,7 @@ C_RopeKeyframe::C_RopeKeyframe()
 C_RopeKeyframe::~C_RopeKeyframe()
 {
 	s_RopeManager.RemoveRopeFromQueuedRenderCaches( this );	
+	s_RopeManager.RemoveRopeFromSimulationQueue( this );
 	g_Ropes.FindAndRemove( this );
 }
 
@@ -1147,13 +1206,23 @@ void C_RopeKeyframe::FinishInit( const char *pMaterialName )
 
 void C_RopeKeyframe::RunRopeSimulation( float flSeconds )
 {
-	// First, forget about links touching things.
-	for ( int i=0; i < m_nSegments; i++ )
-		m_LinksTouchingSomething[i] = false;
+	StartRopeSimulation();
 
 	// Simulate, and it will mark which links touched things.
 	m_RopePhysics.Simulate( flSeconds );
 
+	EndRopeSimulation();
+}
+
+void C_RopeKeyframe::StartRopeSimulation()
+{
+	// First, forget about links touching things.
+	for ( int i=0; i < m_nSegments; i++ )
+		m_LinksTouchingSomething[i] = false;
+}
+
+void C_RopeKeyframe::EndRopeSimulation()
+{
 	// Now count how many links touched something.
 	m_nLinksTouchingSomething = 0;
 	for ( int i=0; i < m_nSegments; i++ )
@@ -1222,8 +1291,19 @@ void C_RopeKeyframe::ClientThink()
 	}
 
 	// Update the simulation.
+	if ( rope_batch_simulate.GetBool() )
+	{
+		// SimulateQueuedRopes() simulates it with the others and finishes the think
+		s_RopeManager.QueueSimulation( this );
+		return;
+	}
+
 	RunRopeSimulation( gpGlobals->frametime );
+	FinishSimulationThink();
+}
 
+void C_RopeKeyframe::FinishSimulationThink()
+{
 	g_nRopePointsSimulated += m_RopePhysics.NumNodes();
 
 	m_bNewDataThisFrame = false;
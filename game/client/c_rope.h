@@ -142,6 +142,9 @@ private:
 	void			FinishInit( const char *pMaterialName );
 
 	void			RunRopeSimulation( float flSeconds );
+	void			StartRopeSimulation();
+	void			EndRopeSimulation();
+	void			FinishSimulationThink();
 	Vector			ConstrainNode( const Vector &vNormal, const Vector &vNodePosition, const Vector &vMidpiont, float fNormalLength );
 	void			ConstrainNodesBetweenEndpoints( void );
 
@@ -251,6 +254,9 @@ public:
 	virtual void				ResetRenderCache( void ) = 0;
 	virtual void				AddToRenderCache( C_RopeKeyframe *pRope ) = 0;
 	virtual void				DrawRenderCache( bool bShadowDepth ) = 0;
+
+	// Simulates the ropes that queued themselves in their think
+	virtual void				SimulateQueuedRopes( void ) = 0;
 };
 
 IRopeManager *RopeManager();
@@ -138,6 +138,7 @@
 
 #include "tier1/UtlDict.h"
 #include "keybindinglistener.h"
+#include "networkstringtableindex.h"
 
 // memdbgon must be the last include file in a .cpp file!!!
 #include "tier0/memdbgon.h"
@@ -235,6 +236,10 @@ INetworkStringTable *g_pStringTableMaterials = NULL;
 INetworkStringTable *g_pStringTableInfoPanel = NULL;
 INetworkStringTable *g_pStringTableClientSideChoreoScenes = NULL;
 
+// Hashed lookups for the tables looked up by name
+static CNetworkStringTableIndex s_StringTableParticleEffectNamesIndex;
+static CNetworkStringTableIndex s_StringTableMaterialsIndex;
+
 static CGlobalVarsBase dummyvars( true );
 // So stuff that might reference gpGlobals during DLL initialization won't have a NULL pointer.
 // Once the engine calls Init on this DLL, this pointer gets assigned to the shared data in the engine
@@ -819,7 +824,7 @@ int GetMaterialIndex( const char *pMaterialName )
 {
 	if (pMaterialName)
 	{
-		int nIndex = g_pStringTableMaterials->FindStringIndex( pMaterialName );
+		int nIndex = s_StringTableMaterialsIndex.FindStringIndex( pMaterialName );
 		Assert( nIndex >= 0 );
 		if (nIndex >= 0)
 			return nIndex;
@@ -850,7 +855,7 @@ const char *GetMaterialNameFromIndex( int nIndex )
 //-----------------------------------------------------------------------------
 int PrecacheParticleSystem( const char *pParticleSystemName )
 {
-	int nIndex = g_pStringTableParticleEffectNames->AddString( false, pParticleSystemName );
+	int nIndex = s_StringTableParticleEffectNamesIndex.AddString( false, pParticleSystemName );
 	g_pParticleSystemMgr->PrecacheParticleSystem( nIndex, pParticleSystemName );
 	return nIndex;
 }
@@ -863,7 +868,7 @@ int GetParticleSystemIndex( const char *pParticleSystemName )
 {
 	if ( pParticleSystemName )
 	{
-		int nIndex = g_pStringTableParticleEffectNames->FindStringIndex( pParticleSystemName );
+		int nIndex = s_StringTableParticleEffectNamesIndex.FindStringIndex( pParticleSystemName );
 		if ( nIndex != INVALID_STRING_INDEX )
 			return nIndex;
 		DevWarning("Client: Missing precache for particle system \"%s\"!\n", pParticleSystemName );
@@ -1895,6 +1900,9 @@ void CHLClient::ResetStringTablePointers()
 	g_pStringTableMaterials = NULL;
 	g_pStringTableInfoPanel = NULL;
 	g_pStringTableClientSideChoreoScenes = NULL;
+
+	s_StringTableParticleEffectNamesIndex.Purge();
+	s_StringTableMaterialsIndex.Purge();
 }
 
 //-----------------------------------------------------------------------------
@@ -2130,6 +2138,7 @@ void CHLClient::InstallStringTableCallback( const char *tableName )
 	{
 		// Look up the id 
 		g_pStringTableMaterials = networkstringtable->FindTable( tableName );
+		s_StringTableMaterialsIndex.Init( g_pStringTableMaterials );
 
 		// When the material list changes, we need to know immediately
 		g_pStringTableMaterials->SetStringChangedCallback( NULL, OnMaterialStringTableChanged );
@@ -2154,6 +2163,7 @@ void CHLClient::InstallStringTableCallback( const char *tableName )
 	else if ( !Q_strcasecmp( tableName, "ParticleEffectNames" ) )
 	{
 		g_pStringTableParticleEffectNames = networkstringtable->FindTable( tableName );
+		s_StringTableParticleEffectNamesIndex.Init( g_pStringTableParticleEffectNames );
 		networkstringtable->SetAllowClientSideAddString( g_pStringTableParticleEffectNames, true );
 		// When the particle system list changes, we need to know immediately
 		g_pStringTableParticleEffectNames->SetStringChangedCallback( NULL, OnParticleSystemStringTableChanged );
@@ -2231,6 +2241,9 @@ void SimulateEntities()
 	// Service timer events (think functions).
   	ClientThinkList()->PerformThinkFunctions();
 
+	// Ropes queue their simulation in their think
+	RopeManager()->SimulateQueuedRopes();
+
 	C_BaseEntity::SimulateEntities();
 }
 
@@ -92,7 +92,7 @@ void CClientThinkList::SetNextClientThink( ClientThinkHandle_t hThink, float flN
 	}
 	else
 	{
-		GetThinkEntry( hThink )->m_flNextClientThink = flNextTime;
+		SetEntryNextThink( GetThinkEntry( hThink ), flNextTime );
 	}
 }
 
@@ -128,12 +128,24 @@ void CClientThinkList::SetNextClientThink( ClientEntityHandle_t hEnt, float flNe
 
 		ThinkEntry_t *pEntry = GetThinkEntry( hThink );
 		pEntry->m_hEnt = hEnt;
+		pEntry->m_hThink = hThink;
 		pEntry->m_nIterEnum = -1;
 		pEntry->m_flLastClientThink = 0.0f;
+		m_Schedule.Add( (unsigned long)hThink );
 	}
 
 	Assert( GetThinkEntry( hThink )->m_hEnt == hEnt );
-	GetThinkEntry( hThink )->m_flNextClientThink = flNextTime;
+	SetEntryNextThink( GetThinkEntry( hThink ), flNextTime );
+}
+
+
+//-----------------------------------------------------------------------------
+// Every change of the think time goes through here to keep the schedule in step
+//-----------------------------------------------------------------------------
+void CClientThinkList::SetEntryNextThink( ThinkEntry_t *pEntry, float flNextTime )
+{
+	pEntry->m_flNextClientThink = flNextTime;
+	m_Schedule.Schedule( (unsigned long)pEntry->m_hThink, flNextTime );
 }
 
 
@@ -161,6 +173,7 @@ void CClientThinkList::RemoveThinkable( ClientThinkHandle_t hThink )
 	{
 		pThink->SetThinkHandle( INVALID_THINK_HANDLE );
 	}
+	m_Schedule.Remove( (unsigned long)hThink );
 	m_ThinkEntries.Remove( (unsigned long)hThink );
 }
 
@@ -211,7 +224,7 @@ void CClientThinkList::PerformThinkFunction( ThinkEntry_t *pEntry, float flCurti
 		Assert( pEntry->m_flNextClientThink <= flCurtime );
 
 		// Indicate we're not going to think again
-		pEntry->m_flNextClientThink = FLT_MAX;
+		SetEntryNextThink( pEntry, FLT_MAX );
 
 		// NOTE: The Think function here could call SetNextClientThink
 		// which would cause it to be readded into the list
@@ -276,15 +289,20 @@ void CClientThinkList::PerformThinkFunctions()
 
 	++m_nIterEnum;
 
+	// Only the entries that think this frame, in the order of the think list.
+	// The others would be skipped by AddEntityToFrameThinkList() anyway.
+	int nDueCount = m_Schedule.GatherDue( gpGlobals->curtime, m_DueEntries );
+
 	// Build a list of entities to think this frame, in order of hierarchy.
 	// Do this because the list may be modified during the thinking and also to
 	// prevent bad situations where an entity can think more than once in a frame.
-	ThinkEntry_t **ppThinkEntryList = (ThinkEntry_t**)stackalloc( nMaxList * sizeof(ThinkEntry_t*) );
+	ThinkEntry_t **ppThinkEntryList = (ThinkEntry_t**)stackalloc( MAX( nDueCount, 1 ) * sizeof(ThinkEntry_t*) );
 	int nThinkCount = 0;
-	for ( unsigned short iCur=m_ThinkEntries.Head(); iCur != m_ThinkEntries.InvalidIndex(); iCur = m_ThinkEntries.Next( iCur ) )
+	for ( int i = 0; i < nDueCount; ++i )
 	{
-		AddEntityToFrameThinkList( &m_ThinkEntries[iCur], false, nThinkCount, ppThinkEntryList );
-		Assert( nThinkCount <= nMaxList );
+		// Parents are only added if they are due themselves
+		AddEntityToFrameThinkList( &m_ThinkEntries[ m_DueEntries[i] ], false, nThinkCount, ppThinkEntryList );
+		Assert( nThinkCount <= nDueCount );
 	}
 
 	// While we're in the loop, no changes to the think list are allowed
@@ -424,3 +442,437 @@ void CClientThinkList::CleanUpDeleteList()
 	m_aDeleteList.RemoveAll();
 }
 
+
+
+//-----------------------------------------------------------------------------
+// CClientThinkSchedule
+//-----------------------------------------------------------------------------
+CClientThinkSchedule::CClientThinkSchedule()
+{
+	Reset();
+}
+
+void CClientThinkSchedule::Reset()
+{
+	m_Nodes.Purge();
+	m_Due.Purge();
+	for ( int i = 0; i < LIST_COUNT; ++i )
+	{
+		m_Heads[i] = LIST_NONE;
+	}
+	m_nWheelTick = 0;
+	m_nSequence = 0;
+	m_nScheduled = 0;
+}
+
+int CClientThinkSchedule::TimeToTick( float flTime )
+{
+	double flTick = floor( (double)flTime * CLIENT_THINK_WHEEL_TICKRATE );
+	return (int)clamp( flTick, -1073741824.0, 1073741824.0 );
+}
+
+void CClientThinkSchedule::Link( int iEntry, int nList )
+{
+	Node_t &node = m_Nodes[iEntry];
+	Assert( node.m_nList == LIST_NONE );
+
+	node.m_nList = nList;
+	node.m_nPrev = LIST_NONE;
+	node.m_nNext = m_Heads[nList];
+	if ( node.m_nNext != LIST_NONE )
+	{
+		m_Nodes[node.m_nNext].m_nPrev = iEntry;
+	}
+	m_Heads[nList] = iEntry;
+	++m_nScheduled;
+}
+
+void CClientThinkSchedule::Unlink( int iEntry )
+{
+	Node_t &node = m_Nodes[iEntry];
+	if ( node.m_nList == LIST_NONE )
+		return;
+
+	if ( node.m_nPrev != LIST_NONE )
+	{
+		m_Nodes[node.m_nPrev].m_nNext = node.m_nNext;
+	}
+	else
+	{
+		m_Heads[node.m_nList] = node.m_nNext;
+	}
+	if ( node.m_nNext != LIST_NONE )
+	{
+		m_Nodes[node.m_nNext].m_nPrev = node.m_nPrev;
+	}
+	node.m_nList = LIST_NONE;
+	--m_nScheduled;
+}
+
+void CClientThinkSchedule::Add( int iEntry )
+{
+	Assert( iEntry >= 0 && iEntry < LIST_NONE );
+	if ( iEntry >= m_Nodes.Count() )
+	{
+		int nFirst = m_Nodes.AddMultipleToTail( iEntry + 1 - m_Nodes.Count() );
+		for ( int i = nFirst; i < m_Nodes.Count(); ++i )
+		{
+			m_Nodes[i].m_nList = LIST_NONE;
+		}
+	}
+
+	Node_t &node = m_Nodes[iEntry];
+	Unlink( iEntry );
+	node.m_flNextThink = FLT_MAX;
+	node.m_nTick = 0;
+	node.m_nSequence = m_nSequence++;
+}
+
+void CClientThinkSchedule::Remove( int iEntry )
+{
+	Unlink( iEntry );
+}
+
+void CClientThinkSchedule::Unschedule( int iEntry )
+{
+	Unlink( iEntry );
+	m_Nodes[iEntry].m_flNextThink = FLT_MAX;
+}
+
+void CClientThinkSchedule::Schedule( int iEntry, float flNextThink )
+{
+	if ( flNextThink == FLT_MAX )
+	{
+		Unschedule( iEntry );
+		return;
+	}
+
+	Unlink( iEntry );
+
+	Node_t &node = m_Nodes[iEntry];
+	node.m_flNextThink = flNextThink;
+	if ( flNextThink == CLIENT_THINK_ALWAYS )
+	{
+		Link( iEntry, LIST_ALWAYS );
+		return;
+	}
+
+	node.m_nTick = TimeToTick( flNextThink );
+	Link( iEntry, ( node.m_nTick <= m_nWheelTick ) ? LIST_PENDING : LIST_WHEEL + ( node.m_nTick & ( CLIENT_THINK_WHEEL_SIZE - 1 ) ) );
+}
+
+
+//-----------------------------------------------------------------------------
+// Moves the entries of the ticks up to nTick to the pending list
+//-----------------------------------------------------------------------------
+void CClientThinkSchedule::AdvanceWheel( int nTick )
+{
+	if ( nTick < m_nWheelTick )
+	{
+		// The clock went back (new level, demo skip): the pending entries
+		// that are in the future again go back into the wheel
+		m_nWheelTick = nTick;
+		unsigned short iNext;
+		for ( unsigned short i = m_Heads[LIST_PENDING]; i != LIST_NONE; i = iNext )
+		{
+			iNext = m_Nodes[i].m_nNext;
+			if ( m_Nodes[i].m_nTick > nTick )
+			{
+				Unlink( i );
+				Link( i, LIST_WHEEL + ( m_Nodes[i].m_nTick & ( CLIENT_THINK_WHEEL_SIZE - 1 ) ) );
+			}
+		}
+		return;
+	}
+
+	// A jump past the whole wheel visits every bucket once
+	int nSteps = MIN( nTick - m_nWheelTick, CLIENT_THINK_WHEEL_SIZE );
+	for ( int nStep = 1; nStep <= nSteps; ++nStep )
+	{
+		int nList = LIST_WHEEL + ( ( m_nWheelTick + nStep ) & ( CLIENT_THINK_WHEEL_SIZE - 1 ) );
+		unsigned short iNext;
+		for ( unsigned short i = m_Heads[nList]; i != LIST_NONE; i = iNext )
+		{
+			iNext = m_Nodes[i].m_nNext;
+
+			// Entries a turn of the wheel or more away stay
+			if ( m_Nodes[i].m_nTick <= nTick )
+			{
+				Unlink( i );
+				Link( i, LIST_PENDING );
+			}
+		}
+	}
+	m_nWheelTick = nTick;
+}
+
+int __cdecl CClientThinkSchedule::DueLessFunc( const Due_t *pLeft, const Due_t *pRight )
+{
+	if ( pLeft->m_nSequence != pRight->m_nSequence )
+		return ( pLeft->m_nSequence < pRight->m_nSequence ) ? -1 : 1;
+	return 0;
+}
+
+int CClientThinkSchedule::GatherDue( float flCurtime, CUtlVector< unsigned short > &due )
+{
+	AdvanceWheel( TimeToTick( flCurtime ) );
+
+	m_Due.RemoveAll();
+	for ( unsigned short i = m_Heads[LIST_ALWAYS]; i != LIST_NONE; i = m_Nodes[i].m_nNext )
+	{
+		Due_t &entry = m_Due[ m_Due.AddToTail() ];
+		entry.m_nSequence = m_Nodes[i].m_nSequence;
+		entry.m_iEntry = i;
+	}
+	for ( unsigned short i = m_Heads[LIST_PENDING]; i != LIST_NONE; i = m_Nodes[i].m_nNext )
+	{
+		if ( m_Nodes[i].m_flNextThink <= flCurtime )
+		{
+			Due_t &entry = m_Due[ m_Due.AddToTail() ];
+			entry.m_nSequence = m_Nodes[i].m_nSequence;
+			entry.m_iEntry = i;
+		}
+	}
+
+	if ( m_Due.Count() > 1 )
+	{
+		m_Due.Sort( DueLessFunc );
+	}
+
+	due.SetCount( m_Due.Count() );
+	for ( int i = 0; i < m_Due.Count(); ++i )
+	{
+		due[i] = m_Due[i].m_iEntry;
+	}
+	return due.Count();
+}
+
+
+#if defined( FASTPATH_TESTS )
+
+//-----------------------------------------------------------------------------
+// Tests. The reference is what PerformThinkFunctions() used to do: walk every
+// entry in list order and take the ones thinking always or whose time has come.
+//-----------------------------------------------------------------------------
+struct ThinkScheduleTestEntry_t
+{
+	float	m_flNextThink;
+	int		m_iEntry;
+};
+
+static unsigned int s_nThinkScheduleSeed;
+
+static int ThinkScheduleTest_Random( int nRange )
+{
+	s_nThinkScheduleSeed = s_nThinkScheduleSeed * 1664525 + 1013904223;
+	return (int)( ( s_nThinkScheduleSeed >> 8 ) % (unsigned int)nRange );
+}
+
+static float ThinkScheduleTest_RandomTime( float flCurtime )
+{
+	switch ( ThinkScheduleTest_Random( 10 ) )
+	{
+	case 0:
+		return CLIENT_THINK_ALWAYS;
+	case 1:
+		return FLT_MAX;
+	case 2:
+		return flCurtime - ThinkScheduleTest_Random( 1000 ) * 0.001f;		// already due
+	case 3:
+		return flCurtime + 8.0f + ThinkScheduleTest_Random( 30000 ) * 0.001f;	// past a turn of the wheel
+	default:
+		return flCurtime + ThinkScheduleTest_Random( 3000 ) * 0.001f;
+	}
+}
+
+// The entries in list order (add order), like the CUtlLinkedList of the think list
+static void ThinkScheduleTest_ReferenceDue( const CUtlVector< ThinkScheduleTestEntry_t > &entries, float flCurtime, CUtlVector< unsigned short > &due )
+{
+	due.RemoveAll();
+	for ( int i = 0; i < entries.Count(); ++i )
+	{
+		float flNextThink = entries[i].m_flNextThink;
+		if ( flNextThink == CLIENT_THINK_ALWAYS || flNextThink <= flCurtime )
+		{
+			due.AddToTail( entries[i].m_iEntry );
+		}
+	}
+}
+
+bool ClientThinkSchedule_Validate( int nEntries, int nFrames )
+{
+	s_nThinkScheduleSeed = 0x7417;
+	nEntries = clamp( nEntries, 1, 60000 );
+
+	CClientThinkSchedule schedule;
+	CUtlVector< ThinkScheduleTestEntry_t > entries;
+	CUtlVector< int > freeEntries;
+	for ( int i = nEntries - 1; i >= 0; --i )
+	{
+		freeEntries.AddToTail( i );
+	}
+
+	CUtlVector< unsigned short > due, expected;
+	float flCurtime = 100.0f;
+	int nFailures = 0;
+	int nDue = 0;
+	for ( int nFrame = 0; nFrame < nFrames && nFailures < 5; ++nFrame )
+	{
+		// Entities come and go; freed handles are reused like the linked list's
+		int nChanges = ThinkScheduleTest_Random( 8 );
+		for ( int i = 0; i < nChanges; ++i )
+		{
+			if ( freeEntries.Count() && ( !entries.Count() || ThinkScheduleTest_Random( 3 ) ) )
+			{
+				int iEntry = freeEntries.Tail();
+				freeEntries.RemoveMultipleFromTail( 1 );
+				ThinkScheduleTestEntry_t &entry = entries[ entries.AddToTail() ];
+				entry.m_iEntry = iEntry;
+				entry.m_flNextThink = ThinkScheduleTest_RandomTime( flCurtime );
+				schedule.Add( iEntry );
+				schedule.Schedule( iEntry, entry.m_flNextThink );
+			}
+			else if ( entries.Count() )
+			{
+				int nIndex = ThinkScheduleTest_Random( entries.Count() );
+				if ( ThinkScheduleTest_Random( 2 ) )
+				{
+					schedule.Remove( entries[nIndex].m_iEntry );
+					freeEntries.AddToTail( entries[nIndex].m_iEntry );
+					entries.Remove( nIndex );
+				}
+				else
+				{
+					entries[nIndex].m_flNextThink = ThinkScheduleTest_RandomTime( flCurtime );
+					schedule.Schedule( entries[nIndex].m_iEntry, entries[nIndex].m_flNextThink );
+				}
+			}
+		}
+
+		// Mostly frames, sometimes a hitch past the wheel or a new level
+		switch ( ThinkScheduleTest_Random( 64 ) )
+		{
+		case 0:
+			flCurtime += 10.0f + ThinkScheduleTest_Random( 10000 ) * 0.001f;
+			break;
+		case 1:
+			flCurtime = ThinkScheduleTest_Random( 5000 ) * 0.001f;
+			break;
+		default:
+			flCurtime += ThinkScheduleTest_Random( 50 ) * 0.001f;
+			break;
+		}
+
+		schedule.GatherDue( flCurtime, due );
+		ThinkScheduleTest_ReferenceDue( entries, flCurtime, expected );
+		nDue += expected.Count();
+
+		bool bSame = ( due.Count() == expected.Count() );
+		for ( int i = 0; bSame && i < due.Count(); ++i )
+		{
+			bSame = ( due[i] == expected[i] );
+		}
+		if ( !bSame )
+		{
+			Warning( "client think schedule: frame %d at %.3f has %d entries due, the walk over every entry has %d\n", nFrame, flCurtime, due.Count(), expected.Count() );
+			++nFailures;
+		}
+
+		// Think: the timed ones don't think again unless they say so
+		for ( int i = 0; i < entries.Count(); ++i )
+		{
+			ThinkScheduleTestEntry_t &entry = entries[i];
+			if ( entry.m_flNextThink != CLIENT_THINK_ALWAYS && entry.m_flNextThink <= flCurtime )
+			{
+				entry.m_flNextThink = ThinkScheduleTest_Random( 2 ) ? FLT_MAX : ThinkScheduleTest_RandomTime( flCurtime );
+				schedule.Schedule( entry.m_iEntry, entry.m_flNextThink );
+			}
+		}
+	}
+
+	Msg( "client think schedule: %d frames, %d entries due, compared against the walk over every entry: %s\n", nFrames, nDue, nFailures ? "FAILED" : "OK" );
+	return nFailures == 0;
+}
+
+void ClientThinkSchedule_Benchmark( int nEntries, int nFrames )
+{
+	s_nThinkScheduleSeed = 0xbe7c;
+	nEntries = clamp( nEntries, 1, 60000 );
+	nFrames = MAX( nFrames, 1 );
+
+	// Lots of client props, gibs and ragdolls: a few think every frame, some
+	// every second or so, most are idle
+	float flCurtime = 100.0f;
+	CUtlVector< ThinkScheduleTestEntry_t > entries;
+	CClientThinkSchedule schedule;
+	entries.SetCount( nEntries );
+	for ( int i = 0; i < nEntries; ++i )
+	{
+		int nKind = ThinkScheduleTest_Random( 100 );
+		entries[i].m_iEntry = i;
+		entries[i].m_flNextThink = ( nKind < 2 ) ? CLIENT_THINK_ALWAYS : ( nKind < 20 ) ? flCurtime + ThinkScheduleTest_Random( 1000 ) * 0.001f : FLT_MAX;
+		schedule.Add( i );
+		schedule.Schedule( i, entries[i].m_flNextThink );
+	}
+
+	CUtlVector< ThinkScheduleTestEntry_t > reference;
+	reference.CopyArray( entries.Base(), entries.Count() );
+
+	CUtlVector< unsigned short > due;
+	int nWheelDue = 0;
+	double flStart = Plat_FloatTime();
+	float flTime = flCurtime;
+	for ( int nFrame = 0; nFrame < nFrames; ++nFrame )
+	{
+		flTime += 1.0f / 60.0f;
+		int nDue = schedule.GatherDue( flTime, due );
+		for ( int i = 0; i < nDue; ++i )
+		{
+			ThinkScheduleTestEntry_t &entry = entries[ due[i] ];
+			if ( entry.m_flNextThink != CLIENT_THINK_ALWAYS )
+			{
+				entry.m_flNextThink = flTime + 1.0f;
+				schedule.Schedule( due[i], entry.m_flNextThink );
+			}
+		}
+		nWheelDue += nDue;
+	}
+	double flWheel = Plat_FloatTime() - flStart;
+
+	int nWalkDue = 0;
+	flStart = Plat_FloatTime();
+	flTime = flCurtime;
+	for ( int nFrame = 0; nFrame < nFrames; ++nFrame )
+	{
+		flTime += 1.0f / 60.0f;
+		ThinkScheduleTest_ReferenceDue( reference, flTime, due );
+		for ( int i = 0; i < due.Count(); ++i )
+		{
+			ThinkScheduleTestEntry_t &entry = reference[ due[i] ];
+			if ( entry.m_flNextThink != CLIENT_THINK_ALWAYS )
+			{
+				entry.m_flNextThink = flTime + 1.0f;
+			}
+		}
+		nWalkDue += due.Count();
+	}
+	double flWalk = Plat_FloatTime() - flStart;
+
+	Msg( "client think schedule: %d entries, %d frames, %d / %d thinks\n", nEntries, nFrames, nWheelDue, nWalkDue );
+	Msg( "  walk:  %8.3f ms (%.3f us per frame)\n", flWalk * 1000.0, flWalk * 1000000.0 / nFrames );
+	Msg( "  wheel: %8.3f ms (%.3f us per frame), %.2fx\n", flWheel * 1000.0, flWheel * 1000000.0 / nFrames, flWheel > 0.0 ? flWalk / flWheel : 0.0 );
+}
+
+void CC_ClientThinkScheduleTest( const CCommand &args )
+{
+	int nEntries = ( args.ArgC() >= 2 ) ? atoi( args[1] ) : 4000;
+	int nFrames = ( args.ArgC() >= 3 ) ? atoi( args[2] ) : 2000;
+	if ( !ClientThinkSchedule_Validate( MIN( nEntries, 2000 ), nFrames ) )
+		return;
+
+	ClientThinkSchedule_Benchmark( nEntries, nFrames );
+}
+
+static ConCommand client_think_schedule_test( "client_think_schedule_test", CC_ClientThinkScheduleTest, "Checks the timing wheel of the client think list against a walk over every entry on random think times, then times both. Usage: client_think_schedule_test [entries] [frames]", FCVAR_CHEAT );
+
+#endif // FASTPATH_TESTS
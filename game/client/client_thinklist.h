@@ -26,6 +26,96 @@
 #define INVALID_THINK_HANDLE ClientThinkList()->GetInvalidThinkHandle()
 
 
+//-----------------------------------------------------------------------------
+// When the entries of the think list are due.
+//
+// Entries thinking every frame are on their own list. Timed entries sit in a
+// hashed timing wheel: a bucket per tick of 1/CLIENT_THINK_WHEEL_TICKRATE
+// seconds over CLIENT_THINK_WHEEL_SIZE ticks, later times wrap around and wait
+// for their turn. Entries of the ticks the clock has passed move to a pending
+// list whose times are compared each frame. Scheduling or unscheduling an
+// entry is a relink, and a frame only looks at the entries of the ticks it
+// passed instead of at every entry.
+//
+// Entries are numbered by Add(), and GatherDue() returns them in that order,
+// which is the order of the think list.
+//-----------------------------------------------------------------------------
+#define CLIENT_THINK_WHEEL_BITS			8
+#define CLIENT_THINK_WHEEL_SIZE			( 1 << CLIENT_THINK_WHEEL_BITS )
+#define CLIENT_THINK_WHEEL_TICKRATE		32
+
+class CClientThinkSchedule
+{
+public:
+	CClientThinkSchedule();
+
+	void	Reset();
+
+	// iEntry is the think handle; Add() puts it after every entry added before
+	void	Add( int iEntry );
+	void	Remove( int iEntry );
+
+	// CLIENT_THINK_ALWAYS thinks every frame, FLT_MAX never
+	void	Schedule( int iEntry, float flNextThink );
+	void	Unschedule( int iEntry );
+
+	// The entries thinking every frame and the ones whose time is <= flCurtime, in Add() order
+	int		GatherDue( float flCurtime, CUtlVector< unsigned short > &due );
+
+	int		GetScheduledCount() const	{ return m_nScheduled; }
+
+private:
+	enum
+	{
+		LIST_ALWAYS = 0,
+		LIST_PENDING,
+		LIST_WHEEL,
+
+		LIST_COUNT = LIST_WHEEL + CLIENT_THINK_WHEEL_SIZE,
+		LIST_NONE = 0xFFFF,
+	};
+
+	struct Node_t
+	{
+		float			m_flNextThink;
+		int				m_nTick;
+		unsigned int	m_nSequence;
+		unsigned short	m_nPrev;
+		unsigned short	m_nNext;
+		unsigned short	m_nList;
+	};
+
+	struct Due_t
+	{
+		unsigned int	m_nSequence;
+		unsigned short	m_iEntry;
+	};
+
+	static int		TimeToTick( float flTime );
+	static int		__cdecl DueLessFunc( const Due_t *pLeft, const Due_t *pRight );
+	void			Link( int iEntry, int nList );
+	void			Unlink( int iEntry );
+	void			AdvanceWheel( int nTick );
+
+	CUtlVector< Node_t > m_Nodes;
+	unsigned short m_Heads[LIST_COUNT];
+	int m_nWheelTick;				// every tick up to this one has been moved to pending
+	unsigned int m_nSequence;
+	int m_nScheduled;
+	CUtlVector< Due_t > m_Due;
+};
+
+
+#if defined( FASTPATH_TESTS )
+//-----------------------------------------------------------------------------
+// Checks the due entries of the schedule against a walk over every entry on
+// random think times, then times a frame of both with few entries due
+//-----------------------------------------------------------------------------
+bool ClientThinkSchedule_Validate( int nEntries, int nFrames );
+void ClientThinkSchedule_Benchmark( int nEntries, int nFrames );
+#endif
+
+
 class CClientThinkList : public IGameSystemPerFrame
 {
 public:
@@ -74,6 +164,7 @@ private:
 	struct ThinkEntry_t
 	{
 		ClientEntityHandle_t	m_hEnt;
+		ClientThinkHandle_t		m_hThink;
 		float					m_flNextClientThink;
 		float					m_flLastClientThink;
 		int						m_nIterEnum;
@@ -89,6 +180,7 @@ private:
 // Internal stuff.
 private:
 	void			SetNextClientThink( ClientThinkHandle_t hThink, float nextTime );
+	void			SetEntryNextThink( ThinkEntry_t *pEntry, float nextTime );
 	void			RemoveThinkable( ClientThinkHandle_t hThink );
 	void			PerformThinkFunction( ThinkEntry_t *pEntry, float curtime );
 	ThinkEntry_t*	GetThinkEntry( ClientThinkHandle_t hThink );
@@ -99,6 +191,8 @@ private:
 
 private:
 	CUtlLinkedList<ThinkEntry_t, unsigned short>	m_ThinkEntries;
+	CClientThinkSchedule							m_Schedule;
+	CUtlVector<unsigned short>						m_DueEntries;
 
 	CUtlVector<ClientEntityHandle_t>	m_aDeleteList;
 	CUtlVector<ThinkListChanges_t>		m_aChangeList;
@@ -26,6 +26,7 @@
 #include "viewrender.h"
 #include "clientalphaproperty.h"
 #include "con_nprint.h"
+#include "leaflistbatch.h"
 //#include "tier0/miniprofiler.h" 
 
 // memdbgon must be the last include file in a .cpp file!!!
@@ -45,6 +46,7 @@ static ConVar r_portalsopenall( "r_portalsopenall", "0", FCVAR_CHEAT, "Open all
 static ConVar r_shadows_on_renderables_enable( "r_shadows_on_renderables_enable", "0", 0, "Support casting RTT shadows onto other renderables" );
 
 static ConVar cl_leafsystemvis( "cl_leafsystemvis", "0", FCVAR_CHEAT );
+static ConVar cl_threaded_leaf_reinsertion( "cl_threaded_leaf_reinsertion", "1", 0, "List the leaves of moved renderables on the thread pool." );
 
 DEFINE_FIXEDSIZE_ALLOCATOR( CClientRenderablesList, 1, CUtlMemoryPool::GROW_SLOW );
 
@@ -265,7 +267,10 @@ private:
 
 	// remove renderables from leaves
 	void RemoveFromTree( ClientRenderHandle_t handle );
-	void InsertIntoTree( ClientRenderHandle_t &handle, const Vector &absMins, const Vector &absMaxs );
+	void InsertIntoTree( ClientRenderHandle_t &handle, const Vector &absMins, const Vector &absMaxs, int nLeafCount, unsigned short *pLeaves );
+
+	// Is the renderable in exactly these leaves? They must be sorted.
+	bool IsRenderableInLeaves( ClientRenderHandle_t handle, int nLeafCount, const unsigned short *pLeaves );
 
 	// Adds, removes renderables from view model list
 	void AddToViewModelList( ClientRenderHandle_t handle );
@@ -279,6 +284,13 @@ private:
 	void AddShadowToRenderable( ClientRenderHandle_t renderHandle, ClientLeafShadowHandle_t shadowHandle );
 	void RemoveShadowFromRenderables( ClientLeafShadowHandle_t handle );
 
+	// Adds, removes the renderable as a receiver of shadows in the shadow manager
+	void AddShadowToReceiver( ClientRenderHandle_t renderHandle, ClientLeafShadowHandle_t shadowHandle );
+	void RemoveAllShadowsFromReceiver( ClientRenderHandle_t handle );
+
+	// Re-projects the shadows on a renderable that moved within its leaves
+	void ReprojectShadowsOnRenderable( ClientRenderHandle_t handle );
+
 	// Adds a shadow to a leaf/removes shadow from renderable
 	bool ShouldRenderableReceiveShadow( ClientRenderHandle_t renderHandle, int nShadowFlags );
 
@@ -364,6 +376,10 @@ private:
 	// Dirty list of renderables
 	CUtlVector< ClientRenderHandle_t >	m_DirtyRenderables;
 
+	// Renderables whose bounds changed, and the leaves of their new bounds
+	CUtlVector< ClientRenderHandle_t >	m_ReinsertHandles;
+	CLeafListBatch						m_LeafListBatch;
+
 	// List of renderables in view model render groups
 	CUtlVector< ClientRenderHandle_t >	m_ViewModels;
 
@@ -614,6 +630,8 @@ void CClientLeafSystem::LevelShutdownPostEntity()
 	m_ShadowsInLeaf.Purge();
 	m_ShadowsOnRenderable.Purge();
 	m_DirtyRenderables.Purge();
+	m_ReinsertHandles.Purge();
+	m_LeafListBatch.Purge();
 }
 
 
@@ -690,6 +708,10 @@ void CClientLeafSystem::RecomputeRenderableLeaves()
 
 		s_bIsInRecomputeRenderableLeaves = true;
 
+		// Bounds first; they come from the renderables, so this stays on the main thread
+		m_ReinsertHandles.RemoveAll();
+		m_LeafListBatch.RemoveAll();
+
 		int nDirty = m_DirtyRenderables.Count();
 		for ( i = nDirty; --i >= 0; )
 		{
@@ -707,13 +729,42 @@ void CClientLeafSystem::RecomputeRenderableLeaves()
 			CalcRenderableWorldSpaceAABB_Bloated( info, absMins, absMaxs );
 			if ( absMins != info.m_vecBloatedAbsMins || absMaxs != info.m_vecBloatedAbsMaxs )
 			{
-				// Update position in leaf system
-				RemoveFromTree( handle );
-				InsertIntoTree( m_DirtyRenderables[i], absMins, absMaxs );
-				if ( bDebugLeafSystem )
-				{
-					debugoverlay->AddBoxOverlay( vec3_origin, absMins, absMaxs, QAngle( 0, 0, 0 ), 0, 255, 0, 0, 0 );
-				}
+				m_ReinsertHandles.AddToTail( handle );
+				m_LeafListBatch.AddBox( absMins, absMaxs );
+			}
+		}
+
+		// Then the leaves of all of them at once
+		if ( m_ReinsertHandles.Count() )
+		{
+			m_LeafListBatch.ListLeaves( engine->GetBSPTreeQuery(), cl_threaded_leaf_reinsertion.GetBool() ? g_pThreadPool : NULL );
+		}
+
+		// Update position in leaf system. Bounds that moved within the
+		// leaves the renderable is already in only need to be stored.
+		for ( i = 0; i < m_ReinsertHandles.Count(); ++i )
+		{
+			ClientRenderHandle_t handle = m_ReinsertHandles[i];
+			const Vector &vecMins = m_LeafListBatch.GetMins( i );
+			const Vector &vecMaxs = m_LeafListBatch.GetMaxs( i );
+			int nLeafCount = m_LeafListBatch.GetLeafCount( i );
+			unsigned short *pLeaves = m_LeafListBatch.GetLeaves( i );
+
+			if ( nLeafCount && IsRenderableInLeaves( handle, nLeafCount, pLeaves ) )
+			{
+				m_Renderables[handle].m_vecBloatedAbsMins = vecMins;
+				m_Renderables[handle].m_vecBloatedAbsMaxs = vecMaxs;
+
+				// Same leaves, same shadows, but they were projected onto where it used to be
+				ReprojectShadowsOnRenderable( handle );
+				continue;
+			}
+
+			RemoveFromTree( handle );
+			InsertIntoTree( m_ReinsertHandles[i], vecMins, vecMaxs, nLeafCount, pLeaves );
+			if ( bDebugLeafSystem )
+			{
+				debugoverlay->AddBoxOverlay( vec3_origin, vecMins, vecMaxs, QAngle( 0, 0, 0 ), 0, 255, 0, 0, 0 );
 			}
 		}
 
@@ -1201,7 +1252,12 @@ void CClientLeafSystem::AddShadowToRenderable( ClientRenderHandle_t renderHandle
 		return;
 
 	m_ShadowsOnRenderable.AddElementToBucket( renderHandle, shadowHandle );
+	AddShadowToReceiver( renderHandle, shadowHandle );
+}
 
+void CClientLeafSystem::AddShadowToReceiver( ClientRenderHandle_t renderHandle, 
+										ClientLeafShadowHandle_t shadowHandle )
+{
 	// Also, do some stuff specific to the particular types of renderables
 #if 0
 	// If the renderable is a brush model, then add this shadow to it
@@ -1251,6 +1307,44 @@ void CClientLeafSystem::RemoveShadowFromRenderables( ClientLeafShadowHandle_t ha
 	m_ShadowsOnRenderable.RemoveElement( handle );
 }
 
+void CClientLeafSystem::RemoveAllShadowsFromReceiver( ClientRenderHandle_t handle )
+{
+	switch( m_Renderables[handle].m_nModelType )
+	{
+	case RENDERABLE_MODEL_BRUSH:
+		g_pClientShadowMgr->RemoveAllShadowsFromReceiver( 
+			m_Renderables[handle].m_pRenderable, SHADOW_RECEIVER_BRUSH_MODEL );
+		break;
+
+	case RENDERABLE_MODEL_STATIC_PROP:
+		g_pClientShadowMgr->RemoveAllShadowsFromReceiver( 
+			m_Renderables[handle].m_pRenderable, SHADOW_RECEIVER_STATIC_PROP );
+		break;
+
+	case RENDERABLE_MODEL_STUDIOMDL:
+		g_pClientShadowMgr->RemoveAllShadowsFromReceiver( 
+			m_Renderables[handle].m_pRenderable, SHADOW_RECEIVER_STUDIO_MODEL );
+		break;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// A renderable that moved within the leaves it is in keeps its shadows, but
+// the shadow manager clipped them against where it was. Does what removing
+// and reinserting it would do to them.
+//-----------------------------------------------------------------------------
+void CClientLeafSystem::ReprojectShadowsOnRenderable( ClientRenderHandle_t handle )
+{
+	RemoveAllShadowsFromReceiver( handle );
+
+	unsigned int i = m_ShadowsOnRenderable.FirstElement( handle );
+	while ( i != m_ShadowsOnRenderable.InvalidIndex() )
+	{
+		AddShadowToReceiver( handle, m_ShadowsOnRenderable.Element( i ) );
+		i = m_ShadowsOnRenderable.NextElement( i );
+	}
+}
+
 
 //-----------------------------------------------------------------------------
 // Adds a shadow to a leaf/removes shadow from leaf
@@ -1464,7 +1558,18 @@ bool CClientLeafSystem::EnumerateLeaf( int leaf, int context )
 	return true;
 }
 
-void CClientLeafSystem::InsertIntoTree( ClientRenderHandle_t &handle, const Vector &absMins, const Vector &absMaxs )
+bool CClientLeafSystem::IsRenderableInLeaves( ClientRenderHandle_t handle, int nLeafCount, const unsigned short *pLeaves )
+{
+	int nCount = 0;
+	for ( unsigned int i = m_RenderablesInLeaf.FirstBucket( handle ); i != m_RenderablesInLeaf.InvalidIndex(); i = m_RenderablesInLeaf.NextBucket( i ) )
+	{
+		if ( ++nCount > nLeafCount || !CLeafListBatch::ContainsLeaf( pLeaves, nLeafCount, m_RenderablesInLeaf.Bucket( i ) ) )
+			return false;
+	}
+	return nCount == nLeafCount;
+}
+
+void CClientLeafSystem::InsertIntoTree( ClientRenderHandle_t &handle, const Vector &absMins, const Vector &absMaxs, int nLeafCount, unsigned short *pLeaves )
 {
 	// NOTE: The render bounds here are relative to the renderable's coordinate system
 	RenderableInfo_t &info = m_Renderables[handle];
@@ -1479,9 +1584,6 @@ void CClientLeafSystem::InsertIntoTree( ClientRenderHandle_t &handle, const Vect
 	// When we insert into the tree, increase the shadow enumerator
 	// to make sure each shadow is added exactly once to each renderable
 	m_ShadowEnum++;
-	unsigned short leafList[1024];
-	ISpatialQuery* pQuery = engine->GetBSPTreeQuery();
-	int leafCount = pQuery->ListLeavesInBox( absMins, absMaxs, leafList, ARRAYSIZE(leafList) );
 	bool bReceiveShadows = ShouldRenderableReceiveShadow( handle, SHADOW_FLAGS_PROJECTED_TEXTURE_TYPE_MASK );
 
 	if ( !IsX360() && cl_leafsystemvis.GetBool() )
@@ -1518,7 +1620,7 @@ void CClientLeafSystem::InsertIntoTree( ClientRenderHandle_t &handle, const Vect
 		engine->Con_NXPrintf( &np, "%s", pClassName );
 	}
 
-	AddRenderableToLeaves( handle, leafCount, leafList, bReceiveShadows );
+	AddRenderableToLeaves( handle, nLeafCount, pLeaves, bReceiveShadows );
 }
 
 //-----------------------------------------------------------------------------
@@ -1530,25 +1632,7 @@ void CClientLeafSystem::RemoveFromTree( ClientRenderHandle_t handle )
 
 	// Remove all shadows cast onto the object
 	m_ShadowsOnRenderable.RemoveBucket( handle );
-
-	switch( m_Renderables[handle].m_nModelType )
-	{
-	case RENDERABLE_MODEL_BRUSH:
-		g_pClientShadowMgr->RemoveAllShadowsFromReceiver( 
-			m_Renderables[handle].m_pRenderable, SHADOW_RECEIVER_BRUSH_MODEL );
-		break;
-
-	case RENDERABLE_MODEL_STATIC_PROP:
-		g_pClientShadowMgr->RemoveAllShadowsFromReceiver( 
-			m_Renderables[handle].m_pRenderable, SHADOW_RECEIVER_STATIC_PROP );
-		break;
-
-	case RENDERABLE_MODEL_STUDIOMDL:
-		g_pClientShadowMgr->RemoveAllShadowsFromReceiver( 
-			m_Renderables[handle].m_pRenderable, SHADOW_RECEIVER_STUDIO_MODEL );
-		break;
-	}
-
+	RemoveAllShadowsFromReceiver( handle );
 }
 
 
@@ -0,0 +1,555 @@
+//===== Copyright (c) 1996-2005, Valve Corporation, All rights reserved. ======//
+//
+// Purpose: Lists the leaves of many boxes at once, on the thread pool.
+//
+// $NoKeywords: $
+//===========================================================================//
+
+#include "cbase.h"
+#include "leaflistbatch.h"
+#include "bsptreedata.h"
+#include "vstdlib/jobthread.h"
+#include "utlbidirectionalset.h"
+#include <algorithm>
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+
+//-----------------------------------------------------------------------------
+// Batch
+//-----------------------------------------------------------------------------
+CLeafListBatch::CLeafListBatch()
+{
+	m_nJobs = 0;
+}
+
+void CLeafListBatch::RemoveAll()
+{
+	m_Boxes.RemoveAll();
+	m_nJobs = 0;
+}
+
+void CLeafListBatch::Purge()
+{
+	m_Boxes.Purge();
+	m_Jobs.Purge();
+	m_nJobs = 0;
+}
+
+int CLeafListBatch::AddBox( const Vector &vecMins, const Vector &vecMaxs )
+{
+	int iBox = m_Boxes.AddToTail();
+	Box_t &box = m_Boxes[iBox];
+	box.m_vecMins = vecMins;
+	box.m_vecMaxs = vecMaxs;
+	box.m_nJob = iBox / LEAFLISTBATCH_BOXES_PER_JOB;
+	box.m_nFirstLeaf = 0;
+	box.m_nLeafCount = 0;
+	return iBox;
+}
+
+void CLeafListBatch::ProcessJob( Job_t &job )
+{
+	job.m_Leaves.RemoveAll();
+
+	unsigned short leafList[LEAFLISTBATCH_MAX_LEAVES];
+	for ( int i = 0; i < job.m_nBoxCount; ++i )
+	{
+		Box_t &box = job.m_pBoxes[ job.m_nFirstBox + i ];
+		int nLeafCount = job.m_pQuery->ListLeavesInBox( box.m_vecMins, box.m_vecMaxs, leafList, ARRAYSIZE( leafList ) );
+
+		// Sorted, so the leaf system can compare them with the leaves a renderable is in
+		std::sort( leafList, leafList + nLeafCount );
+
+		box.m_nFirstLeaf = job.m_Leaves.AddMultipleToTail( nLeafCount, leafList );
+		box.m_nLeafCount = nLeafCount;
+	}
+}
+
+void CLeafListBatch::ListLeaves( ISpatialQuery *pQuery, IThreadPool *pThreadPool )
+{
+	int nBoxes = m_Boxes.Count();
+	m_nJobs = ( nBoxes + LEAFLISTBATCH_BOXES_PER_JOB - 1 ) / LEAFLISTBATCH_BOXES_PER_JOB;
+	if ( m_Jobs.Count() < m_nJobs )
+	{
+		m_Jobs.AddMultipleToTail( m_nJobs - m_Jobs.Count() );
+	}
+
+	for ( int i = 0; i < m_nJobs; ++i )
+	{
+		Job_t &job = m_Jobs[i];
+		job.m_pQuery = pQuery;
+		job.m_pBoxes = m_Boxes.Base();
+		job.m_nFirstBox = i * LEAFLISTBATCH_BOXES_PER_JOB;
+		job.m_nBoxCount = MIN( LEAFLISTBATCH_BOXES_PER_JOB, nBoxes - job.m_nFirstBox );
+	}
+
+	if ( pThreadPool && m_nJobs > 1 )
+	{
+		ParallelProcess( pThreadPool, m_Jobs.Base(), m_nJobs, &CLeafListBatch::ProcessJob );
+	}
+	else
+	{
+		for ( int i = 0; i < m_nJobs; ++i )
+		{
+			ProcessJob( m_Jobs[i] );
+		}
+	}
+}
+
+bool CLeafListBatch::ContainsLeaf( const unsigned short *pSortedLeaves, int nLeafCount, int nLeaf )
+{
+	int nLow = 0;
+	int nHigh = nLeafCount - 1;
+	while ( nLow <= nHigh )
+	{
+		int nMid = ( nLow + nHigh ) >> 1;
+		if ( pSortedLeaves[nMid] < nLeaf )
+		{
+			nLow = nMid + 1;
+		}
+		else if ( pSortedLeaves[nMid] > nLeaf )
+		{
+			nHigh = nMid - 1;
+		}
+		else
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+
+#if defined( FASTPATH_TESTS )
+
+//-----------------------------------------------------------------------------
+// Tests. The tree is a BSP of axis aligned planes splitting a level sized
+// box down to 128 x 128 x 256 leaves, walked the way the engine walks its
+// nodes for ListLeavesInBox().
+//-----------------------------------------------------------------------------
+class CLeafListTestTree : public ISpatialQuery
+{
+public:
+	void Build( const Vector &vecMins, const Vector &vecMaxs, const Vector &vecLeafSize )
+	{
+		m_Nodes.RemoveAll();
+		m_nLeafCount = 0;
+		m_nHeadNode = BuildNode( vecMins, vecMaxs, vecLeafSize );
+	}
+
+	virtual int LeafCount() const { return m_nLeafCount; }
+
+	virtual bool EnumerateLeavesAtPoint( const Vector& pt, ISpatialLeafEnumerator* pEnum, int context ) { Assert( 0 ); return false; }
+	virtual bool EnumerateLeavesInBox( const Vector& mins, const Vector& maxs, ISpatialLeafEnumerator* pEnum, int context ) { Assert( 0 ); return false; }
+	virtual bool EnumerateLeavesInSphere( const Vector& center, float radius, ISpatialLeafEnumerator* pEnum, int context ) { Assert( 0 ); return false; }
+	virtual bool EnumerateLeavesAlongRay( Ray_t const& ray, ISpatialLeafEnumerator* pEnum, int context ) { Assert( 0 ); return false; }
+	virtual bool EnumerateLeavesInSphereWithFlagSet( const Vector& center, float radius, ISpatialLeafEnumerator* pEnum, int context, int nFlagsCheck ) { Assert( 0 ); return false; }
+	virtual int ListLeavesInSphereWithFlagSet( int *pLeafsInSphere, const Vector& vecCenter, float flRadius, int nLeafCount, const uint16 *pLeafs, int nLeafStride, int nFlagsCheck ) { Assert( 0 ); return 0; }
+
+	virtual int ListLeavesInBox( const Vector& mins, const Vector& maxs, unsigned short *pList, int listMax )
+	{
+		int nCount = 0;
+		ListLeavesInBox_r( m_nHeadNode, mins, maxs, pList, listMax, nCount );
+		return nCount;
+	}
+
+private:
+	struct Node_t
+	{
+		int		m_nAxis;
+		float	m_flDist;
+		int		m_nChildren[2];		// front, back; -1 - leaf for leaves
+	};
+
+	int BuildNode( const Vector &vecMins, const Vector &vecMaxs, const Vector &vecLeafSize )
+	{
+		int nAxis = 0;
+		float flBest = 0.0f;
+		for ( int i = 0; i < 3; ++i )
+		{
+			float flCells = ( vecMaxs[i] - vecMins[i] ) / vecLeafSize[i];
+			if ( flCells > flBest )
+			{
+				flBest = flCells;
+				nAxis = i;
+			}
+		}
+
+		if ( flBest <= 1.0f )
+			return -1 - m_nLeafCount++;
+
+		int iNode = m_Nodes.AddToTail();
+		float flDist = vecMins[nAxis] + floor( flBest * 0.5f ) * vecLeafSize[nAxis];
+		m_Nodes[iNode].m_nAxis = nAxis;
+		m_Nodes[iNode].m_flDist = flDist;
+
+		Vector vecSplitMins = vecMins;
+		Vector vecSplitMaxs = vecMaxs;
+		vecSplitMins[nAxis] = flDist;
+		int nFront = BuildNode( vecSplitMins, vecMaxs, vecLeafSize );
+		vecSplitMaxs[nAxis] = flDist;
+		int nBack = BuildNode( vecMins, vecSplitMaxs, vecLeafSize );
+
+		m_Nodes[iNode].m_nChildren[0] = nFront;
+		m_Nodes[iNode].m_nChildren[1] = nBack;
+		return iNode;
+	}
+
+	void ListLeavesInBox_r( int nNode, const Vector& mins, const Vector& maxs, unsigned short *pList, int listMax, int &nCount )
+	{
+		while ( nNode >= 0 )
+		{
+			const Node_t &node = m_Nodes[nNode];
+			if ( mins[node.m_nAxis] >= node.m_flDist )
+			{
+				nNode = node.m_nChildren[0];
+			}
+			else if ( maxs[node.m_nAxis] < node.m_flDist )
+			{
+				nNode = node.m_nChildren[1];
+			}
+			else
+			{
+				ListLeavesInBox_r( node.m_nChildren[0], mins, maxs, pList, listMax, nCount );
+				nNode = node.m_nChildren[1];
+			}
+		}
+
+		if ( nCount < listMax )
+		{
+			pList[nCount++] = -1 - nNode;
+		}
+	}
+
+	CUtlVector< Node_t > m_Nodes;
+	int m_nHeadNode;
+	int m_nLeafCount;
+};
+
+static unsigned int s_nLeafListSeed;
+
+static float LeafListTest_Random( float flMin, float flMax )
+{
+	s_nLeafListSeed = s_nLeafListSeed * 1664525 + 1013904223;
+	return flMin + ( flMax - flMin ) * ( ( s_nLeafListSeed >> 8 ) & 0xFFFF ) * ( 1.0f / 65535.0f );
+}
+
+static void LeafListTest_BuildTree( CLeafListTestTree &tree )
+{
+	tree.Build( Vector( -4096, -4096, -1024 ), Vector( 4096, 4096, 1024 ), Vector( 128, 128, 256 ) );
+}
+
+// Like CClientLeafSystem::CalcRenderableWorldSpaceAABB_Bloated()
+static void LeafListTest_Bloat( const Vector &vecCenter, const Vector &vecExtents, Vector &vecMins, Vector &vecMaxs )
+{
+	for ( int i = 0; i < 3; ++i )
+	{
+		vecMins[i] = floor( ( vecCenter[i] - vecExtents[i] ) / 32.0f ) * 32.0f;
+		vecMaxs[i] = ceil( ( vecCenter[i] + vecExtents[i] ) / 32.0f ) * 32.0f;
+	}
+}
+
+bool LeafListBatch_Validate( int nBoxes, IThreadPool *pThreadPool )
+{
+	CLeafListTestTree tree;
+	LeafListTest_BuildTree( tree );
+
+	s_nLeafListSeed = 4321;
+	CLeafListBatch batch;
+	int nFailures = 0;
+	for ( int nPass = 0; nPass < 3; ++nPass )
+	{
+		// Different counts on each pass so the job buffers get reused at other sizes
+		int nPassBoxes = ( nPass == 1 ) ? nBoxes / 3 + 1 : nBoxes;
+		batch.RemoveAll();
+		for ( int i = 0; i < nPassBoxes; ++i )
+		{
+			Vector vecCenter( LeafListTest_Random( -4200, 4200 ), LeafListTest_Random( -4200, 4200 ), LeafListTest_Random( -1100, 1100 ) );
+			float flSize = ( i % 50 ) ? LeafListTest_Random( 4, 96 ) : LeafListTest_Random( 256, 1024 );
+			Vector vecExtents( flSize, LeafListTest_Random( 4, 96 ), LeafListTest_Random( 4, 128 ) );
+			Vector vecMins, vecMaxs;
+			LeafListTest_Bloat( vecCenter, vecExtents, vecMins, vecMaxs );
+			batch.AddBox( vecMins, vecMaxs );
+		}
+
+		batch.ListLeaves( &tree, ( nPass == 2 ) ? NULL : pThreadPool );
+
+		for ( int i = 0; i < nPassBoxes; ++i )
+		{
+			unsigned short leafList[LEAFLISTBATCH_MAX_LEAVES];
+			int nLeafCount = tree.ListLeavesInBox( batch.GetMins( i ), batch.GetMaxs( i ), leafList, ARRAYSIZE( leafList ) );
+			std::sort( leafList, leafList + nLeafCount );
+
+			const unsigned short *pLeaves = batch.GetLeaves( i );
+			bool bMatch = ( batch.GetLeafCount( i ) == nLeafCount );
+			for ( int j = 0; bMatch && j < nLeafCount; ++j )
+			{
+				bMatch = ( pLeaves[j] == leafList[j] ) && CLeafListBatch::ContainsLeaf( pLeaves, nLeafCount, leafList[j] );
+			}
+			if ( bMatch && nLeafCount && ( CLeafListBatch::ContainsLeaf( pLeaves, nLeafCount, leafList[nLeafCount-1] + 1 ) || CLeafListBatch::ContainsLeaf( pLeaves, nLeafCount, leafList[0] - 1 ) ) )
+			{
+				bMatch = false;
+			}
+
+			if ( !bMatch && ++nFailures <= 5 )
+			{
+				Warning( "leaf list batch: pass %d box %d has %d leaves, ListLeavesInBox %d\n", nPass, i, batch.GetLeafCount( i ), nLeafCount );
+			}
+		}
+	}
+
+	if ( nFailures )
+	{
+		Warning( "leaf list batch: %d mismatches\n", nFailures );
+		return false;
+	}
+
+	Msg( "leaf list batch: %d boxes in %d leaves OK\n", nBoxes, tree.LeafCount() );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Benchmark: moving renderables kept in per-leaf lists like the ones of the
+// client leaf system, reinserted one at a time or through the batch
+//-----------------------------------------------------------------------------
+typedef CBidirectionalSet< int, int, unsigned short, unsigned int > LeafListTestSet_t;
+
+struct LeafListTestRenderable_t
+{
+	Vector			m_vecCenter;
+	Vector			m_vecExtents;
+	Vector			m_vecVelocity;
+	Vector			m_vecBloatedMins;
+	Vector			m_vecBloatedMaxs;
+	unsigned short	m_nFirstLeaf;
+};
+
+struct LeafListTestState_t
+{
+	CUtlVector< LeafListTestRenderable_t > m_Renderables;
+	CUtlVector< unsigned short > m_FirstInLeaf;
+	LeafListTestSet_t m_RenderablesInLeaf;
+	int m_nReinserted;
+	int m_nKept;
+};
+
+static LeafListTestState_t *s_pLeafListTestState;
+
+static unsigned short &LeafListTest_FirstRenderableInLeaf( int nLeaf )
+{
+	return s_pLeafListTestState->m_FirstInLeaf[nLeaf];
+}
+
+static unsigned short &LeafListTest_FirstLeafInRenderable( int nRenderable )
+{
+	return s_pLeafListTestState->m_Renderables[nRenderable].m_nFirstLeaf;
+}
+
+static void LeafListTest_Init( LeafListTestState_t &state, CLeafListTestTree &tree, int nRenderables )
+{
+	s_pLeafListTestState = &state;
+	state.m_RenderablesInLeaf.Init( LeafListTest_FirstRenderableInLeaf, LeafListTest_FirstLeafInRenderable );
+	state.m_FirstInLeaf.SetCount( tree.LeafCount() );
+	for ( int i = 0; i < tree.LeafCount(); ++i )
+	{
+		state.m_FirstInLeaf[i] = state.m_RenderablesInLeaf.InvalidIndex();
+	}
+
+	s_nLeafListSeed = 8765;
+	state.m_Renderables.SetCount( nRenderables );
+	for ( int i = 0; i < nRenderables; ++i )
+	{
+		LeafListTestRenderable_t &renderable = state.m_Renderables[i];
+		renderable.m_vecCenter.Init( LeafListTest_Random( -4000, 4000 ), LeafListTest_Random( -4000, 4000 ), LeafListTest_Random( -900, 900 ) );
+		renderable.m_vecExtents.Init( LeafListTest_Random( 8, 48 ), LeafListTest_Random( 8, 48 ), LeafListTest_Random( 16, 64 ) );
+		renderable.m_vecVelocity.Init( LeafListTest_Random( -4, 4 ), LeafListTest_Random( -4, 4 ), LeafListTest_Random( -1, 1 ) );
+		renderable.m_nFirstLeaf = state.m_RenderablesInLeaf.InvalidIndex();
+
+		unsigned short leafList[LEAFLISTBATCH_MAX_LEAVES];
+		LeafListTest_Bloat( renderable.m_vecCenter, renderable.m_vecExtents, renderable.m_vecBloatedMins, renderable.m_vecBloatedMaxs );
+		int nLeafCount = tree.ListLeavesInBox( renderable.m_vecBloatedMins, renderable.m_vecBloatedMaxs, leafList, ARRAYSIZE( leafList ) );
+		for ( int j = 0; j < nLeafCount; ++j )
+		{
+			state.m_RenderablesInLeaf.AddElementToBucket( leafList[j], i );
+		}
+	}
+	state.m_nReinserted = 0;
+	state.m_nKept = 0;
+}
+
+static void LeafListTest_Move( LeafListTestRenderable_t &renderable )
+{
+	renderable.m_vecCenter += renderable.m_vecVelocity;
+	for ( int i = 0; i < 3; ++i )
+	{
+		float flLimit = ( i == 2 ) ? 1000.0f : 4000.0f;
+		if ( fabs( renderable.m_vecCenter[i] ) > flLimit )
+		{
+			renderable.m_vecVelocity[i] = -renderable.m_vecVelocity[i];
+		}
+	}
+}
+
+// What RecomputeRenderableLeaves() did before the batch
+static void LeafListTest_FrameSerial( LeafListTestState_t &state, CLeafListTestTree &tree )
+{
+	for ( int i = state.m_Renderables.Count(); --i >= 0; )
+	{
+		LeafListTestRenderable_t &renderable = state.m_Renderables[i];
+		LeafListTest_Move( renderable );
+
+		Vector vecMins, vecMaxs;
+		LeafListTest_Bloat( renderable.m_vecCenter, renderable.m_vecExtents, vecMins, vecMaxs );
+		if ( vecMins == renderable.m_vecBloatedMins && vecMaxs == renderable.m_vecBloatedMaxs )
+			continue;
+
+		state.m_RenderablesInLeaf.RemoveElement( i );
+		renderable.m_vecBloatedMins = vecMins;
+		renderable.m_vecBloatedMaxs = vecMaxs;
+
+		unsigned short leafList[LEAFLISTBATCH_MAX_LEAVES];
+		int nLeafCount = tree.ListLeavesInBox( vecMins, vecMaxs, leafList, ARRAYSIZE( leafList ) );
+		for ( int j = 0; j < nLeafCount; ++j )
+		{
+			state.m_RenderablesInLeaf.AddElementToBucket( leafList[j], i );
+		}
+		++state.m_nReinserted;
+	}
+}
+
+static bool LeafListTest_InSameLeaves( LeafListTestSet_t &set, int nRenderable, const unsigned short *pLeaves, int nLeafCount )
+{
+	int nCount = 0;
+	for ( unsigned int i = set.FirstBucket( nRenderable ); i != set.InvalidIndex(); i = set.NextBucket( i ) )
+	{
+		if ( ++nCount > nLeafCount || !CLeafListBatch::ContainsLeaf( pLeaves, nLeafCount, set.Bucket( i ) ) )
+			return false;
+	}
+	return nCount == nLeafCount;
+}
+
+// What it does now
+static void LeafListTest_FrameBatched( LeafListTestState_t &state, CLeafListTestTree &tree, CLeafListBatch &batch, CUtlVector< int > &handles, IThreadPool *pThreadPool )
+{
+	batch.RemoveAll();
+	handles.RemoveAll();
+	for ( int i = state.m_Renderables.Count(); --i >= 0; )
+	{
+		LeafListTestRenderable_t &renderable = state.m_Renderables[i];
+		LeafListTest_Move( renderable );
+
+		Vector vecMins, vecMaxs;
+		LeafListTest_Bloat( renderable.m_vecCenter, renderable.m_vecExtents, vecMins, vecMaxs );
+		if ( vecMins == renderable.m_vecBloatedMins && vecMaxs == renderable.m_vecBloatedMaxs )
+			continue;
+
+		handles.AddToTail( i );
+		batch.AddBox( vecMins, vecMaxs );
+	}
+
+	batch.ListLeaves( &tree, pThreadPool );
+
+	for ( int i = 0; i < handles.Count(); ++i )
+	{
+		LeafListTestRenderable_t &renderable = state.m_Renderables[ handles[i] ];
+		renderable.m_vecBloatedMins = batch.GetMins( i );
+		renderable.m_vecBloatedMaxs = batch.GetMaxs( i );
+
+		int nLeafCount = batch.GetLeafCount( i );
+		unsigned short *pLeaves = batch.GetLeaves( i );
+		if ( nLeafCount && LeafListTest_InSameLeaves( state.m_RenderablesInLeaf, handles[i], pLeaves, nLeafCount ) )
+		{
+			++state.m_nKept;
+			continue;
+		}
+
+		state.m_RenderablesInLeaf.RemoveElement( handles[i] );
+		for ( int j = 0; j < nLeafCount; ++j )
+		{
+			state.m_RenderablesInLeaf.AddElementToBucket( pLeaves[j], handles[i] );
+		}
+		++state.m_nReinserted;
+	}
+}
+
+// Order independent sum over the leaves each renderable is in
+static unsigned int LeafListTest_Checksum( LeafListTestState_t &state )
+{
+	unsigned int nSum = 0;
+	for ( int i = 0; i < state.m_Renderables.Count(); ++i )
+	{
+		for ( unsigned int j = state.m_RenderablesInLeaf.FirstBucket( i ); j != state.m_RenderablesInLeaf.InvalidIndex(); j = state.m_RenderablesInLeaf.NextBucket( j ) )
+		{
+			unsigned int nHash = ( state.m_RenderablesInLeaf.Bucket( j ) + 1 ) * 2654435761u ^ ( i + 1 ) * 40503u;
+			nSum += nHash ^ ( nHash >> 15 );
+		}
+	}
+	return nSum;
+}
+
+void LeafListBatch_Benchmark( int nRenderables, int nFrames, IThreadPool *pThreadPool )
+{
+	CLeafListTestTree tree;
+	LeafListTest_BuildTree( tree );
+
+	CLeafListBatch batch;
+	CUtlVector< int > handles;
+	double flTimes[3];
+	int nReinserted[3];
+	int nKept[3];
+	unsigned int nChecksums[3];
+	for ( int nMode = 0; nMode < 3; ++nMode )
+	{
+		LeafListTestState_t state;
+		LeafListTest_Init( state, tree, nRenderables );
+
+		double flStart = Plat_FloatTime();
+		for ( int nFrame = 0; nFrame < nFrames; ++nFrame )
+		{
+			if ( nMode == 0 )
+			{
+				LeafListTest_FrameSerial( state, tree );
+			}
+			else
+			{
+				LeafListTest_FrameBatched( state, tree, batch, handles, ( nMode == 2 ) ? pThreadPool : NULL );
+			}
+		}
+		flTimes[nMode] = Plat_FloatTime() - flStart;
+		nReinserted[nMode] = state.m_nReinserted;
+		nKept[nMode] = state.m_nKept;
+		nChecksums[nMode] = LeafListTest_Checksum( state );
+		s_pLeafListTestState = NULL;
+	}
+
+	if ( nChecksums[1] != nChecksums[0] || nChecksums[2] != nChecksums[0] )
+	{
+		Warning( "leaf list batch: renderables ended up in different leaves (%08x %08x %08x)\n", nChecksums[0], nChecksums[1], nChecksums[2] );
+	}
+
+	Msg( "leaf reinsertion: %d renderables, %d frames, %d leaves\n", nRenderables, nFrames, tree.LeafCount() );
+	Msg( "  one at a time: %8.3f ms (%.3f us per frame), %d reinserted\n", flTimes[0] * 1000.0, flTimes[0] * 1000000.0 / nFrames, nReinserted[0] );
+	for ( int nMode = 1; nMode < 3; ++nMode )
+	{
+		Msg( "  %-14s %8.3f ms (%.3f us per frame), %d reinserted, %d kept their leaves, %.2fx\n",
+			( nMode == 2 ) ? "batched, pool:" : "batched:", flTimes[nMode] * 1000.0, flTimes[nMode] * 1000000.0 / nFrames,
+			nReinserted[nMode], nKept[nMode], flTimes[nMode] > 0.0 ? flTimes[0] / flTimes[nMode] : 0.0 );
+	}
+}
+
+void CC_LeafReinsertTest( const CCommand &args )
+{
+	int nRenderables = ( args.ArgC() >= 2 ) ? atoi( args[1] ) : 2000;
+	int nFrames = ( args.ArgC() >= 3 ) ? atoi( args[2] ) : 1000;
+	if ( !LeafListBatch_Validate( 4000, g_pThreadPool ) )
+		return;
+
+	LeafListBatch_Benchmark( nRenderables, nFrames, g_pThreadPool );
+}
+
+static ConCommand leaf_reinsert_test( "leaf_reinsert_test", CC_LeafReinsertTest, "Checks the batched leaf lists of the client leaf system against ListLeavesInBox() on a test tree, then times moving renderables through per-leaf lists one at a time and batched. Usage: leaf_reinsert_test [renderables] [frames]", FCVAR_CHEAT );
+
+#endif // FASTPATH_TESTS
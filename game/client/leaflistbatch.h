@@ -0,0 +1,95 @@
+//===== Copyright (c) 1996-2005, Valve Corporation, All rights reserved. ======//
+//
+// Purpose: Lists the leaves of many boxes at once, on the thread pool.
+//
+//			The client leaf system moves every dirty renderable in two
+//			phases: the boxes are queued here and ListLeaves() finds their
+//			leaves in parallel, each job writing into its own buffer; then
+//			the main thread commits the results, skipping the renderables
+//			whose new bounds still cover the leaves they are in.
+//
+// $NoKeywords: $
+//===========================================================================//
+
+#ifndef LEAFLISTBATCH_H
+#define LEAFLISTBATCH_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include "mathlib/vector.h"
+#include "utlvector.h"
+
+class ISpatialQuery;
+class IThreadPool;
+
+
+#define LEAFLISTBATCH_MAX_LEAVES		1024	// per box, like CClientLeafSystem::InsertIntoTree always had
+#define LEAFLISTBATCH_BOXES_PER_JOB		16
+
+
+class CLeafListBatch
+{
+public:
+	CLeafListBatch();
+
+	void	RemoveAll();
+	void	Purge();
+
+	// Returns the index of the box
+	int		AddBox( const Vector &vecMins, const Vector &vecMaxs );
+	int		Count() const								{ return m_Boxes.Count(); }
+	const Vector &GetMins( int iBox ) const				{ return m_Boxes[iBox].m_vecMins; }
+	const Vector &GetMaxs( int iBox ) const				{ return m_Boxes[iBox].m_vecMaxs; }
+
+	// Finds the leaves of every box. Uses the pool if there is one and
+	// enough boxes to be worth it; ISpatialQuery::ListLeavesInBox() has to
+	// be safe to call from several threads, which the engine's BSP query is.
+	void	ListLeaves( ISpatialQuery *pQuery, IThreadPool *pThreadPool );
+
+	// The leaves of a box after ListLeaves(), sorted
+	int		GetLeafCount( int iBox ) const				{ return m_Boxes[iBox].m_nLeafCount; }
+	unsigned short *GetLeaves( int iBox )				{ Box_t &box = m_Boxes[iBox]; return m_Jobs[box.m_nJob].m_Leaves.Base() + box.m_nFirstLeaf; }
+
+	// Binary search through a sorted leaf list
+	static bool ContainsLeaf( const unsigned short *pSortedLeaves, int nLeafCount, int nLeaf );
+
+private:
+	struct Box_t
+	{
+		Vector	m_vecMins;
+		Vector	m_vecMaxs;
+		int		m_nJob;
+		int		m_nFirstLeaf;		// in the job's buffer
+		int		m_nLeafCount;
+	};
+
+	struct Job_t
+	{
+		ISpatialQuery *m_pQuery;
+		Box_t	*m_pBoxes;
+		int		m_nFirstBox;
+		int		m_nBoxCount;
+		CUtlVector< unsigned short > m_Leaves;
+	};
+
+	static void ProcessJob( Job_t &job );
+
+	CUtlVector< Box_t > m_Boxes;
+	CUtlVector< Job_t > m_Jobs;		// kept with their buffers between frames
+	int m_nJobs;
+};
+
+
+#if defined( FASTPATH_TESTS )
+//-----------------------------------------------------------------------------
+// Checks the batch against ListLeavesInBox() on a synthetic BSP tree, then
+// times moving nRenderables boxes through per-leaf lists for nFrames frames,
+// one at a time as before and batched with the leaf set check
+//-----------------------------------------------------------------------------
+bool LeafListBatch_Validate( int nBoxes, IThreadPool *pThreadPool );
+void LeafListBatch_Benchmark( int nRenderables, int nFrames, IThreadPool *pThreadPool );
+#endif
+
+
+#endif // LEAFLISTBATCH_H
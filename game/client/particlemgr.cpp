@@ -27,6 +27,7 @@
 #include "particle_parse.h"
 #include "model_types.h"
 #include "tier0/icommandline.h"
+#include "particlesimschedule.h"
 // memdbgon must be the last include file in a .cpp file!!!
 #include "tier0/memdbgon.h"
 
@@ -1495,6 +1496,34 @@ static void ProcessNonDrawingSystem( CParticleCollection *&pNonDrawingEffect )
 	pNonDrawingEffect->Simulate( s_flThreadedPSystemTimeStep );
 }
 
+static ConVar cl_particle_sim_schedule( "cl_particle_sim_schedule", "1", FCVAR_NONE, "Hand particle systems to the job pool in batches of the same definition, most expensive first, instead of in list order." );
+
+static CParticleSimSchedule s_ParticleSimSchedule;
+
+static void ProcessScheduledPSystem( void *pUnit )
+{
+	CNewParticleEffect *pNewEffect = (CNewParticleEffect *)pUnit;
+	ProcessPSystem( pNewEffect );
+}
+
+// Relative cost of simulating a system and the children it simulates: the
+// operators touch every live particle, emitters and initializers the new ones
+static float EstimateSimulationCost( CParticleCollection *pCollection )
+{
+	float flCost = 1.0f;
+	if ( pCollection->IsValid() )
+	{
+		CParticleSystemDefinition *pDef = pCollection->m_pDef.GetObject();
+		int nPerParticle = 1 + pDef->m_Operators.Count() + pDef->m_ForceGenerators.Count() + pDef->m_Constraints.Count();
+		flCost += ( pCollection->m_nActiveParticles + 4 ) * nPerParticle + 4 * ( pDef->m_Emitters.Count() + pDef->m_Initializers.Count() );
+	}
+	for ( CParticleCollection *pChild = pCollection->m_Children.m_pHead; pChild; pChild = pChild->m_pNext )
+	{
+		flCost += EstimateSimulationCost( pChild );
+	}
+	return flCost;
+}
+
 
 
 int CParticleMgr::ComputeParticleDefScreenArea( int nInfoCount, RetireInfo_t *pInfo, float *pTotalArea, CParticleSystemDefinition* pDef, 
@@ -1811,7 +1840,18 @@ void CParticleMgr::UpdateNewEffects( float flTimeDelta )
 		else
 		{
 			int nAltCore = IsX360() && particle_sim_alt_cores.GetInt();
-			if ( !m_pThreadPool[1] || nAltCore == 0 )
+			if ( ( !m_pThreadPool[1] || nAltCore == 0 ) && cl_particle_sim_schedule.GetBool() && g_pThreadPool && g_pThreadPool->NumThreads() > 0 )
+			{
+				s_ParticleSimSchedule.RemoveAll();
+				for( int i=0; i<nCount; i++ )
+				{
+					CNewParticleEffect *pNewEffect = particlesToSimulate[i];
+					s_ParticleSimSchedule.AddUnit( pNewEffect, pNewEffect->m_pDef.GetObject(), EstimateSimulationCost( pNewEffect ) );
+				}
+				s_ParticleSimSchedule.Schedule( g_pThreadPool->NumThreads() + 1 );
+				s_ParticleSimSchedule.Run( ProcessScheduledPSystem, PreProcessPSystem, PostProcessPSystem, g_pThreadPool );
+			}
+			else if ( !m_pThreadPool[1] || nAltCore == 0 )
 			{
 				ParallelProcess( particlesToSimulate.Base(), nCount, ProcessPSystem, PreProcessPSystem, PostProcessPSystem );
 			}
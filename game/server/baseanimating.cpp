@@ -31,6 +31,7 @@
 #include "smoke_trail.h"
 #include "collisionutils.h"
 #include "toolframework/itoolframework.h"
+#include "mathlib/transformbatch.h"
 
 
 
@@ -3309,11 +3310,12 @@ bool CBaseAnimating::ComputeHitboxSurroundingBox( Vector *pVecWorldMins, Vector
 
 	CBoneCache *pCache = GetBoneCache();
 
-	// Compute a box in world space that surrounds this entity
-	pVecWorldMins->Init( FLT_MAX, FLT_MAX, FLT_MAX );
-	pVecWorldMaxs->Init( -FLT_MAX, -FLT_MAX, -FLT_MAX );
-
-	Vector vecBoxAbsMins, vecBoxAbsMaxs;
+	// Gather the hitboxes whose bones are cached and transform them all at once
+	matrix3x4_t *pBoneToWorld = (matrix3x4_t *)stackalloc( set->numhitboxes * sizeof( matrix3x4_t ) );
+	Vector *pBoxMins = (Vector *)stackalloc( set->numhitboxes * sizeof( Vector ) );
+	Vector *pBoxMaxs = (Vector *)stackalloc( set->numhitboxes * sizeof( Vector ) );
+	float flModelScale = GetModelScale();
+	int nBoxes = 0;
 	for ( int i = 0; i < set->numhitboxes; i++ )
 	{
 		mstudiobbox_t *pbox = set->pHitbox(i);
@@ -3321,11 +3323,24 @@ bool CBaseAnimating::ComputeHitboxSurroundingBox( Vector *pVecWorldMins, Vector
 
 		if ( pMatrix )
 		{
-			TransformAABB( *pMatrix, pbox->bbmin*GetModelScale(), pbox->bbmax*GetModelScale(), vecBoxAbsMins, vecBoxAbsMaxs );
-			VectorMin( *pVecWorldMins, vecBoxAbsMins, *pVecWorldMins );
-			VectorMax( *pVecWorldMaxs, vecBoxAbsMaxs, *pVecWorldMaxs );
+			MatrixCopy( *pMatrix, pBoneToWorld[nBoxes] );
+			pBoxMins[nBoxes] = pbox->bbmin * flModelScale;
+			pBoxMaxs[nBoxes] = pbox->bbmax * flModelScale;
+			++nBoxes;
 		}
 	}
+
+	TransformAABBBatch( pBoneToWorld, NULL, pBoxMins, pBoxMaxs, pBoxMins, pBoxMaxs, nBoxes );
+
+	// Compute a box in world space that surrounds this entity
+	pVecWorldMins->Init( FLT_MAX, FLT_MAX, FLT_MAX );
+	pVecWorldMaxs->Init( -FLT_MAX, -FLT_MAX, -FLT_MAX );
+
+	for ( int i = 0; i < nBoxes; i++ )
+	{
+		VectorMin( *pVecWorldMins, pBoxMins[i], *pVecWorldMins );
+		VectorMax( *pVecWorldMaxs, pBoxMaxs[i], *pVecWorldMaxs );
+	}
 	return true;
 }
 
@@ -41,6 +41,7 @@
 #include "physics_saverestore.h"
 #include "achievement_saverestore.h"
 #include "tier0/vprof.h"
+#include "tier1/vproftrace.h"
 #include "effect_dispatch_data.h"
 #include "engine/IStaticPropMgr.h"
 #include "TemplateEntities.h"
@@ -104,6 +105,7 @@
 #include "vscript_server.h"
 #include "tier2/tier2_logging.h"
 #include "fmtstr.h"
+#include "networkstringtableindex.h"
 
 #ifdef INFESTED_DLL
 #include "missionchooser/iasw_mission_chooser.h"
@@ -216,6 +218,58 @@ ConVar *sv_maxreplay = NULL;
 static ConVar  *g_pcv_commentary = NULL;
 static ConVar *g_pcv_ThreadMode = NULL;
 
+static ConVar vprof_trace_spike_ticks( "vprof_trace_spike_ticks", "0", 0, "When the per-thread VProf trace is recording, automatically dump this many ticks whenever a spike is detected (0 = off)." );
+
+//-----------------------------------------------------------------------------
+// Writes the last nTicks ticks of the per-thread VProf trace to disk
+//-----------------------------------------------------------------------------
+static void VProfTrace_WriteDump( int nTicks, bool bBinary )
+{
+	CUtlBuffer buf( 0, 0, bBinary ? 0 : CUtlBuffer::TEXT_BUFFER );
+	if ( bBinary )
+	{
+		g_VProfTraceRecorder.DumpBinary( buf, nTicks );
+	}
+	else
+	{
+		g_VProfTraceRecorder.DumpChromeTrace( buf, nTicks );
+	}
+
+	char szFileName[MAX_PATH];
+	Q_snprintf( szFileName, sizeof( szFileName ), "vprof_trace_%d.%s", g_VProfTraceRecorder.GetCurrentTick(), bBinary ? "vpt" : "json" );
+	if ( filesystem->WriteFile( szFileName, "MOD", buf ) )
+	{
+		Msg( "Wrote %d ticks of VProf trace (%d threads) to %s\n", nTicks, g_VProfTraceRecorder.GetThreadCount(), szFileName );
+	}
+	else
+	{
+		Warning( "Unable to write VProf trace to %s\n", szFileName );
+	}
+}
+
+CON_COMMAND( vprof_trace_start, "Start recording per-thread VProf scope events." )
+{
+	g_VProfTraceRecorder.Start();
+}
+
+CON_COMMAND( vprof_trace_stop, "Stop recording per-thread VProf scope events." )
+{
+	g_VProfTraceRecorder.Stop();
+}
+
+CON_COMMAND( vprof_trace_dump, "Usage: vprof_trace_dump <ticks> [binary]. Writes the last N ticks of the per-thread VProf trace as Chrome trace JSON, or the compact binary format." )
+{
+	if ( !g_VProfTraceRecorder.IsRecording() )
+	{
+		Msg( "VProf trace is not recording, use vprof_trace_start first.\n" );
+		return;
+	}
+
+	int nTicks = ( args.ArgC() >= 2 ) ? atoi( args[1] ) : TIME_TO_TICKS( 5.0f );
+	bool bBinary = ( args.ArgC() >= 3 ) && !Q_stricmp( args[2], "binary" );
+	VProfTrace_WriteDump( nTicks, bBinary );
+}
+
 #if !defined(NO_STEAM)
 //-----------------------------------------------------------------------------
 // Purpose: singleton accessor
@@ -244,6 +298,11 @@ INetworkStringTable *g_pStringTableInfoPanel = NULL;
 INetworkStringTable *g_pStringTableClientSideChoreoScenes = NULL;
 INetworkStringTable *g_pStringTableExtraParticleFiles = NULL;
 
+// Hashed lookups for the tables precached by name
+static CNetworkStringTableIndex s_StringTableParticleEffectNamesIndex;
+static CNetworkStringTableIndex s_StringTableEffectDispatchIndex;
+static CNetworkStringTableIndex s_StringTableMaterialsIndex;
+
 CStringTableSaveRestoreOps g_VguiScreenStringOps;
 
 // Holds global variables shared between engine and game.
@@ -1242,6 +1301,13 @@ ConVar  trace_report( "trace_report", "0" );
 
 void CServerGameDLL::GameFrame( bool simulating )
 {
+	// Close out the previous tick first so a spike it caught is fully in the dump
+	if ( g_VProfTraceRecorder.ConsumeSpike() && vprof_trace_spike_ticks.GetInt() > 0 )
+	{
+		VProfTrace_WriteDump( vprof_trace_spike_ticks.GetInt(), false );
+	}
+	g_VProfTraceRecorder.MarkTick( gpGlobals->tickcount );
+
 	VPROF( "CServerGameDLL::GameFrame" );
 
 	// Don't run frames until fully restored
@@ -1499,6 +1565,10 @@ void CServerGameDLL::CreateNetworkStringTables( void )
 			g_pStringTableClientSideChoreoScenes &&
 			g_pStringTableExtraParticleFiles );
 
+	s_StringTableParticleEffectNamesIndex.Init( g_pStringTableParticleEffectNames );
+	s_StringTableEffectDispatchIndex.Init( g_pStringTableEffectDispatch );
+	s_StringTableMaterialsIndex.Init( g_pStringTableMaterials );
+
 	// Need this so we have the error material always handy
 	PrecacheMaterial( "debug/debugempty" );
 	Assert( GetMaterialIndex( "debug/debugempty" ) == 0 );
@@ -2197,7 +2267,7 @@ void UpdateChapterRestrictions( const char *mapname )
 void PrecacheMaterial( const char *pMaterialName )
 {
 	Assert( pMaterialName && pMaterialName[0] );
-	g_pStringTableMaterials->AddString( CBaseEntity::IsServer(), pMaterialName );
+	s_StringTableMaterialsIndex.AddString( CBaseEntity::IsServer(), pMaterialName );
 }
 
 
@@ -2208,7 +2278,7 @@ int GetMaterialIndex( const char *pMaterialName )
 {
 	if (pMaterialName)
 	{
-		int nIndex = g_pStringTableMaterials->FindStringIndex( pMaterialName );
+		int nIndex = s_StringTableMaterialsIndex.FindStringIndex( pMaterialName );
 		
 		if (nIndex != INVALID_STRING_INDEX )
 		{
@@ -2240,7 +2310,7 @@ const char *GetMaterialNameFromIndex( int nMaterialIndex )
 int PrecacheParticleSystem( const char *pParticleSystemName )
 {
 	Assert( pParticleSystemName && pParticleSystemName[0] );
-	return g_pStringTableParticleEffectNames->AddString( CBaseEntity::IsServer(), pParticleSystemName );
+	return s_StringTableParticleEffectNamesIndex.AddString( CBaseEntity::IsServer(), pParticleSystemName );
 }
 
 void PrecacheParticleFileAndSystems( const char *pParticleSystemFile )
@@ -2256,10 +2326,13 @@ void PrecacheParticleFileAndSystems( const char *pParticleSystemFile )
 	g_pParticleSystemMgr->GetParticleSystemsInFile( pParticleSystemFile, &systems );
 
 	int nCount = systems.Count();
+	CUtlVector< const char * > systemNames( 0, nCount );
 	for ( int i = 0; i < nCount; ++i )
 	{
-		PrecacheParticleSystem( systems[i] );
+		Assert( !systems[i].IsEmpty() );
+		systemNames.AddToTail( systems[i].Get() );
 	}
+	s_StringTableParticleEffectNamesIndex.AddStrings( CBaseEntity::IsServer(), systemNames.Base(), nCount );
 }
 
 void PrecacheGameSoundsFile( const char *pSoundFile )
@@ -2275,7 +2348,7 @@ int GetParticleSystemIndex( const char *pParticleSystemName )
 {
 	if ( pParticleSystemName )
 	{
-		int nIndex = g_pStringTableParticleEffectNames->FindStringIndex( pParticleSystemName );
+		int nIndex = s_StringTableParticleEffectNamesIndex.FindStringIndex( pParticleSystemName );
 		if (nIndex != INVALID_STRING_INDEX )
 			return nIndex;
 
@@ -2303,7 +2376,7 @@ const char *GetParticleSystemNameFromIndex( int nMaterialIndex )
 void PrecacheEffect( const char *pEffectName )
 {
 	Assert( pEffectName && pEffectName[0] );
-	g_pStringTableEffectDispatch->AddString( CBaseEntity::IsServer(), pEffectName );
+	s_StringTableEffectDispatchIndex.AddString( CBaseEntity::IsServer(), pEffectName );
 }
 
 
@@ -2314,7 +2387,7 @@ int GetEffectIndex( const char *pEffectName )
 {
 	if ( pEffectName )
 	{
-		int nIndex = g_pStringTableEffectDispatch->FindStringIndex( pEffectName );
+		int nIndex = s_StringTableEffectDispatchIndex.FindStringIndex( pEffectName );
 		if (nIndex != INVALID_STRING_INDEX )
 			return nIndex;
 
@@ -17,6 +17,7 @@
 
 
 #include "tier1/lzmaDecoder.h"
+#include "tier1/utlsegmentedbuffer.h"
 
 
 
@@ -960,7 +961,8 @@ bool CNavMesh::Save( void ) const
 		return false;
 	}
 
-	CUtlBuffer fileBuffer( 4096, 1024*1024 );
+	// Large meshes run to tens of megabytes; pages avoid re-copying the whole file as it grows
+	CUtlSegmentedBuffer fileBuffer;
 
 	// store "magic number" to help identify this kind of file
 	unsigned int magic = NAV_MAGIC_NUMBER;
@@ -1056,9 +1058,30 @@ bool CNavMesh::Save( void ) const
 	//
 	SaveCustomData( fileBuffer );
 
-	if ( !filesystem->WriteFile( filename, "MOD", fileBuffer ) )
+	// Write the pages straight out; WriteFile() would only see the current one
+	bool bWritten = false;
+	FileHandle_t hFile = filesystem->Open( filename, "wb", "MOD" );
+	if ( hFile )
 	{
-		Warning( "Unable to save %d bytes to %s\n", fileBuffer.Size(), filename );
+		bWritten = true;
+
+		UtlBufferSegment_t segments[32];
+		int nOffset = 0;
+		for ( int nCount; bWritten && ( nCount = fileBuffer.GetSegments( segments, ARRAYSIZE( segments ), nOffset ) ) != 0; )
+		{
+			for ( int i = 0; bWritten && i < nCount; ++i )
+			{
+				bWritten = ( filesystem->Write( segments[i].m_pData, segments[i].m_nLength, hFile ) == segments[i].m_nLength );
+				nOffset += segments[i].m_nLength;
+			}
+		}
+
+		filesystem->Close( hFile );
+	}
+
+	if ( !bWritten )
+	{
+		Warning( "Unable to save %d bytes to %s\n", fileBuffer.TellMaxPut(), filename );
 		return false;
 	}
 
@@ -27,6 +27,7 @@
 #include "datacache/imdlcache.h"
 #include "ispatialpartition.h"
 #include "tier0/vprof.h"
+#include "tier1/vproftrace.h"
 #include "movevars_shared.h"
 #include "hierarchy.h"
 #include "trains.h"
@@ -1037,12 +1038,13 @@ void CBaseEntity::PhysicsDispatchThink( BASEPTR thinkFunc )
 		float time = ( Plat_FloatTime() - startTime ) * 1000.0f;
 		if ( time > thinkLimit )
 		{
-#ifdef VPROF_ENABLED
 			if ( vprof_think_limit.GetBool() )
 			{
+#ifdef VPROF_ENABLED
 				g_VProfSignalSpike = true;
-			}
 #endif
+				g_VProfTraceRecorder.SignalSpike();
+			}
 			// If its an NPC print out the shedule/task that took so long
 			CAI_BaseNPC *pNPC = MyNPCPointer();
 			if (pNPC && pNPC->GetCurSchedule())
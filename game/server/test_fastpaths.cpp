@@ -0,0 +1,201 @@
+//========= Copyright (c) 1996-2005, Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Console commands that check the SIMD and batched fast paths against
+//			the code they replace, then time both.
+//
+//			The commands and the _Validate/_Benchmark functions next to each
+//			fast path are only built with FASTPATH_TESTS defined, so none of
+//			it ships. To run them, define FASTPATH_TESTS for the server and
+//			for the tier1 and mathlib libraries it links.
+//
+// $NoKeywords: $
+//=============================================================================//
+
+#include "cbase.h"
+
+#if defined( FASTPATH_TESTS )
+
+#include "tier1/strtools.h"
+#include "tier1/checksum_crc.h"
+#include "tier1/utlsegmentedbuffer.h"
+#include "collisionutils.h"
+#include "mathlib/polyhedron.h"
+#include "mathlib/quantize.h"
+#include "vstdlib/jobthread.h"
+#include "rope_physics.h"
+#include "mathlib/transformbatch.h"
+#include "saverestore.h"
+#include "networkstringtableindex.h"
+#include "soundscriptindex.h"
+#include "particlesimschedule.h"
+#include "gamemovement.h"
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+void CC_StrToolsTest( const CCommand &args )
+{
+	if ( !V_ValidateStringKernels() )
+		return;
+
+	int nIterations = ( args.ArgC() >= 2 ) ? atoi( args[1] ) : 1000000;
+	V_BenchmarkStringKernels( nIterations );
+}
+
+static ConCommand strtools_test( "strtools_test", CC_StrToolsTest, "Checks the SIMD string kernels against the scalar versions, then times both. Usage: strtools_test [iterations]", FCVAR_CHEAT );
+
+void CC_CRC32Test( const CCommand &args )
+{
+	if ( !CRC32_ValidateImplementations( 20000 ) )
+		return;
+
+	int nMegabytes = ( args.ArgC() >= 2 ) ? atoi( args[1] ) : 64;
+	CRC32_Benchmark( MAX( nMegabytes, 1 ) << 20 );
+}
+
+static ConCommand crc32_test( "crc32_test", CC_CRC32Test, "Checks the sliced and PCLMULQDQ CRC32 paths against the table version, then times them. Usage: crc32_test [megabytes]", FCVAR_CHEAT );
+
+void CC_UtlBufferTest( const CCommand &args )
+{
+	if ( !UtlSegmentedBuffer_Validate( 20000 ) )
+		return;
+
+	int nMegabytes = ( args.ArgC() >= 2 ) ? atoi( args[1] ) : 64;
+	UtlSegmentedBuffer_Benchmark( nMegabytes );
+}
+
+static ConCommand utlbuffer_test( "utlbuffer_test", CC_UtlBufferTest, "Checks CUtlSegmentedBuffer against CUtlBuffer, then times both on a large serialization. Usage: utlbuffer_test [megabytes]", FCVAR_CHEAT );
+
+void CC_HitboxRayTest( const CCommand &args )
+{
+	int nIterations = ( args.ArgC() >= 2 ) ? atoi( args[1] ) : 50000;
+	int nBoxes = ( args.ArgC() >= 3 ) ? atoi( args[2] ) : 19;
+	if ( !IntersectRayWithOBBs_Validate( nIterations ) )
+		return;
+
+	IntersectRayWithOBBs_Benchmark( nBoxes, 100000 );
+}
+
+static ConCommand hitbox_ray_test( "hitbox_ray_test", CC_HitboxRayTest, "Checks the batched ray vs OBB kernels against IntersectRayWithOBB on random boxes, then times them. Usage: hitbox_ray_test [iterations] [boxes]", FCVAR_CHEAT );
+
+void CC_PolyhedronClipTest( const CCommand &args )
+{
+	int nIterations = ( args.ArgC() >= 2 ) ? atoi( args[1] ) : 20000;
+	if ( !Polyhedron_ClipValidate( nIterations ) )
+		return;
+
+	Polyhedron_ClipBenchmark( nIterations );
+}
+
+static ConCommand polyhedron_clip_test( "polyhedron_clip_test", CC_PolyhedronClipTest, "Checks polyhedron clipping through a CPolyhedronClipContext against the plain entry points on random convex shapes, then times both. Usage: polyhedron_clip_test [iterations]", FCVAR_CHEAT );
+
+void CC_QuantizeTest( const CCommand &args )
+{
+	int nSamples = ( args.ArgC() >= 2 ) ? atoi( args[1] ) : 200000;
+	int nDims = ( args.ArgC() >= 3 ) ? atoi( args[2] ) : 4;
+	int nValues = ( args.ArgC() >= 4 ) ? atoi( args[3] ) : 256;
+	if ( !Quantize_Validate( g_pThreadPool, nSamples, nDims, nValues ) )
+		return;
+
+	Quantize_Benchmark( g_pThreadPool, nSamples, nDims, nValues );
+}
+
+static ConCommand quantize_test( "quantize_test", CC_QuantizeTest, "Checks that Quantize() builds the same tree with and without the thread pool on random clustered samples, then times both. Usage: quantize_test [samples] [dims] [values]", FCVAR_CHEAT );
+
+void CC_RopeBatchTest( const CCommand &args )
+{
+	int nRopes = ( args.ArgC() >= 2 ) ? atoi( args[1] ) : 1000;
+	int nFrames = ( args.ArgC() >= 3 ) ? atoi( args[2] ) : 300;
+	if ( !RopePhysicsBatch_Validate( nRopes, g_pThreadPool ) )
+		return;
+
+	RopePhysicsBatch_Benchmark( nRopes, nFrames, g_pThreadPool );
+}
+
+static ConCommand rope_batch_test( "rope_batch_test", CC_RopeBatchTest, "Checks that ropes simulated through a CRopePhysicsBatch end up where CRopePhysics::Simulate puts them, with and without the thread pool, then times both. Usage: rope_batch_test [ropes] [frames]", FCVAR_CHEAT );
+
+void CC_TransformBatchTest( const CCommand &args )
+{
+	int nCount = ( args.ArgC() >= 2 ) ? atoi( args[1] ) : 128;
+	int nIterations = ( args.ArgC() >= 3 ) ? atoi( args[2] ) : 10000;
+	if ( !TransformBatch_Validate( nCount ) )
+		return;
+
+	TransformBatch_Benchmark( nCount, nIterations );
+}
+
+static ConCommand transform_batch_test( "transform_batch_test", CC_TransformBatchTest, "Checks the batched point, matrix, hierarchy and AABB transforms against the scalar mathlib routines on random data, then times both. Usage: transform_batch_test [matrices] [iterations]", FCVAR_CHEAT );
+
+void CC_SavePlanTest( const CCommand &args )
+{
+	int nIterations = ( args.ArgC() >= 2 ) ? atoi( args[1] ) : 100;
+	if ( !SaveRestorePlans_Validate() )
+		return;
+
+	SaveRestorePlans_Benchmark( nIterations );
+}
+
+static ConCommand save_plan_test( "save_plan_test", CC_SavePlanTest, "Checks the compiled save plans write what the datadesc walk writes and restore the same values from runs on every entity, then times the save field modes. Usage: save_plan_test [iterations]", FCVAR_CHEAT );
+
+void CC_StringTableIndexTest( const CCommand &args )
+{
+	int nStrings = ( args.ArgC() >= 2 ) ? atoi( args[1] ) : 8192;
+	int nIterations = ( args.ArgC() >= 3 ) ? atoi( args[2] ) : 200000;
+	if ( !NetworkStringTableIndex_Validate( nStrings ) )
+		return;
+
+	NetworkStringTableIndex_Benchmark( nStrings, nIterations );
+}
+
+static ConCommand string_table_index_test( "string_table_index_test", CC_StringTableIndexTest, "Checks the hashed string table index against the table's own lookups, then times loading and looking up strings both ways. Usage: string_table_index_test [strings] [lookups]", FCVAR_CHEAT );
+
+void CC_SoundScriptIndexTest( const CCommand &args )
+{
+	int nSounds = ( args.ArgC() >= 2 ) ? atoi( args[1] ) : 8192;
+	int nLookups = ( args.ArgC() >= 3 ) ? atoi( args[2] ) : 200000;
+	if ( !SoundScriptIndex_Validate( nSounds ) )
+		return;
+
+	SoundScriptIndex_Benchmark( nSounds, nLookups );
+}
+
+static ConCommand sound_script_index_test( "sound_script_index_test", CC_SoundScriptIndexTest, "Checks the hashed sound script index against a case insensitive dictionary, then times looking sounds up by name through both and through the loaded scripts. Usage: sound_script_index_test [sounds] [lookups]", FCVAR_CHEAT );
+
+void CC_ParticleSimScheduleTest( const CCommand &args )
+{
+	int nSystems = ( args.ArgC() >= 2 ) ? atoi( args[1] ) : 1000;
+	int nFrames = ( args.ArgC() >= 3 ) ? atoi( args[2] ) : 200;
+	if ( !ParticleSimSchedule_Validate( 2000, g_pThreadPool ) )
+		return;
+
+	ParticleSimSchedule_Benchmark( nSystems, nFrames, g_pThreadPool );
+}
+
+static ConCommand particle_sim_schedule_test( "particle_sim_schedule_test", CC_ParticleSimScheduleTest, "Simulates made up particle systems on the job pool through the simulation schedule and checks them against simulating them one at a time, then times list order against the schedule. Runs without a renderer. Usage: particle_sim_schedule_test [systems] [frames]", FCVAR_CHEAT );
+
+void CC_MovementTraceCacheTest( const CCommand &args )
+{
+	int nTraces = ( args.ArgC() >= 2 ) ? atoi( args[1] ) : 2000;
+
+	CUtlVector< CBaseEntity * > players;
+	for ( int i = 1; i <= gpGlobals->maxClients; ++i )
+	{
+		CBasePlayer *pPlayer = UTIL_PlayerByIndex( i );
+		if ( pPlayer && pPlayer->IsAlive() )
+		{
+			players.AddToTail( pPlayer );
+		}
+	}
+
+	if ( !players.Count() )
+	{
+		Msg( "movement_trace_cache_test needs a live player or bot to trace around\n" );
+		return;
+	}
+
+	MovementTraceCache_Validate( players.Base(), players.Count(), nTraces );
+}
+
+static ConCommand movement_trace_cache_test( "movement_trace_cache_test", CC_MovementTraceCacheTest, "Traces player hulls around every live player against a leaf and entity list built like a movement command's and against the whole world, checks they match and times both. movement_trace_cache_verify does the same for real movement. Usage: movement_trace_cache_test [traces per player]", FCVAR_CHEAT );
+
+#endif // FASTPATH_TESTS
@@ -15,6 +15,8 @@
 #include "tier0/vprof.h"
 #include "checksum_crc.h"
 #include "tier0/icommandline.h"
+#include "bitvec.h"
+#include "soundscriptindex.h"
 
 #ifndef CLIENT_DLL
 #include "envmicrophone.h"
@@ -219,32 +221,27 @@ public:
 #if !defined( CLIENT_DLL )
 	bool			m_bLogPrecache;
 	FileHandle_t	m_hPrecacheLogFile;
-	CUtlSymbolTable m_PrecachedScriptSounds;
 	CUtlVector< AsyncCaption_t > m_ServerCaptions;
 
 public:
 	CSoundEmitterSystem( char const *pszName ) :
 		m_bLogPrecache( false ),
-		m_hPrecacheLogFile( FILESYSTEM_INVALID_HANDLE )
+		m_hPrecacheLogFile( FILESYSTEM_INVALID_HANDLE ),
+		m_nIndexedSoundCount( -1 )
 	{
 	}
 
+	// Called the first time a level precaches the sound, see PrecacheScriptSound()
 	void LogPrecache( char const *soundname )
 	{
 		if ( !m_bLogPrecache )
 			return;
 
-		// Make sure we only show the message once
-		if ( UTL_INVAL_SYMBOL != m_PrecachedScriptSounds.Find( soundname ) )
-			return;
-
 		if (m_hPrecacheLogFile == FILESYSTEM_INVALID_HANDLE)
 		{
 			StartLog();
 		}
 
-		m_PrecachedScriptSounds.AddString( soundname );
-
 		if (m_hPrecacheLogFile != FILESYSTEM_INVALID_HANDLE)
 		{
 			filesystem->Write("\"", 1, m_hPrecacheLogFile);
@@ -260,8 +257,6 @@ public:
 
 	void StartLog()
 	{
-		m_PrecachedScriptSounds.RemoveAll();
-
 		if ( !m_bLogPrecache )
 			return;
 
@@ -289,16 +284,70 @@ public:
 			filesystem->Close( m_hPrecacheLogFile );
 			m_hPrecacheLogFile = FILESYSTEM_INVALID_HANDLE;
 		}
-
-		m_PrecachedScriptSounds.RemoveAll();
 	}
 #else
-	CSoundEmitterSystem( char const *name )
+	CSoundEmitterSystem( char const *name ) :
+		m_nIndexedSoundCount( -1 )
 	{
 	}
 
 #endif
 
+	// Name lookups go through a hashed index of the scripts instead of the
+	// emitter system's dictionary. The emitter system doesn't say when its
+	// scripts change, so the index is rebuilt when this system changes them
+	// and when the count of sounds no longer matches.
+	CSoundScriptIndex	m_SoundIndex;
+	int					m_nIndexedSoundCount;	// soundemitterbase->GetSoundCount() when built, -1 to rebuild
+
+	// Sound indices whose waves this level has precached
+	CVarBitVec			m_PrecachedSounds;
+
+	CSoundScriptIndex &GetSoundScriptIndex()
+	{
+		int nSoundCount = soundemitterbase->GetSoundCount();
+		if ( m_nIndexedSoundCount != nSoundCount )
+		{
+			m_SoundIndex.Build( soundemitterbase );
+			m_nIndexedSoundCount = nSoundCount;
+
+			// The indices may have moved
+			m_PrecachedSounds.Resize( m_SoundIndex.GetMaxSoundIndex() + 1, true );
+		}
+		return m_SoundIndex;
+	}
+
+	void InvalidateSoundScriptIndex()
+	{
+		m_nIndexedSoundCount = -1;
+	}
+
+	// Same as soundemitterbase->GetSoundIndex()
+	int GetSoundIndex( const char *soundname, unsigned int nHash )
+	{
+		int soundIndex = GetSoundScriptIndex().Find( soundname, nHash );
+		if ( soundIndex >= 0 )
+			return soundIndex;
+
+		// Not in the index: no such sound, or one a tool renamed without changing the count
+		return soundemitterbase->GetSoundIndex( soundname );
+	}
+
+	int GetSoundIndex( const char *soundname )
+	{
+		return GetSoundIndex( soundname, CSoundScriptIndex::HashName( soundname ) );
+	}
+
+	bool IsSoundPrecached( int soundIndex ) const
+	{
+		return soundIndex < m_PrecachedSounds.GetNumBits() && m_PrecachedSounds.IsBitSet( soundIndex );
+	}
+
+	void ClearPrecachedSounds()
+	{
+		m_PrecachedSounds.ClearAll();
+	}
+
 	// IServerSystem stuff
 	virtual bool Init()
 	{
@@ -348,6 +397,7 @@ public:
 	{
 		Shutdown();
 		soundemitterbase->Flush();
+		InvalidateSoundScriptIndex();
 #ifdef CLIENT_DLL
 #ifdef GAMEUI_UISYSTEM2_ENABLED
 		g_pGameUIGameSystem->ReloadSounds();
@@ -396,8 +446,12 @@ public:
 		if ( filesystem->FileExists( scriptfile, "GAME" ) )
 		{
 			soundemitterbase->AddSoundOverrides( scriptfile );
+			InvalidateSoundScriptIndex();
 		}
 
+		// The engine's precache tables are new for the level
+		ClearPrecachedSounds();
+
 #if !defined( CLIENT_DLL )
 	
 		PreloadSounds();
@@ -425,6 +479,8 @@ public:
 	virtual void LevelShutdownPostEntity()
 	{
 		soundemitterbase->ClearSoundOverrides();
+		InvalidateSoundScriptIndex();
+		ClearPrecachedSounds();
 
 #if !defined( CLIENT_DLL )
 		FinishLog();
@@ -456,6 +512,12 @@ public:
 
 			g_bPermitDirectSoundPrecache = false;
 		}
+
+		GetSoundScriptIndex();
+		if ( soundIndex < m_PrecachedSounds.GetNumBits() )
+		{
+			m_PrecachedSounds.Set( soundIndex );
+		}
 	}
 
 	void InternalPrefetchWaves( int soundIndex )
@@ -481,7 +543,7 @@ public:
 
 	HSOUNDSCRIPTHANDLE PrecacheScriptSound( const char *soundname )
 	{
-		int soundIndex = soundemitterbase->GetSoundIndex( soundname );
+		int soundIndex = GetSoundIndex( soundname );
 		if ( !soundemitterbase->IsValidIndex( soundIndex ) )
 		{
 			if ( Q_stristr( soundname, ".wav" ) || Q_strstr( soundname, ".mp3" ) )
@@ -509,6 +571,11 @@ public:
 #endif
 			return (HSOUNDSCRIPTHANDLE)soundIndex;
 		}
+
+		// Every entity of a class precaches the same sounds; the waves only need it once a level
+		if ( IsSoundPrecached( soundIndex ) )
+			return (HSOUNDSCRIPTHANDLE)soundIndex;
+
 #if !defined( CLIENT_DLL )
 		LogPrecache( soundname );
 #endif
@@ -519,7 +586,7 @@ public:
 
 	void PrefetchScriptSound( const char *soundname )
 	{
-		int soundIndex = soundemitterbase->GetSoundIndex( soundname );
+		int soundIndex = GetSoundIndex( soundname );
 		if ( !soundemitterbase->IsValidIndex( soundIndex ) )
 		{
 			if ( Q_stristr( soundname, ".wav" ) || Q_strstr( soundname, ".mp3" ) )
@@ -744,7 +811,7 @@ public:
 
 		if ( ep.m_hSoundScriptHandle == SOUNDEMITTER_INVALID_HANDLE )
 		{
-			ep.m_hSoundScriptHandle = (HSOUNDSCRIPTHANDLE)soundemitterbase->GetSoundIndex( ep.m_pSoundName );
+			ep.m_hSoundScriptHandle = (HSOUNDSCRIPTHANDLE)GetSoundIndex( ep.m_pSoundName );
 		}
 
 		if ( ep.m_hSoundScriptHandle == -1 )
@@ -1021,7 +1088,7 @@ public:
 	{
 		if ( handle == SOUNDEMITTER_INVALID_HANDLE )
 		{
-			handle = (HSOUNDSCRIPTHANDLE)soundemitterbase->GetSoundIndex( soundname );
+			handle = (HSOUNDSCRIPTHANDLE)GetSoundIndex( soundname );
 		}
 
 		if ( handle == SOUNDEMITTER_INVALID_HANDLE )
@@ -1062,7 +1129,7 @@ public:
 
 	void StopSound( int entindex, const char *soundname )
 	{
-		HSOUNDSCRIPTHANDLE handle = (HSOUNDSCRIPTHANDLE)soundemitterbase->GetSoundIndex( soundname );
+		HSOUNDSCRIPTHANDLE handle = (HSOUNDSCRIPTHANDLE)GetSoundIndex( soundname );
 		if ( handle == SOUNDEMITTER_INVALID_HANDLE )
 		{
 			return;
@@ -1204,6 +1271,16 @@ void SoundSystemPreloadSounds( void )
 	g_SoundEmitterSystem.PreloadSounds();
 }
 
+CSoundScriptIndex &SoundScriptIndex()
+{
+	return g_SoundEmitterSystem.GetSoundScriptIndex();
+}
+
+int LookupSoundScript( const char *pName, unsigned int nHash )
+{
+	return g_SoundEmitterSystem.GetSoundIndex( pName, nHash );
+}
+
 #if !defined( CLIENT_DLL )
 
 CON_COMMAND( sv_soundemitter_flush, "Flushes the sounds.txt system (server only)" )
@@ -1794,7 +1871,7 @@ HSOUNDSCRIPTHANDLE CBaseEntity::PrecacheScriptSound( const char *soundname )
 #if !defined( CLIENT_DLL )
 	return g_SoundEmitterSystem.PrecacheScriptSound( soundname );
 #else
-	return soundemitterbase->GetSoundIndex( soundname );
+	return g_SoundEmitterSystem.GetSoundIndex( soundname );
 #endif
 }
 
@@ -889,6 +889,39 @@ const Vector& CGameMovement::GetPlayerViewOffset( bool ducked ) const
 	return ducked ? VEC_DUCK_VIEW : VEC_VIEW;
 }
 
+static ConVar movement_trace_cache_verify( "movement_trace_cache_verify", "0", FCVAR_REPLICATED | FCVAR_CHEAT, "Traces every movement trace that ran against the command's leaf and entity list again against the whole world, and reports the ones that come out differently." );
+
+static int s_nMovementTraceMisses;		// this command's traces that didn't fit its bounds
+
+static bool MovementTracesMatch( const trace_t &a, const trace_t &b )
+{
+	return a.fraction == b.fraction && a.endpos == b.endpos && a.plane.normal == b.plane.normal && a.plane.dist == b.plane.dist &&
+		a.startsolid == b.startsolid && a.allsolid == b.allsolid && a.contents == b.contents && a.m_pEnt == b.m_pEnt;
+}
+
+void TraceMovementRay( ITraceListData *pTraceListData, const Ray_t &ray, unsigned int fMask, ITraceFilter *pFilter, trace_t *pTrace )
+{
+	if ( !pTraceListData || !pTraceListData->CanTraceRay( ray ) )
+	{
+		++s_nMovementTraceMisses;
+		enginetrace->TraceRay( ray, fMask, pFilter, pTrace );
+		return;
+	}
+
+	enginetrace->TraceRayAgainstLeafAndEntityList( ray, pTraceListData, fMask, pFilter, pTrace );
+
+	if ( movement_trace_cache_verify.GetBool() )
+	{
+		trace_t full;
+		enginetrace->TraceRay( ray, fMask, pFilter, &full );
+		if ( !MovementTracesMatch( *pTrace, full ) )
+		{
+			Warning( "movement trace cache: trace from (%.3f %.3f %.3f) by (%.3f %.3f %.3f) hit %.5f against the leaf list, %.5f against the world\n",
+				ray.m_Start.x, ray.m_Start.y, ray.m_Start.z, ray.m_Delta.x, ray.m_Delta.y, ray.m_Delta.z, pTrace->fraction, full.fraction );
+		}
+	}
+}
+
 #if 0
 //-----------------------------------------------------------------------------
 // Traces player movement + position
@@ -909,7 +942,7 @@ CBaseHandle CGameMovement::TestPlayerPosition( const Vector& pos, int collisionG
 	Ray_t ray;
 	ray.Init( pos, pos, GetPlayerMins(), GetPlayerMaxs() );
 	ITraceFilter *filter = LockTraceFilter( collisionGroup );
-	UTIL_TraceRay( ray, PlayerSolidMask(), filter, &pm );
+	TraceMovementRay( m_pTraceListData, ray, PlayerSolidMask(), filter, &pm );
 	UnlockTraceFilter( filter );
 	if ( (pm.contents & PlayerSolidMask()) && pm.m_pEnt )
 		return pm.m_pEnt->GetRefEHandle();
@@ -1270,7 +1303,10 @@ void CGameMovement::SetupMovementBounds( CMoveData *move )
 	Vector moveMins, moveMaxs;
 	ClearBounds( moveMins, moveMaxs );
 	Vector start = move->GetAbsOrigin();
-	float radius = ((move->m_vecVelocity.Length() + move->m_flMaxSpeed) * gpGlobals->frametime) + 1.0f;
+	// ProcessMovement() scales the frame time by the lagged movement value,
+	// and the base velocity (conveyors, push triggers) moves the player too
+	float flFrameTime = gpGlobals->frametime * pPlayer->GetLaggedMovementValue();
+	float radius = ((move->m_vecVelocity.Length() + move->m_flMaxSpeed + pPlayer->GetBaseVelocity().Length()) * flFrameTime) + 1.0f;
 	// NOTE: assumes the unducked bbox encloses the ducked bbox
 	Vector boxMins = GetPlayerMins(false);
 	Vector boxMaxs = GetPlayerMaxs(false);
@@ -1292,6 +1328,7 @@ void CGameMovement::SetupMovementBounds( CMoveData *move )
 void CGameMovement::ProcessMovement( CBasePlayer *pPlayer, CMoveData *pMove )
 {
 	m_nTraceCount = 0;
+	s_nMovementTraceMisses = 0;
 
 	Assert( pMove && pPlayer );
 
@@ -1339,6 +1376,7 @@ void CGameMovement::ProcessMovement( CBasePlayer *pPlayer, CMoveData *pMove )
 	if ( !player->IsBot() )
 	{
 		VPROF_INCREMENT_COUNTER( "PlayerMovementTraces", m_nTraceCount );
+		VPROF_INCREMENT_COUNTER( "PlayerMovementTraceMisses", s_nMovementTraceMisses );
 	}
 #endif
 }
@@ -3861,15 +3899,7 @@ void CGameMovement::SetGroundEntity( trace_t *pm )
 static inline void DoTrace( ITraceListData *pTraceListData, const Ray_t &ray, uint32 fMask, ITraceFilter *filter, trace_t *ptr, int *counter )
 {
 	++*counter;
-
-	if ( pTraceListData && pTraceListData->CanTraceRay(ray) )
-	{
-		enginetrace->TraceRayAgainstLeafAndEntityList( ray, pTraceListData, fMask, filter, ptr );
-	}
-	else
-	{
-		enginetrace->TraceRay( ray, fMask, filter, ptr );
-	}
+	TraceMovementRay( pTraceListData, ray, fMask, filter, ptr );
 }
 
 //-----------------------------------------------------------------------------
@@ -5084,4 +5114,118 @@ void CGameMovement::IsometricMove( void )
 bool CGameMovement::GameHasLadders() const
 {
 	return true;
-}
\ No newline at end of file
+}
+
+#if defined( FASTPATH_TESTS )
+
+//-----------------------------------------------------------------------------
+// Tests
+//-----------------------------------------------------------------------------
+
+static unsigned int s_nMovementTraceTestSeed;
+
+static float MovementTraceTest_Random( float flMin, float flMax )
+{
+	s_nMovementTraceTestSeed = s_nMovementTraceTestSeed * 1664525 + 1013904223;
+	return flMin + ( flMax - flMin ) * ( ( s_nMovementTraceTestSeed >> 8 ) & 0xffff ) / 65535.0f;
+}
+
+static Vector MovementTraceTest_RandomVector( float flExtent )
+{
+	return Vector( MovementTraceTest_Random( -flExtent, flExtent ), MovementTraceTest_Random( -flExtent, flExtent ), MovementTraceTest_Random( -flExtent, flExtent ) );
+}
+
+//-----------------------------------------------------------------------------
+// Builds the bounds SetupMovementBounds() would for each entity running at
+// sv_maxspeed, then traces the kinds of hulls a command traces (standing,
+// ducked, the ground quadrants) inside them against the leaf and entity
+// list and against the whole world, and checks the results match. Rays
+// that leave the bounds have to be turned away by CanTraceRay().
+//-----------------------------------------------------------------------------
+bool MovementTraceCache_Validate( CBaseEntity **ppEntities, int nEntities, int nTracesPerEntity )
+{
+	s_nMovementTraceTestSeed = 0x3a7e5;
+	nTracesPerEntity = MAX( nTracesPerEntity, 1 );
+
+	ITraceListData *pTraceListData = enginetrace->AllocTraceListData();
+	int nFailures = 0;
+	int nTraces = 0;
+	int nHits = 0;
+	int nMisses = 0;		// inside the bounds, but too close to their edge for the list
+	double flListTime = 0.0, flWorldTime = 0.0;
+
+	const Vector vecHullMins[3] = { VEC_HULL_MIN, VEC_DUCK_HULL_MIN, Vector( 0, 0, VEC_HULL_MIN.z ) };
+	const Vector vecHullMaxs[3] = { VEC_HULL_MAX, VEC_DUCK_HULL_MAX, VEC_HULL_MAX };
+	const float flStepSize = 18.0f;
+	float flRadius = sv_maxspeed.GetFloat() * 2.0f * gpGlobals->interval_per_tick + 1.0f;
+
+	for ( int iEntity = 0; iEntity < nEntities; ++iEntity )
+	{
+		CBaseEntity *pEntity = ppEntities[iEntity];
+		Vector vecOrigin = pEntity->GetAbsOrigin();
+		Vector vecBloat( flRadius, flRadius, flRadius + flStepSize );
+		Vector vecMins = vecOrigin + VEC_HULL_MIN - vecBloat;
+		Vector vecMaxs = vecOrigin + VEC_HULL_MAX + vecBloat;
+
+		double flStart = Plat_FloatTime();
+		pTraceListData->Reset();
+		enginetrace->SetupLeafAndEntityListBox( vecMins, vecMaxs, pTraceListData );
+		flListTime += Plat_FloatTime() - flStart;
+
+		CTraceFilterSimple filter( pEntity, COLLISION_GROUP_PLAYER_MOVEMENT );
+		for ( int i = 0; i < nTracesPerEntity; ++i )
+		{
+			int nHull = i % ARRAYSIZE( vecHullMins );
+			Vector vecStart = vecOrigin + MovementTraceTest_RandomVector( flRadius * 0.5f );
+			Vector vecEnd = vecStart + MovementTraceTest_RandomVector( flRadius * 0.5f );
+			if ( i & 4 )
+			{
+				vecEnd = vecStart;
+			}
+			vecEnd.z = clamp( vecEnd.z, vecOrigin.z - flStepSize, vecOrigin.z + flStepSize );
+
+			Ray_t ray;
+			ray.Init( vecStart, vecEnd, vecHullMins[nHull], vecHullMaxs[nHull] );
+			if ( !pTraceListData->CanTraceRay( ray ) )
+			{
+				++nMisses;
+				continue;
+			}
+
+			trace_t listTrace, worldTrace;
+			flStart = Plat_FloatTime();
+			enginetrace->TraceRayAgainstLeafAndEntityList( ray, pTraceListData, MASK_PLAYERSOLID, &filter, &listTrace );
+			flListTime += Plat_FloatTime() - flStart;
+
+			flStart = Plat_FloatTime();
+			enginetrace->TraceRay( ray, MASK_PLAYERSOLID, &filter, &worldTrace );
+			flWorldTime += Plat_FloatTime() - flStart;
+
+			++nTraces;
+			if ( worldTrace.DidHit() )
+			{
+				++nHits;
+			}
+			if ( !MovementTracesMatch( listTrace, worldTrace ) && ++nFailures <= 5 )
+			{
+				Warning( "movement trace cache: entity %d trace %d hit %.5f against the list, %.5f against the world\n", pEntity->entindex(), i, listTrace.fraction, worldTrace.fraction );
+			}
+		}
+
+		// Out past the bounds
+		Ray_t ray;
+		ray.Init( vecOrigin, vecOrigin + Vector( flRadius * 4.0f, 0, 0 ), VEC_HULL_MIN, VEC_HULL_MAX );
+		if ( pTraceListData->CanTraceRay( ray ) && ++nFailures <= 5 )
+		{
+			Warning( "movement trace cache: entity %d can use the list for a trace that leaves its bounds\n", pEntity->entindex() );
+		}
+	}
+
+	enginetrace->FreeTraceListData( pTraceListData );
+
+	Msg( "movement trace cache: %d entities, %d traces (%d hit something, %d couldn't use the list): %s\n", nEntities, nTraces, nHits, nMisses, nFailures ? "FAILED" : "OK" );
+	Msg( "  list (with building it): %8.3f ms, world: %8.3f ms, %.2fx\n", flListTime * 1000.0, flWorldTime * 1000.0, flListTime > 0.0 ? flWorldTime / flListTime : 0.0 );
+	return nFailures == 0;
+}
+
+#endif // FASTPATH_TESTS
@@ -28,6 +28,22 @@
 struct surfacedata_t;
 
 class CBasePlayer;
+class CBaseEntity;
+
+//-----------------------------------------------------------------------------
+// Every movement trace of a command goes through here: against the leaves
+// and entities SetupMovementBounds() gathered for the command when the ray
+// fits in them, against the whole world when it doesn't
+//-----------------------------------------------------------------------------
+void TraceMovementRay( ITraceListData *pTraceListData, const Ray_t &ray, unsigned int fMask, ITraceFilter *pFilter, trace_t *pTrace );
+
+#if defined( FASTPATH_TESTS )
+//-----------------------------------------------------------------------------
+// Traces hulls around each entity against a leaf and entity list built like
+// a command's and against the whole world, and checks they come out the same
+//-----------------------------------------------------------------------------
+bool MovementTraceCache_Validate( CBaseEntity **ppEntities, int nEntities, int nTracesPerEntity );
+#endif
 
 class CGameMovement : public IGameMovement
 {
@@ -292,14 +308,7 @@ inline void CGameMovement::TracePlayerBBox( const Vector& start, const Vector& e
 	Ray_t ray;
 	ray.Init( start, end, GetPlayerMins(), GetPlayerMaxs() );
 	ITraceFilter *pFilter = LockTraceFilter( collisionGroup );
-	if ( m_pTraceListData && m_pTraceListData->CanTraceRay(ray) )
-	{
-		enginetrace->TraceRayAgainstLeafAndEntityList( ray, m_pTraceListData, fMask, pFilter, &pm );
-	}
-	else
-	{
-		enginetrace->TraceRay( ray, fMask, pFilter, &pm );
-	}
+	TraceMovementRay( m_pTraceListData, ray, fMask, pFilter, &pm );
 	UnlockTraceFilter( pFilter );
 }
 
@@ -308,14 +317,7 @@ inline void CGameMovement::GameMovementTraceHull( const Vector& start, const Vec
 	++m_nTraceCount;
 	Ray_t ray;
 	ray.Init( start, end, mins, maxs );
-	if ( m_pTraceListData && m_pTraceListData->CanTraceRay(ray) )
-	{
-		enginetrace->TraceRayAgainstLeafAndEntityList( ray, m_pTraceListData, fMask, pFilter, pTrace );
-	}
-	else
-	{
-		enginetrace->TraceRay( ray, fMask, pFilter, pTrace );
-	}
+	TraceMovementRay( m_pTraceListData, ray, fMask, pFilter, pTrace );
 }
 
 #endif // GAMEMOVEMENT_H
@@ -0,0 +1,506 @@
+//===== Copyright (c) 1996-2005, Valve Corporation, All rights reserved. ======//
+//
+// Purpose: Hashed name lookup in front of an INetworkStringTable.
+//
+// $NoKeywords: $
+//===========================================================================//
+
+#include "cbase.h"
+#include "networkstringtableindex.h"
+#include "utldict.h"
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+
+#define STRINGTABLEINDEX_MIN_SLOT_BITS	6
+
+
+CNetworkStringTableIndex::CNetworkStringTableIndex()
+{
+	m_pTable = NULL;
+	m_nIndexed = 0;
+	m_nSlotMask = 0;
+	m_nSlotBits = 0;
+}
+
+void CNetworkStringTableIndex::Init( INetworkStringTable *pTable )
+{
+	Purge();
+	m_pTable = pTable;
+	if ( m_pTable )
+	{
+		Sync();
+	}
+}
+
+void CNetworkStringTableIndex::Purge()
+{
+	m_pTable = NULL;
+	m_nIndexed = 0;
+	m_nSlotMask = 0;
+	m_nSlotBits = 0;
+	m_Slots.Purge();
+}
+
+//-----------------------------------------------------------------------------
+// FNV-1a over the string with ASCII upper case folded to lower case, which is
+// what the table's compares ignore. Cheaper than the generic caseless hashes
+// since it doesn't call tolower() per character.
+//-----------------------------------------------------------------------------
+unsigned int CNetworkStringTableIndex::HashString( const char *pString )
+{
+	unsigned int nHash = 2166136261u;
+	for ( const unsigned char *p = (const unsigned char *)pString; *p; ++p )
+	{
+		unsigned int c = *p;
+		if ( c - 'A' <= 'Z' - 'A' )
+		{
+			c += 'a' - 'A';
+		}
+		nHash = ( nHash ^ c ) * 16777619u;
+	}
+	return nHash;
+}
+
+
+//-----------------------------------------------------------------------------
+// Hashes the strings the table got since the last call
+//-----------------------------------------------------------------------------
+void CNetworkStringTableIndex::Sync()
+{
+	int nStrings = m_pTable->GetNumStrings();
+	if ( nStrings == m_nIndexed )
+		return;
+
+	if ( nStrings < m_nIndexed )
+	{
+		// Can only shrink if the engine made a new table at the same address
+		INetworkStringTable *pTable = m_pTable;
+		Purge();
+		m_pTable = pTable;
+	}
+
+	EnsureCapacity( nStrings );
+	for ( int i = m_nIndexed; i < nStrings; ++i )
+	{
+		const char *pString = m_pTable->GetString( i );
+		if ( pString )
+		{
+			Insert( HashString( pString ), i );
+		}
+	}
+	m_nIndexed = nStrings;
+}
+
+void CNetworkStringTableIndex::EnsureCapacity( int nStrings )
+{
+	if ( nStrings * 2 <= m_Slots.Count() )
+		return;
+
+	int nBits = MAX( m_nSlotBits, STRINGTABLEINDEX_MIN_SLOT_BITS );
+	while ( ( 1 << nBits ) < nStrings * 2 )
+	{
+		++nBits;
+	}
+
+	CUtlVector< Slot_t > oldSlots;
+	oldSlots.Swap( m_Slots );
+
+	m_nSlotBits = nBits;
+	m_nSlotMask = ( 1u << nBits ) - 1;
+	m_Slots.SetCount( 1 << nBits );
+	for ( int i = 0; i < m_Slots.Count(); ++i )
+	{
+		m_Slots[i].m_nString = -1;
+	}
+
+	for ( int i = 0; i < oldSlots.Count(); ++i )
+	{
+		if ( oldSlots[i].m_nString >= 0 )
+		{
+			Insert( oldSlots[i].m_nHash, oldSlots[i].m_nString );
+		}
+	}
+}
+
+// Fibonacci hashing: the slot comes from the top bits of the mixed hash
+#define STRINGTABLEINDEX_SLOT( _hash )	( ( (_hash) * 2654435769u ) >> ( 32 - m_nSlotBits ) )
+
+void CNetworkStringTableIndex::Insert( unsigned int nHash, int nString )
+{
+	unsigned int nSlot = STRINGTABLEINDEX_SLOT( nHash );
+	while ( m_Slots[nSlot].m_nString >= 0 )
+	{
+		nSlot = ( nSlot + 1 ) & m_nSlotMask;
+	}
+	m_Slots[nSlot].m_nHash = nHash;
+	m_Slots[nSlot].m_nString = nString;
+}
+
+int CNetworkStringTableIndex::Find( const char *pString, unsigned int nHash ) const
+{
+	if ( !m_Slots.Count() )
+		return -1;
+
+	unsigned int nSlot = STRINGTABLEINDEX_SLOT( nHash );
+	for ( ;; )
+	{
+		const Slot_t &slot = m_Slots[nSlot];
+		if ( slot.m_nString < 0 )
+			return -1;
+
+		if ( slot.m_nHash == nHash && !V_stricmp( m_pTable->GetString( slot.m_nString ), pString ) )
+			return slot.m_nString;
+
+		nSlot = ( nSlot + 1 ) & m_nSlotMask;
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Lookups
+//-----------------------------------------------------------------------------
+int CNetworkStringTableIndex::FindStringIndex( const char *pString )
+{
+	return FindStringIndex( pString, HashString( pString ) );
+}
+
+int CNetworkStringTableIndex::FindStringIndex( const char *pString, unsigned int nHash )
+{
+	Assert( nHash == HashString( pString ) );
+	if ( !m_pTable )
+		return INVALID_STRING_INDEX;
+
+	Sync();
+	int nString = Find( pString, nHash );
+	return ( nString >= 0 ) ? nString : INVALID_STRING_INDEX;
+}
+
+
+//-----------------------------------------------------------------------------
+// Adds; the new string is picked up by Sync() like any other
+//-----------------------------------------------------------------------------
+int CNetworkStringTableIndex::AddString( bool bIsServer, const char *pString, int nLength, const void *pUserData )
+{
+	Assert( m_pTable );
+	if ( nLength == -1 )
+		return AddString( bIsServer, pString, HashString( pString ) );
+
+	// Setting user data, which only the table can do
+	int nString = m_pTable->AddString( bIsServer, pString, nLength, pUserData );
+	Sync();
+	return nString;
+}
+
+int CNetworkStringTableIndex::AddString( bool bIsServer, const char *pString, unsigned int nHash )
+{
+	Assert( m_pTable && nHash == HashString( pString ) );
+	Sync();
+	int nString = Find( pString, nHash );
+	if ( nString >= 0 )
+		return nString;
+
+	nString = m_pTable->AddString( bIsServer, pString );
+	Sync();
+	return nString;
+}
+
+void CNetworkStringTableIndex::AddStrings( bool bIsServer, const char * const *ppStrings, int nCount, int *pIndices )
+{
+	Assert( m_pTable );
+	Sync();
+	EnsureCapacity( MIN( m_nIndexed + nCount, m_pTable->GetMaxStrings() ) );
+
+	for ( int i = 0; i < nCount; ++i )
+	{
+		int nString = AddString( bIsServer, ppStrings[i], HashString( ppStrings[i] ) );
+		if ( pIndices )
+		{
+			pIndices[i] = nString;
+		}
+	}
+}
+
+
+#if defined( FASTPATH_TESTS )
+
+//-----------------------------------------------------------------------------
+// Tests
+//-----------------------------------------------------------------------------
+
+// A string table that looks strings up the way the engine's does, through an
+// ordered case insensitive dictionary
+class CStringTableIndexTestTable : public INetworkStringTable
+{
+public:
+	CStringTableIndexTestTable( int nMaxStrings ) : m_Dict( k_eDictCompareTypeCaseInsensitive ), m_nMaxStrings( nMaxStrings ) {}
+
+	virtual const char *GetTableName( void ) const		{ return "StringTableIndexTest"; }
+	virtual TABLEID GetTableId( void ) const			{ return 0; }
+	virtual int GetNumStrings( void ) const				{ return m_Strings.Count(); }
+	virtual int GetMaxStrings( void ) const				{ return m_nMaxStrings; }
+	virtual int GetEntryBits( void ) const				{ return Q_log2( m_nMaxStrings ); }
+	virtual void SetTick( int tick )					{}
+	virtual bool ChangedSinceTick( int tick ) const		{ return false; }
+
+	virtual int AddString( bool bIsServer, const char *value, int length = -1, const void *userdata = 0 )
+	{
+		int nString = FindStringIndex( value );
+		if ( nString != INVALID_STRING_INDEX )
+			return nString;
+		if ( m_Strings.Count() >= m_nMaxStrings )
+			return INVALID_STRING_INDEX;
+
+		int i = m_Dict.Insert( value, m_Strings.Count() );
+		return m_Strings.AddToTail( i );
+	}
+
+	virtual const char *GetString( int stringNumber ) const	{ return m_Dict.GetElementName( m_Strings[stringNumber] ); }
+	virtual void SetStringUserData( int stringNumber, int length, const void *userdata ) {}
+	virtual const void *GetStringUserData( int stringNumber, int *length ) const	{ if ( length ) { *length = 0; } return NULL; }
+
+	virtual int FindStringIndex( char const *string )
+	{
+		int i = m_Dict.Find( string );
+		return ( i != m_Dict.InvalidIndex() ) ? m_Dict[i] : INVALID_STRING_INDEX;
+	}
+
+	virtual void SetStringChangedCallback( void *object, pfnStringChanged changeFunc ) {}
+
+private:
+	CUtlDict< int, int > m_Dict;
+	CUtlVector< int > m_Strings;
+	int m_nMaxStrings;
+};
+
+static unsigned int s_nStringTableIndexSeed;
+
+static unsigned int StringTableIndexTest_Random()
+{
+	s_nStringTableIndexSeed = s_nStringTableIndexSeed * 1664525 + 1013904223;
+	return s_nStringTableIndexSeed >> 8;
+}
+
+// Precache-like names: a few directories, many files
+static void StringTableIndexTest_MakeNames( int nCount, CUtlVector< CUtlString > &names )
+{
+	static const char *s_pszDirs[] = { "models/props_c17/", "models/player/", "sound/weapons/", "particles/", "materials/effects/" };
+	static const char *s_pszExts[] = { ".mdl", ".mdl", ".wav", ".pcf", ".vmt" };
+
+	names.SetCount( nCount );
+	for ( int i = 0; i < nCount; ++i )
+	{
+		int nDir = i % ARRAYSIZE( s_pszDirs );
+		names[i].Format( "%sasset_%04x_%d%s", s_pszDirs[nDir], StringTableIndexTest_Random() & 0xffff, i, s_pszExts[nDir] );
+	}
+}
+
+// The same name with some letters in upper case
+static const char *StringTableIndexTest_Respell( const char *pszName, char *pszBuf, int nBufSize )
+{
+	V_strncpy( pszBuf, pszName, nBufSize );
+	for ( char *p = pszBuf; *p; ++p )
+	{
+		if ( ( StringTableIndexTest_Random() & 3 ) == 0 )
+		{
+			*p = toupper( *p );
+		}
+	}
+	return pszBuf;
+}
+
+static int StringTableIndexTest_Compare( CNetworkStringTableIndex &index, CStringTableIndexTestTable &table, const CUtlVector< CUtlString > &names )
+{
+	int nFailures = 0;
+	char szName[MAX_PATH];
+	for ( int i = 0; i < names.Count(); ++i )
+	{
+		const char *pszName = StringTableIndexTest_Respell( names[i], szName, sizeof( szName ) );
+		int nExpected = table.FindStringIndex( pszName );
+		int nFound = index.FindStringIndex( pszName );
+		int nHashed = index.FindStringIndex( pszName, CNetworkStringTableIndex::HashString( pszName ) );
+		if ( nFound != nExpected || nHashed != nExpected )
+		{
+			if ( ++nFailures <= 5 )
+			{
+				Warning( "string table index: %s is %d in the table, the index has %d (hashed %d)\n", pszName, nExpected, nFound, nHashed );
+			}
+		}
+
+		char szMissing[MAX_PATH];
+		V_snprintf( szMissing, sizeof( szMissing ), "%s.missing", pszName );
+		if ( index.FindStringIndex( szMissing ) != INVALID_STRING_INDEX )
+		{
+			if ( ++nFailures <= 5 )
+			{
+				Warning( "string table index: found %s\n", szMissing );
+			}
+		}
+	}
+	return nFailures;
+}
+
+bool NetworkStringTableIndex_Validate( int nStrings )
+{
+	s_nStringTableIndexSeed = 0x5eed;
+	nStrings = MAX( nStrings, 3 );
+
+	CUtlVector< CUtlString > names;
+	StringTableIndexTest_MakeNames( nStrings, names );
+
+	CStringTableIndexTestTable table( nStrings * 2 );
+	CNetworkStringTableIndex index;
+	index.Init( &table );
+
+	int nFailures = 0;
+	int nThird = nStrings / 3;
+
+	// One by one through the index, every other one with a cached hash
+	for ( int i = 0; i < nThird; ++i )
+	{
+		int nString = ( i & 1 ) ? index.AddString( true, names[i] ) : index.AddString( true, names[i], CNetworkStringTableIndex::HashString( names[i] ) );
+		if ( nString != table.FindStringIndex( names[i] ) )
+		{
+			++nFailures;
+		}
+	}
+
+	// In bulk, with the first third again in other spellings that must keep their numbers
+	CUtlVector< const char * > bulk;
+	CUtlVector< CUtlString > respelled;
+	respelled.SetCount( nThird );
+	for ( int i = nThird; i < 2 * nThird; ++i )
+	{
+		bulk.AddToTail( names[i] );
+		char szName[MAX_PATH];
+		respelled[i - nThird] = StringTableIndexTest_Respell( names[i - nThird], szName, sizeof( szName ) );
+		bulk.AddToTail( respelled[i - nThird] );
+	}
+	CUtlVector< int > indices;
+	indices.SetCount( bulk.Count() );
+	index.AddStrings( true, bulk.Base(), bulk.Count(), indices.Base() );
+	for ( int i = 0; i < bulk.Count(); ++i )
+	{
+		if ( indices[i] != table.FindStringIndex( bulk[i] ) )
+		{
+			++nFailures;
+		}
+	}
+	if ( table.GetNumStrings() != 2 * nThird )
+	{
+		Warning( "string table index: the table has %d strings after adding %d\n", table.GetNumStrings(), 2 * nThird );
+		++nFailures;
+	}
+
+	// The rest behind the index's back, like strings arriving from the server
+	for ( int i = 2 * nThird; i < nStrings; ++i )
+	{
+		table.AddString( true, names[i] );
+	}
+
+	nFailures += StringTableIndexTest_Compare( index, table, names );
+
+	// Bound to another table
+	CStringTableIndexTestTable other( nStrings * 2 );
+	for ( int i = nStrings - 1; i >= 0; i -= 2 )
+	{
+		other.AddString( false, names[i] );
+	}
+	index.Init( &other );
+	nFailures += StringTableIndexTest_Compare( index, other, names );
+
+	// A full table refuses strings through the index like it does directly
+	CStringTableIndexTestTable full( 4 );
+	index.Init( &full );
+	const char *pszFull[] = { "a", "b", "A", "c", "d", "e", "B", "f" };
+	int nFull[ARRAYSIZE( pszFull )];
+	index.AddStrings( true, pszFull, ARRAYSIZE( pszFull ), nFull );
+	for ( int i = 0; i < ARRAYSIZE( pszFull ); ++i )
+	{
+		if ( nFull[i] != full.FindStringIndex( pszFull[i] ) )
+		{
+			Warning( "string table index: %s got %d in a full table, which has it at %d\n", pszFull[i], nFull[i], full.FindStringIndex( pszFull[i] ) );
+			++nFailures;
+		}
+	}
+
+	Msg( "string table index: %d strings compared against the table: %s\n", nStrings, nFailures ? "FAILED" : "OK" );
+	return nFailures == 0;
+}
+
+void NetworkStringTableIndex_Benchmark( int nStrings, int nIterations )
+{
+	s_nStringTableIndexSeed = 0xbe9c4;
+	nStrings = MAX( nStrings, 1 );
+	nIterations = MAX( nIterations, 1 );
+
+	CUtlVector< CUtlString > names;
+	StringTableIndexTest_MakeNames( nStrings, names );
+
+	// Level load precaches most names more than once (every entity precaches its model)
+	const int nPrecaches = 4;
+	CUtlVector< const char * > precaches;
+	char szName[MAX_PATH];
+	CUtlVector< CUtlString > spellings;
+	spellings.SetCount( nStrings * nPrecaches );
+	for ( int i = 0; i < spellings.Count(); ++i )
+	{
+		spellings[i] = StringTableIndexTest_Respell( names[StringTableIndexTest_Random() % nStrings], szName, sizeof( szName ) );
+		precaches.AddToTail( spellings[i] );
+	}
+
+	CUtlVector< int > lookups;
+	lookups.SetCount( nIterations );
+	CUtlVector< unsigned int > hashes;
+	hashes.SetCount( nIterations );
+	for ( int i = 0; i < nIterations; ++i )
+	{
+		lookups[i] = StringTableIndexTest_Random() % precaches.Count();
+		hashes[i] = CNetworkStringTableIndex::HashString( precaches[lookups[i]] );
+	}
+
+	CStringTableIndexTestTable table( nStrings * 2 );
+	double flStart = Plat_FloatTime();
+	for ( int i = 0; i < precaches.Count(); ++i )
+	{
+		table.AddString( true, precaches[i] );
+	}
+	double flTableLoad = Plat_FloatTime() - flStart;
+
+	CStringTableIndexTestTable indexed( nStrings * 2 );
+	CNetworkStringTableIndex index;
+	index.Init( &indexed );
+	flStart = Plat_FloatTime();
+	index.AddStrings( true, precaches.Base(), precaches.Count() );
+	double flIndexLoad = Plat_FloatTime() - flStart;
+
+	int nSum = 0;
+	flStart = Plat_FloatTime();
+	for ( int i = 0; i < nIterations; ++i )
+	{
+		nSum += table.FindStringIndex( precaches[lookups[i]] );
+	}
+	double flTableFind = Plat_FloatTime() - flStart;
+
+	flStart = Plat_FloatTime();
+	for ( int i = 0; i < nIterations; ++i )
+	{
+		nSum -= index.FindStringIndex( precaches[lookups[i]] );
+	}
+	double flIndexFind = Plat_FloatTime() - flStart;
+
+	flStart = Plat_FloatTime();
+	for ( int i = 0; i < nIterations; ++i )
+	{
+		nSum += index.FindStringIndex( precaches[lookups[i]], hashes[i] );
+	}
+	double flHashedFind = Plat_FloatTime() - flStart;
+
+	Msg( "string table index: %d strings, %d precaches, %d lookups (checksum %d)\n", table.GetNumStrings(), precaches.Count(), nIterations, nSum );
+	Msg( "  load:   table %8.3f ms, index bulk %8.3f ms, %.2fx\n", flTableLoad * 1000.0, flIndexLoad * 1000.0, flIndexLoad > 0.0 ? flTableLoad / flIndexLoad : 0.0 );
+	Msg( "  find:   table %8.3f ms, index %8.3f ms, %.2fx\n", flTableFind * 1000.0, flIndexFind * 1000.0, flIndexFind > 0.0 ? flTableFind / flIndexFind : 0.0 );
+	Msg( "  hashed: index %8.3f ms, %.2fx\n", flHashedFind * 1000.0, flHashedFind > 0.0 ? flTableFind / flHashedFind : 0.0 );
+}
+
+#endif // FASTPATH_TESTS
@@ -0,0 +1,89 @@
+//===== Copyright (c) 1996-2005, Valve Corporation, All rights reserved. ======//
+//
+// Purpose: Hashed name lookup in front of an INetworkStringTable.
+//
+//			The engine finds a string in a table by walking an ordered
+//			dictionary with case insensitive compares. The index here is an
+//			open addressed hash of the case folded strings mapping to the
+//			table's own string numbers, so the numbers the engine hands out
+//			stay the only ones anybody sees.
+//
+//			Strings are only ever appended to a table, so the index keeps
+//			in sync by hashing the strings past the ones it has seen before
+//			each lookup. That covers strings added by the engine or arriving
+//			from the server without a change callback (the client tables
+//			already have theirs taken by the game).
+//
+// $NoKeywords: $
+//===========================================================================//
+
+#ifndef NETWORKSTRINGTABLEINDEX_H
+#define NETWORKSTRINGTABLEINDEX_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include "networkstringtabledefs.h"
+#include "utlvector.h"
+
+
+class CNetworkStringTableIndex
+{
+public:
+	CNetworkStringTableIndex();
+
+	// Indexes the strings already in the table. NULL unbinds.
+	void Init( INetworkStringTable *pTable );
+	void Purge();
+
+	INetworkStringTable *GetTable() const		{ return m_pTable; }
+
+	// Case folded, so it matches for every spelling the table treats as the same string.
+	// Callers that look the same name up repeatedly can keep the hash.
+	static unsigned int HashString( const char *pString );
+
+	// INVALID_STRING_INDEX if the table doesn't have the string
+	int FindStringIndex( const char *pString );
+	int FindStringIndex( const char *pString, unsigned int nHash );
+
+	// Like INetworkStringTable::AddString(). The table is only called for
+	// strings it doesn't have yet, or to change the user data of one it has.
+	int AddString( bool bIsServer, const char *pString, int nLength = -1, const void *pUserData = NULL );
+	int AddString( bool bIsServer, const char *pString, unsigned int nHash );
+
+	// Level load path: sizes the index for all of them once, then adds each
+	// string without user data. pIndices (optional) gets the string numbers.
+	void AddStrings( bool bIsServer, const char * const *ppStrings, int nCount, int *pIndices = NULL );
+
+private:
+	struct Slot_t
+	{
+		unsigned int	m_nHash;
+		int				m_nString;		// -1 if the slot is free
+	};
+
+	void Sync();
+	void EnsureCapacity( int nStrings );
+	void Insert( unsigned int nHash, int nString );
+	int Find( const char *pString, unsigned int nHash ) const;
+
+	INetworkStringTable *m_pTable;
+	int m_nIndexed;					// strings of the table in the index
+	unsigned int m_nSlotMask;
+	int m_nSlotBits;
+	CUtlVector< Slot_t > m_Slots;	// power of two, at most half full
+};
+
+
+#if defined( FASTPATH_TESTS )
+//-----------------------------------------------------------------------------
+// Checks the index against the table's own lookups on a test table with
+// strings added through the index, in bulk and behind its back, then times
+// loading and looking up nStrings strings both ways
+//-----------------------------------------------------------------------------
+bool NetworkStringTableIndex_Validate( int nStrings );
+void NetworkStringTableIndex_Benchmark( int nStrings, int nIterations );
+#endif
+
+
+#endif // NETWORKSTRINGTABLEINDEX_H
@@ -0,0 +1,612 @@
+//===== Copyright (c) 1996-2005, Valve Corporation, All rights reserved. ======//
+//
+// Purpose: Orders a frame of particle system simulation for the job pool.
+//
+// $NoKeywords: $
+//===========================================================================//
+
+#include "cbase.h"
+#include "particlesimschedule.h"
+#include "mathlib/ssemath.h"
+#include "vstdlib/jobthread.h"
+#include <algorithm>
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+
+CParticleSimSchedule::CParticleSimSchedule()
+{
+	m_nGroups = 0;
+	m_flMaxBatchCost = 0.0f;
+	m_pfnProcess = NULL;
+}
+
+void CParticleSimSchedule::RemoveAll()
+{
+	m_Units.RemoveAll();
+	m_Order.RemoveAll();
+	m_Batches.RemoveAll();
+	m_flMaxBatchCost = 0.0f;
+}
+
+void CParticleSimSchedule::Purge()
+{
+	m_Units.Purge();
+	m_GroupSlots.Purge();
+	m_Order.Purge();
+	m_Batches.Purge();
+	m_flMaxBatchCost = 0.0f;
+}
+
+void CParticleSimSchedule::AddUnit( void *pUnit, const void *pGroup, float flCost )
+{
+	Unit_t &unit = m_Units[ m_Units.AddToTail() ];
+	unit.m_pUnit = pUnit;
+	unit.m_pGroup = pGroup;
+	unit.m_flCost = flCost;
+}
+
+// Numbers the groups in the order they turn up
+int CParticleSimSchedule::FindGroup( const void *pGroup )
+{
+	unsigned int nMask = m_GroupSlots.Count() - 1;
+	uintp nPointer = (uintp)pGroup;
+	unsigned int nSlot = ( (unsigned int)( nPointer >> 4 ) ^ (unsigned int)( (uint64)nPointer >> 32 ) ) * 0x9E3779B9u;
+	for ( nSlot = ( nSlot >> 16 ) & nMask; ; nSlot = ( nSlot + 1 ) & nMask )
+	{
+		GroupSlot_t &slot = m_GroupSlots[nSlot];
+		if ( slot.m_nGroup < 0 )
+		{
+			slot.m_pGroup = pGroup;
+			slot.m_nGroup = m_nGroups++;
+			return slot.m_nGroup;
+		}
+		if ( slot.m_pGroup == pGroup )
+			return slot.m_nGroup;
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// A batch takes units of its group until the next one would take it over
+// the cap; a unit that costs more than the cap gets a batch of its own
+//-----------------------------------------------------------------------------
+void CParticleSimSchedule::Schedule( int nThreads )
+{
+	m_Order.RemoveAll();
+	m_Batches.RemoveAll();
+
+	int nUnits = m_Units.Count();
+	if ( !nUnits )
+		return;
+
+	int nSlots = 16;
+	while ( nSlots < nUnits * 2 )
+	{
+		nSlots <<= 1;
+	}
+	m_GroupSlots.SetCount( nSlots );
+	for ( int i = 0; i < nSlots; ++i )
+	{
+		m_GroupSlots[i].m_nGroup = -1;
+	}
+	m_nGroups = 0;
+
+	// Costs are positive, so their bits sort like unsigned ints
+	float flTotalCost = 0.0f;
+	for ( int i = 0; i < nUnits; ++i )
+	{
+		Unit_t &unit = m_Units[i];
+		unit.m_flCost = MAX( unit.m_flCost, 0.0f );
+		flTotalCost += unit.m_flCost;
+		unit.m_nSortKey = ( (uint64)FindGroup( unit.m_pGroup ) << 32 ) | ( 0xffffffffu - *(uint32 *)&unit.m_flCost );
+	}
+
+	std::sort( m_Units.Base(), m_Units.Base() + nUnits, UnitLess_t() );
+	m_flMaxBatchCost = flTotalCost / ( MAX( nThreads, 1 ) * PARTICLESIMSCHEDULE_BATCHES_PER_THREAD );
+
+	m_Order.SetCount( nUnits );
+	Batch_t *pBatch = NULL;
+	for ( int i = 0; i < nUnits; ++i )
+	{
+		const Unit_t &unit = m_Units[i];
+		m_Order[i] = unit.m_pUnit;
+
+		if ( !pBatch || unit.m_pGroup != m_Units[i - 1].m_pGroup || pBatch->m_flCost + unit.m_flCost > m_flMaxBatchCost )
+		{
+			pBatch = &m_Batches[ m_Batches.AddToTail() ];
+			pBatch->m_pSchedule = this;
+			pBatch->m_nFirst = i;
+			pBatch->m_nCount = 0;
+			pBatch->m_flCost = 0.0f;
+		}
+
+		++pBatch->m_nCount;
+		pBatch->m_flCost += unit.m_flCost;
+	}
+
+	std::stable_sort( m_Batches.Base(), m_Batches.Base() + m_Batches.Count(), BatchLess_t() );
+}
+
+void CParticleSimSchedule::ProcessBatch( Batch_t &batch )
+{
+	void (*pfnProcess)( void * ) = batch.m_pSchedule->m_pfnProcess;
+	void * const *ppUnits = batch.m_pSchedule->m_Order.Base() + batch.m_nFirst;
+	for ( int i = 0; i < batch.m_nCount; ++i )
+	{
+		pfnProcess( ppUnits[i] );
+	}
+}
+
+void CParticleSimSchedule::Run( void (*pfnProcess)( void *pUnit ), void (*pfnBegin)(), void (*pfnEnd)(), IThreadPool *pThreadPool )
+{
+	if ( !m_Batches.Count() )
+		return;
+
+	m_pfnProcess = pfnProcess;
+	ParallelProcess( pThreadPool, m_Batches.Base(), m_Batches.Count(), &CParticleSimSchedule::ProcessBatch, pfnBegin, pfnEnd );
+}
+
+
+#if defined( FASTPATH_TESTS )
+
+//-----------------------------------------------------------------------------
+// Tests
+//-----------------------------------------------------------------------------
+
+enum ParticleSimTestOperator_t
+{
+	PARTICLESIMTEST_GRAVITY = 0,
+	PARTICLESIMTEST_DRAG,
+	PARTICLESIMTEST_MOVE,
+	PARTICLESIMTEST_DECAY,
+
+	PARTICLESIMTEST_OPERATOR_COUNT
+};
+
+enum ParticleSimTestStream_t
+{
+	PARTICLESIMTEST_POS_X = 0,
+	PARTICLESIMTEST_POS_Y,
+	PARTICLESIMTEST_POS_Z,
+	PARTICLESIMTEST_VEL_X,
+	PARTICLESIMTEST_VEL_Y,
+	PARTICLESIMTEST_VEL_Z,
+	PARTICLESIMTEST_LIFE,
+
+	PARTICLESIMTEST_STREAM_COUNT
+};
+
+struct ParticleSimTestDef_t
+{
+	CUtlVector< int > m_Operators;
+};
+
+// A particle collection cut down to what the schedule sees: SoA streams
+// padded to four particles, children simulated by their parent
+struct ParticleSimTestSystem_t
+{
+	const ParticleSimTestDef_t *m_pDef;
+	int m_nParticles;
+	CUtlVector< float > m_Streams;
+	CUtlVector< ParticleSimTestSystem_t * > m_Children;
+	int m_nSimulated;
+
+	float *GetStream( int nStream )		{ return m_Streams.Base() + nStream * m_nParticles; }
+};
+
+static unsigned int s_nParticleSimTestSeed;
+
+static unsigned int ParticleSimTest_Random()
+{
+	s_nParticleSimTestSeed = s_nParticleSimTestSeed * 1664525 + 1013904223;
+	return s_nParticleSimTestSeed >> 8;
+}
+
+static float ParticleSimTest_RandomFloat( float flMin, float flMax )
+{
+	return flMin + ( flMax - flMin ) * ( ParticleSimTest_Random() & 0xffff ) / 65535.0f;
+}
+
+static void ParticleSimTest_MakeDefs( CUtlVector< ParticleSimTestDef_t > &defs, int nDefs )
+{
+	defs.SetCount( nDefs );
+	for ( int i = 0; i < nDefs; ++i )
+	{
+		int nOperators = 2 + ParticleSimTest_Random() % 7;
+		for ( int j = 0; j < nOperators; ++j )
+		{
+			defs[i].m_Operators.AddToTail( ParticleSimTest_Random() % PARTICLESIMTEST_OPERATOR_COUNT );
+		}
+	}
+}
+
+static ParticleSimTestSystem_t *ParticleSimTest_CreateSystem( const CUtlVector< ParticleSimTestDef_t > &defs, int nParticles, int nDepth )
+{
+	ParticleSimTestSystem_t *pSystem = new ParticleSimTestSystem_t;
+	pSystem->m_pDef = &defs[ ParticleSimTest_Random() % defs.Count() ];
+	pSystem->m_nParticles = ( nParticles + 3 ) & ~3;
+	pSystem->m_nSimulated = 0;
+	pSystem->m_Streams.SetCount( pSystem->m_nParticles * PARTICLESIMTEST_STREAM_COUNT );
+	for ( int i = 0; i < pSystem->m_Streams.Count(); ++i )
+	{
+		pSystem->m_Streams[i] = ParticleSimTest_RandomFloat( -100.0f, 100.0f );
+	}
+
+	int nChildren = nDepth ? ParticleSimTest_Random() % 3 : 0;
+	for ( int i = 0; i < nChildren; ++i )
+	{
+		pSystem->m_Children.AddToTail( ParticleSimTest_CreateSystem( defs, 1 + nParticles / 2, nDepth - 1 ) );
+	}
+	return pSystem;
+}
+
+static void ParticleSimTest_DestroySystem( ParticleSimTestSystem_t *pSystem )
+{
+	for ( int i = 0; i < pSystem->m_Children.Count(); ++i )
+	{
+		ParticleSimTest_DestroySystem( pSystem->m_Children[i] );
+	}
+	delete pSystem;
+}
+
+// Most systems are a few dozen sprites, a few are big
+static void ParticleSimTest_CreateSystems( const CUtlVector< ParticleSimTestDef_t > &defs, CUtlVector< ParticleSimTestSystem_t * > &systems, int nSystems )
+{
+	for ( int i = 0; i < nSystems; ++i )
+	{
+		int nParticles = ( ParticleSimTest_Random() % 32 ) ? 8 + ParticleSimTest_Random() % 56 : 1024 + ParticleSimTest_Random() % 4096;
+		systems.AddToTail( ParticleSimTest_CreateSystem( defs, nParticles, 2 ) );
+	}
+}
+
+static void ParticleSimTest_DestroySystems( CUtlVector< ParticleSimTestSystem_t * > &systems )
+{
+	for ( int i = 0; i < systems.Count(); ++i )
+	{
+		ParticleSimTest_DestroySystem( systems[i] );
+	}
+	systems.Purge();
+}
+
+static void ParticleSimTest_Simulate( ParticleSimTestSystem_t *pSystem, float flDt )
+{
+	fltx4 dt = ReplicateX4( flDt );
+	fltx4 gravity = ReplicateX4( -800.0f * flDt );
+	fltx4 drag = ReplicateX4( 1.0f - 0.06f * flDt );
+	int n = pSystem->m_nParticles;
+	float *pPosX = pSystem->GetStream( PARTICLESIMTEST_POS_X );
+	float *pPosY = pSystem->GetStream( PARTICLESIMTEST_POS_Y );
+	float *pPosZ = pSystem->GetStream( PARTICLESIMTEST_POS_Z );
+	float *pVelX = pSystem->GetStream( PARTICLESIMTEST_VEL_X );
+	float *pVelY = pSystem->GetStream( PARTICLESIMTEST_VEL_Y );
+	float *pVelZ = pSystem->GetStream( PARTICLESIMTEST_VEL_Z );
+	float *pLife = pSystem->GetStream( PARTICLESIMTEST_LIFE );
+
+	const CUtlVector< int > &operators = pSystem->m_pDef->m_Operators;
+	for ( int nOp = 0; nOp < operators.Count(); ++nOp )
+	{
+		switch ( operators[nOp] )
+		{
+		case PARTICLESIMTEST_GRAVITY:
+			for ( int i = 0; i < n; i += 4 )
+			{
+				StoreUnalignedSIMD( pVelZ + i, AddSIMD( LoadUnalignedSIMD( pVelZ + i ), gravity ) );
+			}
+			break;
+
+		case PARTICLESIMTEST_DRAG:
+			for ( int i = 0; i < n; i += 4 )
+			{
+				StoreUnalignedSIMD( pVelX + i, MulSIMD( LoadUnalignedSIMD( pVelX + i ), drag ) );
+				StoreUnalignedSIMD( pVelY + i, MulSIMD( LoadUnalignedSIMD( pVelY + i ), drag ) );
+				StoreUnalignedSIMD( pVelZ + i, MulSIMD( LoadUnalignedSIMD( pVelZ + i ), drag ) );
+			}
+			break;
+
+		case PARTICLESIMTEST_MOVE:
+			for ( int i = 0; i < n; i += 4 )
+			{
+				StoreUnalignedSIMD( pPosX + i, MaddSIMD( LoadUnalignedSIMD( pVelX + i ), dt, LoadUnalignedSIMD( pPosX + i ) ) );
+				StoreUnalignedSIMD( pPosY + i, MaddSIMD( LoadUnalignedSIMD( pVelY + i ), dt, LoadUnalignedSIMD( pPosY + i ) ) );
+				StoreUnalignedSIMD( pPosZ + i, MaddSIMD( LoadUnalignedSIMD( pVelZ + i ), dt, LoadUnalignedSIMD( pPosZ + i ) ) );
+			}
+			break;
+
+		case PARTICLESIMTEST_DECAY:
+			for ( int i = 0; i < n; i += 4 )
+			{
+				StoreUnalignedSIMD( pLife + i, MaxSIMD( SubSIMD( LoadUnalignedSIMD( pLife + i ), dt ), Four_Zeros ) );
+			}
+			break;
+		}
+	}
+
+	for ( int i = 0; i < pSystem->m_Children.Count(); ++i )
+	{
+		ParticleSimTest_Simulate( pSystem->m_Children[i], flDt );
+	}
+}
+
+// Mirrors the particle manager's estimate: every operator touches every particle
+static float ParticleSimTest_EstimateCost( const ParticleSimTestSystem_t *pSystem )
+{
+	float flCost = 1.0f + ( pSystem->m_nParticles + 4 ) * ( 1 + pSystem->m_pDef->m_Operators.Count() );
+	for ( int i = 0; i < pSystem->m_Children.Count(); ++i )
+	{
+		flCost += ParticleSimTest_EstimateCost( pSystem->m_Children[i] );
+	}
+	return flCost;
+}
+
+#define PARTICLESIMTEST_DT	( 1.0f / 60.0f )
+
+static void ParticleSimTest_ProcessSystem( ParticleSimTestSystem_t *&pSystem )
+{
+	++pSystem->m_nSimulated;
+	ParticleSimTest_Simulate( pSystem, PARTICLESIMTEST_DT );
+}
+
+static void ParticleSimTest_ProcessUnit( void *pUnit )
+{
+	ParticleSimTestSystem_t *pSystem = (ParticleSimTestSystem_t *)pUnit;
+	ParticleSimTest_ProcessSystem( pSystem );
+}
+
+static int ParticleSimTest_ThreadCount( IThreadPool *pThreadPool )
+{
+	return pThreadPool ? pThreadPool->NumThreads() + 1 : 1;
+}
+
+static void ParticleSimTest_Schedule( CParticleSimSchedule &schedule, CUtlVector< ParticleSimTestSystem_t * > &systems, IThreadPool *pThreadPool )
+{
+	schedule.RemoveAll();
+	for ( int i = 0; i < systems.Count(); ++i )
+	{
+		schedule.AddUnit( systems[i], systems[i]->m_pDef, ParticleSimTest_EstimateCost( systems[i] ) );
+	}
+	schedule.Schedule( ParticleSimTest_ThreadCount( pThreadPool ) );
+}
+
+static bool ParticleSimTest_SameStreams( ParticleSimTestSystem_t *pA, ParticleSimTestSystem_t *pB )
+{
+	if ( pA->m_Streams.Count() != pB->m_Streams.Count() || pA->m_Children.Count() != pB->m_Children.Count() )
+		return false;
+	if ( V_memcmp( pA->m_Streams.Base(), pB->m_Streams.Base(), pA->m_Streams.Count() * sizeof( float ) ) )
+		return false;
+	for ( int i = 0; i < pA->m_Children.Count(); ++i )
+	{
+		if ( !ParticleSimTest_SameStreams( pA->m_Children[i], pB->m_Children[i] ) )
+			return false;
+	}
+	return true;
+}
+
+// Every unit in exactly one batch of its own group, batches under the cap
+// unless they hold a single unit, most expensive first
+static int ParticleSimTest_CheckBatches( const CParticleSimSchedule &schedule, CUtlVector< ParticleSimTestSystem_t * > &systems )
+{
+	int nFailures = 0;
+	int nUnits = 0;
+	for ( int iBatch = 0; iBatch < schedule.GetBatchCount(); ++iBatch )
+	{
+		int nCount = schedule.GetBatchUnitCount( iBatch );
+		const ParticleSimTestDef_t *pDef = ( (ParticleSimTestSystem_t *)schedule.GetBatchUnit( iBatch, 0 ) )->m_pDef;
+		for ( int i = 0; i < nCount; ++i )
+		{
+			ParticleSimTestSystem_t *pSystem = (ParticleSimTestSystem_t *)schedule.GetBatchUnit( iBatch, i );
+			++pSystem->m_nSimulated;
+			if ( pSystem->m_pDef != pDef && ++nFailures <= 5 )
+			{
+				Warning( "particle sim schedule: batch %d mixes definitions\n", iBatch );
+			}
+		}
+		nUnits += nCount;
+
+		if ( nCount > 1 && schedule.GetBatchCost( iBatch ) > schedule.GetMaxBatchCost() && ++nFailures <= 5 )
+		{
+			Warning( "particle sim schedule: batch %d costs %.0f, over the cap of %.0f\n", iBatch, schedule.GetBatchCost( iBatch ), schedule.GetMaxBatchCost() );
+		}
+		if ( iBatch && schedule.GetBatchCost( iBatch ) > schedule.GetBatchCost( iBatch - 1 ) && ++nFailures <= 5 )
+		{
+			Warning( "particle sim schedule: batch %d costs more than batch %d\n", iBatch, iBatch - 1 );
+		}
+	}
+
+	for ( int i = 0; i < systems.Count(); ++i )
+	{
+		if ( systems[i]->m_nSimulated != 1 && ++nFailures <= 5 )
+		{
+			Warning( "particle sim schedule: system %d is in %d batches\n", i, systems[i]->m_nSimulated );
+		}
+		systems[i]->m_nSimulated = 0;
+	}
+	if ( nUnits != systems.Count() && ++nFailures <= 5 )
+	{
+		Warning( "particle sim schedule: %d units in the batches, %d added\n", nUnits, systems.Count() );
+	}
+	return nFailures;
+}
+
+bool ParticleSimSchedule_Validate( int nSystems, IThreadPool *pThreadPool )
+{
+	nSystems = MAX( nSystems, 1 );
+	int nFailures = 0;
+
+	CUtlVector< ParticleSimTestDef_t > defs;
+	CUtlVector< ParticleSimTestSystem_t * > serial, scheduled;
+	s_nParticleSimTestSeed = 0x5c4ed;
+	ParticleSimTest_MakeDefs( defs, 24 );
+	unsigned int nSystemSeed = s_nParticleSimTestSeed;
+	ParticleSimTest_CreateSystems( defs, serial, nSystems );
+	s_nParticleSimTestSeed = nSystemSeed;
+	ParticleSimTest_CreateSystems( defs, scheduled, nSystems );
+
+	// One thread, then the pool
+	CParticleSimSchedule schedule;
+	for ( int nPass = 0; nPass < 2; ++nPass )
+	{
+		IThreadPool *pPool = nPass ? pThreadPool : NULL;
+		ParticleSimTest_Schedule( schedule, scheduled, pPool );
+		nFailures += ParticleSimTest_CheckBatches( schedule, scheduled );
+	}
+
+	const int nFrames = 3;
+	for ( int nFrame = 0; nFrame < nFrames; ++nFrame )
+	{
+		for ( int i = 0; i < serial.Count(); ++i )
+		{
+			ParticleSimTest_ProcessSystem( serial[i] );
+		}
+
+		ParticleSimTest_Schedule( schedule, scheduled, pThreadPool );
+		schedule.Run( ParticleSimTest_ProcessUnit, NULL, NULL, pThreadPool );
+	}
+
+	for ( int i = 0; i < nSystems; ++i )
+	{
+		if ( scheduled[i]->m_nSimulated != nFrames && ++nFailures <= 5 )
+		{
+			Warning( "particle sim schedule: system %d simulated %d times in %d frames\n", i, scheduled[i]->m_nSimulated, nFrames );
+		}
+		if ( !ParticleSimTest_SameStreams( serial[i], scheduled[i] ) && ++nFailures <= 5 )
+		{
+			Warning( "particle sim schedule: system %d differs from the one simulated alone\n", i );
+		}
+	}
+
+	// Nothing to do is fine too
+	CParticleSimSchedule empty;
+	empty.Schedule( ParticleSimTest_ThreadCount( pThreadPool ) );
+	empty.Run( ParticleSimTest_ProcessUnit, NULL, NULL, pThreadPool );
+	if ( empty.GetBatchCount() && ++nFailures <= 5 )
+	{
+		Warning( "particle sim schedule: empty schedule has %d batches\n", empty.GetBatchCount() );
+	}
+
+	ParticleSimTest_DestroySystems( serial );
+	ParticleSimTest_DestroySystems( scheduled );
+
+	Msg( "particle sim schedule: %d systems, %d batches on %d threads: %s\n", nSystems, schedule.GetBatchCount(), ParticleSimTest_ThreadCount( pThreadPool ), nFailures ? "FAILED" : "OK" );
+	return nFailures == 0;
+}
+
+// How long nThreads threads take over the costs when each takes the next
+// one as soon as it's free, the way ParallelProcess() hands out items
+static float ParticleSimTest_Makespan( const CUtlVector< float > &costs, int nThreads )
+{
+	float flFree[32] = { 0.0f };
+	nThreads = clamp( nThreads, 1, (int)ARRAYSIZE( flFree ) );
+	float flMakespan = 0.0f;
+	for ( int i = 0; i < costs.Count(); ++i )
+	{
+		int nThread = 0;
+		for ( int j = 1; j < nThreads; ++j )
+		{
+			if ( flFree[j] < flFree[nThread] )
+			{
+				nThread = j;
+			}
+		}
+		flFree[nThread] += costs[i];
+		flMakespan = MAX( flMakespan, flFree[nThread] );
+	}
+	return flMakespan;
+}
+
+void ParticleSimSchedule_Benchmark( int nSystems, int nFrames, IThreadPool *pThreadPool )
+{
+	nSystems = MAX( nSystems, 1 );
+	nFrames = MAX( nFrames, 1 );
+
+	// The same systems three times, in the same order, one set per mode;
+	// the modes take turns every frame so neither gets the warmer caches
+	CUtlVector< ParticleSimTestDef_t > defs;
+	CUtlVector< ParticleSimTestSystem_t * > systems[3];
+	s_nParticleSimTestSeed = 0x7a11e;
+	ParticleSimTest_MakeDefs( defs, 24 );
+	unsigned int nSystemSeed = s_nParticleSimTestSeed;
+	for ( int nMode = 0; nMode < 3; ++nMode )
+	{
+		s_nParticleSimTestSeed = nSystemSeed;
+		ParticleSimTest_CreateSystems( defs, systems[nMode], nSystems );
+	}
+
+	int nParticles = 0;
+	for ( int i = 0; i < nSystems; ++i )
+	{
+		nParticles += systems[0][i]->m_nParticles;
+	}
+
+	CParticleSimSchedule schedule;
+	double flTime[3] = { 0.0, 0.0, 0.0 };
+	for ( int nFrame = 0; nFrame < nFrames; ++nFrame )
+	{
+		for ( int nMode = 0; nMode < 3; ++nMode )
+		{
+			CUtlVector< ParticleSimTestSystem_t * > &list = systems[nMode];
+			double flStart = Plat_FloatTime();
+			switch ( nMode )
+			{
+			case 0:
+				for ( int i = 0; i < list.Count(); ++i )
+				{
+					ParticleSimTest_ProcessSystem( list[i] );
+				}
+				break;
+
+			case 1:
+				ParallelProcess( pThreadPool, list.Base(), list.Count(), ParticleSimTest_ProcessSystem );
+				break;
+
+			case 2:
+				ParticleSimTest_Schedule( schedule, list, pThreadPool );
+				schedule.Run( ParticleSimTest_ProcessUnit, NULL, NULL, pThreadPool );
+				break;
+			}
+			flTime[nMode] += Plat_FloatTime() - flStart;
+		}
+	}
+
+	// The frame time depends on how many cores there are to spread it over,
+	// so also work it out from the estimates for a few thread counts
+	CUtlVector< float > listCosts, batchCosts;
+	float flTotalCost = 0.0f;
+	for ( int i = 0; i < nSystems; ++i )
+	{
+		listCosts.AddToTail( ParticleSimTest_EstimateCost( systems[0][i] ) );
+		flTotalCost += listCosts[i];
+	}
+
+	static const int s_nModelThreads[] = { 2, 4, 8, 16 };
+	float flListMakespan[ ARRAYSIZE( s_nModelThreads ) ], flBatchMakespan[ ARRAYSIZE( s_nModelThreads ) ];
+	for ( int i = 0; i < ARRAYSIZE( s_nModelThreads ); ++i )
+	{
+		schedule.Schedule( s_nModelThreads[i] );
+		batchCosts.RemoveAll();
+		for ( int iBatch = 0; iBatch < schedule.GetBatchCount(); ++iBatch )
+		{
+			batchCosts.AddToTail( schedule.GetBatchCost( iBatch ) );
+		}
+		flListMakespan[i] = ParticleSimTest_Makespan( listCosts, s_nModelThreads[i] );
+		flBatchMakespan[i] = ParticleSimTest_Makespan( batchCosts, s_nModelThreads[i] );
+	}
+
+	for ( int nMode = 0; nMode < 3; ++nMode )
+	{
+		ParticleSimTest_DestroySystems( systems[nMode] );
+	}
+
+	Msg( "particle sim schedule: %d systems (%d root particles), %d frames, %d threads, %d batches\n", nSystems, nParticles, nFrames, ParticleSimTest_ThreadCount( pThreadPool ), schedule.GetBatchCount() );
+	Msg( "  one at a time: %8.3f ms/frame\n", flTime[0] * 1000.0 / nFrames );
+	Msg( "  list order:    %8.3f ms/frame, %.2fx\n", flTime[1] * 1000.0 / nFrames, flTime[1] > 0.0 ? flTime[0] / flTime[1] : 0.0 );
+	Msg( "  scheduled:     %8.3f ms/frame, %.2fx (%.2fx over list order)\n", flTime[2] * 1000.0 / nFrames, flTime[2] > 0.0 ? flTime[0] / flTime[2] : 0.0, flTime[2] > 0.0 ? flTime[1] / flTime[2] : 0.0 );
+	for ( int i = 0; i < ARRAYSIZE( s_nModelThreads ); ++i )
+	{
+		Msg( "  %2d threads, from the estimates: list order %5.1f%%, scheduled %5.1f%% of the work on the longest thread (%.1f%% ideal)\n",
+			s_nModelThreads[i], 100.0f * flListMakespan[i] / flTotalCost, 100.0f * flBatchMakespan[i] / flTotalCost, 100.0f / s_nModelThreads[i] );
+	}
+}
+
+#endif // FASTPATH_TESTS
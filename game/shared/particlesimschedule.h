@@ -0,0 +1,123 @@
+//===== Copyright (c) 1996-2005, Valve Corporation, All rights reserved. ======//
+//
+// Purpose: Orders a frame of particle system simulation for the job pool.
+//
+//			The particle manager handed its systems to ParallelProcess() in
+//			list order, newest first, one at a time. A big system near the end
+//			of the list kept one thread busy after the others had run out of
+//			work, and systems sharing a definition were spread over every
+//			thread. The schedule puts systems with the same definition in
+//			batches, so one thread runs the same operators over them back to
+//			back, caps the batches so there are a few per thread, and hands
+//			them out most expensive first.
+//
+//			Children are simulated by their parent, and control points are
+//			set before the simulation starts, so the systems the manager
+//			lists don't depend on each other; the schedule only orders them.
+//			It knows nothing about particles either, which lets it be tested
+//			without a renderer.
+//
+// $NoKeywords: $
+//===========================================================================//
+
+#ifndef PARTICLESIMSCHEDULE_H
+#define PARTICLESIMSCHEDULE_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include "utlvector.h"
+
+class IThreadPool;
+
+
+#define PARTICLESIMSCHEDULE_BATCHES_PER_THREAD	4
+
+
+class CParticleSimSchedule
+{
+public:
+	CParticleSimSchedule();
+
+	void	RemoveAll();
+	void	Purge();
+
+	// Units with the same group run back to back in a batch (the particle
+	// manager passes the definition). The cost only has to be right relative
+	// to the other units.
+	void	AddUnit( void *pUnit, const void *pGroup, float flCost );
+	int		GetUnitCount() const						{ return m_Units.Count(); }
+
+	// Batches the units for nThreads threads, the caller's included
+	void	Schedule( int nThreads );
+
+	int		GetBatchCount() const						{ return m_Batches.Count(); }
+	int		GetBatchUnitCount( int iBatch ) const		{ return m_Batches[iBatch].m_nCount; }
+	void	*GetBatchUnit( int iBatch, int i ) const	{ return m_Order[m_Batches[iBatch].m_nFirst + i]; }
+	float	GetBatchCost( int iBatch ) const			{ return m_Batches[iBatch].m_flCost; }
+	float	GetMaxBatchCost() const						{ return m_flMaxBatchCost; }
+
+	// Runs pfnProcess on every unit after Schedule(), the batches in order
+	// on the pool (g_pThreadPool if there isn't one). pfnBegin and pfnEnd
+	// run on every thread that takes part, like ParallelProcess() does it.
+	void	Run( void (*pfnProcess)( void *pUnit ), void (*pfnBegin)() = NULL, void (*pfnEnd)() = NULL, IThreadPool *pThreadPool = NULL );
+
+private:
+	struct Unit_t
+	{
+		void		*m_pUnit;
+		const void	*m_pGroup;
+		float		m_flCost;
+		uint64		m_nSortKey;		// group number, then most expensive first
+	};
+
+	struct GroupSlot_t
+	{
+		const void	*m_pGroup;
+		int			m_nGroup;		// -1 if the slot is free
+	};
+
+	struct Batch_t
+	{
+		CParticleSimSchedule *m_pSchedule;
+		int		m_nFirst;			// in m_Order
+		int		m_nCount;
+		float	m_flCost;
+	};
+
+	struct UnitLess_t
+	{
+		bool operator()( const Unit_t &a, const Unit_t &b ) const	{ return a.m_nSortKey < b.m_nSortKey; }
+	};
+
+	struct BatchLess_t
+	{
+		bool operator()( const Batch_t &a, const Batch_t &b ) const	{ return a.m_flCost > b.m_flCost; }
+	};
+
+	int		FindGroup( const void *pGroup );
+	static void ProcessBatch( Batch_t &batch );
+
+	CUtlVector< Unit_t > m_Units;
+	CUtlVector< GroupSlot_t > m_GroupSlots;	// power of two, at most half full
+	int m_nGroups;
+	CUtlVector< void * > m_Order;
+	CUtlVector< Batch_t > m_Batches;
+	float m_flMaxBatchCost;
+	void (*m_pfnProcess)( void *pUnit );
+};
+
+
+#if defined( FASTPATH_TESTS )
+//-----------------------------------------------------------------------------
+// Simulates made up particle systems (SoA streams, children, a handful of
+// operators shared through definitions) on the pool through the schedule
+// and checks they come out as they do one at a time, then times nFrames
+// frames of nSystems systems in list order and scheduled
+//-----------------------------------------------------------------------------
+bool ParticleSimSchedule_Validate( int nSystems, IThreadPool *pThreadPool );
+void ParticleSimSchedule_Benchmark( int nSystems, int nFrames, IThreadPool *pThreadPool );
+#endif
+
+
+#endif // PARTICLESIMSCHEDULE_H
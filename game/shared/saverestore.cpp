@@ -24,6 +24,8 @@
 #include "vphysics/object_hash.h"
 #include "datacache/imdlcache.h"
 #include "tier0/vprof.h"
+#include "checksum_crc.h"
+#include "utlmap.h"
 
 #if !defined( CLIENT_DLL )
 
@@ -178,6 +180,242 @@ void *UTIL_FunctionFromName( datamap_t *pMap, const char *pName )
 	return NULL;
 }
 
+//-----------------------------------------------------------------------------
+//
+// Save plans
+//
+// A field list is compiled the first time it is saved or restored. Fields
+// that are written as nothing but a header and their raw bytes (plain
+// fields) are found up front, and plain fields that sit back to back in
+// memory are merged into runs. With save_field_runs set, a run is written
+// as one record named after its layout; otherwise every field gets its own
+// record and the output matches the typedescription_t walk byte for byte.
+// Runs are only written for datadescs saved through WriteAll(). The engine
+// saves its own field lists (the save header, ...) through WriteFields()
+// and may look their records up by name, so those always get a record per
+// field. Restore reads both. A run record whose layout no longer matches
+// the datadesc is skipped the same way an unknown field is. Older builds
+// can't read runs; the entity block carries ENTITY_SAVE_RESTORE_VERSION so
+// they stop at the header instead of restoring entities with fields missing.
+//
+//-----------------------------------------------------------------------------
+
+ConVar save_field_runs( "save_field_runs", "1", 0, "Save adjacent plain datadesc fields as one record. 0 gives every field its own record." );
+
+class CSaveRestorePlan
+{
+public:
+	struct PlanField_t
+	{
+		int				m_nBytes;		// plain fields only, 0 for the rest
+		int				m_iRun;			// run starting at this field, or -1
+		unsigned short	m_nSymbol;		// symbol the name had last time; checked before use
+	};
+
+	struct PlanRun_t
+	{
+		int				m_iFirstField;
+		int				m_nFields;
+		int				m_nOffset;
+		int				m_nBytes;
+		char			*m_pszName;		// "$<first field>+<field count>:<layout crc>"
+		unsigned short	m_nSymbol;
+	};
+
+	CSaveRestorePlan( typedescription_t *pFields, int fieldCount );
+	~CSaveRestorePlan();
+
+	static bool IsPlainField( const typedescription_t *pField );
+	int FindRun( const char *pszName, int *pCookie ) const;
+
+	typedescription_t			*m_pFields;
+	int							m_nFields;
+	CUtlVector< PlanField_t >	m_Fields;
+	CUtlVector< PlanRun_t >		m_Runs;
+
+private:
+	void AddRun( int iFirstField, int nFields );
+};
+
+//-------------------------------------
+
+bool CSaveRestorePlan::IsPlainField( const typedescription_t *pField )
+{
+	if ( ( pField->flags & ( FTYPEDESC_SAVE | FTYPEDESC_PTR ) ) != FTYPEDESC_SAVE )
+		return false;
+
+	switch ( pField->fieldType )
+	{
+	case FIELD_FLOAT:
+	case FIELD_VECTOR:
+	case FIELD_QUATERNION:
+	case FIELD_INTEGER:
+	case FIELD_BOOLEAN:
+	case FIELD_SHORT:
+	case FIELD_CHARACTER:
+	case FIELD_COLOR32:
+	case FIELD_VMATRIX:
+	case FIELD_INTERVAL:
+		// fields with the wrong FIELD_ type keep going through ShouldSaveField() so they still warn
+		return ( pField->fieldSize > 0 && pField->fieldSizeInBytes == pField->fieldSize * gSizes[pField->fieldType] );
+
+	default:
+		return false;
+	}
+}
+
+//-------------------------------------
+
+CSaveRestorePlan::CSaveRestorePlan( typedescription_t *pFields, int fieldCount )
+{
+	m_pFields = pFields;
+	m_nFields = fieldCount;
+	m_Fields.SetCount( fieldCount );
+
+	int iRunStart = -1;
+	int nRunEnd = 0;
+	for ( int i = 0; i < fieldCount; i++ )
+	{
+		typedescription_t *pField = &pFields[i];
+		PlanField_t &planField = m_Fields[i];
+		planField.m_nBytes = IsPlainField( pField ) ? pField->fieldSizeInBytes : 0;
+		planField.m_iRun = -1;
+		planField.m_nSymbol = 0;
+
+		// Global fields are left alone when a global entity is restored, so they stay out of runs.
+		// So does the hammer id, which ScanAheadForHammerID() finds by name before any plan may exist.
+		bool bRunField = planField.m_nBytes && !( pField->flags & FTYPEDESC_GLOBAL ) && V_strcmp( pField->fieldName, "m_iHammerID" ) != 0;
+		if ( iRunStart >= 0 && bRunField && pField->fieldOffset == nRunEnd &&
+			 nRunEnd + planField.m_nBytes - pFields[iRunStart].fieldOffset <= SHRT_MAX )
+		{
+			nRunEnd += planField.m_nBytes;
+			continue;
+		}
+
+		if ( iRunStart >= 0 )
+		{
+			AddRun( iRunStart, i - iRunStart );
+		}
+
+		iRunStart = bRunField ? i : -1;
+		nRunEnd = pField->fieldOffset + planField.m_nBytes;
+	}
+
+	if ( iRunStart >= 0 )
+	{
+		AddRun( iRunStart, fieldCount - iRunStart );
+	}
+}
+
+//-------------------------------------
+
+CSaveRestorePlan::~CSaveRestorePlan()
+{
+	for ( int i = 0; i < m_Runs.Count(); i++ )
+	{
+		delete [] m_Runs[i].m_pszName;
+	}
+}
+
+//-------------------------------------
+
+void CSaveRestorePlan::AddRun( int iFirstField, int nFields )
+{
+	// single fields are written as themselves
+	if ( nFields < 2 )
+		return;
+
+	int nBaseOffset = m_pFields[iFirstField].fieldOffset;
+
+	// Any change to the fields of the run, or to where they sit in it, changes the name
+	CRC32_t crc;
+	CRC32_Init( &crc );
+	for ( int i = iFirstField; i < iFirstField + nFields; i++ )
+	{
+		const typedescription_t *pField = &m_pFields[i];
+		int layout[3] = { pField->fieldType, pField->fieldSize, pField->fieldOffset - nBaseOffset };
+		CRC32_ProcessBuffer( &crc, pField->fieldName, Q_strlen( pField->fieldName ) + 1 );
+		CRC32_ProcessBuffer( &crc, layout, sizeof( layout ) );
+	}
+	CRC32_Final( &crc );
+
+	PlanRun_t &run = m_Runs[ m_Runs.AddToTail() ];
+	run.m_iFirstField = iFirstField;
+	run.m_nFields = nFields;
+	run.m_nOffset = nBaseOffset;
+	run.m_nBytes = m_pFields[iFirstField + nFields - 1].fieldOffset + m_Fields[iFirstField + nFields - 1].m_nBytes - nBaseOffset;
+	run.m_nSymbol = 0;
+
+	char szName[256];
+	Q_snprintf( szName, sizeof( szName ), "$%s+%d:%08x", m_pFields[iFirstField].fieldName, nFields, (unsigned int)crc );
+	run.m_pszName = new char[ Q_strlen( szName ) + 1 ];
+	Q_strcpy( run.m_pszName, szName );
+
+	m_Fields[iFirstField].m_iRun = m_Runs.Count() - 1;
+}
+
+//-------------------------------------
+// Runs come back in the order they were written, so the search starts
+// after the last one found
+
+int CSaveRestorePlan::FindRun( const char *pszName, int *pCookie ) const
+{
+	int &iRun = *pCookie;
+	for ( int i = 0; i < m_Runs.Count(); i++ )
+	{
+		if ( iRun >= m_Runs.Count() )
+			iRun = 0;
+
+		if ( Q_strcmp( m_Runs[iRun].m_pszName, pszName ) == 0 )
+			return iRun++;
+
+		iRun++;
+	}
+	return -1;
+}
+
+//-----------------------------------------------------------------------------
+// Every plan compiled so far, by field list. Plans live until shutdown;
+// the field lists they point into are static.
+//-----------------------------------------------------------------------------
+
+class CSaveRestorePlans
+{
+public:
+	CSaveRestorePlans() : m_Plans( DefLessFunc( typedescription_t * ) ) {}
+	~CSaveRestorePlans()
+	{
+		FOR_EACH_MAP_FAST( m_Plans, i )
+		{
+			delete m_Plans[i];
+		}
+		m_Plans.Purge();
+	}
+
+	CSaveRestorePlan *GetPlan( typedescription_t *pFields, int fieldCount );
+
+private:
+	CUtlMap< typedescription_t *, CSaveRestorePlan * > m_Plans;
+};
+
+static CSaveRestorePlans g_SaveRestorePlans;
+
+//-------------------------------------
+
+CSaveRestorePlan *CSaveRestorePlans::GetPlan( typedescription_t *pFields, int fieldCount )
+{
+	unsigned short iPlan = m_Plans.Find( pFields );
+	if ( iPlan != m_Plans.InvalidIndex() )
+	{
+		Assert( m_Plans[iPlan]->m_nFields == fieldCount );
+		return m_Plans[iPlan];
+	}
+
+	CSaveRestorePlan *pPlan = new CSaveRestorePlan( pFields, fieldCount );
+	m_Plans.Insert( pFields, pPlan );
+	return pPlan;
+}
+
 //-----------------------------------------------------------------------------
 //
 // CSave
@@ -193,6 +431,8 @@ CSave::CSave( CSaveRestoreData *pdata )
 
 	// Logging.
 	m_hLogFile = NULL;
+
+	m_FieldMode = save_field_runs.GetBool() ? SAVEFIELDS_RUNS : SAVEFIELDS_COMPATIBLE;
 }
 
 //-------------------------------------
@@ -823,6 +1063,13 @@ bool CSave::WriteField( const char *pname, void *pData, datamap_t *pRootMap, typ
 //-------------------------------------
 
 int CSave::WriteFields( const char *pname, const void *pBaseData, datamap_t *pRootMap, typedescription_t *pFields, int fieldCount )
+{
+	return DoWriteFields( pname, pBaseData, pRootMap, pFields, fieldCount, false );
+}
+
+//-------------------------------------
+
+int CSave::DoWriteFields( const char *pname, const void *pBaseData, datamap_t *pRootMap, typedescription_t *pFields, int fieldCount, bool bRuns )
 {
 	typedescription_t *pTest;
 	int iHeaderPos = m_pData->GetCurPos();
@@ -843,17 +1090,25 @@ int CSave::WriteFields( const char *pname, const void *pBaseData, datamap_t *pRo
 	__dcbt( 512, pDest );
 #endif
 
-	for ( int i = 0; i < fieldCount; i++ )
+	// the log wants every field by itself
+	if ( m_FieldMode != SAVEFIELDS_DATADESC && !IsLogging() )
 	{
-		pTest = &pFields[ i ];
-		void *pOutputData = ( (char *)pBaseData + pTest->fieldOffset );
-			
-		if ( !ShouldSaveField( pOutputData, pTest ) )
-			continue;
+		count = WritePlanFields( pname, pBaseData, pRootMap, g_SaveRestorePlans.GetPlan( pFields, fieldCount ), bRuns );
+	}
+	else
+	{
+		for ( int i = 0; i < fieldCount; i++ )
+		{
+			pTest = &pFields[ i ];
+			void *pOutputData = ( (char *)pBaseData + pTest->fieldOffset );
+				
+			if ( !ShouldSaveField( pOutputData, pTest ) )
+				continue;
 
-		if ( !WriteField( pname, pOutputData, pRootMap, pTest ) )
-			break;
-		count++;
+			if ( !WriteField( pname, pOutputData, pRootMap, pTest ) )
+				break;
+			count++;
+		}
 	}
 
 	int iCurPos = m_pData->GetCurPos();
@@ -866,6 +1121,65 @@ int CSave::WriteFields( const char *pname, const void *pBaseData, datamap_t *pRo
 	return 1;
 }
 
+//-------------------------------------
+// Purpose: WriteFields() through a compiled plan. Plain fields skip the
+//			type switch and the symbol hash; everything else is written
+//			by WriteField() as usual.
+// Output : number of records written
+
+int CSave::WritePlanFields( const char *pname, const void *pBaseData, datamap_t *pRootMap, CSaveRestorePlan *pPlan, bool bRuns )
+{
+	const char *pBase = (const char *)pBaseData;
+	int count = 0;
+
+	for ( int i = 0; i < pPlan->m_nFields; i++ )
+	{
+		typedescription_t *pField = &pPlan->m_pFields[i];
+		CSaveRestorePlan::PlanField_t &planField = pPlan->m_Fields[i];
+		const char *pData = pBase + pField->fieldOffset;
+
+		if ( planField.m_iRun >= 0 )
+		{
+			CSaveRestorePlan::PlanRun_t &run = pPlan->m_Runs[ planField.m_iRun ];
+			if ( DataEmpty( pBase + run.m_nOffset, run.m_nBytes ) )
+			{
+				// none of its fields would be saved
+				i += run.m_nFields - 1;
+				continue;
+			}
+
+			if ( bRuns )
+			{
+				WriteHeader( FindCreatePlanSymbol( run.m_pszName, &run.m_nSymbol ), run.m_nBytes );
+				BufferData( pBase + run.m_nOffset, run.m_nBytes );
+				i += run.m_nFields - 1;
+				count++;
+				continue;
+			}
+		}
+
+		if ( planField.m_nBytes )
+		{
+			if ( !DataEmpty( pData, planField.m_nBytes ) )
+			{
+				WriteHeader( FindCreatePlanSymbol( pField->fieldName, &planField.m_nSymbol ), planField.m_nBytes );
+				BufferData( pData, planField.m_nBytes );
+				count++;
+			}
+			continue;
+		}
+
+		if ( !ShouldSaveField( pData, pField ) )
+			continue;
+
+		if ( !WriteField( pname, (void *)pData, pRootMap, pField ) )
+			break;
+		count++;
+	}
+
+	return count;
+}
+
 //-------------------------------------
 // Purpose: Recursively saves all the classes in an object, in reverse order (top down)
 // Output : int 0 on failure, 1 on success
@@ -880,7 +1194,7 @@ int CSave::DoWriteAll( const void *pLeafObject, datamap_t *pLeafMap, datamap_t *
 			return status;
 	}
 
-	return WriteFields( pCurMap->dataClassName, pLeafObject, pLeafMap, pCurMap->dataDesc, pCurMap->dataNumFields );
+	return DoWriteFields( pCurMap->dataClassName, pLeafObject, pLeafMap, pCurMap->dataDesc, pCurMap->dataNumFields, ( m_FieldMode == SAVEFIELDS_RUNS ) );
 }
 	
 //-------------------------------------
@@ -936,9 +1250,16 @@ void CSave::BufferField( const char *pname, int size, const char *pdata )
 //-------------------------------------
 
 void CSave::WriteHeader( const char *pname, int size )
+{
+	WriteHeader( m_pData->FindCreateSymbol( pname ), size );
+}
+
+//-------------------------------------
+
+void CSave::WriteHeader( unsigned short symbol, int size )
 {
 	short shortSize = size;
-	short hashvalue = m_pData->FindCreateSymbol( pname );
+	short hashvalue = symbol;
 	if ( size > SHRT_MAX || size < 0 )
 	{
 		Warning( "CSave::WriteHeader() size parameter exceeds 'short'!\n" );
@@ -949,6 +1270,20 @@ void CSave::WriteHeader( const char *pname, int size )
 	BufferData( (const char *)&hashvalue, sizeof(short) );
 }
 
+//-------------------------------------
+// Purpose: The symbol of a name the plans keep for the process lifetime.
+//			The symbol table stores the pointer it was last given for a
+//			name, so a cached symbol still holding our pointer is current.
+
+unsigned short CSave::FindCreatePlanSymbol( const char *pszName, unsigned short *pCachedSymbol )
+{
+	if ( *pCachedSymbol >= m_pData->SizeSymbolTable() || m_pData->StringFromSymbol( *pCachedSymbol ) != pszName )
+	{
+		*pCachedSymbol = m_pData->FindCreateSymbol( pszName );
+	}
+	return *pCachedSymbol;
+}
+
 //-------------------------------------
 
 void CSave::BufferData( const char *pdata, int size )
@@ -1562,46 +1897,84 @@ void CRestore::EmptyFields( void *pBaseData, typedescription_t *pFields, int fie
 		if ( !ShouldEmptyField( pField ) )
 			continue;
 
-		void *pFieldData = (char *)pBaseData + pField->fieldOffset;
-		switch( pField->fieldType )
-		{
-		case FIELD_CUSTOM:
-			{
-				SaveRestoreFieldInfo_t fieldInfo =
-				{
-					pFieldData,
-					pBaseData,
-					pField
-				};
-				pField->pSaveRestoreOps->MakeEmpty( fieldInfo );
-			}
-			break;
+		EmptyField( pBaseData, pField );
+	}
+}
 
-		case FIELD_EMBEDDED:
+//-------------------------------------
+
+void CRestore::EmptyField( void *pBaseData, typedescription_t *pField )
+{
+	void *pFieldData = (char *)pBaseData + pField->fieldOffset;
+	switch( pField->fieldType )
+	{
+	case FIELD_CUSTOM:
+		{
+			SaveRestoreFieldInfo_t fieldInfo =
 			{
-				if ( (pField->flags & FTYPEDESC_PTR) && !*((void **)pFieldData) )
-					break;
+				pFieldData,
+				pBaseData,
+				pField
+			};
+			pField->pSaveRestoreOps->MakeEmpty( fieldInfo );
+		}
+		break;
 
-				int nFieldCount = pField->fieldSize;
-				char *pFieldMemory = (char *)( ( !(pField->flags & FTYPEDESC_PTR) ) ? pFieldData : *((void **)pFieldData) );
-				while ( --nFieldCount >= 0 )
-				{
-					EmptyFields( pFieldMemory, pField->td->dataDesc, pField->td->dataNumFields );
-					pFieldMemory += pField->fieldSizeInBytes;
-				}
-			}
-			break;
+	case FIELD_EMBEDDED:
+		{
+			if ( (pField->flags & FTYPEDESC_PTR) && !*((void **)pFieldData) )
+				break;
 
-		default:
-			// NOTE: If you hit this assertion, you've got a bug where you're using 
-			// the wrong field type for your field
-			if ( pField->fieldSizeInBytes != pField->fieldSize * gSizes[pField->fieldType] )
+			int nFieldCount = pField->fieldSize;
+			char *pFieldMemory = (char *)( ( !(pField->flags & FTYPEDESC_PTR) ) ? pFieldData : *((void **)pFieldData) );
+			while ( --nFieldCount >= 0 )
 			{
-				Warning("WARNING! Field %s is using the wrong FIELD_ type!\nFix this or you'll see a crash.\n", pField->fieldName );
-				Assert( 0 );
+				EmptyFields( pFieldMemory, pField->td->dataDesc, pField->td->dataNumFields );
+				pFieldMemory += pField->fieldSizeInBytes;
 			}
-			memset( pFieldData, (pField->fieldType != FIELD_EHANDLE) ? 0 : 0xFF, pField->fieldSize * gSizes[pField->fieldType] );
-			break;
+		}
+		break;
+
+	default:
+		// NOTE: If you hit this assertion, you've got a bug where you're using 
+		// the wrong field type for your field
+		if ( pField->fieldSizeInBytes != pField->fieldSize * gSizes[pField->fieldType] )
+		{
+			Warning("WARNING! Field %s is using the wrong FIELD_ type!\nFix this or you'll see a crash.\n", pField->fieldName );
+			Assert( 0 );
+		}
+		memset( pFieldData, (pField->fieldType != FIELD_EHANDLE) ? 0 : 0xFF, pField->fieldSize * gSizes[pField->fieldType] );
+		break;
+	}
+}
+
+//-------------------------------------
+// Purpose: EmptyFields() through a compiled plan; a run is cleared in one go
+
+void CRestore::EmptyPlanFields( void *pBaseData, CSaveRestorePlan *pPlan )
+{
+	for ( int i = 0; i < pPlan->m_nFields; i++ )
+	{
+		CSaveRestorePlan::PlanField_t &planField = pPlan->m_Fields[i];
+		if ( planField.m_iRun >= 0 )
+		{
+			CSaveRestorePlan::PlanRun_t &run = pPlan->m_Runs[ planField.m_iRun ];
+			memset( (char *)pBaseData + run.m_nOffset, 0, run.m_nBytes );
+			i += run.m_nFields - 1;
+			continue;
+		}
+
+		typedescription_t *pField = &pPlan->m_pFields[i];
+		if ( !ShouldEmptyField( pField ) )
+			continue;
+
+		if ( planField.m_nBytes )
+		{
+			memset( (char *)pBaseData + pField->fieldOffset, 0, planField.m_nBytes );
+		}
+		else
+		{
+			EmptyField( pBaseData, pField );
 		}
 	}
 }
@@ -1705,19 +2078,38 @@ int CRestore::ReadFields( const char *pname, void *pBaseData, datamap_t *pRootMa
 	lastName = symName;
 
 	// Clear out base data
-	EmptyFields( pBaseData, pFields, fieldCount );
+	CSaveRestorePlan *pPlan = g_SaveRestorePlans.GetPlan( pFields, fieldCount );
+	EmptyPlanFields( pBaseData, pPlan );
 	
 	// Skip over the struct name
 	int i;
 	int nFieldsSaved = ReadInt();						// Read field count
 	int searchCookie = 0;								// Make searches faster, most data is read/written in the same order
+	int runCookie = 0;
 	SaveRestoreRecordHeader_t header;
 
 	for ( i = 0; i < nFieldsSaved; i++ )
 	{
 		ReadHeader( &header );
 
-		typedescription_t *pField = FindField( m_pData->StringFromSymbol( header.symbol ), pFields, fieldCount, &searchCookie);
+		const char *pszFieldName = m_pData->StringFromSymbol( header.symbol );
+		if ( pszFieldName && pszFieldName[0] == '$' )
+		{
+			// A run of plain fields (see CSaveRestorePlan)
+			int iRun = pPlan->FindRun( pszFieldName, &runCookie );
+			if ( iRun >= 0 && pPlan->m_Runs[iRun].m_nBytes == header.size )
+			{
+				BufferReadBytes( (char *)pBaseData + pPlan->m_Runs[iRun].m_nOffset, header.size );
+			}
+			else
+			{
+				DevWarning( "Skipping %s in %s, the fields have changed since the save\n", pszFieldName, pname );
+				BufferSkipBytes( header.size );
+			}
+			continue;
+		}
+
+		typedescription_t *pField = FindField( pszFieldName, pFields, fieldCount, &searchCookie);
 		if ( pField && ShouldReadField( pField ) )
 		{
 			ReadField( header, ((char *)pBaseData + pField->fieldOffset), pRootMap, pField );
@@ -2452,6 +2844,14 @@ IEntitySaveUtils *GetEntitySaveUtils()
 //-----------------------------------------------------------------------------
 // Implementation of the block handler for save/restore of entities
 //-----------------------------------------------------------------------------
+
+// The entity block header used to start with the entity count. It now starts
+// with ENTITY_SAVE_RESTORE_TAG and the version, then the count, so a header
+// without the tag is an old save and is read as before. Older builds take the
+// tag for a bad entity count and restore no entities.
+static const int ENTITY_SAVE_RESTORE_TAG = -1;
+static short ENTITY_SAVE_RESTORE_VERSION = 1;	// 1: datadesc fields may be saved as runs
+
 const char *CEntitySaveRestoreBlockHandler::GetBlockName()
 {
 	return "Entities";
@@ -2560,6 +2960,10 @@ void CEntitySaveRestoreBlockHandler::WriteSaveHeaders( ISave *pSave )
 {
 	CGameSaveRestoreInfo *pSaveData = pSave->GetGameSaveRestoreInfo();
 
+	int nTag = ENTITY_SAVE_RESTORE_TAG;
+	pSave->WriteInt( &nTag );
+	pSave->WriteShort( &ENTITY_SAVE_RESTORE_VERSION );
+
 	int nEntities = pSaveData->NumEntities();
 	pSave->WriteInt( &nEntities );
 	
@@ -2588,6 +2992,18 @@ void CEntitySaveRestoreBlockHandler::ReadRestoreHeaders( IRestore *pRestore )
 
 	int nEntities;
 	pRestore->ReadInt( &nEntities );
+	if ( nEntities == ENTITY_SAVE_RESTORE_TAG )
+	{
+		short version;
+		pRestore->ReadShort( &version );
+		if ( version > ENTITY_SAVE_RESTORE_VERSION )
+		{
+			Warning( "Entities were saved by a newer version (%d) than this one (%d), not restoring them\n", version, ENTITY_SAVE_RESTORE_VERSION );
+			return;
+		}
+
+		pRestore->ReadInt( &nEntities );
+	}
 
 	entitytable_t *pEntityTable = ( entitytable_t *)engine->SaveAllocMemory( (sizeof(entitytable_t) * nEntities), sizeof(char) );
 	if ( !pEntityTable )
@@ -3731,3 +4147,278 @@ int CreateEntityTransitionList( CSaveRestoreData *pSaveData, int levelMask )
 	return movedCount;
 }
 #endif
+
+#if !defined( CLIENT_DLL ) && defined( FASTPATH_TESTS )
+//-----------------------------------------------------------------------------
+// Save plan test. Each datamap is tested through copies of its field list:
+// one without custom and embedded fields, whose ops can have side effects
+// (physics objects, outputs), and one with nothing but plain fields for the
+// restore. The copies are kept since plans are cached by field list, and
+// are chained into datamaps of their own so they are saved through
+// WriteAll() like an entity is.
+//-----------------------------------------------------------------------------
+
+struct SaveRestorePlanTestMap_t
+{
+	CUtlVector< typedescription_t >	m_SaveFields;
+	CUtlVector< typedescription_t >	m_PlainFields;
+	datamap_t						m_SaveMap;
+	datamap_t						m_PlainMap;
+	int								m_nExtent;		// end of the last plain field
+};
+
+static CUtlMap< datamap_t *, SaveRestorePlanTestMap_t * > s_SaveRestorePlanTestMaps( DefLessFunc( datamap_t * ) );
+
+static SaveRestorePlanTestMap_t *SaveRestorePlanTest_GetMap( datamap_t *pMap )
+{
+	unsigned short iMap = s_SaveRestorePlanTestMaps.Find( pMap );
+	if ( iMap != s_SaveRestorePlanTestMaps.InvalidIndex() )
+		return s_SaveRestorePlanTestMaps[iMap];
+
+	SaveRestorePlanTestMap_t *pTestMap = new SaveRestorePlanTestMap_t;
+	pTestMap->m_nExtent = 0;
+	for ( int i = 0; i < pMap->dataNumFields; i++ )
+	{
+		typedescription_t *pField = &pMap->dataDesc[i];
+		if ( pField->fieldType == FIELD_CUSTOM || pField->fieldType == FIELD_EMBEDDED )
+			continue;
+
+		pTestMap->m_SaveFields.AddToTail( *pField );
+		if ( CSaveRestorePlan::IsPlainField( pField ) )
+		{
+			pTestMap->m_PlainFields.AddToTail( *pField );
+			pTestMap->m_nExtent = MAX( pTestMap->m_nExtent, pField->fieldOffset + pField->fieldSizeInBytes );
+		}
+	}
+
+	SaveRestorePlanTestMap_t *pBaseTestMap = pMap->baseMap ? SaveRestorePlanTest_GetMap( pMap->baseMap ) : NULL;
+
+	memset( &pTestMap->m_SaveMap, 0, sizeof( datamap_t ) );
+	pTestMap->m_SaveMap.dataDesc = pTestMap->m_SaveFields.Base();
+	pTestMap->m_SaveMap.dataNumFields = pTestMap->m_SaveFields.Count();
+	pTestMap->m_SaveMap.dataClassName = pMap->dataClassName;
+	pTestMap->m_SaveMap.baseMap = pBaseTestMap ? &pBaseTestMap->m_SaveMap : NULL;
+
+	memset( &pTestMap->m_PlainMap, 0, sizeof( datamap_t ) );
+	pTestMap->m_PlainMap.dataDesc = pTestMap->m_PlainFields.Base();
+	pTestMap->m_PlainMap.dataNumFields = pTestMap->m_PlainFields.Count();
+	pTestMap->m_PlainMap.dataClassName = pMap->dataClassName;
+	pTestMap->m_PlainMap.baseMap = pBaseTestMap ? &pBaseTestMap->m_PlainMap : NULL;
+
+	s_SaveRestorePlanTestMaps.Insert( pMap, pTestMap );
+	return pTestMap;
+}
+
+//-------------------------------------
+
+static CSaveRestoreData *SaveRestorePlanTest_CreateData( int nBytes, int nSymbols )
+{
+	char *pMemory = (char *)malloc( sizeof( CSaveRestoreData ) + nBytes + nSymbols * sizeof( char * ) );
+	CSaveRestoreData *pData = MakeSaveRestoreData( pMemory );
+	pData->Init( pMemory + sizeof( CSaveRestoreData ), nBytes );
+	pData->InitSymbolTable( (char **)( pMemory + sizeof( CSaveRestoreData ) + nBytes ), nSymbols );
+	return pData;
+}
+
+static void SaveRestorePlanTest_DestroyData( CSaveRestoreData *pData )
+{
+	pData->~CSaveRestoreData();
+	free( pData );
+}
+
+//-------------------------------------
+// Writes every level of the entity's datadesc from the start of the buffer
+
+static int SaveRestorePlanTest_Write( CSaveRestoreData *pData, SaveFieldMode_t mode, CBaseEntity *pEntity, bool bPlainFields )
+{
+	pData->Rewind( pData->GetCurPos() );
+
+	CSave save( pData );
+	save.SetFieldMode( mode );
+
+	SaveRestorePlanTestMap_t *pTestMap = SaveRestorePlanTest_GetMap( pEntity->GetDataDescMap() );
+	save.WriteAll( pEntity, bPlainFields ? &pTestMap->m_PlainMap : &pTestMap->m_SaveMap );
+	return pData->GetCurPos();
+}
+
+//-------------------------------------
+// Reads what SaveRestorePlanTest_Write( ..., true ) wrote into pScratch
+
+static void SaveRestorePlanTest_Read( CSaveRestoreData *pData, CBaseEntity *pEntity, void *pScratch )
+{
+	pData->Rewind( pData->GetCurPos() );
+
+	CRestore restore( pData );
+	restore.ReadAll( pScratch, &SaveRestorePlanTest_GetMap( pEntity->GetDataDescMap() )->m_PlainMap );
+}
+
+static int SaveRestorePlanTest_GetExtent( CBaseEntity *pEntity )
+{
+	int nExtent = 0;
+	for ( datamap_t *pMap = pEntity->GetDataDescMap(); pMap; pMap = pMap->baseMap )
+	{
+		nExtent = MAX( nExtent, SaveRestorePlanTest_GetMap( pMap )->m_nExtent );
+	}
+	return nExtent;
+}
+
+//-------------------------------------
+
+#define SAVE_PLAN_TEST_BYTES	( 1024 * 1024 )
+#define SAVE_PLAN_TEST_SYMBOLS	( 16 * 1024 )
+
+bool SaveRestorePlans_Validate()
+{
+	// The byte compare needs both symbol tables to see the same names, so the runs get their own
+	CSaveRestoreData *pReference = SaveRestorePlanTest_CreateData( SAVE_PLAN_TEST_BYTES, SAVE_PLAN_TEST_SYMBOLS );
+	CSaveRestoreData *pPlan = SaveRestorePlanTest_CreateData( SAVE_PLAN_TEST_BYTES, SAVE_PLAN_TEST_SYMBOLS );
+	CSaveRestoreData *pRunReference = SaveRestorePlanTest_CreateData( SAVE_PLAN_TEST_BYTES, SAVE_PLAN_TEST_SYMBOLS );
+	CSaveRestoreData *pRuns = SaveRestorePlanTest_CreateData( SAVE_PLAN_TEST_BYTES, SAVE_PLAN_TEST_SYMBOLS );
+	CUtlVector< unsigned char > referenceScratch;
+	CUtlVector< unsigned char > planScratch;
+
+	int nEntities = 0;
+	int nMismatches = 0;
+	int nDatadescBytes = 0;
+	int nRunBytes = 0;
+	for ( CBaseEntity *pEntity = gEntList.FirstEnt(); pEntity; pEntity = gEntList.NextEnt( pEntity ) )
+	{
+		++nEntities;
+
+		// Without runs the plan writes exactly what the typedescription_t walk does
+		int nReferenceBytes = SaveRestorePlanTest_Write( pReference, SAVEFIELDS_DATADESC, pEntity, false );
+		int nPlanBytes = SaveRestorePlanTest_Write( pPlan, SAVEFIELDS_COMPATIBLE, pEntity, false );
+		if ( nReferenceBytes != nPlanBytes || memcmp( pReference->GetBuffer(), pPlan->GetBuffer(), nReferenceBytes ) )
+		{
+			int iByte = 0;
+			int nCompare = MIN( nReferenceBytes, nPlanBytes );
+			while ( iByte < nCompare && pReference->GetBuffer()[iByte] == pPlan->GetBuffer()[iByte] )
+			{
+				++iByte;
+			}
+
+			Warning( "save plan: %s (%d) wrote %d bytes, the datadesc %d; first difference at byte %d\n",
+				pEntity->GetClassname(), pEntity->entindex(), nPlanBytes, nReferenceBytes, iByte );
+			++nMismatches;
+			continue;
+		}
+
+		// With runs the plain fields restore the same values
+		nDatadescBytes += SaveRestorePlanTest_Write( pRunReference, SAVEFIELDS_DATADESC, pEntity, true );
+		nRunBytes += SaveRestorePlanTest_Write( pRuns, SAVEFIELDS_RUNS, pEntity, true );
+
+		int nExtent = SaveRestorePlanTest_GetExtent( pEntity );
+		referenceScratch.SetCount( nExtent );
+		planScratch.SetCount( nExtent );
+		memset( referenceScratch.Base(), 0xCD, nExtent );
+		memset( planScratch.Base(), 0xCD, nExtent );
+
+		SaveRestorePlanTest_Read( pRunReference, pEntity, referenceScratch.Base() );
+		SaveRestorePlanTest_Read( pRuns, pEntity, planScratch.Base() );
+		if ( memcmp( referenceScratch.Base(), planScratch.Base(), nExtent ) )
+		{
+			Warning( "save plan: %s (%d) restored different plain fields from runs\n", pEntity->GetClassname(), pEntity->entindex() );
+			++nMismatches;
+			continue;
+		}
+
+		for ( datamap_t *pMap = pEntity->GetDataDescMap(); pMap; pMap = pMap->baseMap )
+		{
+			CUtlVector< typedescription_t > &fields = SaveRestorePlanTest_GetMap( pMap )->m_PlainFields;
+			for ( int i = 0; i < fields.Count(); i++ )
+			{
+				if ( memcmp( planScratch.Base() + fields[i].fieldOffset, (char *)pEntity + fields[i].fieldOffset, fields[i].fieldSizeInBytes ) )
+				{
+					Warning( "save plan: %s (%d) restored %s::%s wrong\n", pEntity->GetClassname(), pEntity->entindex(), pMap->dataClassName, fields[i].fieldName );
+					++nMismatches;
+					break;
+				}
+			}
+		}
+	}
+
+	SaveRestorePlanTest_DestroyData( pReference );
+	SaveRestorePlanTest_DestroyData( pPlan );
+	SaveRestorePlanTest_DestroyData( pRunReference );
+	SaveRestorePlanTest_DestroyData( pRuns );
+
+	int nPlans = 0;
+	int nRuns = 0;
+	for ( unsigned short i = s_SaveRestorePlanTestMaps.FirstInorder(); i != s_SaveRestorePlanTestMaps.InvalidIndex(); i = s_SaveRestorePlanTestMaps.NextInorder( i ) )
+	{
+		++nPlans;
+		nRuns += g_SaveRestorePlans.GetPlan( s_SaveRestorePlanTestMaps[i]->m_PlainFields.Base(), s_SaveRestorePlanTestMaps[i]->m_PlainFields.Count() )->m_Runs.Count();
+	}
+
+	Msg( "save plan: %d entities, %d datamaps with %d runs, plain fields %d bytes as runs vs %d: %s\n",
+		nEntities, nPlans, nRuns, nRunBytes, nDatadescBytes, nMismatches ? "FAILED" : "OK" );
+	return !nMismatches;
+}
+
+//-------------------------------------
+
+void SaveRestorePlans_Benchmark( int nIterations )
+{
+	CUtlVector< CBaseEntity * > entities;
+	for ( CBaseEntity *pEntity = gEntList.FirstEnt(); pEntity; pEntity = gEntList.NextEnt( pEntity ) )
+	{
+		entities.AddToTail( pEntity );
+	}
+
+	if ( !entities.Count() )
+	{
+		Msg( "save plan: no entities to save\n" );
+		return;
+	}
+
+	nIterations = MAX( nIterations, 1 );
+
+	static const char *s_pModeNames[] = { "datadesc:", "compatible:", "runs:" };
+	CSaveRestoreData *pData = SaveRestorePlanTest_CreateData( SAVE_PLAN_TEST_BYTES, SAVE_PLAN_TEST_SYMBOLS );
+	double flSave[3];
+	double flRestore[3];
+	int nBytes[3];
+	CUtlVector< unsigned char > scratch;
+
+	for ( int mode = SAVEFIELDS_DATADESC; mode <= SAVEFIELDS_RUNS; mode++ )
+	{
+		nBytes[mode] = 0;
+		double flStart = Plat_FloatTime();
+		for ( int n = 0; n < nIterations; ++n )
+		{
+			for ( int i = 0; i < entities.Count(); ++i )
+			{
+				nBytes[mode] += SaveRestorePlanTest_Write( pData, (SaveFieldMode_t)mode, entities[i], false );
+			}
+		}
+		flSave[mode] = Plat_FloatTime() - flStart;
+
+		// Restores go through the plain fields only; the stream is written once per entity
+		flRestore[mode] = 0.0;
+		for ( int i = 0; i < entities.Count(); ++i )
+		{
+			SaveRestorePlanTest_Write( pData, (SaveFieldMode_t)mode, entities[i], true );
+			scratch.SetCount( SaveRestorePlanTest_GetExtent( entities[i] ) );
+
+			flStart = Plat_FloatTime();
+			for ( int n = 0; n < nIterations; ++n )
+			{
+				SaveRestorePlanTest_Read( pData, entities[i], scratch.Base() );
+			}
+			flRestore[mode] += Plat_FloatTime() - flStart;
+		}
+	}
+
+	SaveRestorePlanTest_DestroyData( pData );
+
+	int nSaves = nIterations * entities.Count();
+	Msg( "save plan: %d entity saves and restores\n", nSaves );
+	for ( int mode = SAVEFIELDS_DATADESC; mode <= SAVEFIELDS_RUNS; mode++ )
+	{
+		Msg( "  %-12s save %8.3f ms (%.2f us per entity, %d bytes), restore %8.3f ms (%.2f us per entity), %.2fx\n",
+			s_pModeNames[mode], flSave[mode] * 1000.0, flSave[mode] * 1000000.0 / nSaves, nBytes[mode] / nIterations,
+			flRestore[mode] * 1000.0, flRestore[mode] * 1000000.0 / nSaves,
+			flSave[mode] + flRestore[mode] > 0.0 ? ( flSave[SAVEFIELDS_DATADESC] + flRestore[SAVEFIELDS_DATADESC] ) / ( flSave[mode] + flRestore[mode] ) : 0.0 );
+	}
+}
+#endif // !defined( CLIENT_DLL ) && defined( FASTPATH_TESTS )
@@ -28,6 +28,17 @@ struct edict_t;
 struct datamap_t;
 class CBaseEntity;
 struct interval_t;
+class CSaveRestorePlan;
+
+//-------------------------------------
+// How CSave writes datadesc fields
+
+enum SaveFieldMode_t
+{
+	SAVEFIELDS_DATADESC = 0,		// walk the typedescription_t list
+	SAVEFIELDS_COMPATIBLE,			// compiled plan, same output as SAVEFIELDS_DATADESC
+	SAVEFIELDS_RUNS,				// compiled plan, adjacent plain fields written as one record (WriteAll() only)
+};
 
 //-----------------------------------------------------------------------------
 //
@@ -61,6 +72,12 @@ public:
 	
 	int				WriteFields( const char *pname, const void *pBaseData, datamap_t *pMap, typedescription_t *pFields, int fieldCount );
 
+	// Defaults to SAVEFIELDS_COMPATIBLE, or SAVEFIELDS_RUNS with save_field_runs 1.
+	// WriteFields() is also how the engine saves its own field lists, so it
+	// never writes runs; only WriteAll() does.
+	void			SetFieldMode( SaveFieldMode_t mode )	{ m_FieldMode = mode; }
+	SaveFieldMode_t	GetFieldMode() const					{ return m_FieldMode; }
+
 	//---------------------------------
 	// Block support
 	//
@@ -148,8 +165,12 @@ private:
 	void			BufferField( const char *pname, int size, const char *pdata );
 	void			BufferData( const char *pdata, int size );
 	void			WriteHeader( const char *pname, int size );
+	void			WriteHeader( unsigned short symbol, int size );
+	unsigned short	FindCreatePlanSymbol( const char *pszName, unsigned short *pCachedSymbol );
 
 	int				DoWriteAll( const void *pLeafObject, datamap_t *pLeafMap, datamap_t *pCurMap );
+	int				DoWriteFields( const char *pname, const void *pBaseData, datamap_t *pRootMap, typedescription_t *pFields, int fieldCount, bool bRuns );
+	int				WritePlanFields( const char *pname, const void *pBaseData, datamap_t *pRootMap, CSaveRestorePlan *pPlan, bool bRuns );
 	bool 			WriteField( const char *pname, void *pData, datamap_t *pRootMap, typedescription_t *pField );
 	
 	bool 			WriteBasicField( const char *pname, void *pData, datamap_t *pRootMap, typedescription_t *pField );
@@ -179,6 +200,7 @@ private:
 
 	FileHandle_t		m_hLogFile;
 	bool				m_bAsync;
+	SaveFieldMode_t		m_FieldMode;
 };
 
 //-----------------------------------------------------------------------------
@@ -308,6 +330,8 @@ private:
 
 	bool			ShouldReadField( typedescription_t *pField );
 	bool 			ShouldEmptyField( typedescription_t *pField );
+	void			EmptyField( void *pBaseData, typedescription_t *pField );
+	void			EmptyPlanFields( void *pBaseData, CSaveRestorePlan *pPlan );
 
 	//---------------------------------
 	// Game info methods
@@ -329,6 +353,17 @@ private:
 };
 
 
+//-----------------------------------------------------------------------------
+// Saves the datadesc of every entity with each SaveFieldMode_t, checks the
+// compiled plans write what the typedescription_t walk writes and restore
+// the same values from runs, then times the modes
+//-----------------------------------------------------------------------------
+#if !defined( CLIENT_DLL ) && defined( FASTPATH_TESTS )
+bool SaveRestorePlans_Validate();
+void SaveRestorePlans_Benchmark( int nIterations );
+#endif
+
+
 //-----------------------------------------------------------------------------
 // An interface passed into the OnSave method of all entities
 //-----------------------------------------------------------------------------
@@ -0,0 +1,408 @@
+//===== Copyright (c) 1996-2005, Valve Corporation, All rights reserved. ======//
+//
+// Purpose: Hashed lookup of sound script entries by name.
+//
+// $NoKeywords: $
+//===========================================================================//
+
+#include "cbase.h"
+#include "soundscriptindex.h"
+#include "SoundEmitterSystem/isoundemittersystembase.h"
+#include "utldict.h"
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+
+#define SOUNDSCRIPTINDEX_MIN_SLOT_BITS	8
+
+extern ISoundEmitterSystemBase *soundemitterbase;
+
+
+CSoundScriptIndex::CSoundScriptIndex()
+{
+	m_nSlotMask = 0;
+	m_nSlotBits = 0;
+	m_nSounds = 0;
+	m_nMaxSoundIndex = -1;
+	m_nGeneration = 0;
+}
+
+void CSoundScriptIndex::Purge()
+{
+	m_Slots.Purge();
+	m_Names.Purge();
+	m_nSlotMask = 0;
+	m_nSlotBits = 0;
+	m_nSounds = 0;
+	m_nMaxSoundIndex = -1;
+	++m_nGeneration;
+}
+
+//-----------------------------------------------------------------------------
+// FNV-1a over the name with ASCII upper case folded to lower case, which is
+// what the emitter system's compares ignore
+//-----------------------------------------------------------------------------
+unsigned int CSoundScriptIndex::HashName( const char *pName )
+{
+	unsigned int nHash = 2166136261u;
+	for ( const unsigned char *p = (const unsigned char *)pName; *p; ++p )
+	{
+		unsigned int c = *p;
+		if ( c - 'A' <= 'Z' - 'A' )
+		{
+			c += 'a' - 'A';
+		}
+		nHash = ( nHash ^ c ) * 16777619u;
+	}
+	return nHash;
+}
+
+// Fibonacci hashing: the slot comes from the top bits of the mixed hash
+#define SOUNDSCRIPTINDEX_SLOT( _hash )	( ( (_hash) * 2654435769u ) >> ( 32 - m_nSlotBits ) )
+
+
+//-----------------------------------------------------------------------------
+// Building
+//-----------------------------------------------------------------------------
+void CSoundScriptIndex::Build( ISoundEmitterSystemBase *pSounds )
+{
+	CUtlVector< const char * > names;
+	CUtlVector< int > soundIndices;
+	names.EnsureCapacity( pSounds->GetSoundCount() );
+	soundIndices.EnsureCapacity( pSounds->GetSoundCount() );
+	for ( int i = pSounds->First(); i != pSounds->InvalidIndex(); i = pSounds->Next( i ) )
+	{
+		const char *pName = pSounds->GetSoundName( i );
+		if ( pName )
+		{
+			names.AddToTail( pName );
+			soundIndices.AddToTail( i );
+		}
+	}
+
+	Build( names.Base(), soundIndices.Base(), names.Count() );
+}
+
+void CSoundScriptIndex::Build( const char * const *ppNames, const int *pSoundIndices, int nCount )
+{
+	int nGeneration = m_nGeneration;
+	Purge();
+	m_nGeneration = nGeneration + 1;
+
+	int nBits = SOUNDSCRIPTINDEX_MIN_SLOT_BITS;
+	while ( ( 1 << nBits ) < nCount * 2 )
+	{
+		++nBits;
+	}
+	m_nSlotBits = nBits;
+	m_nSlotMask = ( 1u << nBits ) - 1;
+	m_Slots.SetCount( 1 << nBits );
+	for ( int i = 0; i < m_Slots.Count(); ++i )
+	{
+		m_Slots[i].m_nSound = -1;
+	}
+
+	int nNameBytes = 0;
+	for ( int i = 0; i < nCount; ++i )
+	{
+		nNameBytes += V_strlen( ppNames[i] ) + 1;
+	}
+	m_Names.EnsureCapacity( nNameBytes );
+
+	for ( int i = 0; i < nCount; ++i )
+	{
+		// The emitter system doesn't have a name twice, but be like its dictionary if it did
+		unsigned int nHash = HashName( ppNames[i] );
+		if ( Find( ppNames[i], nHash ) >= 0 )
+			continue;
+
+		int nLength = V_strlen( ppNames[i] ) + 1;
+		int nName = m_Names.AddMultipleToTail( nLength );
+		V_memcpy( m_Names.Base() + nName, ppNames[i], nLength );
+
+		unsigned int nSlot = SOUNDSCRIPTINDEX_SLOT( nHash );
+		while ( m_Slots[nSlot].m_nSound >= 0 )
+		{
+			nSlot = ( nSlot + 1 ) & m_nSlotMask;
+		}
+		m_Slots[nSlot].m_nHash = nHash;
+		m_Slots[nSlot].m_nSound = pSoundIndices[i];
+		m_Slots[nSlot].m_nName = nName;
+
+		++m_nSounds;
+		m_nMaxSoundIndex = MAX( m_nMaxSoundIndex, pSoundIndices[i] );
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Lookups
+//-----------------------------------------------------------------------------
+int CSoundScriptIndex::Find( const char *pName ) const
+{
+	return Find( pName, HashName( pName ) );
+}
+
+int CSoundScriptIndex::Find( const char *pName, unsigned int nHash ) const
+{
+	Assert( nHash == HashName( pName ) );
+	if ( !m_Slots.Count() )
+		return -1;
+
+	unsigned int nSlot = SOUNDSCRIPTINDEX_SLOT( nHash );
+	for ( ;; )
+	{
+		const Slot_t &slot = m_Slots[nSlot];
+		if ( slot.m_nSound < 0 )
+			return -1;
+
+		if ( slot.m_nHash == nHash && !V_stricmp( m_Names.Base() + slot.m_nName, pName ) )
+			return slot.m_nSound;
+
+		nSlot = ( nSlot + 1 ) & m_nSlotMask;
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// CSoundNameHandle
+//-----------------------------------------------------------------------------
+CSoundNameHandle::CSoundNameHandle( const char *pSoundName )
+{
+	m_pSoundName = pSoundName;
+	m_nHash = CSoundScriptIndex::HashName( pSoundName );
+	m_nGeneration = -1;
+	m_hSound = -1;
+}
+
+HSOUNDSCRIPTHANDLE &CSoundNameHandle::Resolve()
+{
+	if ( m_nGeneration != SoundScriptIndex().GetGeneration() )
+	{
+		m_hSound = (HSOUNDSCRIPTHANDLE)LookupSoundScript( m_pSoundName, m_nHash );
+
+		// After the lookup, which may have rebuilt the index
+		m_nGeneration = SoundScriptIndex().GetGeneration();
+	}
+	return m_hSound;
+}
+
+
+#if defined( FASTPATH_TESTS )
+
+//-----------------------------------------------------------------------------
+// Tests
+//-----------------------------------------------------------------------------
+static unsigned int s_nSoundScriptIndexSeed;
+
+static unsigned int SoundScriptIndexTest_Random()
+{
+	s_nSoundScriptIndexSeed = s_nSoundScriptIndexSeed * 1664525 + 1013904223;
+	return s_nSoundScriptIndexSeed >> 8;
+}
+
+// Script sound like names: a few prefixes, many entries
+static void SoundScriptIndexTest_MakeNames( int nCount, CUtlVector< CUtlString > &names )
+{
+	static const char *s_pszPrefixes[] = { "Weapon_AK47", "NPC_Antlion", "Player", "Physics", "Default", "Bounce" };
+
+	names.SetCount( nCount );
+	for ( int i = 0; i < nCount; ++i )
+	{
+		names[i].Format( "%s.Sound%04x_%d", s_pszPrefixes[i % ARRAYSIZE( s_pszPrefixes )], SoundScriptIndexTest_Random() & 0xffff, i );
+	}
+}
+
+// The same name with some letters in the other case
+static const char *SoundScriptIndexTest_Respell( const char *pszName, char *pszBuf, int nBufSize )
+{
+	V_strncpy( pszBuf, pszName, nBufSize );
+	for ( char *p = pszBuf; *p; ++p )
+	{
+		if ( ( SoundScriptIndexTest_Random() & 3 ) == 0 )
+		{
+			*p = isupper( *p ) ? tolower( *p ) : toupper( *p );
+		}
+	}
+	return pszBuf;
+}
+
+// Sounds in a case insensitive dictionary, like the emitter system keeps them
+static void SoundScriptIndexTest_Load( const CUtlVector< CUtlString > &names, CUtlDict< int, int > &dict, CUtlVector< const char * > &ppNames, CUtlVector< int > &soundIndices )
+{
+	for ( int i = 0; i < names.Count(); ++i )
+	{
+		int nSound = dict.Insert( names[i], i );
+		ppNames.AddToTail( dict.GetElementName( nSound ) );
+		soundIndices.AddToTail( nSound );
+	}
+}
+
+bool SoundScriptIndex_Validate( int nSounds )
+{
+	s_nSoundScriptIndexSeed = 0x50d5;
+	nSounds = MAX( nSounds, 1 );
+
+	CUtlVector< CUtlString > names;
+	SoundScriptIndexTest_MakeNames( nSounds, names );
+
+	CUtlDict< int, int > dict( k_eDictCompareTypeCaseInsensitive );
+	CUtlVector< const char * > ppNames;
+	CUtlVector< int > soundIndices;
+	SoundScriptIndexTest_Load( names, dict, ppNames, soundIndices );
+
+	// Some sounds removed, so the emitter system's indices have holes
+	for ( int i = 0; i < ppNames.Count(); i += 7 )
+	{
+		dict.Remove( ppNames[i] );
+	}
+	ppNames.RemoveAll();
+	soundIndices.RemoveAll();
+	for ( int i = dict.First(); i != dict.InvalidIndex(); i = dict.Next( i ) )
+	{
+		ppNames.AddToTail( dict.GetElementName( i ) );
+		soundIndices.AddToTail( i );
+	}
+
+	CSoundScriptIndex index;
+	int nGeneration = index.GetGeneration();
+	index.Build( ppNames.Base(), soundIndices.Base(), ppNames.Count() );
+
+	int nFailures = 0;
+	if ( index.GetCount() != dict.Count() || index.GetGeneration() == nGeneration )
+	{
+		Warning( "sound script index: %d sounds indexed out of %d\n", index.GetCount(), dict.Count() );
+		++nFailures;
+	}
+
+	char szName[256];
+	char szMissing[256];
+	for ( int i = 0; i < names.Count(); ++i )
+	{
+		const char *pszName = SoundScriptIndexTest_Respell( names[i], szName, sizeof( szName ) );
+		int nExpected = dict.Find( pszName );
+		if ( nExpected == dict.InvalidIndex() )
+		{
+			nExpected = -1;
+		}
+
+		int nFound = index.Find( pszName );
+		int nHashed = index.Find( pszName, CSoundScriptIndex::HashName( pszName ) );
+		V_snprintf( szMissing, sizeof( szMissing ), "%s_missing", pszName );
+		int nMissing = index.Find( szMissing );
+		if ( nFound != nExpected || nHashed != nExpected || nMissing != -1 )
+		{
+			if ( ++nFailures <= 5 )
+			{
+				Warning( "sound script index: %s is %d in the dictionary, the index has %d (hashed %d, missing %d)\n", pszName, nExpected, nFound, nHashed, nMissing );
+			}
+		}
+	}
+
+	// Built again, like after the scripts reload
+	index.Build( ppNames.Base() + 1, soundIndices.Base() + 1, ppNames.Count() - 1 );
+	if ( ppNames.Count() && index.Find( ppNames[0] ) != -1 )
+	{
+		Warning( "sound script index: %s is still there after rebuilding without it\n", ppNames[0] );
+		++nFailures;
+	}
+
+	Msg( "sound script index: %d sounds compared against the dictionary: %s\n", nSounds, nFailures ? "FAILED" : "OK" );
+	return nFailures == 0;
+}
+
+void SoundScriptIndex_Benchmark( int nSounds, int nLookups )
+{
+	s_nSoundScriptIndexSeed = 0xe317;
+	nSounds = MAX( nSounds, 1 );
+	nLookups = MAX( nLookups, 1 );
+
+	CUtlVector< CUtlString > names;
+	SoundScriptIndexTest_MakeNames( nSounds, names );
+
+	CUtlDict< int, int > dict( k_eDictCompareTypeCaseInsensitive );
+	CUtlVector< const char * > ppNames;
+	CUtlVector< int > soundIndices;
+	SoundScriptIndexTest_Load( names, dict, ppNames, soundIndices );
+
+	double flStart = Plat_FloatTime();
+	CSoundScriptIndex index;
+	index.Build( ppNames.Base(), soundIndices.Base(), ppNames.Count() );
+	double flBuild = Plat_FloatTime() - flStart;
+
+	// Emits go to a few sounds much more than the rest
+	CUtlVector< int > lookups;
+	CUtlVector< unsigned int > hashes;
+	lookups.SetCount( nLookups );
+	hashes.SetCount( nLookups );
+	for ( int i = 0; i < nLookups; ++i )
+	{
+		unsigned int nRandom = SoundScriptIndexTest_Random();
+		lookups[i] = ( nRandom & 1 ) ? ( nRandom >> 1 ) % MIN( nSounds, 64 ) : ( nRandom >> 1 ) % nSounds;
+		hashes[i] = CSoundScriptIndex::HashName( ppNames[lookups[i]] );
+	}
+
+	int nSum = 0;
+	flStart = Plat_FloatTime();
+	for ( int i = 0; i < nLookups; ++i )
+	{
+		nSum += dict.Find( ppNames[lookups[i]] );
+	}
+	double flDict = Plat_FloatTime() - flStart;
+
+	flStart = Plat_FloatTime();
+	for ( int i = 0; i < nLookups; ++i )
+	{
+		nSum -= index.Find( ppNames[lookups[i]] );
+	}
+	double flIndex = Plat_FloatTime() - flStart;
+
+	flStart = Plat_FloatTime();
+	for ( int i = 0; i < nLookups; ++i )
+	{
+		nSum += index.Find( ppNames[lookups[i]], hashes[i] );
+	}
+	double flHashed = Plat_FloatTime() - flStart;
+
+	Msg( "sound script index: %d sounds, %d lookups (checksum %d), built in %.3f ms\n", nSounds, nLookups, nSum, flBuild * 1000.0 );
+	Msg( "  dictionary: %8.3f ms (%.0f lookups/s)\n", flDict * 1000.0, flDict > 0.0 ? nLookups / flDict : 0.0 );
+	Msg( "  index:      %8.3f ms (%.0f lookups/s), %.2fx\n", flIndex * 1000.0, flIndex > 0.0 ? nLookups / flIndex : 0.0, flIndex > 0.0 ? flDict / flIndex : 0.0 );
+	Msg( "  hashed:     %8.3f ms (%.0f lookups/s), %.2fx\n", flHashed * 1000.0, flHashed > 0.0 ? nLookups / flHashed : 0.0, flHashed > 0.0 ? flDict / flHashed : 0.0 );
+
+	// The loaded scripts, through the emitter system as EmitSound() did and through the index
+	if ( !soundemitterbase || !soundemitterbase->GetSoundCount() )
+		return;
+
+	CUtlVector< const char * > loaded;
+	for ( int i = soundemitterbase->First(); i != soundemitterbase->InvalidIndex(); i = soundemitterbase->Next( i ) )
+	{
+		loaded.AddToTail( soundemitterbase->GetSoundName( i ) );
+	}
+
+	CSoundScriptIndex &scripts = SoundScriptIndex();
+	for ( int i = 0; i < nLookups; ++i )
+	{
+		lookups[i] = SoundScriptIndexTest_Random() % loaded.Count();
+	}
+
+	flStart = Plat_FloatTime();
+	for ( int i = 0; i < nLookups; ++i )
+	{
+		nSum += soundemitterbase->GetSoundIndex( loaded[lookups[i]] );
+	}
+	double flEmitter = Plat_FloatTime() - flStart;
+
+	flStart = Plat_FloatTime();
+	for ( int i = 0; i < nLookups; ++i )
+	{
+		nSum -= scripts.Find( loaded[lookups[i]] );
+	}
+	double flScripts = Plat_FloatTime() - flStart;
+
+	Msg( "  loaded scripts, %d sounds (checksum %d):\n", loaded.Count(), nSum );
+	Msg( "    emitter system: %8.3f ms (%.0f lookups/s)\n", flEmitter * 1000.0, flEmitter > 0.0 ? nLookups / flEmitter : 0.0 );
+	Msg( "    index:          %8.3f ms (%.0f lookups/s), %.2fx\n", flScripts * 1000.0, flScripts > 0.0 ? nLookups / flScripts : 0.0, flScripts > 0.0 ? flEmitter / flScripts : 0.0 );
+}
+
+#endif // FASTPATH_TESTS
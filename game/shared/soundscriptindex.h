@@ -0,0 +1,122 @@
+//===== Copyright (c) 1996-2005, Valve Corporation, All rights reserved. ======//
+//
+// Purpose: Hashed lookup of sound script entries by name.
+//
+//			The sound emitter system finds a script sound by walking its
+//			dictionary with case insensitive compares, and EmitSound() does
+//			that for every sound emitted by name. The index here is an open
+//			addressed hash of the case folded names, built from the loaded
+//			scripts, mapping to the emitter system's own sound indices.
+//
+//			CSoundNameHandle is for code that emits the same sound over and
+//			over: it hashes its name once and keeps the sound index until
+//			the scripts are reloaded.
+//
+// $NoKeywords: $
+//===========================================================================//
+
+#ifndef SOUNDSCRIPTINDEX_H
+#define SOUNDSCRIPTINDEX_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include "utlvector.h"
+
+class ISoundEmitterSystemBase;
+
+
+class CSoundScriptIndex
+{
+public:
+	CSoundScriptIndex();
+
+	void Purge();
+
+	// Indexes every sound of the emitter system
+	void Build( ISoundEmitterSystemBase *pSounds );
+	void Build( const char * const *ppNames, const int *pSoundIndices, int nCount );
+
+	int GetCount() const				{ return m_nSounds; }
+	int GetMaxSoundIndex() const		{ return m_nMaxSoundIndex; }
+
+	// Changes with every Build(), so handles know to look their sounds up again
+	int GetGeneration() const			{ return m_nGeneration; }
+
+	// Case folded, so it matches for every spelling the emitter system treats as the same name
+	static unsigned int HashName( const char *pName );
+
+	// The emitter system's index of the sound, -1 if the index doesn't have it
+	int Find( const char *pName ) const;
+	int Find( const char *pName, unsigned int nHash ) const;
+
+private:
+	struct Slot_t
+	{
+		unsigned int	m_nHash;
+		int				m_nSound;		// -1 if the slot is free
+		int				m_nName;		// offset in m_Names
+	};
+
+	CUtlVector< Slot_t > m_Slots;		// power of two, at most half full
+	CUtlVector< char > m_Names;			// copies, so lookups don't call the emitter system
+	unsigned int m_nSlotMask;
+	int m_nSlotBits;
+	int m_nSounds;
+	int m_nMaxSoundIndex;
+	int m_nGeneration;
+};
+
+
+//-----------------------------------------------------------------------------
+// The index of the sound scripts this DLL sees, rebuilt when they change.
+// LookupSoundScript() asks the emitter system about the names the index
+// doesn't have, so it answers like soundemitterbase->GetSoundIndex().
+// Both live in SoundEmitterSystem.cpp.
+//-----------------------------------------------------------------------------
+CSoundScriptIndex &SoundScriptIndex();
+int LookupSoundScript( const char *pName, unsigned int nHash );
+
+
+//-----------------------------------------------------------------------------
+// A script sound name for a static local or a member:
+//
+//		static CSoundNameHandle s_hFootstep( "NPC_Antlion.Footstep" );
+//		EmitSound( s_hFootstep.GetName(), s_hFootstep.Resolve() );
+//
+// The name has to outlive the handle; string literals do.
+//-----------------------------------------------------------------------------
+class CSoundNameHandle
+{
+public:
+	explicit CSoundNameHandle( const char *pSoundName );
+
+	const char *GetName() const			{ return m_pSoundName; }
+	unsigned int GetHash() const		{ return m_nHash; }
+
+	// The sound's handle (SOUNDEMITTER_INVALID_HANDLE if there's no such
+	// sound), looked up the first time and again after the scripts reload
+	HSOUNDSCRIPTHANDLE &Resolve();
+
+private:
+	const char *m_pSoundName;
+	unsigned int m_nHash;
+	int m_nGeneration;					// of the index m_hSound was found in
+	HSOUNDSCRIPTHANDLE m_hSound;
+};
+
+
+#if defined( FASTPATH_TESTS )
+//-----------------------------------------------------------------------------
+// Checks the index against a case insensitive dictionary like the emitter
+// system's on nSounds made up sound names, then times nLookups lookups by
+// name through the dictionary and through the index, with and without the
+// hash a handle keeps (and through the emitter system itself when it has
+// sounds loaded)
+//-----------------------------------------------------------------------------
+bool SoundScriptIndex_Validate( int nSounds );
+void SoundScriptIndex_Benchmark( int nSounds, int nLookups );
+#endif
+
+
+#endif // SOUNDSCRIPTINDEX_H
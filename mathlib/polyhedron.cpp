@@ -8,6 +8,7 @@
 
 #include "mathlib/polyhedron.h"
 #include "mathlib/vmatrix.h"
+#include "mathlib/ssemath.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include "tier1/utlvector.h"
@@ -25,10 +26,20 @@ struct GeneratePolyhedronFromPlanes_UnorderedPointLL;
 struct GeneratePolyhedronFromPlanes_UnorderedLineLL;
 struct GeneratePolyhedronFromPlanes_UnorderedPolygonLL;
 
+enum PolyhedronMemory_t //where a generated polyhedron lives
+{
+	POLYHEDRON_MEMORY_NEW, //CPolyhedron_AllocByNew
+	POLYHEDRON_MEMORY_TEMP, //GetTempPolyhedron()
+	POLYHEDRON_MEMORY_CONTEXT, //CPolyhedronClipContext::GetPolyhedron()
+};
+
+#define POLYHEDRON_CONTEXT_BLOCK_SIZE (32 * 1024) //heap blocks a context grows by
+#define POLYHEDRON_STACK_CONTEXT_SIZE (16 * 1024) //stack buffer the non-context entry points clip in before touching the heap
+
 Vector FindPointInPlanes( const float *pPlanes, int planeCount );
 bool FindConvexShapeLooseAABB( const float *pInwardFacingPlanes, int iPlaneCount, Vector *pAABBMins, Vector *pAABBMaxs );
-CPolyhedron *ClipLinkedGeometry( GeneratePolyhedronFromPlanes_UnorderedPolygonLL *pPolygons, GeneratePolyhedronFromPlanes_UnorderedLineLL *pLines, GeneratePolyhedronFromPlanes_UnorderedPointLL *pPoints, const float *pOutwardFacingPlanes, int iPlaneCount, float fOnPlaneEpsilon, bool bUseTemporaryMemory );
-CPolyhedron *ConvertLinkedGeometryToPolyhedron( GeneratePolyhedronFromPlanes_UnorderedPolygonLL *pPolygons, GeneratePolyhedronFromPlanes_UnorderedLineLL *pLines, GeneratePolyhedronFromPlanes_UnorderedPointLL *pPoints, bool bUseTemporaryMemory );
+CPolyhedron *ClipLinkedGeometry( CPolyhedronClipContext &context, GeneratePolyhedronFromPlanes_UnorderedPolygonLL *pPolygons, GeneratePolyhedronFromPlanes_UnorderedLineLL *pLines, GeneratePolyhedronFromPlanes_UnorderedPointLL *pPoints, const float *pOutwardFacingPlanes, int iPlaneCount, float fOnPlaneEpsilon, PolyhedronMemory_t memory );
+CPolyhedron *ConvertLinkedGeometryToPolyhedron( CPolyhedronClipContext &context, GeneratePolyhedronFromPlanes_UnorderedPolygonLL *pPolygons, GeneratePolyhedronFromPlanes_UnorderedLineLL *pLines, GeneratePolyhedronFromPlanes_UnorderedPointLL *pPoints, PolyhedronMemory_t memory );
 
 //#define ENABLE_DEBUG_POLYHEDRON_DUMPS //Dumps debug information to disk for use with glview. Requires that tier2 also be in all projects using debug mathlib
 //#define DEBUG_DUMP_POLYHEDRONS_TO_NUMBERED_GLVIEWS //dumps successfully generated polyhedrons
@@ -150,6 +161,135 @@ CPolyhedron *GetTempPolyhedron( unsigned short iVertices, unsigned short iLines,
 }
 
 
+CPolyhedronClipContext::CPolyhedronClipContext( void *pInitialBuffer, int iInitialBufferSize )
+	: m_pFirstBlock( NULL ), m_pCurrentBlock( NULL ), m_iCurrentBlockUsed( 0 ), m_pPolyhedronMemory( NULL ), m_iPolyhedronMemorySize( 0 )
+{
+	m_Polyhedron.pVertices = NULL;
+	m_Polyhedron.pLines = NULL;
+	m_Polyhedron.pIndices = NULL;
+	m_Polyhedron.pPolygons = NULL;
+	m_Polyhedron.iVertexCount = m_Polyhedron.iLineCount = m_Polyhedron.iIndexCount = m_Polyhedron.iPolygonCount = 0;
+
+	if( pInitialBuffer )
+	{
+		//the block header goes at the front of the buffer, the data after it on a 16 byte boundary
+		unsigned char *pHeader = (unsigned char *)AlignValue( (unsigned char *)pInitialBuffer, sizeof( void * ) );
+		unsigned char *pData = (unsigned char *)AlignValue( pHeader + sizeof( Block_t ), 16 );
+		int iUsable = iInitialBufferSize - (int)(pData - (unsigned char *)pInitialBuffer);
+		if( iUsable >= 16 )
+		{
+			m_pFirstBlock = (Block_t *)pHeader;
+			m_pFirstBlock->pNext = NULL;
+			m_pFirstBlock->iSize = iUsable & ~15;
+			m_pFirstBlock->bOwned = false;
+			m_pCurrentBlock = m_pFirstBlock;
+		}
+	}
+}
+
+CPolyhedronClipContext::~CPolyhedronClipContext( void )
+{
+	Block_t *pBlock = m_pFirstBlock;
+	while( pBlock )
+	{
+		Block_t *pNext = pBlock->pNext;
+		if( pBlock->bOwned )
+			delete [] (unsigned char *)pBlock;
+		pBlock = pNext;
+	}
+
+	delete [] m_pPolyhedronMemory;
+}
+
+void *CPolyhedronClipContext::Alloc( int iBytes )
+{
+	iBytes = (iBytes + 15) & ~15;
+
+	if( m_pCurrentBlock && ((m_iCurrentBlockUsed + iBytes) > m_pCurrentBlock->iSize) )
+	{
+		//move on to the next block we already have, if it's big enough
+		if( m_pCurrentBlock->pNext && (iBytes <= m_pCurrentBlock->pNext->iSize) )
+		{
+			m_pCurrentBlock = m_pCurrentBlock->pNext;
+			m_iCurrentBlockUsed = 0;
+		}
+	}
+
+	if( (m_pCurrentBlock == NULL) || ((m_iCurrentBlockUsed + iBytes) > m_pCurrentBlock->iSize) )
+	{
+		//link a new block in after the current one so it's reused from now on
+		int iBlockSize = MAX( iBytes, POLYHEDRON_CONTEXT_BLOCK_SIZE );
+		Block_t *pNewBlock = (Block_t *)new unsigned char [ sizeof( Block_t ) + 16 + iBlockSize ];
+		pNewBlock->iSize = iBlockSize;
+		pNewBlock->bOwned = true;
+		if( m_pCurrentBlock )
+		{
+			pNewBlock->pNext = m_pCurrentBlock->pNext;
+			m_pCurrentBlock->pNext = pNewBlock;
+		}
+		else
+		{
+			pNewBlock->pNext = NULL;
+			m_pFirstBlock = pNewBlock;
+		}
+
+		m_pCurrentBlock = pNewBlock;
+		m_iCurrentBlockUsed = 0;
+	}
+
+	unsigned char *pData = (unsigned char *)AlignValue( (unsigned char *)(m_pCurrentBlock + 1), 16 );
+	void *pReturn = pData + m_iCurrentBlockUsed;
+	m_iCurrentBlockUsed += iBytes;
+	return pReturn;
+}
+
+void CPolyhedronClipContext::Reset( void )
+{
+	m_pCurrentBlock = m_pFirstBlock;
+	m_iCurrentBlockUsed = 0;
+}
+
+CPolyhedron *CPolyhedronClipContext::GetPolyhedron( unsigned short iVertices, unsigned short iLines, unsigned short iIndices, unsigned short iPolygons )
+{
+	int iSize = (sizeof( Vector ) * iVertices) +
+				(sizeof( Polyhedron_IndexedLine_t ) * iLines) +
+				(sizeof( Polyhedron_IndexedLineReference_t ) * iIndices) +
+				(sizeof( Polyhedron_IndexedPolygon_t ) * iPolygons);
+
+	if( iSize > m_iPolyhedronMemorySize )
+	{
+		delete [] m_pPolyhedronMemory;
+		m_iPolyhedronMemorySize = MAX( iSize, m_iPolyhedronMemorySize * 2 );
+		m_pPolyhedronMemory = new unsigned char [ m_iPolyhedronMemorySize ];
+	}
+
+	m_Polyhedron.iVertexCount = iVertices;
+	m_Polyhedron.iLineCount = iLines;
+	m_Polyhedron.iIndexCount = iIndices;
+	m_Polyhedron.iPolygonCount = iPolygons;
+
+	m_Polyhedron.pVertices = (Vector *)m_pPolyhedronMemory;
+	m_Polyhedron.pLines = (Polyhedron_IndexedLine_t *)(&m_Polyhedron.pVertices[iVertices]);
+	m_Polyhedron.pIndices = (Polyhedron_IndexedLineReference_t *)(&m_Polyhedron.pLines[iLines]);
+	m_Polyhedron.pPolygons = (Polyhedron_IndexedPolygon_t *)(&m_Polyhedron.pIndices[iIndices]);
+
+	return &m_Polyhedron;
+}
+
+static CPolyhedron *AllocatePolyhedron( CPolyhedronClipContext &context, PolyhedronMemory_t memory, unsigned short iVertices, unsigned short iLines, unsigned short iIndices, unsigned short iPolygons )
+{
+	switch( memory )
+	{
+	case POLYHEDRON_MEMORY_TEMP:
+		return GetTempPolyhedron( iVertices, iLines, iIndices, iPolygons );
+	case POLYHEDRON_MEMORY_CONTEXT:
+		return context.GetPolyhedron( iVertices, iLines, iIndices, iPolygons );
+	default:
+		return CPolyhedron_AllocByNew::Allocate( iVertices, iLines, iIndices, iPolygons );
+	}
+}
+
+
 Vector CPolyhedron::Center( void )
 {
 	if( iVertexCount == 0 )
@@ -248,14 +388,43 @@ struct GeneratePolyhedronFromPlanes_UnorderedPointLL //an unordered collection o
 
 
 
-CPolyhedron *ClipPolyhedron( const CPolyhedron *pExistingPolyhedron, const float *pOutwardFacingPlanes, int iPlaneCount, float fOnPlaneEpsilon, bool bUseTemporaryMemory )
+static const int s_iFourBitPopCount[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+
+//Counts the vertices clearly behind and clearly in front of a plane, four at a time. pVertices holds iVertexCount vertices in groups of four, the unused slots of the last group are ignored.
+static void CountPlaneSides( const FourVectors *pVertices, int iVertexCount, const Vector &vNormal, float fPlaneDist, float fOnPlaneEpsilon, int &iLiveCount, int &iDeadCount )
+{
+	const fltx4 fl4NormalX = ReplicateX4( vNormal.x );
+	const fltx4 fl4NormalY = ReplicateX4( vNormal.y );
+	const fltx4 fl4NormalZ = ReplicateX4( vNormal.z );
+	const fltx4 fl4PlaneDist = ReplicateX4( fPlaneDist );
+	const fltx4 fl4OnPlaneEpsilon = ReplicateX4( fOnPlaneEpsilon );
+	const fltx4 fl4NegativeOnPlaneEpsilon = ReplicateX4( -fOnPlaneEpsilon );
+
+	int iGroups = (iVertexCount + 3) >> 2;
+	for( int i = 0; i != iGroups; ++i )
+	{
+		//same operation order as vNormal.Dot( vPoint ) - fPlaneDist so the counts match the per point classification exactly
+		const FourVectors &vPoints = pVertices[i];
+		fltx4 fl4PointDist = AddSIMD( AddSIMD( MulSIMD( fl4NormalX, vPoints.x ), MulSIMD( fl4NormalY, vPoints.y ) ), MulSIMD( fl4NormalZ, vPoints.z ) );
+		fl4PointDist = SubSIMD( fl4PointDist, fl4PlaneDist );
+
+		fltx4 fl4Live = CmpLeSIMD( fl4PointDist, fl4NegativeOnPlaneEpsilon );
+		fltx4 fl4Dead = AndNotSIMD( fl4Live, CmpGtSIMD( fl4PointDist, fl4OnPlaneEpsilon ) );
+
+		int iValidMask = ( i == iGroups - 1 ) ? ( 0xF >> ((iGroups << 2) - iVertexCount) ) : 0xF;
+		iLiveCount += s_iFourBitPopCount[TestSignSIMD( fl4Live ) & iValidMask];
+		iDeadCount += s_iFourBitPopCount[TestSignSIMD( fl4Dead ) & iValidMask];
+	}
+}
+
+static CPolyhedron *ClipPolyhedron_Internal( CPolyhedronClipContext &context, const CPolyhedron *pExistingPolyhedron, const float *pOutwardFacingPlanes, int iPlaneCount, float fOnPlaneEpsilon, PolyhedronMemory_t memory )
 {
 	if( pExistingPolyhedron == NULL )
 		return NULL;
 
 	AssertMsg( (pExistingPolyhedron->iVertexCount >= 3) && (pExistingPolyhedron->iPolygonCount >= 2), "Polyhedron doesn't meet absolute minimum spec" );
 
-	float *pUsefulPlanes = (float *)stackalloc( sizeof( float ) * 4 * iPlaneCount );
+	float *pUsefulPlanes = (float *)context.Alloc( sizeof( float ) * 4 * iPlaneCount );
 	int iUsefulPlaneCount = 0;
 	Vector *pExistingVertices = pExistingPolyhedron->pVertices;
 
@@ -263,22 +432,24 @@ CPolyhedron *ClipPolyhedron( const CPolyhedron *pExistingPolyhedron, const float
 	{
 		int iLiveCount = 0;
 		int iDeadCount = 0;
-		const float fNegativeOnPlaneEpsilon = -fOnPlaneEpsilon;
+
+		//swizzle the vertices once for all the planes
+		int iVertexGroups = (pExistingPolyhedron->iVertexCount + 3) >> 2;
+		FourVectors *pVertexGroups = (FourVectors *)context.Alloc( sizeof( FourVectors ) * iVertexGroups );
+		for( int j = 0; j != iVertexGroups * 4; ++j )
+		{
+			const Vector &vPoint = pExistingVertices[MIN( j, pExistingPolyhedron->iVertexCount - 1 )];
+			pVertexGroups[j >> 2].X( j & 3 ) = vPoint.x;
+			pVertexGroups[j >> 2].Y( j & 3 ) = vPoint.y;
+			pVertexGroups[j >> 2].Z( j & 3 ) = vPoint.z;
+		}
 
 		for( int i = 0; i != iPlaneCount; ++i )
 		{
 			Vector vNormal = *((Vector *)&pOutwardFacingPlanes[(i * 4) + 0]);
 			float fPlaneDist = pOutwardFacingPlanes[(i * 4) + 3];
 
-			for( int j = 0; j != pExistingPolyhedron->iVertexCount; ++j )
-			{
-				float fPointDist = vNormal.Dot( pExistingVertices[j] ) - fPlaneDist;
-				
-				if( fPointDist <= fNegativeOnPlaneEpsilon )
-					++iLiveCount;
-				else if( fPointDist > fOnPlaneEpsilon )
-					++iDeadCount;
-			}
+			CountPlaneSides( pVertexGroups, pExistingPolyhedron->iVertexCount, vNormal, fPlaneDist, fOnPlaneEpsilon, iLiveCount, iDeadCount );
 
 			if( iLiveCount == 0 )
 			{
@@ -302,21 +473,14 @@ CPolyhedron *ClipPolyhedron( const CPolyhedron *pExistingPolyhedron, const float
 	{
 		//testing shows that the polyhedron won't even be cut, clone the existing polyhedron and return that
 
-		CPolyhedron *pReturn;
-		if( bUseTemporaryMemory )
-		{
-			pReturn = GetTempPolyhedron( pExistingPolyhedron->iVertexCount, 
-											pExistingPolyhedron->iLineCount, 
-											pExistingPolyhedron->iIndexCount, 
-											pExistingPolyhedron->iPolygonCount );
-		}
-		else
-		{
-			pReturn = CPolyhedron_AllocByNew::Allocate( pExistingPolyhedron->iVertexCount, 
-														pExistingPolyhedron->iLineCount, 
-														pExistingPolyhedron->iIndexCount, 
-														pExistingPolyhedron->iPolygonCount );
-		}
+		if( (memory == POLYHEDRON_MEMORY_CONTEXT) && context.IsContextPolyhedron( pExistingPolyhedron ) )
+			return const_cast<CPolyhedron *>( pExistingPolyhedron ); //already where the clone would go
+
+		CPolyhedron *pReturn = AllocatePolyhedron( context, memory, 
+													pExistingPolyhedron->iVertexCount, 
+													pExistingPolyhedron->iLineCount, 
+													pExistingPolyhedron->iIndexCount, 
+													pExistingPolyhedron->iPolygonCount );
 
 		memcpy( pReturn->pVertices, pExistingPolyhedron->pVertices, sizeof( Vector ) * pReturn->iVertexCount );
 		memcpy( pReturn->pLines, pExistingPolyhedron->pLines, sizeof( Polyhedron_IndexedLine_t ) * pReturn->iLineCount );
@@ -326,14 +490,12 @@ CPolyhedron *ClipPolyhedron( const CPolyhedron *pExistingPolyhedron, const float
 		return pReturn;
 	}
 
-
-
 	//convert the polyhedron to linked geometry
-	GeneratePolyhedronFromPlanes_Point *pStartPoints = (GeneratePolyhedronFromPlanes_Point *)stackalloc( pExistingPolyhedron->iVertexCount * sizeof( GeneratePolyhedronFromPlanes_Point ) );
-	GeneratePolyhedronFromPlanes_Line *pStartLines = (GeneratePolyhedronFromPlanes_Line *)stackalloc( pExistingPolyhedron->iLineCount * sizeof( GeneratePolyhedronFromPlanes_Line ) );
-	GeneratePolyhedronFromPlanes_Polygon *pStartPolygons = (GeneratePolyhedronFromPlanes_Polygon *)stackalloc( pExistingPolyhedron->iPolygonCount * sizeof( GeneratePolyhedronFromPlanes_Polygon ) );
+	GeneratePolyhedronFromPlanes_Point *pStartPoints = (GeneratePolyhedronFromPlanes_Point *)context.Alloc( pExistingPolyhedron->iVertexCount * sizeof( GeneratePolyhedronFromPlanes_Point ) );
+	GeneratePolyhedronFromPlanes_Line *pStartLines = (GeneratePolyhedronFromPlanes_Line *)context.Alloc( pExistingPolyhedron->iLineCount * sizeof( GeneratePolyhedronFromPlanes_Line ) );
+	GeneratePolyhedronFromPlanes_Polygon *pStartPolygons = (GeneratePolyhedronFromPlanes_Polygon *)context.Alloc( pExistingPolyhedron->iPolygonCount * sizeof( GeneratePolyhedronFromPlanes_Polygon ) );
 
-	GeneratePolyhedronFromPlanes_LineLL *pStartLineLinks = (GeneratePolyhedronFromPlanes_LineLL *)stackalloc( pExistingPolyhedron->iLineCount * 4 * sizeof( GeneratePolyhedronFromPlanes_LineLL ) );
+	GeneratePolyhedronFromPlanes_LineLL *pStartLineLinks = (GeneratePolyhedronFromPlanes_LineLL *)context.Alloc( pExistingPolyhedron->iLineCount * 4 * sizeof( GeneratePolyhedronFromPlanes_LineLL ) );
 	
 	int iCurrentLineLinkIndex = 0;
 
@@ -444,9 +606,9 @@ CPolyhedron *ClipPolyhedron( const CPolyhedron *pExistingPolyhedron, const float
 		} while( pWorkLink != pFirstLink );
 	}
 
-	GeneratePolyhedronFromPlanes_UnorderedPointLL *pPoints = (GeneratePolyhedronFromPlanes_UnorderedPointLL *)stackalloc( pExistingPolyhedron->iVertexCount * sizeof( GeneratePolyhedronFromPlanes_UnorderedPointLL ) );
-	GeneratePolyhedronFromPlanes_UnorderedLineLL *pLines = (GeneratePolyhedronFromPlanes_UnorderedLineLL *)stackalloc( pExistingPolyhedron->iLineCount * sizeof( GeneratePolyhedronFromPlanes_UnorderedLineLL ) );
-	GeneratePolyhedronFromPlanes_UnorderedPolygonLL *pPolygons = (GeneratePolyhedronFromPlanes_UnorderedPolygonLL *)stackalloc( pExistingPolyhedron->iPolygonCount * sizeof( GeneratePolyhedronFromPlanes_UnorderedPolygonLL ) );
+	GeneratePolyhedronFromPlanes_UnorderedPointLL *pPoints = (GeneratePolyhedronFromPlanes_UnorderedPointLL *)context.Alloc( pExistingPolyhedron->iVertexCount * sizeof( GeneratePolyhedronFromPlanes_UnorderedPointLL ) );
+	GeneratePolyhedronFromPlanes_UnorderedLineLL *pLines = (GeneratePolyhedronFromPlanes_UnorderedLineLL *)context.Alloc( pExistingPolyhedron->iLineCount * sizeof( GeneratePolyhedronFromPlanes_UnorderedLineLL ) );
+	GeneratePolyhedronFromPlanes_UnorderedPolygonLL *pPolygons = (GeneratePolyhedronFromPlanes_UnorderedPolygonLL *)context.Alloc( pExistingPolyhedron->iPolygonCount * sizeof( GeneratePolyhedronFromPlanes_UnorderedPolygonLL ) );
 
 	//setup point collection
 	{
@@ -499,7 +661,20 @@ CPolyhedron *ClipPolyhedron( const CPolyhedron *pExistingPolyhedron, const float
 		pPolygons[iLastPolygon].pNext = NULL;
 	}
 
-	return ClipLinkedGeometry( pPolygons, pLines, pPoints, pUsefulPlanes, iUsefulPlaneCount, fOnPlaneEpsilon, bUseTemporaryMemory );
+	return ClipLinkedGeometry( context, pPolygons, pLines, pPoints, pUsefulPlanes, iUsefulPlaneCount, fOnPlaneEpsilon, memory );
+}
+
+CPolyhedron *ClipPolyhedron( const CPolyhedron *pExistingPolyhedron, const float *pOutwardFacingPlanes, int iPlaneCount, float fOnPlaneEpsilon, bool bUseTemporaryMemory )
+{
+	void *pStackBuffer = stackalloc( POLYHEDRON_STACK_CONTEXT_SIZE );
+	CPolyhedronClipContext context( pStackBuffer, POLYHEDRON_STACK_CONTEXT_SIZE );
+	return ClipPolyhedron_Internal( context, pExistingPolyhedron, pOutwardFacingPlanes, iPlaneCount, fOnPlaneEpsilon, bUseTemporaryMemory ? POLYHEDRON_MEMORY_TEMP : POLYHEDRON_MEMORY_NEW );
+}
+
+CPolyhedron *ClipPolyhedron( CPolyhedronClipContext *pContext, const CPolyhedron *pExistingPolyhedron, const float *pOutwardFacingPlanes, int iPlaneCount, float fOnPlaneEpsilon, bool bUseContextMemory )
+{
+	pContext->Reset();
+	return ClipPolyhedron_Internal( *pContext, pExistingPolyhedron, pOutwardFacingPlanes, iPlaneCount, fOnPlaneEpsilon, bUseContextMemory ? POLYHEDRON_MEMORY_CONTEXT : POLYHEDRON_MEMORY_NEW );
 }
 
 
@@ -668,7 +843,7 @@ bool FindConvexShapeLooseAABB( const float *pInwardFacingPlanes, int iPlaneCount
 
 
 
-CPolyhedron *ConvertLinkedGeometryToPolyhedron( GeneratePolyhedronFromPlanes_UnorderedPolygonLL *pPolygons, GeneratePolyhedronFromPlanes_UnorderedLineLL *pLines, GeneratePolyhedronFromPlanes_UnorderedPointLL *pPoints, bool bUseTemporaryMemory )
+CPolyhedron *ConvertLinkedGeometryToPolyhedron( CPolyhedronClipContext &context, GeneratePolyhedronFromPlanes_UnorderedPolygonLL *pPolygons, GeneratePolyhedronFromPlanes_UnorderedLineLL *pLines, GeneratePolyhedronFromPlanes_UnorderedPointLL *pPoints, PolyhedronMemory_t memory )
 {
 	Assert( (pPolygons != NULL) && (pLines != NULL) && (pPoints != NULL) );
 	unsigned int iPolyCount = 0, iLineCount = 0, iPointCount = 0, iIndexCount = 0;
@@ -704,15 +879,7 @@ CPolyhedron *ConvertLinkedGeometryToPolyhedron( GeneratePolyhedronFromPlanes_Uno
 		pActivePointWalk = pActivePointWalk->pNext;
 	} while( pActivePointWalk );	
 	
-	CPolyhedron *pReturn;
-	if( bUseTemporaryMemory )
-	{
-		pReturn = GetTempPolyhedron( iPointCount, iLineCount, iIndexCount, iPolyCount );
-	}
-	else
-	{
-		pReturn = CPolyhedron_AllocByNew::Allocate( iPointCount, iLineCount, iIndexCount, iPolyCount );
-	}
+	CPolyhedron *pReturn = AllocatePolyhedron( context, memory, iPointCount, iLineCount, iIndexCount, iPolyCount );
 
 	Vector *pVertexArray = pReturn->pVertices;
 	Polyhedron_IndexedLine_t *pLineArray = pReturn->pLines;
@@ -862,7 +1029,44 @@ const char * DumpPolyhedronCutHistory( const CUtlVector<CPolyhedron *> &DumpedHi
 
 #endif
 
-CPolyhedron *ClipLinkedGeometry( GeneratePolyhedronFromPlanes_UnorderedPolygonLL *pAllPolygons, GeneratePolyhedronFromPlanes_UnorderedLineLL *pAllLines, GeneratePolyhedronFromPlanes_UnorderedPointLL *pAllPoints, const float *pOutwardFacingPlanes, int iPlaneCount, float fOnPlaneEpsilon, bool bUseTemporaryMemory )
+//Stores vNormal.Dot( ptPosition ) - fPlaneDist in fPlaneDist of every point, four points at a time
+static void ComputePointPlaneDistances( GeneratePolyhedronFromPlanes_UnorderedPointLL *pPoints, const Vector &vNormal, float fPlaneDist )
+{
+	const fltx4 fl4NormalX = ReplicateX4( vNormal.x );
+	const fltx4 fl4NormalY = ReplicateX4( vNormal.y );
+	const fltx4 fl4NormalZ = ReplicateX4( vNormal.z );
+	const fltx4 fl4PlaneDist = ReplicateX4( fPlaneDist );
+
+	GeneratePolyhedronFromPlanes_UnorderedPointLL *pActivePointWalk = pPoints;
+	while( pActivePointWalk )
+	{
+		GeneratePolyhedronFromPlanes_Point *pGroup[4];
+		int iCount = 0;
+		do
+		{
+			pGroup[iCount++] = pActivePointWalk->pPoint;
+			pActivePointWalk = pActivePointWalk->pNext;
+		} while( pActivePointWalk && (iCount != 4) );
+
+		for( int i = iCount; i != 4; ++i )
+			pGroup[i] = pGroup[iCount - 1];
+
+		//ptPosition is followed by more of the point, so the 16 byte loads stay inside it
+		FourVectors vPoints;
+		vPoints.LoadAndSwizzle( pGroup[0]->ptPosition, pGroup[1]->ptPosition, pGroup[2]->ptPosition, pGroup[3]->ptPosition );
+
+		//same operation order as vNormal.Dot( ptPosition ) - fPlaneDist
+		fltx4 fl4PointDist = AddSIMD( AddSIMD( MulSIMD( fl4NormalX, vPoints.x ), MulSIMD( fl4NormalY, vPoints.y ) ), MulSIMD( fl4NormalZ, vPoints.z ) );
+		fl4PointDist = SubSIMD( fl4PointDist, fl4PlaneDist );
+
+		ALIGN16 float fPointDists[4] ALIGN16_POST;
+		StoreAlignedSIMD( fPointDists, fl4PointDist );
+		for( int i = 0; i != iCount; ++i )
+			pGroup[i]->fPlaneDist = fPointDists[i];
+	}
+}
+
+CPolyhedron *ClipLinkedGeometry( CPolyhedronClipContext &context, GeneratePolyhedronFromPlanes_UnorderedPolygonLL *pAllPolygons, GeneratePolyhedronFromPlanes_UnorderedLineLL *pAllLines, GeneratePolyhedronFromPlanes_UnorderedPointLL *pAllPoints, const float *pOutwardFacingPlanes, int iPlaneCount, float fOnPlaneEpsilon, PolyhedronMemory_t memory )
 {
 	const float fNegativeOnPlaneEpsilon = -fOnPlaneEpsilon;
 
@@ -875,7 +1079,7 @@ CPolyhedron *ClipLinkedGeometry( GeneratePolyhedronFromPlanes_UnorderedPolygonLL
 	static int iPolyhedronClipCount = 0;
 	++iPolyhedronClipCount;
 	
-	DebugCutHistory.AddToTail( ConvertLinkedGeometryToPolyhedron( pAllPolygons, pAllLines, pAllPoints, false ) );
+	DebugCutHistory.AddToTail( ConvertLinkedGeometryToPolyhedron( context, pAllPolygons, pAllLines, pAllPoints, POLYHEDRON_MEMORY_NEW ) );
 #endif
 
 	//clear out polygon work variables
@@ -931,11 +1135,13 @@ CPolyhedron *ClipLinkedGeometry( GeneratePolyhedronFromPlanes_UnorderedPolygonLL
 			bool bAllPointsAlive = true;
 
 			//find point distances from the plane
+			ComputePointPlaneDistances( pAllPoints, vNormal, fPlaneDist );
+
 			GeneratePolyhedronFromPlanes_UnorderedPointLL *pActivePointWalk = pAllPoints;
 			do
 			{
 				GeneratePolyhedronFromPlanes_Point *pPoint = pActivePointWalk->pPoint;
-				float fPointDist = vNormal.Dot( pPoint->ptPosition ) - fPlaneDist;
+				float fPointDist = pPoint->fPlaneDist;
 				if( fPointDist > fOnPlaneEpsilon )
 				{
 					pPoint->planarity = POINT_DEAD; //point is dead, bang bang
@@ -1319,10 +1525,10 @@ CPolyhedron *ClipLinkedGeometry( GeneratePolyhedronFromPlanes_UnorderedPolygonLL
 					//We'll be de-linking from the old point and generating a new one. We do this so other lines can still access the dead point's untouched data.
 					
 					//Generate a new point
-					GeneratePolyhedronFromPlanes_Point *pNewPoint = (GeneratePolyhedronFromPlanes_Point *)stackalloc( sizeof( GeneratePolyhedronFromPlanes_Point ) );
+					GeneratePolyhedronFromPlanes_Point *pNewPoint = (GeneratePolyhedronFromPlanes_Point *)context.Alloc( sizeof( GeneratePolyhedronFromPlanes_Point ) );
 					{
 						//add this point to the active list
-						pAllPoints->pPrev = (GeneratePolyhedronFromPlanes_UnorderedPointLL *)stackalloc( sizeof( GeneratePolyhedronFromPlanes_UnorderedPointLL ) );
+						pAllPoints->pPrev = (GeneratePolyhedronFromPlanes_UnorderedPointLL *)context.Alloc( sizeof( GeneratePolyhedronFromPlanes_UnorderedPointLL ) );
 						pAllPoints->pPrev->pNext = pAllPoints;
 						pAllPoints = pAllPoints->pPrev;
 						pAllPoints->pPrev = NULL;
@@ -1356,7 +1562,7 @@ CPolyhedron *ClipLinkedGeometry( GeneratePolyhedronFromPlanes_UnorderedPolygonLL
 						pNewPoint->fPlaneDist = 0.0f;
 					}
 					
-					GeneratePolyhedronFromPlanes_LineLL *pNewLineLink = pNewPoint->pConnectedLines = (GeneratePolyhedronFromPlanes_LineLL *)stackalloc( sizeof( GeneratePolyhedronFromPlanes_LineLL ) );
+					GeneratePolyhedronFromPlanes_LineLL *pNewLineLink = pNewPoint->pConnectedLines = (GeneratePolyhedronFromPlanes_LineLL *)context.Alloc( sizeof( GeneratePolyhedronFromPlanes_LineLL ) );
 					pNewLineLink->pLine = pWorkLine;
 					pNewLineLink->pNext = pNewLineLink;
 					pNewLineLink->pPrev = pNewLineLink;
@@ -1455,10 +1661,10 @@ CPolyhedron *ClipLinkedGeometry( GeneratePolyhedronFromPlanes_UnorderedPolygonLL
 			}
 
 			//create the new polygon
-			GeneratePolyhedronFromPlanes_Polygon *pNewPolygon = (GeneratePolyhedronFromPlanes_Polygon *)stackalloc( sizeof( GeneratePolyhedronFromPlanes_Polygon ) );
+			GeneratePolyhedronFromPlanes_Polygon *pNewPolygon = (GeneratePolyhedronFromPlanes_Polygon *)context.Alloc( sizeof( GeneratePolyhedronFromPlanes_Polygon ) );
 			{
 				//before we forget, add this polygon to the active list
-				pAllPolygons->pPrev = (GeneratePolyhedronFromPlanes_UnorderedPolygonLL *)stackalloc( sizeof( GeneratePolyhedronFromPlanes_UnorderedPolygonLL ) );
+				pAllPolygons->pPrev = (GeneratePolyhedronFromPlanes_UnorderedPolygonLL *)context.Alloc( sizeof( GeneratePolyhedronFromPlanes_UnorderedPolygonLL ) );
 				pAllPolygons->pPrev->pNext = pAllPolygons;
 				pAllPolygons = pAllPolygons->pPrev;
 				pAllPolygons->pPrev = NULL;
@@ -1504,10 +1710,10 @@ CPolyhedron *ClipLinkedGeometry( GeneratePolyhedronFromPlanes_UnorderedPolygonLL
 					}
 #endif
 
-					GeneratePolyhedronFromPlanes_Line *pJoinLine = (GeneratePolyhedronFromPlanes_Line *)stackalloc( sizeof( GeneratePolyhedronFromPlanes_Line ) );
+					GeneratePolyhedronFromPlanes_Line *pJoinLine = (GeneratePolyhedronFromPlanes_Line *)context.Alloc( sizeof( GeneratePolyhedronFromPlanes_Line ) );
 					{
 						//before we forget, add this line to the active list
-						pAllLines->pPrev = (GeneratePolyhedronFromPlanes_UnorderedLineLL *)stackalloc( sizeof( GeneratePolyhedronFromPlanes_UnorderedLineLL ) );
+						pAllLines->pPrev = (GeneratePolyhedronFromPlanes_UnorderedLineLL *)context.Alloc( sizeof( GeneratePolyhedronFromPlanes_UnorderedLineLL ) );
 						pAllLines->pPrev->pNext = pAllLines;
 						pAllLines = pAllLines->pPrev;
 						pAllLines->pPrev = NULL;
@@ -1526,12 +1732,12 @@ CPolyhedron *ClipLinkedGeometry( GeneratePolyhedronFromPlanes_UnorderedPolygonLL
 
 					//now create all 4 links into the line
 					GeneratePolyhedronFromPlanes_LineLL *pPointLinks[2];
-					pPointLinks[0] = (GeneratePolyhedronFromPlanes_LineLL *)stackalloc( sizeof( GeneratePolyhedronFromPlanes_LineLL ) );
-					pPointLinks[1] = (GeneratePolyhedronFromPlanes_LineLL *)stackalloc( sizeof( GeneratePolyhedronFromPlanes_LineLL ) );
+					pPointLinks[0] = (GeneratePolyhedronFromPlanes_LineLL *)context.Alloc( sizeof( GeneratePolyhedronFromPlanes_LineLL ) );
+					pPointLinks[1] = (GeneratePolyhedronFromPlanes_LineLL *)context.Alloc( sizeof( GeneratePolyhedronFromPlanes_LineLL ) );
 
 					GeneratePolyhedronFromPlanes_LineLL *pPolygonLinks[2];
-					pPolygonLinks[0] = (GeneratePolyhedronFromPlanes_LineLL *)stackalloc( sizeof( GeneratePolyhedronFromPlanes_LineLL ) );
-					pPolygonLinks[1] = (GeneratePolyhedronFromPlanes_LineLL *)stackalloc( sizeof( GeneratePolyhedronFromPlanes_LineLL ) );
+					pPolygonLinks[0] = (GeneratePolyhedronFromPlanes_LineLL *)context.Alloc( sizeof( GeneratePolyhedronFromPlanes_LineLL ) );
+					pPolygonLinks[1] = (GeneratePolyhedronFromPlanes_LineLL *)context.Alloc( sizeof( GeneratePolyhedronFromPlanes_LineLL ) );
 
 					pPointLinks[0]->pLine = pPointLinks[1]->pLine = pPolygonLinks[0]->pLine = pPolygonLinks[1]->pLine = pJoinLine;
 
@@ -1638,7 +1844,7 @@ CPolyhedron *ClipLinkedGeometry( GeneratePolyhedronFromPlanes_UnorderedPolygonLL
 					
 					//link to this line from the new polygon
 					GeneratePolyhedronFromPlanes_LineLL *pNewLineLink;
-					pNewLineLink = (GeneratePolyhedronFromPlanes_LineLL *)stackalloc( sizeof( GeneratePolyhedronFromPlanes_LineLL ) );
+					pNewLineLink = (GeneratePolyhedronFromPlanes_LineLL *)context.Alloc( sizeof( GeneratePolyhedronFromPlanes_LineLL ) );
 					
 					pNewLineLink->pLine = pTestLine->pLine;
 					pNewLineLink->iReferenceIndex = pTestLine->iReferenceIndex;
@@ -1711,7 +1917,7 @@ CPolyhedron *ClipLinkedGeometry( GeneratePolyhedronFromPlanes_UnorderedPolygonLL
 		}
 
 		//maintain the cut history
-		DebugCutHistory.AddToTail( ConvertLinkedGeometryToPolyhedron( pAllPolygons, pAllLines, pAllPoints, false ) );
+		DebugCutHistory.AddToTail( ConvertLinkedGeometryToPolyhedron( context, pAllPolygons, pAllLines, pAllPoints, POLYHEDRON_MEMORY_NEW ) );
 #endif
 	}
 
@@ -1724,7 +1930,7 @@ CPolyhedron *ClipLinkedGeometry( GeneratePolyhedronFromPlanes_UnorderedPolygonLL
 	DebugCutHistory.RemoveAll();
 #endif
 
-	return ConvertLinkedGeometryToPolyhedron( pAllPolygons, pAllLines, pAllPoints, bUseTemporaryMemory );
+	return ConvertLinkedGeometryToPolyhedron( context, pAllPolygons, pAllLines, pAllPoints, memory );
 }
 
 
@@ -1777,13 +1983,13 @@ CPolyhedron *ClipLinkedGeometry( GeneratePolyhedronFromPlanes_UnorderedPolygonLL
 	StartingPolygon_To_Lines_Links[(polynum * 4) + 3].pNext = &StartingPolygon_To_Lines_Links[(polynum * 4) + 0];
 
 
-CPolyhedron *GeneratePolyhedronFromPlanes( const float *pOutwardFacingPlanes, int iPlaneCount, float fOnPlaneEpsilon, bool bUseTemporaryMemory )
+static CPolyhedron *GeneratePolyhedronFromPlanes_Internal( CPolyhedronClipContext &context, const float *pOutwardFacingPlanes, int iPlaneCount, float fOnPlaneEpsilon, PolyhedronMemory_t memory )
 {
 	//this is version 2 of the polyhedron generator, version 1 made individual polygons and joined points together, some guesswork is involved and it therefore isn't a solid method
 	//this version will start with a cube and hack away at it (retaining point connection information) to produce a polyhedron with no guesswork involved, this method should be rock solid
 	
 	//the polygon clipping functions we're going to use want inward facing planes
-	float *pFlippedPlanes = (float *)stackalloc( (iPlaneCount * 4) * sizeof( float ) );
+	float *pFlippedPlanes = (float *)context.Alloc( (iPlaneCount * 4) * sizeof( float ) );
 	for( int i = 0; i != iPlaneCount * 4; ++i )
 	{
 		pFlippedPlanes[i] = -pOutwardFacingPlanes[i];
@@ -2004,9 +2210,195 @@ CPolyhedron *GeneratePolyhedronFromPlanes( const float *pOutwardFacingPlanes, in
 		}
 	}
 
-	return ClipLinkedGeometry( StartingPolygonList, StartingLineList, StartingPointList, pOutwardFacingPlanes, iPlaneCount, fOnPlaneEpsilon, bUseTemporaryMemory );
+	return ClipLinkedGeometry( context, StartingPolygonList, StartingLineList, StartingPointList, pOutwardFacingPlanes, iPlaneCount, fOnPlaneEpsilon, memory );
+}
+
+CPolyhedron *GeneratePolyhedronFromPlanes( const float *pOutwardFacingPlanes, int iPlaneCount, float fOnPlaneEpsilon, bool bUseTemporaryMemory )
+{
+	void *pStackBuffer = stackalloc( POLYHEDRON_STACK_CONTEXT_SIZE );
+	CPolyhedronClipContext context( pStackBuffer, POLYHEDRON_STACK_CONTEXT_SIZE );
+	return GeneratePolyhedronFromPlanes_Internal( context, pOutwardFacingPlanes, iPlaneCount, fOnPlaneEpsilon, bUseTemporaryMemory ? POLYHEDRON_MEMORY_TEMP : POLYHEDRON_MEMORY_NEW );
+}
+
+CPolyhedron *GeneratePolyhedronFromPlanes( CPolyhedronClipContext *pContext, const float *pOutwardFacingPlanes, int iPlaneCount, float fOnPlaneEpsilon, bool bUseContextMemory )
+{
+	pContext->Reset();
+	return GeneratePolyhedronFromPlanes_Internal( *pContext, pOutwardFacingPlanes, iPlaneCount, fOnPlaneEpsilon, bUseContextMemory ? POLYHEDRON_MEMORY_CONTEXT : POLYHEDRON_MEMORY_NEW );
+}
+
+
+
+#if defined( FASTPATH_TESTS )
+
+#define POLYHEDRON_TEST_MAX_SHAPE_PLANES 16
+#define POLYHEDRON_TEST_MAX_CLIP_PLANES 6
+#define POLYHEDRON_TEST_EPSILON 0.01f
+
+struct PolyhedronClipTest_t
+{
+	float fShapePlanes[POLYHEDRON_TEST_MAX_SHAPE_PLANES * 4];
+	float fClipPlanes[POLYHEDRON_TEST_MAX_CLIP_PLANES * 4];
+	int iShapePlaneCount;
+	int iClipPlaneCount;
+};
+
+static float PolyhedronTest_Random( unsigned int &iSeed, float fMin, float fMax )
+{
+	iSeed = iSeed * 1664525 + 1013904223;
+	return fMin + (fMax - fMin) * ((float)(iSeed >> 8) * (1.0f / 16777216.0f));
+}
+
+static void PolyhedronTest_RandomPlane( unsigned int &iSeed, float *pPlane, float fMinDist, float fMaxDist )
+{
+	Vector vNormal;
+	do
+	{
+		vNormal.Init( PolyhedronTest_Random( iSeed, -1.0f, 1.0f ), PolyhedronTest_Random( iSeed, -1.0f, 1.0f ), PolyhedronTest_Random( iSeed, -1.0f, 1.0f ) );
+	} while( vNormal.LengthSqr() < 0.01f );
+	vNormal.NormalizeInPlace();
+
+	pPlane[0] = vNormal.x;
+	pPlane[1] = vNormal.y;
+	pPlane[2] = vNormal.z;
+	pPlane[3] = PolyhedronTest_Random( iSeed, fMinDist, fMaxDist );
+}
+
+//random convex shapes around the origin, and planes that miss, cut or remove them
+static void PolyhedronTest_BuildTests( PolyhedronClipTest_t *pTests, int iCount )
+{
+	unsigned int iSeed = 0x5eed1234;
+	for( int i = 0; i != iCount; ++i )
+	{
+		PolyhedronClipTest_t &test = pTests[i];
+		test.iShapePlaneCount = 4 + (int)PolyhedronTest_Random( iSeed, 0.0f, POLYHEDRON_TEST_MAX_SHAPE_PLANES - 4 );
+		for( int j = 0; j != test.iShapePlaneCount; ++j )
+			PolyhedronTest_RandomPlane( iSeed, &test.fShapePlanes[j * 4], 8.0f, 16.0f );
+
+		test.iClipPlaneCount = 1 + (int)PolyhedronTest_Random( iSeed, 0.0f, POLYHEDRON_TEST_MAX_CLIP_PLANES - 1 );
+		for( int j = 0; j != test.iClipPlaneCount; ++j )
+			PolyhedronTest_RandomPlane( iSeed, &test.fClipPlanes[j * 4], -6.0f, 20.0f );
+	}
+}
+
+static bool PolyhedronTest_Match( const CPolyhedron *pA, const CPolyhedron *pB )
+{
+	if( (pA == NULL) || (pB == NULL) )
+		return pA == pB;
+
+	if( (pA->iVertexCount != pB->iVertexCount) || (pA->iLineCount != pB->iLineCount) || (pA->iIndexCount != pB->iIndexCount) || (pA->iPolygonCount != pB->iPolygonCount) )
+		return false;
+
+	if( (memcmp( pA->pVertices, pB->pVertices, sizeof( Vector ) * pA->iVertexCount ) != 0) ||
+		(memcmp( pA->pLines, pB->pLines, sizeof( Polyhedron_IndexedLine_t ) * pA->iLineCount ) != 0) )
+		return false;
+
+	//these two have padding, compare by member
+	for( int i = 0; i != pA->iIndexCount; ++i )
+	{
+		if( (pA->pIndices[i].iLineIndex != pB->pIndices[i].iLineIndex) || (pA->pIndices[i].iEndPointIndex != pB->pIndices[i].iEndPointIndex) )
+			return false;
+	}
+
+	for( int i = 0; i != pA->iPolygonCount; ++i )
+	{
+		if( (pA->pPolygons[i].iFirstIndex != pB->pPolygons[i].iFirstIndex) || (pA->pPolygons[i].iIndexCount != pB->pPolygons[i].iIndexCount) ||
+			(memcmp( &pA->pPolygons[i].polyNormal, &pB->pPolygons[i].polyNormal, sizeof( Vector ) ) != 0) )
+			return false;
+	}
+
+	return true;
+}
+
+static bool PolyhedronTest_Inside( const CPolyhedron *pPolyhedron, const float *pPlanes, int iPlaneCount )
+{
+	if( pPolyhedron == NULL )
+		return true;
+
+	for( int i = 0; i != pPolyhedron->iVertexCount; ++i )
+	{
+		for( int j = 0; j != iPlaneCount; ++j )
+		{
+			if( pPolyhedron->pVertices[i].Dot( *(Vector *)&pPlanes[j * 4] ) - pPlanes[(j * 4) + 3] > 0.1f )
+				return false;
+		}
+	}
+	return true;
+}
+
+bool Polyhedron_ClipValidate( int iIterations )
+{
+	PolyhedronClipTest_t *pTests = new PolyhedronClipTest_t [ iIterations ];
+	PolyhedronTest_BuildTests( pTests, iIterations );
+
+	CPolyhedronClipContext context;
+	int iMismatches = 0, iOutside = 0, iEmpty = 0;
+	for( int i = 0; i != iIterations; ++i )
+	{
+		const PolyhedronClipTest_t &test = pTests[i];
+
+		//the context clips its own result in place, the other path copies between allocations
+		CPolyhedron *pShape = GeneratePolyhedronFromPlanes( test.fShapePlanes, test.iShapePlaneCount, POLYHEDRON_TEST_EPSILON );
+		CPolyhedron *pContextShape = GeneratePolyhedronFromPlanes( &context, test.fShapePlanes, test.iShapePlaneCount, POLYHEDRON_TEST_EPSILON );
+		if( !PolyhedronTest_Match( pShape, pContextShape ) || !PolyhedronTest_Inside( pShape, test.fShapePlanes, test.iShapePlaneCount ) )
+			++iMismatches;
+
+		CPolyhedron *pClipped = ClipPolyhedron( pShape, test.fClipPlanes, test.iClipPlaneCount, POLYHEDRON_TEST_EPSILON );
+		CPolyhedron *pContextClipped = ClipPolyhedron( &context, pContextShape, test.fClipPlanes, test.iClipPlaneCount, POLYHEDRON_TEST_EPSILON );
+		if( !PolyhedronTest_Match( pClipped, pContextClipped ) )
+			++iMismatches;
+		if( !PolyhedronTest_Inside( pClipped, test.fClipPlanes, test.iClipPlaneCount ) )
+			++iOutside;
+		if( pClipped == NULL )
+			++iEmpty;
+
+		if( pShape )
+			pShape->Release();
+		if( pClipped )
+			pClipped->Release();
+	}
+
+	delete [] pTests;
+
+	Msg( "Polyhedron_ClipValidate: %d clips, %d empty, %d mismatches, %d outside their planes\n", iIterations, iEmpty, iMismatches, iOutside );
+	return (iMismatches == 0) && (iOutside == 0);
+}
+
+void Polyhedron_ClipBenchmark( int iIterations )
+{
+	PolyhedronClipTest_t *pTests = new PolyhedronClipTest_t [ iIterations ];
+	PolyhedronTest_BuildTests( pTests, iIterations );
+
+	double fStart = Plat_FloatTime();
+	for( int i = 0; i != iIterations; ++i )
+	{
+		const PolyhedronClipTest_t &test = pTests[i];
+		CPolyhedron *pShape = GeneratePolyhedronFromPlanes( test.fShapePlanes, test.iShapePlaneCount, POLYHEDRON_TEST_EPSILON );
+		CPolyhedron *pClipped = ClipPolyhedron( pShape, test.fClipPlanes, test.iClipPlaneCount, POLYHEDRON_TEST_EPSILON, true );
+		if( pShape )
+			pShape->Release();
+		if( pClipped )
+			pClipped->Release();
+	}
+	double fLegacy = Plat_FloatTime() - fStart;
+
+	CPolyhedronClipContext context;
+	fStart = Plat_FloatTime();
+	for( int i = 0; i != iIterations; ++i )
+	{
+		const PolyhedronClipTest_t &test = pTests[i];
+		CPolyhedron *pShape = GeneratePolyhedronFromPlanes( &context, test.fShapePlanes, test.iShapePlaneCount, POLYHEDRON_TEST_EPSILON );
+		ClipPolyhedron( &context, pShape, test.fClipPlanes, test.iClipPlaneCount, POLYHEDRON_TEST_EPSILON );
+	}
+	double fContext = Plat_FloatTime() - fStart;
+
+	delete [] pTests;
+
+	Msg( "Polyhedron_ClipBenchmark: %d generate + clip, entry points %.2f ms, context %.2f ms (%.2fx)\n",
+		iIterations, fLegacy * 1000.0, fContext * 1000.0, (fContext > 0.0) ? (fLegacy / fContext) : 0.0 );
 }
 
+#endif // FASTPATH_TESTS
+
 
 
 
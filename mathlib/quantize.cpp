@@ -22,109 +22,236 @@
 #include <math.h>
 
 #include "tier0/basetypes.h"
+#include "tier0/dbg.h"
+#include "tier1/utlvector.h"
+#include "vstdlib/jobthread.h"
 
-static int current_ndims;
-static struct QuantizedValue *current_root;
-static int current_ssize;
+#if ( defined( _M_IX86 ) || defined( _M_X64 ) || defined( __i386__ ) || defined( __x86_64__ ) ) && !defined( _X360 )
+#define QUANTIZE_SSE2
+#include <emmintrin.h>
+#endif
 
-static uint8 *current_weights;
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
 
 double SquaredError;
 
-#define SPLIT_THEN_SORT 1
-
 #define SQ(x) ((x)*(x))
 
-static struct QuantizedValue *AllocQValue(void)
-{
-	struct QuantizedValue *ret=new QuantizedValue;
-	ret->Samples=0;
-	ret->Children[0]=ret->Children[1]=0;
-	ret->NSamples=0;
-  
-	ret->ErrorMeasure=new double[current_ndims];
-	ret->Mean=new uint8[current_ndims];
-	ret->Mins=new uint8[current_ndims];
-	ret->Maxs=new uint8[current_ndims];
-	ret->Sums=new int [current_ndims];
-	memset(ret->Sums,0,sizeof(int)*current_ndims);
-	ret->NQuant=0;
-	ret->sortdim=-1;
-	return ret;
-}
+#define QUANTIZE_NODES_PER_BLOCK		256
+#define QUANTIZE_HISTOGRAM_MAX_DIMS		8		// UpdateStats() keeps a 256 entry histogram per dimension on the stack up to this many dimensions
+#define QUANTIZE_HISTOGRAM_MIN_SAMPLES	512		// below this, two passes over the samples are cheaper than clearing the histograms
+#define QUANTIZE_PARALLEL_MIN_SAMPLES	8192	// a batch of splits over fewer samples than this isn't worth handing to the pool
 
-void FreeQuantization(struct QuantizedValue *t)
+struct QuantizeTreeBlock_t
 {
-	if (t)
+	QuantizeTreeBlock_t *m_pNext;
+	double m_flAlign;
+};
+
+// Every QuantizedValue Quantize() hands out is the front of one of these
+struct QuantizeNode_t
+{
+	QuantizedValue		m_Value;			// must be first
+	QuantizeNode_t		*m_pParent;
+	int					m_iChild;			// which child of m_pParent this is
+	int					m_nDepth;
+	int					m_nDims;
+	const uint8			*m_pWeights;
+	QuantizeTreeBlock_t	*m_pBlocks;			// root only, every node of the tree lives in these
+
+	// A split worked out ahead of time. m_pSplit[] become the children once this node is picked.
+	QuantizeNode_t		*m_pSplit[2];
+	int					m_nSplitFirst;		// samples that go to m_pSplit[0]
+	bool				m_bSplitReady;
+};
+
+// Everything one Quantize() call works with, so calls don't share state
+struct QuantizeState_t
+{
+	int					m_nDims;
+	int					m_nSampleSize;
+	const uint8			*m_pWeights;
+	const double		*m_pflWeights;
+	struct Sample		*m_pSamples;		// the whole sample set
+	uint8				*m_pScratch;		// as large as the sample set; a split partitions its samples into the matching range here
+
+	QuantizeTreeBlock_t	*m_pBlocks;
+	uint8				*m_pBlockPos;
+	uint8				*m_pBlockEnd;
+};
+
+struct QuantizeSplitJob_t
+{
+	const QuantizeState_t	*m_pState;
+	QuantizeNode_t			*m_pNode;
+};
+
+struct QuantizeContextData_t
+{
+	IThreadPool								*m_pThreadPool;
+	int										m_nMaxParallelSplits;
+	CUtlVector< uint8 >						m_Scratch;
+	CUtlVector< double >					m_flWeights;
+	CUtlVector< QuantizeNode_t * >			m_Leaves;		// binary heap, the leaf FindWorst() used to pick first
+	CUtlVector< QuantizeNode_t * >			m_Candidates;
+	CUtlVector< QuantizeSplitJob_t >		m_Jobs;
+};
+
+CQuantizeContext::CQuantizeContext( IThreadPool *pThreadPool, int nMaxParallelSplits )
+{
+	m_pData = new QuantizeContextData_t;
+	m_pData->m_pThreadPool = pThreadPool;
+	if ( nMaxParallelSplits <= 0 )
 	{
-		delete[] t->ErrorMeasure;
-		delete[] t->Mean;
-		delete[] t->Mins;
-		delete[] t->Maxs;
-		FreeQuantization(t->Children[0]);
-		FreeQuantization(t->Children[1]);
-		delete[] t->Sums;
-		delete[] t;
+		nMaxParallelSplits = pThreadPool ? pThreadPool->NumThreads() + 1 : 1;
 	}
+	m_pData->m_nMaxParallelSplits = nMaxParallelSplits;
 }
 
-static int QNumSort(void const *a, void const *b)
+CQuantizeContext::~CQuantizeContext()
 {
-	int32 as=((struct Sample *) a)->QNum;
-	int32 bs=((struct Sample *) b)->QNum;
-	if (as==bs) return 0;
-	return (as>bs)?1:-1;
+	delete m_pData;
 }
 
-#if SPLIT_THEN_SORT
-#else
-static int current_sort_dim;
-
-static int samplesort(void const *a, void const *b)
+static void InitState( QuantizeState_t &state, int ndims, const uint8 *weights )
 {
-	uint8 as=((struct Sample *) a)->Value[current_sort_dim];
-	uint8 bs=((struct Sample *) b)->Value[current_sort_dim];
-	if (as==bs) return 0;
-	return (as>bs)?1:-1;
+	memset( &state, 0, sizeof( state ) );
+	state.m_nDims = ndims;
+	state.m_nSampleSize = sizeof( struct Sample ) + ( ndims - 1 );
+	state.m_pWeights = weights;
 }
-#endif
 
-static int sortlong(void const *a, void const *b)
+static void InitState( QuantizeState_t &state, struct QuantizedValue const *q )
 {
-	// treat the entire vector of values as a long integer for duplicate removal.
-	return memcmp(((struct Sample *) a)->Value,
-				  ((struct Sample *) b)->Value,current_ndims);
+	const QuantizeNode_t *pNode = (const QuantizeNode_t *)q;
+	InitState( state, pNode->m_nDims, pNode->m_pWeights );
 }
 
+static QuantizeNode_t *AllocQValue( QuantizeState_t &state, QuantizeNode_t *pParent, int iChild )
+{
+	int nDims = state.m_nDims;
+	int nSize = ( sizeof( QuantizeNode_t ) + nDims * ( sizeof( double ) + sizeof( int ) + 3 * sizeof( uint8 ) ) + 7 ) & ~7;
+	if ( state.m_pBlockPos + nSize > state.m_pBlockEnd )
+	{
+		int nBlockSize = sizeof( QuantizeTreeBlock_t ) + nSize * QUANTIZE_NODES_PER_BLOCK;
+		QuantizeTreeBlock_t *pBlock = (QuantizeTreeBlock_t *)new uint8[nBlockSize];
+		pBlock->m_pNext = state.m_pBlocks;
+		state.m_pBlocks = pBlock;
+		state.m_pBlockPos = (uint8 *)( pBlock + 1 );
+		state.m_pBlockEnd = (uint8 *)pBlock + nBlockSize;
+	}
+
+	QuantizeNode_t *pNode = (QuantizeNode_t *)state.m_pBlockPos;
+	state.m_pBlockPos += nSize;
+	memset( pNode, 0, nSize );
 
-  
-#define NEXTSAMPLE(s) ( (struct Sample *) (((uint8 *) s)+current_ssize))
-#define SAMPLE(s,i) NthSample(s,i,current_ndims)
+	struct QuantizedValue *ret=&pNode->m_Value;
+	ret->ErrorMeasure=(double *)( pNode + 1 );
+	ret->Sums=(int *)( ret->ErrorMeasure + nDims );
+	ret->Mean=(uint8 *)( ret->Sums + nDims );
+	ret->Mins=ret->Mean + nDims;
+	ret->Maxs=ret->Mins + nDims;
+	ret->sortdim=-1;
 
-static void SetNDims(int n)
+	pNode->m_pParent = pParent;
+	pNode->m_iChild = iChild;
+	pNode->m_nDepth = pParent ? pParent->m_nDepth + 1 : 0;
+	pNode->m_nDims = nDims;
+	pNode->m_pWeights = state.m_pWeights;
+	return pNode;
+}
+
+void FreeQuantization(struct QuantizedValue *t)
 {
-	current_ssize=sizeof(struct Sample)+(n-1);
-	current_ndims=n;
+	if (t)
+	{
+		QuantizeNode_t *pRoot = (QuantizeNode_t *)t;
+		AssertMsg( pRoot->m_pParent == NULL, "FreeQuantization() frees whole trees only" );
+
+		QuantizeTreeBlock_t *pBlock = pRoot->m_pBlocks;
+		while ( pBlock )
+		{
+			QuantizeTreeBlock_t *pNext = pBlock->m_pNext;
+			delete[] (uint8 *)pBlock;
+			pBlock = pNext;
+		}
+	}
 }
 
+#define NEXTSAMPLE(s) ( (struct Sample *) (((uint8 *) s)+nSampleSize))
+
 int CompressSamples(struct Sample *s, int nsamples, int ndims)
 {
-	SetNDims(ndims);
-	qsort(s,nsamples,current_ssize,sortlong);
+	if ( nsamples <= 0 )
+		return 0;
+
+	int nSampleSize=sizeof(struct Sample)+(ndims-1);
+
+	// Radix sort the sample order, last byte of the values first, which ends
+	// up in memcmp() order. It's stable, so the first of a run of duplicates
+	// is the one that stays.
+	int *pOrder = new int[nsamples];
+	int *pNextOrder = new int[nsamples];
+	for ( int i = 0; i < nsamples; i++ )
+	{
+		pOrder[i] = i;
+	}
+
+	for ( int d = ndims - 1; d >= 0; d-- )
+	{
+		int nCounts[256];
+		memset( nCounts, 0, sizeof( nCounts ) );
+		for ( int i = 0; i < nsamples; i++ )
+		{
+			nCounts[NthSample( s, i, ndims )->Value[d]]++;
+		}
+
+		if ( nCounts[NthSample( s, 0, ndims )->Value[d]] == nsamples )
+			continue;	// every sample has the same value here
+
+		int nOffset = 0;
+		for ( int v = 0; v < 256; v++ )
+		{
+			int nCount = nCounts[v];
+			nCounts[v] = nOffset;
+			nOffset += nCount;
+		}
+
+		for ( int i = 0; i < nsamples; i++ )
+		{
+			int iSample = pOrder[i];
+			pNextOrder[nCounts[NthSample( s, iSample, ndims )->Value[d]]++] = iSample;
+		}
+
+		int *pSwap = pOrder;
+		pOrder = pNextOrder;
+		pNextOrder = pSwap;
+	}
+
+	uint8 *pSorted = new uint8[nsamples * nSampleSize];
+	for ( int i = 0; i < nsamples; i++ )
+	{
+		memcpy( pSorted + i * nSampleSize, NthSample( s, pOrder[i], ndims ), nSampleSize );
+	}
+	delete[] pOrder;
+	delete[] pNextOrder;
+
 	// now, they are all sorted by treating all dimensions as a large number.
 	// we may now remove duplicates.
-	struct Sample *src=s;
+	struct Sample *src=(struct Sample *)pSorted;
 	struct Sample *dst=s;
+	memcpy(dst,src,nSampleSize);
 	struct Sample *lastdst=dst;
 	dst=NEXTSAMPLE(dst);		// copy first sample to get the ball rolling
 	src=NEXTSAMPLE(src);
 	int noutput=1;
 	while(--nsamples)		// while some remain
 	{
-		if (memcmp(src->Value,lastdst->Value,current_ndims))
+		if (memcmp(src->Value,lastdst->Value,ndims))
 		{
 			// yikes, a difference has been found!
-			memcpy(dst,src,current_ssize);
+			memcpy(dst,src,nSampleSize);
 			lastdst=dst;
 			dst=NEXTSAMPLE(dst);
 			noutput++;
@@ -133,12 +260,14 @@ int CompressSamples(struct Sample *s, int nsamples, int ndims)
 			lastdst->Count++;
 		src=NEXTSAMPLE(src);
 	}
+
+	delete[] pSorted;
 	return noutput;
 }
 
 void PrintSamples(struct Sample const *s, int nsamples, int ndims)
 {
-	SetNDims(ndims);
+	int nSampleSize=sizeof(struct Sample)+(ndims-1);
 	int cnt=0;
 	while(nsamples--)
 	{
@@ -156,25 +285,26 @@ void PrintQTree(struct QuantizedValue const *p,int idlevel)
 
 	if (p)
 	{
+		int ndims=((QuantizeNode_t const *)p)->m_nDims;
 		for(i=0;i<idlevel;i++)
 			printf(" ");
 		printf("node=%p NSamples=%d value=%d Mean={",p,p->NSamples,p->value);
-		for(i=0;i<current_ndims;i++)
+		for(i=0;i<ndims;i++)
 			printf("%x,",p->Mean[i]);
 		printf("}\n");
 		for(i=0;i<idlevel;i++)
 			printf(" ");
 		printf("Errors={");
-		for(i=0;i<current_ndims;i++)
+		for(i=0;i<ndims;i++)
 			printf("%f,",p->ErrorMeasure[i]);
 		printf("}\n");
 		for(i=0;i<idlevel;i++)
 			printf(" ");
 		printf("Mins={");
-		for(i=0;i<current_ndims;i++)
+		for(i=0;i<ndims;i++)
 			printf("%d,",p->Mins[i]);
 		printf("} Maxs={");
-		for(i=0;i<current_ndims;i++)
+		for(i=0;i<ndims;i++)
 			printf("%d,",p->Maxs[i]);
 		printf("}\n");
 		PrintQTree(p->Children[0],idlevel+2);
@@ -182,36 +312,48 @@ void PrintQTree(struct QuantizedValue const *p,int idlevel)
 	}
 }
 
-static void UpdateStats(struct QuantizedValue *v)
+//-----------------------------------------------------------------------------
+// Mean and error of the samples of a node, read from pSamples (the node's own
+// samples or the scratch copy of them). Every sum is of integers, so the order
+// samples are visited in doesn't change a bit of the result.
+//-----------------------------------------------------------------------------
+static int AccumulateStatsDirect( const QuantizeState_t &state, struct QuantizedValue *v, struct Sample *pSamples, double *Errors, double *WorstError )
 {
-	// first, find mean
+	int ndims=state.m_nDims;
+	int nSampleSize=state.m_nSampleSize;
 	int32 Means[MAXDIMS];
-	double Errors[MAXDIMS];
-	double WorstError[MAXDIMS];
 	int i,j;
-  
-	memset(Means,0,sizeof(Means));
+
+	memset(Means,0,sizeof(int32)*ndims);
 	int N=0;
-	for(i=0;i<v->NSamples;i++)
+	struct Sample *s=pSamples;
+	for(i=0;i<v->NSamples;i++,s=NEXTSAMPLE(s))
 	{
-		struct Sample *s=SAMPLE(v->Samples,i);
 		N+=s->Count;
-		for(j=0;j<current_ndims;j++)
-		{
-			uint8 v=s->Value[j];
-			Means[j]+=v*s->Count;
-		}
+		for(j=0;j<ndims;j++)
+			Means[j]+=s->Value[j]*s->Count;
 	}
-	for(j=0;j<current_ndims;j++)
+	for(j=0;j<ndims;j++)
 	{
 		if (N) v->Mean[j]=(uint8) (Means[j]/N);
 		Errors[j]=WorstError[j]=0.;
 	}
-	for(i=0;i<v->NSamples;i++)
+
+	s=pSamples;
+	for(i=0;i<v->NSamples;i++,s=NEXTSAMPLE(s))
 	{
-		struct Sample *s=SAMPLE(v->Samples,i);
 		double c=s->Count;
-		for(j=0;j<current_ndims;j++)
+		j=0;
+#ifdef QUANTIZE_SSE2
+		__m128d c2=_mm_set1_pd(c);
+		for(;j+1<ndims;j+=2)
+		{
+			__m128d diff=_mm_cvtepi32_pd(_mm_setr_epi32(SQ(s->Value[j]-v->Mean[j]),SQ(s->Value[j+1]-v->Mean[j+1]),0,0));
+			_mm_store_pd(&Errors[j],_mm_add_pd(_mm_load_pd(&Errors[j]),_mm_mul_pd(c2,diff)));
+			_mm_store_pd(&WorstError[j],_mm_max_pd(diff,_mm_load_pd(&WorstError[j])));
+		}
+#endif
+		for(;j<ndims;j++)
 		{
 			double diff=SQ(s->Value[j]-v->Mean[j]);
 			Errors[j]+=c*diff; // charles uses abs not sq()
@@ -219,94 +361,194 @@ static void UpdateStats(struct QuantizedValue *v)
 				WorstError[j]=diff;
 		}
 	}
+	return N;
+}
+
+// Same result for big nodes from one pass over the samples
+static int AccumulateStatsHistogram( const QuantizeState_t &state, struct QuantizedValue *v, struct Sample *pSamples, double *Errors, double *WorstError )
+{
+	int ndims=state.m_nDims;
+	int nSampleSize=state.m_nSampleSize;
+	int32 nCounts[QUANTIZE_HISTOGRAM_MAX_DIMS][256];
+	uint8 bSeen[QUANTIZE_HISTOGRAM_MAX_DIMS][256];		// samples with a Count of 0 still count for WorstError
+	int i,j;
+
+	memset(nCounts,0,sizeof(nCounts[0])*ndims);
+	memset(bSeen,0,sizeof(bSeen[0])*ndims);
+	int N=0;
+	struct Sample *s=pSamples;
+	for(i=0;i<v->NSamples;i++,s=NEXTSAMPLE(s))
+	{
+		N+=s->Count;
+		for(j=0;j<ndims;j++)
+		{
+			nCounts[j][s->Value[j]]+=s->Count;
+			bSeen[j][s->Value[j]]=1;
+		}
+	}
+
+	for(j=0;j<ndims;j++)
+	{
+		int32 Mean=0;
+		for(int val=0;val<256;val++)
+			Mean+=val*nCounts[j][val];
+		if (N) v->Mean[j]=(uint8) (Mean/N);
+
+		Errors[j]=WorstError[j]=0.;
+		for(int val=0;val<256;val++)
+		{
+			if (!bSeen[j][val])
+				continue;
+			double diff=SQ(val-v->Mean[j]);
+			Errors[j]+=nCounts[j][val]*diff;
+			if (diff>WorstError[j])
+				WorstError[j]=diff;
+		}
+	}
+	return N;
+}
+
+static void UpdateStats( const QuantizeState_t &state, struct QuantizedValue *v, struct Sample *pSamples )
+{
+	int ndims=state.m_nDims;
+	ALIGN16 double Errors[MAXDIMS] ALIGN16_POST;
+	ALIGN16 double WorstError[MAXDIMS] ALIGN16_POST;
+	int N;
+	if ( ( v->NSamples >= QUANTIZE_HISTOGRAM_MIN_SAMPLES ) && ( ndims <= QUANTIZE_HISTOGRAM_MAX_DIMS ) )
+		N=AccumulateStatsHistogram( state, v, pSamples, Errors, WorstError );
+	else
+		N=AccumulateStatsDirect( state, v, pSamples, Errors, WorstError );
+
 	v->TotalError=0.;
 	double ErrorScale=1.; // /sqrt((double) (N));
-	for(j=0;j<current_ndims;j++)
+	for(int j=0;j<ndims;j++)
 	{
-		v->ErrorMeasure[j]=(ErrorScale*Errors[j]*current_weights[j]);
+		v->ErrorMeasure[j]=(ErrorScale*Errors[j]*state.m_pWeights[j]);
 		v->TotalError+=v->ErrorMeasure[j];
-#if SPLIT_THEN_SORT
 		v->ErrorMeasure[j]*=WorstError[j];
-#endif
 	}
 	v->TotSamples=N;
 }
 
-static int ErrorDim;
-static double ErrorVal;
-static struct QuantizedValue *ErrorNode;
-
-static void UpdateWorst(struct QuantizedValue *q)
+//-----------------------------------------------------------------------------
+// Leaves waiting to be split, worst first. Ties go to the leaf further left in
+// the tree, which is the one the old depth first FindWorst() found first.
+//-----------------------------------------------------------------------------
+static bool IsLeftOf( const QuantizeNode_t *pA, const QuantizeNode_t *pB )
 {
-	if (q->Children[0])
+	// neither leaf contains the other, so they part below a common ancestor
+	while ( pA->m_nDepth > pB->m_nDepth )
+		pA = pA->m_pParent;
+	while ( pB->m_nDepth > pA->m_nDepth )
+		pB = pB->m_pParent;
+	while ( pA->m_pParent != pB->m_pParent )
 	{
-		// not a leaf node
-		UpdateWorst(q->Children[0]);
-		UpdateWorst(q->Children[1]);
+		pA = pA->m_pParent;
+		pB = pB->m_pParent;
 	}
-	else
+	return pA->m_iChild < pB->m_iChild;
+}
+
+static inline bool IsWorse( const QuantizeNode_t *pA, const QuantizeNode_t *pB )
+{
+	if ( pA->m_Value.TotalError != pB->m_Value.TotalError )
+		return pA->m_Value.TotalError > pB->m_Value.TotalError;
+	return IsLeftOf( pA, pB );
+}
+
+static void PushLeaf( CUtlVector< QuantizeNode_t * > &leaves, QuantizeNode_t *pLeaf )
+{
+	int i = leaves.AddToTail( pLeaf );
+	while ( i > 0 )
 	{
-		if (q->TotalError>ErrorVal)
-		{
-			ErrorVal=q->TotalError;
-			ErrorNode=q;
-			ErrorDim=0;
-			for(int d=0;d<current_ndims;d++)
-				if (q->ErrorMeasure[d]>q->ErrorMeasure[ErrorDim])
-					ErrorDim=d;
-		}
+		int iParent = ( i - 1 ) >> 1;
+		if ( !IsWorse( pLeaf, leaves[iParent] ) )
+			break;
+		leaves[i] = leaves[iParent];
+		i = iParent;
 	}
+	leaves[i] = pLeaf;
 }
 
-static int FindWorst(void)
+static void PopWorstLeaf( CUtlVector< QuantizeNode_t * > &leaves )
 {
-	ErrorVal=-1.;
-	UpdateWorst(current_root);
-	return (ErrorVal>0);
-}
+	QuantizeNode_t *pLast = leaves.Tail();
+	leaves.RemoveMultipleFromTail( 1 );
+	int nCount = leaves.Count();
+	if ( !nCount )
+		return;
 
+	int i = 0;
+	for ( ;; )
+	{
+		int iChild = ( i << 1 ) + 1;
+		if ( iChild >= nCount )
+			break;
+		if ( ( iChild + 1 < nCount ) && IsWorse( leaves[iChild + 1], leaves[iChild] ) )
+			iChild++;
+		if ( !IsWorse( leaves[iChild], pLast ) )
+			break;
+		leaves[i] = leaves[iChild];
+		i = iChild;
+	}
+	leaves[i] = pLast;
+}
 
+static int WorstDim( const QuantizeState_t &state, struct QuantizedValue const *q )
+{
+	int ErrorDim=0;
+	for(int d=0;d<state.m_nDims;d++)
+		if (q->ErrorMeasure[d]>q->ErrorMeasure[ErrorDim])
+			ErrorDim=d;
+	return ErrorDim;
+}
 
-static void SubdivideNode(struct QuantizedValue *n, int whichdim)
+//-----------------------------------------------------------------------------
+// Works out how a leaf splits: the labels, the stable partition of its samples
+// into the scratch range and the stats of both halves. Only touches the leaf,
+// its samples and the two nodes in m_pSplit, so leaves can split in parallel.
+//-----------------------------------------------------------------------------
+static void PrepareSplit( const QuantizeState_t &state, QuantizeNode_t *pNode )
 {
-	int NAdded=0;
+	struct QuantizedValue *n=&pNode->m_Value;
+	int ndims=state.m_nDims;
+	int nSampleSize=state.m_nSampleSize;
+	int whichdim=WorstDim( state, n );
 	int i;
 
-#if SPLIT_THEN_SORT
 	// we will try the "split then sort" method. This works by finding the
 	// means for all samples above and below the mean along the given axis.
 	// samples are then split into two groups, with the selection based upon
 	// which of the n-dimensional means the sample is closest to.
-	double LocalMean[MAXDIMS][2];
+	ALIGN16 double LocalMean[MAXDIMS][2] ALIGN16_POST;
+	int64 LocalSum[MAXDIMS][2];		// exact, so the means match summing straight into doubles
 	int totsamps[2];
-	for(i=0;i<current_ndims;i++)
-		LocalMean[i][0]=LocalMean[i][1]=0.;
+	memset(LocalSum,0,sizeof(LocalSum[0])*ndims);
 	totsamps[0]=totsamps[1]=0;
 	uint8 minv=255;
 	uint8 maxv=0;
 	struct Sample *minS=0,*maxS=0;
-	for(i=0;i<n->NSamples;i++)
+	struct Sample *sl=n->Samples;
+	for(i=0;i<n->NSamples;i++,sl=NEXTSAMPLE(sl))
 	{
 		uint8 v;
 		int whichside=1;
-		struct Sample *sl;
-		sl=SAMPLE(n->Samples,i);
 		v=sl->Value[whichdim];
 		if (v<minv) { minv=v; minS=sl; }
 		if (v>maxv) { maxv=v; maxS=sl; }
 		if (v<n->Mean[whichdim])
 			whichside=0;
 		totsamps[whichside]+=sl->Count;
-		for(int d=0;d<current_ndims;d++)
-			LocalMean[d][whichside]+=
+		for(int d=0;d<ndims;d++)
+			LocalSum[d][whichside]+=
 				sl->Count*sl->Value[d];
 	}
 
 	if (totsamps[0] && totsamps[1])
-		for(i=0;i<current_ndims;i++)
+		for(i=0;i<ndims;i++)
 		{
-			LocalMean[i][0]/=totsamps[0];
-			LocalMean[i][1]/=totsamps[1];
+			LocalMean[i][0]=(double)LocalSum[i][0]/totsamps[0];
+			LocalMean[i][1]=(double)LocalSum[i][1]/totsamps[1];
 		}
 	else
 	{
@@ -316,7 +558,7 @@ static void SubdivideNode(struct QuantizedValue *n, int whichdim)
 		// extrema instead. LocalMean[i][0] will be the point with the lowest
 		// value on the dimension and LocalMean[i][1] the one with the lowest
 		// value.
-		for(int i=0;i<current_ndims;i++)
+		for(int i=0;i<ndims;i++)
 		{
 			LocalMean[i][0]=minS->Value[i];
 			LocalMean[i][1]=maxS->Value[i];
@@ -325,73 +567,119 @@ static void SubdivideNode(struct QuantizedValue *n, int whichdim)
 
 	// now, we have 2 n-dimensional means. We will label each sample
 	// for which one it is nearer to by using the QNum field.
-	for(i=0;i<n->NSamples;i++)
+	int nFirst=0;
+	struct Sample *s=n->Samples;
+	for(i=0;i<n->NSamples;i++,s=NEXTSAMPLE(s))
 	{
+#ifdef QUANTIZE_SSE2
+		// both distances at once, each lane doing the exact scalar operations
+		__m128d dist=_mm_setzero_pd();
+		for(int d=0;d<ndims;d++)
+		{
+			__m128d diff=_mm_sub_pd(_mm_load_pd(LocalMean[d]),_mm_set1_pd(s->Value[d]));
+			dist=_mm_add_pd(dist,_mm_mul_pd(_mm_set1_pd(state.m_pflWeights[d]),_mm_mul_pd(diff,diff)));
+		}
+		s->QNum=_mm_comilt_sd(dist,_mm_unpackhi_pd(dist,dist));
+#else
 		double dist[2];
 		dist[0]=dist[1]=0.;
-		struct Sample *s=SAMPLE(n->Samples,i);
-		for(int d=0;d<current_ndims;d++)
+		for(int d=0;d<ndims;d++)
 			for(int w=0;w<2;w++)
-				dist[w]+=current_weights[d]*SQ(LocalMean[d][w]-s->Value[d]);
+				dist[w]+=state.m_pWeights[d]*SQ(LocalMean[d][w]-s->Value[d]);
 		s->QNum=(dist[0]<dist[1]);
-    }
-
+#endif
+		nFirst+=(s->QNum==0);
+	}
 
-	// hey ho! we have now labelled each one with a candidate bin. Let's
-	// sort the array by moving the 0-labelled ones to the head of the array.
+	// hey ho! we have now labelled each one with a candidate bin. Move the
+	// 0-labelled ones to the head, keeping the order within each bin.
 	n->sortdim=-1;
-	qsort(n->Samples,n->NSamples,current_ssize,QNumSort);
-	for(i=0;i<n->NSamples;i++,NAdded++)
-		if (SAMPLE(n->Samples,i)->QNum)
-			break;
-  
-#else
-	if (whichdim != n->sortdim)
-	{
-		current_sort_dim=whichdim;
-		qsort(n->Samples,n->NSamples,current_ssize,samplesort);
-		n->sortdim=whichdim;
-	}
-	// now, the samples are sorted along the proper dimension.  we need
-	// to find the place to cut in order to split the node.  this is
-	// complicated by the fact that each sample entry can represent many
-	// samples. What we will do is start at the beginning of the array,
-	// adding samples to the first node, until either the number added
-	// is >=TotSamples/2, or there is only one left.
-	int TotAdded=0;
-	for(;;)
+	uint8 *pScratch=state.m_pScratch+((uint8 *)n->Samples-(uint8 *)state.m_pSamples);
+	uint8 *pDest[2]={ pScratch, pScratch+nFirst*nSampleSize };
+	s=n->Samples;
+	for(i=0;i<n->NSamples;i++,s=NEXTSAMPLE(s))
 	{
-		if (NAdded==n->NSamples-1)
-			break;
-		if (TotAdded>=n->TotSamples/2)
-			break;
-		TotAdded+=SAMPLE(n->Samples,NAdded)->Count;
-		NAdded++;
+		int w=(s->QNum!=0);
+		memcpy(pDest[w],s,nSampleSize);
+		pDest[w]+=nSampleSize;
 	}
-#endif
-	struct QuantizedValue *a=AllocQValue();
+
+	struct QuantizedValue *a=&pNode->m_pSplit[0]->m_Value;
 	a->sortdim=n->sortdim;
 	a->Samples=n->Samples;
-	a->NSamples=NAdded;
-	n->Children[0]=a;
-	UpdateStats(a);
-	a=AllocQValue();
-	a->Samples=SAMPLE(n->Samples,NAdded);
-	a->NSamples=n->NSamples-NAdded;
+	a->NSamples=nFirst;
+	UpdateStats(state,a,(struct Sample *)pScratch);
+	a=&pNode->m_pSplit[1]->m_Value;
+	a->Samples=NthSample(n->Samples,nFirst,ndims);
+	a->NSamples=n->NSamples-nFirst;
 	a->sortdim=n->sortdim;
-	n->Children[1]=a;
-	UpdateStats(a);
+	UpdateStats(state,a,(struct Sample *)(pScratch+nFirst*nSampleSize));
+
+	pNode->m_nSplitFirst=nFirst;
+	pNode->m_bSplitReady=true;
 }
 
-static int colorid=0;
+static void PrepareSplitJob( QuantizeSplitJob_t &job )
+{
+	PrepareSplit( *job.m_pState, job.m_pNode );
+}
 
-static void Label(struct QuantizedValue *q, int updatecolor)
+// Splits the worst leaf, and with a pool the leaves right behind it in the heap
+static void PrepareSplits( QuantizeState_t &state, QuantizeContextData_t &data, int nSplitsLeft )
+{
+	CUtlVector< QuantizeNode_t * > &leaves = data.m_Leaves;
+	data.m_Candidates.RemoveAll();
+	int nMaxSplits = MIN( data.m_nMaxParallelSplits, nSplitsLeft );
+	int nSearch = MIN( leaves.Count(), 4 * nMaxSplits );
+	int nTotalSamples = 0;
+	for ( int i = 0; ( i < nSearch ) && ( data.m_Candidates.Count() < nMaxSplits ); i++ )
+	{
+		QuantizeNode_t *pLeaf = leaves[i];
+		if ( pLeaf->m_bSplitReady || !( pLeaf->m_Value.TotalError > 0 ) )
+			continue;
+		data.m_Candidates.AddToTail( pLeaf );
+		nTotalSamples += pLeaf->m_Value.NSamples;
+	}
+	Assert( data.m_Candidates.Count() && ( data.m_Candidates[0] == leaves[0] ) );
+
+	int nSplits = ( nTotalSamples >= QUANTIZE_PARALLEL_MIN_SAMPLES ) ? data.m_Candidates.Count() : 1;
+	data.m_Jobs.SetCount( nSplits );
+	for ( int i = 0; i < nSplits; i++ )
+	{
+		// only this thread allocates nodes
+		QuantizeNode_t *pLeaf = data.m_Candidates[i];
+		pLeaf->m_pSplit[0] = AllocQValue( state, pLeaf, 0 );
+		pLeaf->m_pSplit[1] = AllocQValue( state, pLeaf, 1 );
+		data.m_Jobs[i].m_pState = &state;
+		data.m_Jobs[i].m_pNode = pLeaf;
+	}
+
+	if ( nSplits == 1 )
+	{
+		PrepareSplitJob( data.m_Jobs[0] );
+	}
+	else
+	{
+		ParallelProcess( data.m_pThreadPool, data.m_Jobs.Base(), nSplits, &PrepareSplitJob );
+	}
+}
+
+static void CommitSplit( const QuantizeState_t &state, QuantizeNode_t *pNode )
+{
+	struct QuantizedValue *n=&pNode->m_Value;
+	uint8 *pScratch=state.m_pScratch+((uint8 *)n->Samples-(uint8 *)state.m_pSamples);
+	memcpy(n->Samples,pScratch,n->NSamples*state.m_nSampleSize);
+	n->Children[0]=&pNode->m_pSplit[0]->m_Value;
+	n->Children[1]=&pNode->m_pSplit[1]->m_Value;
+}
+
+static void Label(int ndims, struct QuantizedValue *q, int updatecolor, int &colorid)
 {
 	// fill in max/min values for tree, etc.
 	if (q)
 	{
-		Label(q->Children[0],updatecolor);
-		Label(q->Children[1],updatecolor);
+		Label(ndims,q->Children[0],updatecolor,colorid);
+		Label(ndims,q->Children[1],updatecolor,colorid);
 		if (! q->Children[0])	// leaf node?
 		{
 			if (updatecolor)
@@ -399,18 +687,18 @@ static void Label(struct QuantizedValue *q, int updatecolor)
 				q->value=colorid++;
 				for(int j=0;j<q->NSamples;j++)
 				{
-					SAMPLE(q->Samples,j)->QNum=q->value;
-					SAMPLE(q->Samples,j)->qptr=q;
+					NthSample(q->Samples,j,ndims)->QNum=q->value;
+					NthSample(q->Samples,j,ndims)->qptr=q;
 				}
 			}
-			for(int i=0;i<current_ndims;i++)
+			for(int i=0;i<ndims;i++)
 			{
 				q->Mins[i]=q->Mean[i];
 				q->Maxs[i]=q->Mean[i];
 			}
 		}
 		else
-			for(int i=0;i<current_ndims;i++)
+			for(int i=0;i<ndims;i++)
 			{
 				q->Mins[i]=MIN(q->Children[0]->Mins[i],q->Children[1]->Mins[i]);
 				q->Maxs[i]=MAX(q->Children[0]->Maxs[i],q->Children[1]->Maxs[i]);
@@ -444,7 +732,8 @@ void CheckInRange(struct QuantizedValue *q, uint8 *max, uint8 *min)
 			CheckInRange(q->Children[0],max, min);
 			CheckInRange(q->Children[1],max, min);
 		}
-		for (int i=0;i<current_ndims;i++)
+		int ndims=((QuantizeNode_t *)q)->m_nDims;
+		for (int i=0;i<ndims;i++)
 		{
 			if (q->Maxs[i]>max[i]) printf("error1\n");
 			if (q->Mins[i]<min[i]) printf("error2\n");
@@ -452,24 +741,57 @@ void CheckInRange(struct QuantizedValue *q, uint8 *max, uint8 *min)
 	}
 }
 
-struct QuantizedValue *Quantize(struct Sample *s, int nsamples, int ndims,
-								int nvalues, uint8 *weights, int firstvalue)
+struct QuantizedValue *Quantize( CQuantizeContext *pContext, struct Sample *s, int nsamples, int ndims,
+								int nvalues, uint8 *weights, int firstvalue )
 {
-	SetNDims(ndims);
-	current_weights=weights;
-	current_root=AllocQValue();
-	current_root->Samples=s;
-	current_root->NSamples=nsamples;
-	UpdateStats(current_root);
-	while(--nvalues)
+	QuantizeContextData_t &data=*pContext->GetData();
+
+	QuantizeState_t state;
+	InitState( state, ndims, weights );
+	state.m_pSamples=s;
+	data.m_Scratch.SetCount( nsamples*state.m_nSampleSize );
+	state.m_pScratch=data.m_Scratch.Base();
+	data.m_flWeights.SetCount( ndims );
+	for ( int d=0;d<ndims;d++ )
+		data.m_flWeights[d]=weights[d];
+	state.m_pflWeights=data.m_flWeights.Base();
+
+	QuantizeNode_t *pRoot=AllocQValue( state, NULL, 0 );
+	struct QuantizedValue *root=&pRoot->m_Value;
+	root->Samples=s;
+	root->NSamples=nsamples;
+	UpdateStats(state,root,s);
+
+	// split the worst leaf until there are nvalues of them (or none worth splitting)
+	data.m_Leaves.RemoveAll();
+	PushLeaf( data.m_Leaves, pRoot );
+	int nSplitsLeft=( nvalues > 0 ) ? nvalues-1 : INT_MAX;
+	while(nSplitsLeft)
 	{
-		if (! FindWorst())
+		QuantizeNode_t *pWorst=data.m_Leaves[0];
+		if (! (pWorst->m_Value.TotalError>0))
 			break;                          // if <n unique ones, stop now
-		SubdivideNode(ErrorNode,ErrorDim);
+		if (! pWorst->m_bSplitReady)
+			PrepareSplits( state, data, nSplitsLeft );
+
+		PopWorstLeaf( data.m_Leaves );
+		CommitSplit( state, pWorst );
+		PushLeaf( data.m_Leaves, pWorst->m_pSplit[0] );
+		PushLeaf( data.m_Leaves, pWorst->m_pSplit[1] );
+		nSplitsLeft--;
 	}
-	colorid=firstvalue;
-	Label(current_root,1);
-	return current_root;
+
+	int colorid=firstvalue;
+	Label(ndims,root,1,colorid);
+	pRoot->m_pBlocks=state.m_pBlocks;
+	return root;
+}
+
+struct QuantizedValue *Quantize(struct Sample *s, int nsamples, int ndims,
+								int nvalues, uint8 *weights, int firstvalue)
+{
+	CQuantizeContext context;
+	return Quantize( &context, s, nsamples, ndims, nvalues, weights, firstvalue );
 }
 
 double MinimumError(struct QuantizedValue const *q, uint8 const *sample,
@@ -628,22 +950,22 @@ struct QuantizedValue *FindMatch(uint8 const *sample, int ndims,
 	return bestmatch;
 }
 
-static void RecalcMeans(struct QuantizedValue *q)
+static void RecalcMeans(struct QuantizedValue *q, int ndims)
 {
 	if (q)
 	{
 		if (q->Children[0])
 		{
 			// not a leaf, invoke recursively.
-			RecalcMeans(q->Children[0]);
-			RecalcMeans(q->Children[0]);
+			RecalcMeans(q->Children[0],ndims);
+			RecalcMeans(q->Children[0],ndims);
 		}
 		else
 		{
 			// it's a leaf. Set the means
 			if (q->NQuant)
 			{
-				for(int i=0;i<current_ndims;i++)
+				for(int i=0;i<ndims;i++)
 				{
 					q->Mean[i]=(uint8) (q->Sums[i]/q->NQuant);
 					q->Sums[i]=0;
@@ -656,25 +978,172 @@ static void RecalcMeans(struct QuantizedValue *q)
 		      
 void OptimizeQuantizer(struct QuantizedValue *q, int ndims)
 {
-	SetNDims(ndims);
-	RecalcMeans(q);		// reset q values
-	Label(q,0);			// update max/mins
+	int colorid=0;
+	RecalcMeans(q,ndims);		// reset q values
+	Label(ndims,q,0,colorid);	// update max/mins
 }
 
 
-static void RecalcStats(struct QuantizedValue *q)
+static void RecalcStats(const QuantizeState_t &state, struct QuantizedValue *q)
 {
 	if (q)
 	{
-		UpdateStats(q);
-		RecalcStats(q->Children[0]);
-		RecalcStats(q->Children[1]);
+		UpdateStats(state,q,q->Samples);
+		RecalcStats(state,q->Children[0]);
+		RecalcStats(state,q->Children[1]);
 	}
 }
 
 void RecalculateValues(struct QuantizedValue *q, int ndims)
 {
-	SetNDims(ndims);
-	RecalcStats(q);
-	Label(q,0);
+	QuantizeState_t state;
+	InitState(state,q);
+	Assert(state.m_nDims==ndims);
+	int colorid=0;
+	RecalcStats(state,q);
+	Label(ndims,q,0,colorid);
 }
+
+
+#if defined( FASTPATH_TESTS )
+
+static uint32 QuantizeTest_Random( uint32 &nSeed )
+{
+	nSeed = nSeed * 1664525 + 1013904223;
+	return nSeed >> 8;
+}
+
+// clusters of noisy samples, roughly like the colors of an image
+static struct Sample *QuantizeTest_MakeSamples( int nSamples, int nDims )
+{
+	struct Sample *s = AllocSamples( nSamples, nDims );
+	uint32 nSeed = 0x1234567;
+	uint8 Centers[64][MAXDIMS];
+	for ( int c = 0; c < 64; c++ )
+	{
+		for ( int d = 0; d < nDims; d++ )
+		{
+			Centers[c][d] = (uint8)QuantizeTest_Random( nSeed );
+		}
+	}
+
+	for ( int i = 0; i < nSamples; i++ )
+	{
+		struct Sample *pSample = NthSample( s, i, nDims );
+		const uint8 *pCenter = Centers[QuantizeTest_Random( nSeed ) & 63];
+		pSample->ID = i;
+		for ( int d = 0; d < nDims; d++ )
+		{
+			int nValue = pCenter[d] + (int)( QuantizeTest_Random( nSeed ) % 41 ) - 20;
+			pSample->Value[d] = (uint8)clamp( nValue, 0, 255 );
+		}
+	}
+	return s;
+}
+
+static bool QuantizeTest_TreesMatch( struct QuantizedValue const *a, struct QuantizedValue const *b, int nDims )
+{
+	if ( !a || !b )
+		return a == b;
+
+	if ( ( a->NSamples != b->NSamples ) || ( a->TotSamples != b->TotSamples ) || ( a->TotalError != b->TotalError ) ||
+		( ( a->Children[0] == NULL ) != ( b->Children[0] == NULL ) ) || ( !a->Children[0] && ( a->value != b->value ) ) )
+		return false;
+
+	if ( memcmp( a->ErrorMeasure, b->ErrorMeasure, nDims * sizeof( double ) ) || memcmp( a->Mean, b->Mean, nDims ) ||
+		memcmp( a->Mins, b->Mins, nDims ) || memcmp( a->Maxs, b->Maxs, nDims ) )
+		return false;
+
+	return QuantizeTest_TreesMatch( a->Children[0], b->Children[0], nDims ) && QuantizeTest_TreesMatch( a->Children[1], b->Children[1], nDims );
+}
+
+bool Quantize_Validate( IThreadPool *pThreadPool, int nSamples, int nDims, int nValues )
+{
+	nDims = clamp( nDims, 1, MAXDIMS );
+	uint8 Weights[MAXDIMS];
+	for ( int d = 0; d < nDims; d++ )
+	{
+		Weights[d] = (uint8)( 1 + ( d * 3 ) % 8 );
+	}
+
+	int nSampleSize = sizeof( struct Sample ) + ( nDims - 1 );
+	struct Sample *pSerial = QuantizeTest_MakeSamples( nSamples, nDims );
+	struct Sample *pParallel = AllocSamples( nSamples, nDims );
+	memcpy( pParallel, pSerial, nSamples * nSampleSize );
+
+	CQuantizeContext serialContext;
+	CQuantizeContext parallelContext( pThreadPool );
+	struct QuantizedValue *pSerialTree = Quantize( &serialContext, pSerial, nSamples, nDims, nValues, Weights );
+	struct QuantizedValue *pParallelTree = Quantize( &parallelContext, pParallel, nSamples, nDims, nValues, Weights );
+
+	bool bMatch = QuantizeTest_TreesMatch( pSerialTree, pParallelTree, nDims );
+	int nSampleMismatches = 0;
+	for ( int i = 0; i < nSamples; i++ )
+	{
+		struct Sample *a = NthSample( pSerial, i, nDims );
+		struct Sample *b = NthSample( pParallel, i, nDims );
+		if ( ( a->ID != b->ID ) || ( a->QNum != b->QNum ) || memcmp( a->Value, b->Value, nDims ) )
+		{
+			nSampleMismatches++;
+		}
+	}
+
+	int nUnique = CompressSamples( pSerial, nSamples, nDims );
+	int nSorted = 1;
+	for ( int i = 1; i < nUnique; i++ )
+	{
+		if ( memcmp( NthSample( pSerial, i - 1, nDims )->Value, NthSample( pSerial, i, nDims )->Value, nDims ) < 0 )
+		{
+			nSorted++;
+		}
+	}
+
+	FreeQuantization( pSerialTree );
+	FreeQuantization( pParallelTree );
+	delete[] (uint8 *)pSerial;
+	delete[] (uint8 *)pParallel;
+
+	Msg( "Quantize_Validate: %d samples, %d dims, %d values: trees %s, %d samples placed differently, %d of %d unique samples in order\n",
+		nSamples, nDims, nValues, bMatch ? "match" : "DIFFER", nSampleMismatches, nSorted, nUnique );
+	return bMatch && ( nSampleMismatches == 0 ) && ( nSorted == nUnique );
+}
+
+void Quantize_Benchmark( IThreadPool *pThreadPool, int nSamples, int nDims, int nValues )
+{
+	nDims = clamp( nDims, 1, MAXDIMS );
+	uint8 Weights[MAXDIMS];
+	for ( int d = 0; d < nDims; d++ )
+	{
+		Weights[d] = (uint8)( 1 + ( d * 3 ) % 8 );
+	}
+
+	int nSampleSize = sizeof( struct Sample ) + ( nDims - 1 );
+	struct Sample *pSource = QuantizeTest_MakeSamples( nSamples, nDims );
+	struct Sample *pWork = AllocSamples( nSamples, nDims );
+
+	CQuantizeContext serialContext;
+	CQuantizeContext parallelContext( pThreadPool );
+	double flTimes[2];
+	for ( int nPass = 0; nPass < 2; nPass++ )
+	{
+		memcpy( pWork, pSource, nSamples * nSampleSize );
+		double flStart = Plat_FloatTime();
+		struct QuantizedValue *pTree = Quantize( nPass ? &parallelContext : &serialContext, pWork, nSamples, nDims, nValues, Weights );
+		flTimes[nPass] = Plat_FloatTime() - flStart;
+		FreeQuantization( pTree );
+	}
+
+	memcpy( pWork, pSource, nSamples * nSampleSize );
+	double flStart = Plat_FloatTime();
+	int nUnique = CompressSamples( pWork, nSamples, nDims );
+	double flCompress = Plat_FloatTime() - flStart;
+
+	delete[] (uint8 *)pSource;
+	delete[] (uint8 *)pWork;
+
+	Msg( "Quantize_Benchmark: %d samples, %d dims, %d values: serial %.1f ms, parallel %.1f ms (%.2fx), CompressSamples %.1f ms (%d unique)\n",
+		nSamples, nDims, nValues, flTimes[0] * 1000.0, flTimes[1] * 1000.0, ( flTimes[1] > 0.0 ) ? flTimes[0] / flTimes[1] : 0.0,
+		flCompress * 1000.0, nUnique );
+}
+
+#endif // FASTPATH_TESTS
@@ -0,0 +1,638 @@
+//===== Copyright (c) 1996-2005, Valve Corporation, All rights reserved. ======//
+//
+// Purpose: Array at a time versions of the matrix and transform routines.
+//
+// $NoKeywords: $
+//===========================================================================//
+
+#include "mathlib/transformbatch.h"
+#include "mathlib/ssemath.h"
+#include "tier0/dbg.h"
+#include "tier0/platform.h"
+#include <math.h>
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+
+static inline bool TransformBatch_UseSIMD()
+{
+#ifdef _X360
+	return true;
+#else
+	return MathLib_SSEEnabled();
+#endif
+}
+
+
+//-----------------------------------------------------------------------------
+// One matrix splatted out for transforming four points at a time
+//-----------------------------------------------------------------------------
+struct TransformSplat_t
+{
+	fltx4 m[3][4];
+};
+
+static FORCEINLINE void SplatTransform( const matrix3x4_t &transform, TransformSplat_t &splat )
+{
+	for ( int i = 0; i < 3; i++ )
+	{
+		fltx4 fl4Row = LoadUnalignedSIMD( transform[i] );
+		splat.m[i][0] = SplatXSIMD( fl4Row );
+		splat.m[i][1] = SplatYSIMD( fl4Row );
+		splat.m[i][2] = SplatZSIMD( fl4Row );
+		splat.m[i][3] = SplatWSIMD( fl4Row );
+	}
+}
+
+// VectorTransform: DotProduct( in, row ) + row[3]
+static FORCEINLINE void TransformFourPoints( const TransformSplat_t &splat, const FourVectors &in, FourVectors &out )
+{
+	fltx4 fl4X = AddSIMD( AddSIMD( AddSIMD( MulSIMD( in.x, splat.m[0][0] ), MulSIMD( in.y, splat.m[0][1] ) ), MulSIMD( in.z, splat.m[0][2] ) ), splat.m[0][3] );
+	fltx4 fl4Y = AddSIMD( AddSIMD( AddSIMD( MulSIMD( in.x, splat.m[1][0] ), MulSIMD( in.y, splat.m[1][1] ) ), MulSIMD( in.z, splat.m[1][2] ) ), splat.m[1][3] );
+	fltx4 fl4Z = AddSIMD( AddSIMD( AddSIMD( MulSIMD( in.x, splat.m[2][0] ), MulSIMD( in.y, splat.m[2][1] ) ), MulSIMD( in.z, splat.m[2][2] ) ), splat.m[2][3] );
+	out.x = fl4X;
+	out.y = fl4Y;
+	out.z = fl4Z;
+}
+
+// DotProductAbs( extents, row ) for the three rows
+static FORCEINLINE void RotateFourExtents( const TransformSplat_t &splat, const FourVectors &in, FourVectors &out )
+{
+	fltx4 fl4X = AddSIMD( AddSIMD( fabs( MulSIMD( in.x, splat.m[0][0] ) ), fabs( MulSIMD( in.y, splat.m[0][1] ) ) ), fabs( MulSIMD( in.z, splat.m[0][2] ) ) );
+	fltx4 fl4Y = AddSIMD( AddSIMD( fabs( MulSIMD( in.x, splat.m[1][0] ) ), fabs( MulSIMD( in.y, splat.m[1][1] ) ) ), fabs( MulSIMD( in.z, splat.m[1][2] ) ) );
+	fltx4 fl4Z = AddSIMD( AddSIMD( fabs( MulSIMD( in.x, splat.m[2][0] ) ), fabs( MulSIMD( in.y, splat.m[2][1] ) ) ), fabs( MulSIMD( in.z, splat.m[2][2] ) ) );
+	out.x = fl4X;
+	out.y = fl4Y;
+	out.z = fl4Z;
+}
+
+// Loading a Vector reads the float after it too, so the last four of an
+// array are loaded from a padded copy
+static FORCEINLINE void LoadFourVectors( const Vector *pIn, int nValid, FourVectors &out )
+{
+	if ( nValid > 4 )
+	{
+		out.LoadAndSwizzle( pIn[0], pIn[1], pIn[2], pIn[3] );
+		return;
+	}
+
+	Vector padded[5];
+	for ( int i = 0; i < 4; i++ )
+	{
+		padded[i] = pIn[ MIN( i, nValid - 1 ) ];
+	}
+	padded[4].Init();
+	out.LoadAndSwizzle( padded[0], padded[1], padded[2], padded[3] );
+}
+
+static FORCEINLINE void StoreFourVectors( const FourVectors &in, Vector *pOut, int nValid )
+{
+	if ( nValid >= 4 )
+	{
+		in.StoreUnalignedVector3SIMD( &pOut[0], &pOut[1], &pOut[2], &pOut[3] );
+		return;
+	}
+
+	for ( int i = 0; i < nValid; i++ )
+	{
+		pOut[i] = in.Vec( i );
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// ConcatTransforms a row at a time: out[r] = in1[r][0] * in2[0] + in1[r][1] * in2[1]
+// + in1[r][2] * in2[2], plus in1[r][3] in the translation column
+//-----------------------------------------------------------------------------
+static FORCEINLINE void ConcatTransformsSIMD( const matrix3x4_t &in1, const matrix3x4_t &in2, matrix3x4_t &out )
+{
+	fltx4 fl4Row0 = LoadUnalignedSIMD( in2[0] );
+	fltx4 fl4Row1 = LoadUnalignedSIMD( in2[1] );
+	fltx4 fl4Row2 = LoadUnalignedSIMD( in2[2] );
+	fltx4 fl4TranslationMask = LoadAlignedSIMD( g_SIMD_ComponentMask[3] );
+
+	for ( int r = 0; r < 3; r++ )
+	{
+		fltx4 fl4In = LoadUnalignedSIMD( in1[r] );
+		fltx4 fl4Out = MulSIMD( SplatXSIMD( fl4In ), fl4Row0 );
+		fl4Out = AddSIMD( fl4Out, MulSIMD( SplatYSIMD( fl4In ), fl4Row1 ) );
+		fl4Out = AddSIMD( fl4Out, MulSIMD( SplatZSIMD( fl4In ), fl4Row2 ) );
+		fl4Out = MaskedAssign( fl4TranslationMask, AddSIMD( fl4Out, fl4In ), fl4Out );
+		StoreUnalignedSIMD( out[r], fl4Out );
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// SIMD paths
+//-----------------------------------------------------------------------------
+static void VectorTransformBatchSIMD( const matrix3x4_t &transform, const Vector *pIn, Vector *pOut, int nCount )
+{
+	TransformSplat_t splat;
+	SplatTransform( transform, splat );
+
+	for ( int i = 0; i < nCount; i += 4 )
+	{
+		FourVectors v;
+		LoadFourVectors( pIn + i, nCount - i, v );
+		TransformFourPoints( splat, v, v );
+		StoreFourVectors( v, pOut + i, nCount - i );
+	}
+}
+
+static void ConcatTransformsBatchSIMD( const matrix3x4_t *pIn1, const matrix3x4_t *pIn2, matrix3x4_t *pOut, int nCount )
+{
+	for ( int i = 0; i < nCount; i++ )
+	{
+		ConcatTransformsSIMD( pIn1[i], pIn2[i], pOut[i] );
+	}
+}
+
+static void ConcatTransformsHierarchySIMD( const matrix3x4_t &rootTransform, const int *pParent, const matrix3x4_t *pLocal, matrix3x4_t *pOut, int nCount )
+{
+	for ( int i = 0; i < nCount; i++ )
+	{
+		Assert( pParent[i] < i );
+		const matrix3x4_t &parent = ( pParent[i] < 0 ) ? rootTransform : pOut[ pParent[i] ];
+		ConcatTransformsSIMD( parent, pLocal[i], pOut[i] );
+	}
+}
+
+// TransformAABB on four boxes: center and extents, the center transformed
+// and the extents rotated through the absolute matrix
+static FORCEINLINE void TransformFourAABBs( const TransformSplat_t &splat, const FourVectors &mins, const FourVectors &maxs, FourVectors &minsOut, FourVectors &maxsOut )
+{
+	fltx4 fl4Half = Four_PointFives;
+	FourVectors localCenter;
+	localCenter.x = MulSIMD( AddSIMD( mins.x, maxs.x ), fl4Half );
+	localCenter.y = MulSIMD( AddSIMD( mins.y, maxs.y ), fl4Half );
+	localCenter.z = MulSIMD( AddSIMD( mins.z, maxs.z ), fl4Half );
+
+	FourVectors localExtents;
+	localExtents.x = SubSIMD( maxs.x, localCenter.x );
+	localExtents.y = SubSIMD( maxs.y, localCenter.y );
+	localExtents.z = SubSIMD( maxs.z, localCenter.z );
+
+	FourVectors worldCenter, worldExtents;
+	TransformFourPoints( splat, localCenter, worldCenter );
+	RotateFourExtents( splat, localExtents, worldExtents );
+
+	minsOut.x = SubSIMD( worldCenter.x, worldExtents.x );
+	minsOut.y = SubSIMD( worldCenter.y, worldExtents.y );
+	minsOut.z = SubSIMD( worldCenter.z, worldExtents.z );
+	maxsOut.x = AddSIMD( worldCenter.x, worldExtents.x );
+	maxsOut.y = AddSIMD( worldCenter.y, worldExtents.y );
+	maxsOut.z = AddSIMD( worldCenter.z, worldExtents.z );
+}
+
+static void TransformAABBBatchSIMD( const matrix3x4_t &transform, const Vector *pMinsIn, const Vector *pMaxsIn, Vector *pMinsOut, Vector *pMaxsOut, int nCount )
+{
+	TransformSplat_t splat;
+	SplatTransform( transform, splat );
+
+	for ( int i = 0; i < nCount; i += 4 )
+	{
+		FourVectors mins, maxs;
+		LoadFourVectors( pMinsIn + i, nCount - i, mins );
+		LoadFourVectors( pMaxsIn + i, nCount - i, maxs );
+		TransformFourAABBs( splat, mins, maxs, mins, maxs );
+		StoreFourVectors( mins, pMinsOut + i, nCount - i );
+		StoreFourVectors( maxs, pMaxsOut + i, nCount - i );
+	}
+}
+
+// One box by its own matrix. The matrix is transposed so that the sums run
+// down its columns in the order the scalar dot products use.
+static FORCEINLINE void TransformAABBSIMD( const matrix3x4_t &transform, const fltx4 &fl4Mins, const fltx4 &fl4Maxs, Vector &minsOut, Vector &maxsOut )
+{
+	fltx4 fl4Col0 = LoadUnalignedSIMD( transform[0] );
+	fltx4 fl4Col1 = LoadUnalignedSIMD( transform[1] );
+	fltx4 fl4Col2 = LoadUnalignedSIMD( transform[2] );
+	fltx4 fl4Col3 = Four_Zeros;
+	TransposeSIMD( fl4Col0, fl4Col1, fl4Col2, fl4Col3 );
+
+	fltx4 fl4Center = MulSIMD( AddSIMD( fl4Mins, fl4Maxs ), Four_PointFives );
+	fltx4 fl4Extents = SubSIMD( fl4Maxs, fl4Center );
+
+	fltx4 fl4WorldCenter = MulSIMD( SplatXSIMD( fl4Center ), fl4Col0 );
+	fl4WorldCenter = AddSIMD( fl4WorldCenter, MulSIMD( SplatYSIMD( fl4Center ), fl4Col1 ) );
+	fl4WorldCenter = AddSIMD( fl4WorldCenter, MulSIMD( SplatZSIMD( fl4Center ), fl4Col2 ) );
+	fl4WorldCenter = AddSIMD( fl4WorldCenter, fl4Col3 );
+
+	fltx4 fl4WorldExtents = fabs( MulSIMD( SplatXSIMD( fl4Extents ), fl4Col0 ) );
+	fl4WorldExtents = AddSIMD( fl4WorldExtents, fabs( MulSIMD( SplatYSIMD( fl4Extents ), fl4Col1 ) ) );
+	fl4WorldExtents = AddSIMD( fl4WorldExtents, fabs( MulSIMD( SplatZSIMD( fl4Extents ), fl4Col2 ) ) );
+
+	StoreUnaligned3SIMD( minsOut.Base(), SubSIMD( fl4WorldCenter, fl4WorldExtents ) );
+	StoreUnaligned3SIMD( maxsOut.Base(), AddSIMD( fl4WorldCenter, fl4WorldExtents ) );
+}
+
+static void TransformAABBBatchSIMD( const matrix3x4_t *pTransforms, const int *pTransformIndex, const Vector *pMinsIn, const Vector *pMaxsIn, Vector *pMinsOut, Vector *pMaxsOut, int nCount )
+{
+	for ( int i = 0; i < nCount; i++ )
+	{
+		const matrix3x4_t &transform = pTransforms[ pTransformIndex ? pTransformIndex[i] : i ];
+
+		// The last box is loaded from a copy so the load doesn't run off the arrays
+		if ( i < nCount - 1 )
+		{
+			TransformAABBSIMD( transform, LoadUnaligned3SIMD( pMinsIn[i].Base() ), LoadUnaligned3SIMD( pMaxsIn[i].Base() ), pMinsOut[i], pMaxsOut[i] );
+		}
+		else
+		{
+			VectorAligned mins( pMinsIn[i] ), maxs( pMaxsIn[i] );
+			TransformAABBSIMD( transform, LoadAlignedSIMD( mins.Base() ), LoadAlignedSIMD( maxs.Base() ), pMinsOut[i], pMaxsOut[i] );
+		}
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Public entry points
+//-----------------------------------------------------------------------------
+void VectorTransformBatch( const matrix3x4_t &transform, const Vector *pIn, Vector *pOut, int nCount )
+{
+	if ( TransformBatch_UseSIMD() )
+	{
+		VectorTransformBatchSIMD( transform, pIn, pOut, nCount );
+		return;
+	}
+
+	for ( int i = 0; i < nCount; i++ )
+	{
+		Vector in = pIn[i];
+		VectorTransform( in, transform, pOut[i] );
+	}
+}
+
+void ConcatTransformsBatch( const matrix3x4_t *pIn1, const matrix3x4_t *pIn2, matrix3x4_t *pOut, int nCount )
+{
+	if ( TransformBatch_UseSIMD() )
+	{
+		ConcatTransformsBatchSIMD( pIn1, pIn2, pOut, nCount );
+		return;
+	}
+
+	for ( int i = 0; i < nCount; i++ )
+	{
+		ConcatTransforms( pIn1[i], pIn2[i], pOut[i] );
+	}
+}
+
+void ConcatTransformsHierarchy( const matrix3x4_t &rootTransform, const int *pParent, const matrix3x4_t *pLocal, matrix3x4_t *pOut, int nCount )
+{
+	if ( TransformBatch_UseSIMD() )
+	{
+		ConcatTransformsHierarchySIMD( rootTransform, pParent, pLocal, pOut, nCount );
+		return;
+	}
+
+	for ( int i = 0; i < nCount; i++ )
+	{
+		Assert( pParent[i] < i );
+		const matrix3x4_t &parent = ( pParent[i] < 0 ) ? rootTransform : pOut[ pParent[i] ];
+		ConcatTransforms( parent, pLocal[i], pOut[i] );
+	}
+}
+
+void TransformAABBBatch( const matrix3x4_t &transform, const Vector *pMinsIn, const Vector *pMaxsIn, Vector *pMinsOut, Vector *pMaxsOut, int nCount )
+{
+	if ( TransformBatch_UseSIMD() )
+	{
+		TransformAABBBatchSIMD( transform, pMinsIn, pMaxsIn, pMinsOut, pMaxsOut, nCount );
+		return;
+	}
+
+	for ( int i = 0; i < nCount; i++ )
+	{
+		Vector mins = pMinsIn[i], maxs = pMaxsIn[i];
+		TransformAABB( transform, mins, maxs, pMinsOut[i], pMaxsOut[i] );
+	}
+}
+
+void TransformAABBBatch( const matrix3x4_t *pTransforms, const int *pTransformIndex, const Vector *pMinsIn, const Vector *pMaxsIn, Vector *pMinsOut, Vector *pMaxsOut, int nCount )
+{
+	if ( TransformBatch_UseSIMD() )
+	{
+		TransformAABBBatchSIMD( pTransforms, pTransformIndex, pMinsIn, pMaxsIn, pMinsOut, pMaxsOut, nCount );
+		return;
+	}
+
+	for ( int i = 0; i < nCount; i++ )
+	{
+		Vector mins = pMinsIn[i], maxs = pMaxsIn[i];
+		TransformAABB( pTransforms[ pTransformIndex ? pTransformIndex[i] : i ], mins, maxs, pMinsOut[i], pMaxsOut[i] );
+	}
+}
+
+
+#if defined( FASTPATH_TESTS )
+
+//-----------------------------------------------------------------------------
+// Validation and timing
+//-----------------------------------------------------------------------------
+struct TransformBatchTest_t
+{
+	TransformBatchTest_t( int nCount );
+	~TransformBatchTest_t();
+
+	int			m_nCount;
+	matrix3x4_t	m_Root;
+	matrix3x4_t	*m_pMatrices;		// m_nCount each
+	matrix3x4_t	*m_pLocal;
+	matrix3x4_t	*m_pOut;
+	matrix3x4_t	*m_pRef;
+	int			*m_pParent;
+	int			*m_pBoxBone;
+	Vector		*m_pPoints;			// m_nCount * 4 each
+	Vector		*m_pMins;
+	Vector		*m_pMaxs;
+	Vector		*m_pOutA;
+	Vector		*m_pOutB;
+	Vector		*m_pRefA;
+	Vector		*m_pRefB;
+};
+
+static unsigned int s_nTransformTestSeed;
+
+static float TransformTest_Random( float flMin, float flMax )
+{
+	s_nTransformTestSeed = s_nTransformTestSeed * 1664525 + 1013904223;
+	return flMin + ( flMax - flMin ) * ( ( s_nTransformTestSeed >> 8 ) * ( 1.0f / 16777216.0f ) );
+}
+
+static void TransformTest_RandomMatrix( matrix3x4_t &mat, float flRange )
+{
+	QAngle angles( TransformTest_Random( -180, 180 ), TransformTest_Random( -180, 180 ), TransformTest_Random( -180, 180 ) );
+	Vector origin( TransformTest_Random( -flRange, flRange ), TransformTest_Random( -flRange, flRange ), TransformTest_Random( -flRange, flRange ) );
+	AngleMatrix( angles, origin, mat );
+}
+
+TransformBatchTest_t::TransformBatchTest_t( int nCount )
+{
+	s_nTransformTestSeed = 0x7A11;
+	m_nCount = nCount;
+	int nPoints = nCount * 4;
+
+	m_pMatrices = new matrix3x4_t[ nCount ];
+	m_pLocal = new matrix3x4_t[ nCount ];
+	m_pOut = new matrix3x4_t[ nCount ];
+	m_pRef = new matrix3x4_t[ nCount ];
+	m_pParent = new int[ nCount ];
+	m_pBoxBone = new int[ nPoints ];
+	m_pPoints = new Vector[ nPoints ];
+	m_pMins = new Vector[ nPoints ];
+	m_pMaxs = new Vector[ nPoints ];
+	m_pOutA = new Vector[ nPoints ];
+	m_pOutB = new Vector[ nPoints ];
+	m_pRefA = new Vector[ nPoints ];
+	m_pRefB = new Vector[ nPoints ];
+
+	TransformTest_RandomMatrix( m_Root, 4096.0f );
+	for ( int i = 0; i < nCount; i++ )
+	{
+		TransformTest_RandomMatrix( m_pMatrices[i], 4096.0f );
+		TransformTest_RandomMatrix( m_pLocal[i], 32.0f );
+
+		// a skeleton: mostly chains, some branches back up, a few roots
+		int nParent = i - 1 - (int)TransformTest_Random( 0, 4 );
+		m_pParent[i] = ( i == 0 || TransformTest_Random( 0, 1 ) < 0.05f ) ? -1 : MAX( nParent, 0 );
+	}
+
+	for ( int i = 0; i < nPoints; i++ )
+	{
+		m_pPoints[i].Init( TransformTest_Random( -256, 256 ), TransformTest_Random( -256, 256 ), TransformTest_Random( -256, 256 ) );
+		Vector vecHalf( TransformTest_Random( 0, 16 ), TransformTest_Random( 0, 16 ), TransformTest_Random( 0, 16 ) );
+		m_pMins[i] = m_pPoints[i] - vecHalf;
+		m_pMaxs[i] = m_pPoints[i] + vecHalf;
+		m_pBoxBone[i] = (int)TransformTest_Random( 0, (float)nCount ) % nCount;
+	}
+}
+
+TransformBatchTest_t::~TransformBatchTest_t()
+{
+	delete [] m_pMatrices;
+	delete [] m_pLocal;
+	delete [] m_pOut;
+	delete [] m_pRef;
+	delete [] m_pParent;
+	delete [] m_pBoxBone;
+	delete [] m_pPoints;
+	delete [] m_pMins;
+	delete [] m_pMaxs;
+	delete [] m_pOutA;
+	delete [] m_pOutB;
+	delete [] m_pRefA;
+	delete [] m_pRefB;
+}
+
+static int TransformTest_CountMismatches( const float *pA, const float *pB, int nFloats, float &flMaxError )
+{
+	int nMismatches = 0;
+	for ( int i = 0; i < nFloats; i++ )
+	{
+		if ( pA[i] != pB[i] )
+		{
+			nMismatches++;
+			flMaxError = MAX( flMaxError, fabs( pA[i] - pB[i] ) / MAX( 1.0f, fabs( pB[i] ) ) );
+		}
+	}
+	return nMismatches;
+}
+
+static bool TransformTest_Report( const char *pName, int nMismatches, int nFloats, float flMaxError )
+{
+	// The SIMD paths do the scalar operations in the scalar order; the
+	// tolerance only covers compilers that keep the scalar code in extended
+	// precision or contract it into fused multiply-adds
+	bool bOk = ( flMaxError <= 1e-5f );
+	Msg( "TransformBatch_Validate: %s, %d of %d floats differ, max relative error %g: %s\n", pName, nMismatches, nFloats, flMaxError, bOk ? "ok" : "FAILED" );
+	return bOk;
+}
+
+bool TransformBatch_Validate( int nCount )
+{
+	if ( nCount < 1 )
+		return false;
+
+	TransformBatchTest_t test( nCount );
+	int nPoints = nCount * 4;
+	bool bOk = true;
+
+	// Odd counts exercise the padded last group
+	for ( int nRun = nPoints - 3; nRun <= nPoints; nRun += 3 )
+	{
+		float flMaxError = 0.0f;
+		for ( int i = 0; i < nRun; i++ )
+		{
+			VectorTransform( test.m_pPoints[i], test.m_Root, test.m_pRefA[i] );
+		}
+		VectorTransformBatchSIMD( test.m_Root, test.m_pPoints, test.m_pOutA, nRun );
+		int nMismatches = TransformTest_CountMismatches( test.m_pOutA->Base(), test.m_pRefA->Base(), nRun * 3, flMaxError );
+
+		// in place
+		memcpy( test.m_pOutA, test.m_pPoints, nRun * sizeof( Vector ) );
+		VectorTransformBatchSIMD( test.m_Root, test.m_pOutA, test.m_pOutA, nRun );
+		nMismatches += TransformTest_CountMismatches( test.m_pOutA->Base(), test.m_pRefA->Base(), nRun * 3, flMaxError );
+		bOk = TransformTest_Report( "VectorTransformBatch", nMismatches, nRun * 6, flMaxError ) && bOk;
+	}
+
+	{
+		float flMaxError = 0.0f;
+		for ( int i = 0; i < nCount; i++ )
+		{
+			ConcatTransforms( test.m_pMatrices[i], test.m_pLocal[i], test.m_pRef[i] );
+		}
+		ConcatTransformsBatchSIMD( test.m_pMatrices, test.m_pLocal, test.m_pOut, nCount );
+		int nMismatches = TransformTest_CountMismatches( test.m_pOut->Base(), test.m_pRef->Base(), nCount * 12, flMaxError );
+
+		// in place on either side
+		memcpy( test.m_pOut, test.m_pMatrices, nCount * sizeof( matrix3x4_t ) );
+		ConcatTransformsBatchSIMD( test.m_pOut, test.m_pLocal, test.m_pOut, nCount );
+		nMismatches += TransformTest_CountMismatches( test.m_pOut->Base(), test.m_pRef->Base(), nCount * 12, flMaxError );
+		memcpy( test.m_pOut, test.m_pLocal, nCount * sizeof( matrix3x4_t ) );
+		ConcatTransformsBatchSIMD( test.m_pMatrices, test.m_pOut, test.m_pOut, nCount );
+		nMismatches += TransformTest_CountMismatches( test.m_pOut->Base(), test.m_pRef->Base(), nCount * 12, flMaxError );
+		bOk = TransformTest_Report( "ConcatTransformsBatch", nMismatches, nCount * 36, flMaxError ) && bOk;
+	}
+
+	{
+		float flMaxError = 0.0f;
+		for ( int i = 0; i < nCount; i++ )
+		{
+			const matrix3x4_t &parent = ( test.m_pParent[i] < 0 ) ? test.m_Root : test.m_pRef[ test.m_pParent[i] ];
+			ConcatTransforms( parent, test.m_pLocal[i], test.m_pRef[i] );
+		}
+		ConcatTransformsHierarchySIMD( test.m_Root, test.m_pParent, test.m_pLocal, test.m_pOut, nCount );
+		int nMismatches = TransformTest_CountMismatches( test.m_pOut->Base(), test.m_pRef->Base(), nCount * 12, flMaxError );
+
+		memcpy( test.m_pOut, test.m_pLocal, nCount * sizeof( matrix3x4_t ) );
+		ConcatTransformsHierarchySIMD( test.m_Root, test.m_pParent, test.m_pOut, test.m_pOut, nCount );
+		nMismatches += TransformTest_CountMismatches( test.m_pOut->Base(), test.m_pRef->Base(), nCount * 12, flMaxError );
+		bOk = TransformTest_Report( "ConcatTransformsHierarchy", nMismatches, nCount * 24, flMaxError ) && bOk;
+	}
+
+	for ( int nRun = nPoints - 3; nRun <= nPoints; nRun += 3 )
+	{
+		float flMaxError = 0.0f;
+		for ( int i = 0; i < nRun; i++ )
+		{
+			TransformAABB( test.m_Root, test.m_pMins[i], test.m_pMaxs[i], test.m_pRefA[i], test.m_pRefB[i] );
+		}
+		TransformAABBBatchSIMD( test.m_Root, test.m_pMins, test.m_pMaxs, test.m_pOutA, test.m_pOutB, nRun );
+		int nMismatches = TransformTest_CountMismatches( test.m_pOutA->Base(), test.m_pRefA->Base(), nRun * 3, flMaxError );
+		nMismatches += TransformTest_CountMismatches( test.m_pOutB->Base(), test.m_pRefB->Base(), nRun * 3, flMaxError );
+		bOk = TransformTest_Report( "TransformAABBBatch", nMismatches, nRun * 6, flMaxError ) && bOk;
+
+		flMaxError = 0.0f;
+		for ( int i = 0; i < nRun; i++ )
+		{
+			TransformAABB( test.m_pMatrices[ test.m_pBoxBone[i] ], test.m_pMins[i], test.m_pMaxs[i], test.m_pRefA[i], test.m_pRefB[i] );
+		}
+		TransformAABBBatchSIMD( test.m_pMatrices, test.m_pBoxBone, test.m_pMins, test.m_pMaxs, test.m_pOutA, test.m_pOutB, nRun );
+		nMismatches = TransformTest_CountMismatches( test.m_pOutA->Base(), test.m_pRefA->Base(), nRun * 3, flMaxError );
+		nMismatches += TransformTest_CountMismatches( test.m_pOutB->Base(), test.m_pRefB->Base(), nRun * 3, flMaxError );
+		bOk = TransformTest_Report( "TransformAABBBatch indexed", nMismatches, nRun * 6, flMaxError ) && bOk;
+	}
+
+	return bOk;
+}
+
+static void TransformTest_ReportTime( const char *pName, int nCount, int nIterations, double flScalar, double flBatch )
+{
+	Msg( "TransformBatch_Benchmark: %s, %d x %d, scalar %.2f ms, batch %.2f ms (%.2fx)\n",
+		pName, nIterations, nCount, flScalar * 1000.0, flBatch * 1000.0, ( flBatch > 0.0 ) ? ( flScalar / flBatch ) : 0.0 );
+}
+
+void TransformBatch_Benchmark( int nCount, int nIterations )
+{
+	if ( nCount < 1 )
+		return;
+
+	TransformBatchTest_t test( nCount );
+	int nPoints = nCount * 4;
+
+	double flStart = Plat_FloatTime();
+	for ( int n = 0; n < nIterations; n++ )
+	{
+		for ( int i = 0; i < nPoints; i++ )
+		{
+			VectorTransform( test.m_pPoints[i], test.m_Root, test.m_pOutA[i] );
+		}
+	}
+	double flScalar = Plat_FloatTime() - flStart;
+	flStart = Plat_FloatTime();
+	for ( int n = 0; n < nIterations; n++ )
+	{
+		VectorTransformBatch( test.m_Root, test.m_pPoints, test.m_pOutA, nPoints );
+	}
+	TransformTest_ReportTime( "VectorTransformBatch", nPoints, nIterations, flScalar, Plat_FloatTime() - flStart );
+
+	flStart = Plat_FloatTime();
+	for ( int n = 0; n < nIterations; n++ )
+	{
+		for ( int i = 0; i < nCount; i++ )
+		{
+			ConcatTransforms( test.m_pMatrices[i], test.m_pLocal[i], test.m_pOut[i] );
+		}
+	}
+	flScalar = Plat_FloatTime() - flStart;
+	flStart = Plat_FloatTime();
+	for ( int n = 0; n < nIterations; n++ )
+	{
+		ConcatTransformsBatch( test.m_pMatrices, test.m_pLocal, test.m_pOut, nCount );
+	}
+	TransformTest_ReportTime( "ConcatTransformsBatch", nCount, nIterations, flScalar, Plat_FloatTime() - flStart );
+
+	flStart = Plat_FloatTime();
+	for ( int n = 0; n < nIterations; n++ )
+	{
+		for ( int i = 0; i < nCount; i++ )
+		{
+			const matrix3x4_t &parent = ( test.m_pParent[i] < 0 ) ? test.m_Root : test.m_pOut[ test.m_pParent[i] ];
+			ConcatTransforms( parent, test.m_pLocal[i], test.m_pOut[i] );
+		}
+	}
+	flScalar = Plat_FloatTime() - flStart;
+	flStart = Plat_FloatTime();
+	for ( int n = 0; n < nIterations; n++ )
+	{
+		ConcatTransformsHierarchy( test.m_Root, test.m_pParent, test.m_pLocal, test.m_pOut, nCount );
+	}
+	TransformTest_ReportTime( "ConcatTransformsHierarchy", nCount, nIterations, flScalar, Plat_FloatTime() - flStart );
+
+	flStart = Plat_FloatTime();
+	for ( int n = 0; n < nIterations; n++ )
+	{
+		for ( int i = 0; i < nPoints; i++ )
+		{
+			TransformAABB( test.m_Root, test.m_pMins[i], test.m_pMaxs[i], test.m_pOutA[i], test.m_pOutB[i] );
+		}
+	}
+	flScalar = Plat_FloatTime() - flStart;
+	flStart = Plat_FloatTime();
+	for ( int n = 0; n < nIterations; n++ )
+	{
+		TransformAABBBatch( test.m_Root, test.m_pMins, test.m_pMaxs, test.m_pOutA, test.m_pOutB, nPoints );
+	}
+	TransformTest_ReportTime( "TransformAABBBatch", nPoints, nIterations, flScalar, Plat_FloatTime() - flStart );
+
+	flStart = Plat_FloatTime();
+	for ( int n = 0; n < nIterations; n++ )
+	{
+		for ( int i = 0; i < nPoints; i++ )
+		{
+			TransformAABB( test.m_pMatrices[ test.m_pBoxBone[i] ], test.m_pMins[i], test.m_pMaxs[i], test.m_pOutA[i], test.m_pOutB[i] );
+		}
+	}
+	flScalar = Plat_FloatTime() - flStart;
+	flStart = Plat_FloatTime();
+	for ( int n = 0; n < nIterations; n++ )
+	{
+		TransformAABBBatch( test.m_pMatrices, test.m_pBoxBone, test.m_pMins, test.m_pMaxs, test.m_pOutA, test.m_pOutB, nPoints );
+	}
+	TransformTest_ReportTime( "TransformAABBBatch indexed", nPoints, nIterations, flScalar, Plat_FloatTime() - flStart );
+}
+
+#endif // FASTPATH_TESTS
@@ -16,6 +16,8 @@
 #include <float.h>
 #include "mathlib/vector4d.h"
 #include "trace.h"
+#include "raytrace.h"
+#include "tier1/utlvector.h"
 
 // memdbgon must be the last include file in a .cpp file!!!
 #include "tier0/memdbgon.h"
@@ -133,6 +135,65 @@ float IntersectRayWithTriangle( const Ray_t& ray,
 	return clamp( t, 0, 1 );
 }
 
+
+//-----------------------------------------------------------------------------
+// Intersects a swept box against four triangles. This is IntersectRayWithTriangle
+// operation for operation, so each lane comes out bit for bit the same; the
+// rejections are or'ed into one mask instead of returning early.
+//-----------------------------------------------------------------------------
+fltx4 IntersectRayWithFourTriangles( const Ray_t& ray, 
+		const FourVectors& v1, const FourVectors& edge1, const FourVectors& edge2, bool oneSided )
+{
+	FourVectors delta, start;
+	delta.DuplicateVector( ray.m_Delta );
+	start.DuplicateVector( ray.m_Start );
+
+	fltx4 reject = LoadZeroSIMD();
+
+	// Cull out one-sided stuff
+	if (oneSided)
+	{
+		fltx4 nx = SubSIMD( MulSIMD( edge1.y, edge2.z ), MulSIMD( edge1.z, edge2.y ) );
+		fltx4 ny = SubSIMD( MulSIMD( edge1.z, edge2.x ), MulSIMD( edge1.x, edge2.z ) );
+		fltx4 nz = SubSIMD( MulSIMD( edge1.x, edge2.y ), MulSIMD( edge1.y, edge2.x ) );
+		fltx4 dot = AddSIMD( AddSIMD( MulSIMD( nx, delta.x ), MulSIMD( ny, delta.y ) ), MulSIMD( nz, delta.z ) );
+		reject = CmpGeSIMD( dot, Four_Zeros );
+	}
+
+	// D x E2
+	FourVectors dirCrossEdge2;
+	dirCrossEdge2.x = SubSIMD( MulSIMD( delta.y, edge2.z ), MulSIMD( delta.z, edge2.y ) );
+	dirCrossEdge2.y = SubSIMD( MulSIMD( delta.z, edge2.x ), MulSIMD( delta.x, edge2.z ) );
+	dirCrossEdge2.z = SubSIMD( MulSIMD( delta.x, edge2.y ), MulSIMD( delta.y, edge2.x ) );
+
+	// The scalar code compares against the double 1e-6; the float nearest to it
+	// lies just below, so <= against it rejects exactly the same denominators.
+	fltx4 denom = AddSIMD( AddSIMD( MulSIMD( dirCrossEdge2.x, edge1.x ), MulSIMD( dirCrossEdge2.y, edge1.y ) ), MulSIMD( dirCrossEdge2.z, edge1.z ) );
+	reject = OrSIMD( reject, CmpLeSIMD( fabs( denom ), ReplicateX4( 1e-6f ) ) );
+	denom = DivSIMD( Four_Ones, denom );
+
+	FourVectors org = start;
+	org -= v1;
+	fltx4 u = MulSIMD( AddSIMD( AddSIMD( MulSIMD( dirCrossEdge2.x, org.x ), MulSIMD( dirCrossEdge2.y, org.y ) ), MulSIMD( dirCrossEdge2.z, org.z ) ), denom );
+	reject = OrSIMD( reject, OrSIMD( CmpLtSIMD( u, Four_Zeros ), CmpGtSIMD( u, Four_Ones ) ) );
+
+	FourVectors orgCrossEdge1;
+	orgCrossEdge1.x = SubSIMD( MulSIMD( org.y, edge1.z ), MulSIMD( org.z, edge1.y ) );
+	orgCrossEdge1.y = SubSIMD( MulSIMD( org.z, edge1.x ), MulSIMD( org.x, edge1.z ) );
+	orgCrossEdge1.z = SubSIMD( MulSIMD( org.x, edge1.y ), MulSIMD( org.y, edge1.x ) );
+	fltx4 v = MulSIMD( AddSIMD( AddSIMD( MulSIMD( orgCrossEdge1.x, delta.x ), MulSIMD( orgCrossEdge1.y, delta.y ) ), MulSIMD( orgCrossEdge1.z, delta.z ) ), denom );
+	reject = OrSIMD( reject, OrSIMD( CmpLtSIMD( v, Four_Zeros ), CmpGtSIMD( AddSIMD( v, u ), Four_Ones ) ) );
+
+	float boxt = ComputeBoxOffset( ray );
+	fltx4 t = MulSIMD( AddSIMD( AddSIMD( MulSIMD( orgCrossEdge1.x, edge2.x ), MulSIMD( orgCrossEdge1.y, edge2.y ) ), MulSIMD( orgCrossEdge1.z, edge2.z ) ), denom );
+	reject = OrSIMD( reject, OrSIMD( CmpLtSIMD( t, ReplicateX4( -boxt ) ), CmpGtSIMD( t, ReplicateX4( 1.0f + boxt ) ) ) );
+
+	// clamp( t, 0, 1 ), keeping a -0 and NaNs the way the scalar compares do
+	t = MaskedAssign( CmpLtSIMD( t, Four_Zeros ), Four_Zeros, t );
+	t = MaskedAssign( CmpGtSIMD( t, Four_Ones ), Four_Ones, t );
+	return MaskedAssign( reject, Four_NegativeOnes, t );
+}
+
 //-----------------------------------------------------------------------------
 // computes the barycentric coordinates of an intersection
 //-----------------------------------------------------------------------------
@@ -1710,6 +1771,463 @@ bool IntersectRayWithOBB( const Ray_t &ray, const Vector &vecBoxOrigin, const QA
 	return IntersectRayWithOBB( ray, matOBBToWorld, vecOBBMins, vecOBBMaxs, flTolerance, pTrace );
 }
 
+
+//-----------------------------------------------------------------------------
+// Packed OBBs
+//-----------------------------------------------------------------------------
+void FourOBBs_t::Init()
+{
+	for ( int i = 0; i < 3; ++i )
+	{
+		for ( int j = 0; j < 4; ++j )
+		{
+			m_Matrix[i][j] = Four_Zeros;
+		}
+	}
+	m_Mins.x = m_Mins.y = m_Mins.z = Four_Zeros;
+	m_Maxs = m_Mins;
+	m_Center = m_Mins;
+	m_Extents = m_Mins;
+	m_Used = Four_Zeros;
+}
+
+void FourOBBs_t::Set( int nLane, const matrix3x4_t &matOBBToWorld, const Vector &vecOBBMins, const Vector &vecOBBMaxs )
+{
+	for ( int i = 0; i < 3; ++i )
+	{
+		for ( int j = 0; j < 4; ++j )
+		{
+			SubFloat( m_Matrix[i][j], nLane ) = matOBBToWorld[i][j];
+		}
+	}
+
+	// Same arithmetic as IntersectRayWithOBB
+	Vector vecBoxExtents = (vecOBBMins + vecOBBMaxs) * 0.5; 
+	Vector vecBoxCenter;
+	VectorTransform( vecBoxExtents, matOBBToWorld, vecBoxCenter );
+	vecBoxExtents = vecOBBMaxs - vecBoxExtents;
+
+	m_Mins.X( nLane ) = vecOBBMins.x;
+	m_Mins.Y( nLane ) = vecOBBMins.y;
+	m_Mins.Z( nLane ) = vecOBBMins.z;
+	m_Maxs.X( nLane ) = vecOBBMaxs.x;
+	m_Maxs.Y( nLane ) = vecOBBMaxs.y;
+	m_Maxs.Z( nLane ) = vecOBBMaxs.z;
+	m_Center.X( nLane ) = vecBoxCenter.x;
+	m_Center.Y( nLane ) = vecBoxCenter.y;
+	m_Center.Z( nLane ) = vecBoxCenter.z;
+	m_Extents.X( nLane ) = vecBoxExtents.x;
+	m_Extents.Y( nLane ) = vecBoxExtents.y;
+	m_Extents.Z( nLane ) = vecBoxExtents.z;
+	SubInt( m_Used, nLane ) = 0xFFFFFFFF;
+}
+
+void PackOBBs( FourOBBs_t *pGroups, int nBoxes, const matrix3x4_t * const *ppOBBToWorld, const Vector *pOBBMins, const Vector *pOBBMaxs )
+{
+	for ( int i = 0; i < nBoxes; ++i )
+	{
+		if ( ( i & 3 ) == 0 )
+		{
+			pGroups[i >> 2].Init();
+		}
+		pGroups[i >> 2].Set( i & 3, *ppOBBToWorld[i], pOBBMins[i], pOBBMaxs[i] );
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Four rays against four boxes, lane by lane. This is IntersectRayWithOBB for
+// a point ray, followed by IntersectRayWithBox, with every operation done in
+// the same order so the results match to the bit. Returns the lanes that hit.
+//-----------------------------------------------------------------------------
+static FORCEINLINE fltx4 IntersectRayWithOBBSIMD( const FourVectors &vecRayStart, const FourVectors &vecRayDelta,
+	const fltx4 (&m)[3][4], const FourVectors &vecMins, const FourVectors &vecMaxs, 
+	const FourVectors &vecCenter, const FourVectors &vecExtents, fltx4 fl4Active, 
+	fltx4 *pFraction, fltx4 *pStartSolid )
+{
+	// Separating axis tests against the box axes
+	fltx4 sx = SubSIMD( AddSIMD( vecRayStart.x, vecRayDelta.x ), vecCenter.x );
+	fltx4 sy = SubSIMD( AddSIMD( vecRayStart.y, vecRayDelta.y ), vecCenter.y );
+	fltx4 sz = SubSIMD( AddSIMD( vecRayStart.z, vecRayDelta.z ), vecCenter.z );
+	fltx4 extent[3], uextent[3];
+	fltx4 fl4Separated = Four_Zeros;
+	for ( int j = 0; j < 3; ++j )
+	{
+		extent[j] = AddSIMD( AddSIMD( MulSIMD( vecRayDelta.x, m[0][j] ), MulSIMD( vecRayDelta.y, m[1][j] ) ), MulSIMD( vecRayDelta.z, m[2][j] ) );
+		uextent[j] = fabs( extent[j] );
+		fltx4 coord = fabs( AddSIMD( AddSIMD( MulSIMD( sx, m[0][j] ), MulSIMD( sy, m[1][j] ) ), MulSIMD( sz, m[2][j] ) ) );
+		fl4Separated = OrSIMD( fl4Separated, CmpGtSIMD( coord, AddSIMD( vecExtents[j], uextent[j] ) ) );
+	}
+
+	// Cross axes
+	fltx4 cx = SubSIMD( MulSIMD( vecRayDelta.y, sz ), MulSIMD( vecRayDelta.z, sy ) );
+	fltx4 cy = SubSIMD( MulSIMD( vecRayDelta.z, sx ), MulSIMD( vecRayDelta.x, sz ) );
+	fltx4 cz = SubSIMD( MulSIMD( vecRayDelta.x, sy ), MulSIMD( vecRayDelta.y, sx ) );
+	static const int s_nOther[3][2] = { { 1, 2 }, { 0, 2 }, { 0, 1 } };
+	for ( int j = 0; j < 3; ++j )
+	{
+		int a = s_nOther[j][0], b = s_nOther[j][1];
+		fltx4 cextent = fabs( AddSIMD( AddSIMD( MulSIMD( cx, m[0][j] ), MulSIMD( cy, m[1][j] ) ), MulSIMD( cz, m[2][j] ) ) );
+		fltx4 tmp = AddSIMD( MulSIMD( vecExtents[a], uextent[b] ), MulSIMD( vecExtents[b], uextent[a] ) );
+		fl4Separated = OrSIMD( fl4Separated, CmpGtSIMD( cextent, tmp ) );
+	}
+
+	fltx4 fl4Alive = AndNotSIMD( fl4Separated, fl4Active );
+	if ( IsAllZeros( fl4Alive ) )
+		return Four_Zeros;
+
+	// Ray start in box space; the delta is the box axis extent doubled
+	fltx4 tx = SubSIMD( vecRayStart.x, m[0][3] );
+	fltx4 ty = SubSIMD( vecRayStart.y, m[1][3] );
+	fltx4 tz = SubSIMD( vecRayStart.z, m[2][3] );
+	fltx4 start[3], delta[3];
+	for ( int j = 0; j < 3; ++j )
+	{
+		start[j] = AddSIMD( AddSIMD( MulSIMD( tx, m[0][j] ), MulSIMD( ty, m[1][j] ) ), MulSIMD( tz, m[2][j] ) );
+		delta[j] = MulSIMD( extent[j], Four_Twos );
+	}
+
+	// Slabs, as IntersectRayWithBox with a tolerance of 0
+	fltx4 t1 = Four_NegativeOnes;
+	fltx4 t2 = Four_Ones;
+	fltx4 fl4StartSolid = fl4Alive;
+	for ( int i = 0; i < 6; ++i )
+	{
+		fltx4 d1, d2;
+		if ( i >= 3 )
+		{
+			d1 = SubSIMD( start[i-3], vecMaxs[i-3] );
+			d2 = AddSIMD( d1, delta[i-3] );
+		}
+		else
+		{
+			d1 = SubSIMD( vecMins[i], start[i] );
+			d2 = SubSIMD( d1, delta[i] );
+		}
+
+		fltx4 d1Out = CmpGtSIMD( d1, Four_Zeros );
+
+		// Completely in front of the face: no intersection
+		fl4Alive = AndNotSIMD( AndSIMD( d1Out, CmpGtSIMD( d2, Four_Zeros ) ), fl4Alive );
+
+		// Lanes that cross the face
+		fltx4 fl4Crosses = AndNotSIMD( AndSIMD( CmpLeSIMD( d1, Four_Zeros ), CmpLeSIMD( d2, Four_Zeros ) ), fl4Alive );
+		fl4StartSolid = AndNotSIMD( AndSIMD( fl4Crosses, d1Out ), fl4StartSolid );
+
+		fltx4 fl4Denom = SubSIMD( d1, d2 );
+		fltx4 fl4Enters = CmpGtSIMD( d1, d2 );
+		fltx4 f = DivSIMD( SubSIMD( d1, Four_Zeros ), fl4Denom );
+		t1 = MaskedAssign( AndSIMD( AndSIMD( fl4Crosses, fl4Enters ), CmpGtSIMD( f, t1 ) ), f, t1 );
+
+		f = DivSIMD( AddSIMD( d1, Four_Zeros ), fl4Denom );
+		t2 = MaskedAssign( AndSIMD( AndNotSIMD( fl4Enters, fl4Crosses ), CmpLtSIMD( f, t2 ) ), f, t2 );
+	}
+
+	fltx4 fl4Entered = AndSIMD( fl4Alive, AndSIMD( CmpLtSIMD( t1, t2 ), CmpGeSIMD( t1, Four_Zeros ) ) );
+	fl4StartSolid = AndSIMD( fl4StartSolid, fl4Alive );
+
+	*pFraction = AndSIMD( fl4Entered, MulSIMD( t1, Four_Twos ) );
+	*pStartSolid = fl4StartSolid;
+	return OrSIMD( fl4Entered, fl4StartSolid );
+}
+
+int IntersectRayWithOBBs( const Vector &vecRayStart, const Vector &vecRayDelta, 
+	const FourOBBs_t *pGroups, int nBoxes, RayOBBHit_t *pHits )
+{
+	FourVectors vecStart, vecDelta;
+	vecStart.DuplicateVector( vecRayStart );
+	vecDelta.DuplicateVector( vecRayDelta );
+
+	int nHits = 0;
+	for ( int nFirst = 0; nFirst < nBoxes; nFirst += 4, ++pGroups )
+	{
+		fltx4 fl4Fraction, fl4StartSolid;
+		fltx4 fl4Hit = IntersectRayWithOBBSIMD( vecStart, vecDelta, pGroups->m_Matrix, pGroups->m_Mins, pGroups->m_Maxs,
+			pGroups->m_Center, pGroups->m_Extents, pGroups->m_Used, &fl4Fraction, &fl4StartSolid );
+
+		int nHitMask = TestSignSIMD( fl4Hit );
+		int nStartSolidMask = TestSignSIMD( fl4StartSolid );
+		int nLanes = MIN( nBoxes - nFirst, 4 );
+		for ( int i = 0; i < nLanes; ++i )
+		{
+			RayOBBHit_t &hit = pHits[nFirst + i];
+			if ( nHitMask & ( 1 << i ) )
+			{
+				hit.m_nBox = nFirst + i;
+				hit.m_flFraction = SubFloat( fl4Fraction, i );
+				hit.m_bStartSolid = ( nStartSolidMask & ( 1 << i ) ) != 0;
+				++nHits;
+			}
+			else
+			{
+				hit.m_nBox = -1;
+				hit.m_flFraction = 1.0f;
+				hit.m_bStartSolid = false;
+			}
+		}
+	}
+	return nHits;
+}
+
+void IntersectFourRaysWithOBBs( const FourRays &rays, const FourOBBs_t *pGroups, int nBoxes, RayOBBHit_t *pHits )
+{
+	fltx4 fl4Closest = Four_FLT_MAX;
+	fltx4 fl4ClosestBox = ReplicateIX4( -1 );
+	fltx4 fl4ClosestStartSolid = Four_Zeros;
+
+	// One box at a time, broadcast against the four rays
+	fltx4 m[3][4];
+	FourVectors vecMins, vecMaxs, vecCenter, vecExtents;
+	for ( int nBox = 0; nBox < nBoxes; ++nBox )
+	{
+		const FourOBBs_t &group = pGroups[nBox >> 2];
+		int nLane = nBox & 3;
+		for ( int i = 0; i < 3; ++i )
+		{
+			for ( int j = 0; j < 4; ++j )
+			{
+				m[i][j] = ReplicateX4( SubFloat( group.m_Matrix[i][j], nLane ) );
+			}
+		}
+		vecMins.DuplicateVector( group.m_Mins.Vec( nLane ) );
+		vecMaxs.DuplicateVector( group.m_Maxs.Vec( nLane ) );
+		vecCenter.DuplicateVector( group.m_Center.Vec( nLane ) );
+		vecExtents.DuplicateVector( group.m_Extents.Vec( nLane ) );
+
+		fltx4 fl4Fraction, fl4StartSolid;
+		fltx4 fl4Hit = IntersectRayWithOBBSIMD( rays.origin, rays.direction, m, vecMins, vecMaxs, vecCenter, vecExtents, 
+			ReplicateIX4( SubInt( group.m_Used, nLane ) ), &fl4Fraction, &fl4StartSolid );
+
+		// Strictly closer, so the first box wins ties
+		fltx4 fl4Closer = AndSIMD( fl4Hit, CmpLtSIMD( fl4Fraction, fl4Closest ) );
+		fl4Closest = MaskedAssign( fl4Closer, fl4Fraction, fl4Closest );
+		fl4ClosestBox = MaskedAssign( fl4Closer, ReplicateIX4( nBox ), fl4ClosestBox );
+		fl4ClosestStartSolid = MaskedAssign( fl4Closer, fl4StartSolid, fl4ClosestStartSolid );
+	}
+
+	int nStartSolidMask = TestSignSIMD( fl4ClosestStartSolid );
+	for ( int i = 0; i < 4; ++i )
+	{
+		pHits[i].m_nBox = SubInt( fl4ClosestBox, i );
+		pHits[i].m_flFraction = ( pHits[i].m_nBox >= 0 ) ? SubFloat( fl4Closest, i ) : 1.0f;
+		pHits[i].m_bStartSolid = ( nStartSolidMask & ( 1 << i ) ) != 0;
+	}
+}
+
+
+#if defined( FASTPATH_TESTS )
+
+//-----------------------------------------------------------------------------
+// Randomized check against IntersectRayWithOBB, and a benchmark
+//-----------------------------------------------------------------------------
+static float OBBTestRandomFloat( uint32 &nSeed, float flMin, float flMax )
+{
+	nSeed = nSeed * 1664525 + 1013904223;
+	return flMin + ( flMax - flMin ) * ( ( nSeed >> 8 ) * ( 1.0f / 16777216.0f ) );
+}
+
+static void OBBTestRandomBox( uint32 &nSeed, matrix3x4_t &matOBBToWorld, Vector &vecMins, Vector &vecMaxs )
+{
+	QAngle angles( OBBTestRandomFloat( nSeed, -180, 180 ), OBBTestRandomFloat( nSeed, -180, 180 ), OBBTestRandomFloat( nSeed, -180, 180 ) );
+	Vector origin( OBBTestRandomFloat( nSeed, -64, 64 ), OBBTestRandomFloat( nSeed, -64, 64 ), OBBTestRandomFloat( nSeed, -64, 64 ) );
+	if ( ( nSeed >> 4 ) % 8 == 0 )
+	{
+		// Axis aligned boxes hit the equal-distance cases
+		angles.Init();
+	}
+	AngleMatrix( angles, origin, matOBBToWorld );
+
+	for ( int i = 0; i < 3; ++i )
+	{
+		vecMins[i] = OBBTestRandomFloat( nSeed, -16, 0 );
+		vecMaxs[i] = OBBTestRandomFloat( nSeed, 0, 16 );
+	}
+}
+
+static void OBBTestRandomRay( uint32 &nSeed, Vector &vecStart, Vector &vecDelta )
+{
+	for ( int i = 0; i < 3; ++i )
+	{
+		vecStart[i] = OBBTestRandomFloat( nSeed, -128, 128 );
+		vecDelta[i] = OBBTestRandomFloat( nSeed, -256, 256 );
+	}
+
+	int nKind = ( nSeed >> 4 ) % 8;
+	if ( nKind == 0 )
+	{
+		// Axis aligned rays
+		vecDelta.y = vecDelta.z = 0.0f;
+	}
+	else if ( nKind == 1 )
+	{
+		// Starting inside the boxes
+		vecStart *= 0.05f;
+	}
+	else if ( nKind == 2 )
+	{
+		// Short rays, mostly ending before the boxes
+		vecDelta *= 0.05f;
+	}
+}
+
+static bool OBBTestSameFloat( float a, float b )
+{
+	return *(uint32 *)&a == *(uint32 *)&b;
+}
+
+bool IntersectRayWithOBBs_Validate( int nIterations )
+{
+	const int MAX_TEST_BOXES = 23;
+	FourOBBs_t groups[ ( MAX_TEST_BOXES + 3 ) / 4 ];
+	matrix3x4_t matrices[MAX_TEST_BOXES];
+	const matrix3x4_t *pMatrices[MAX_TEST_BOXES];
+	Vector vecMins[MAX_TEST_BOXES], vecMaxs[MAX_TEST_BOXES];
+	RayOBBHit_t hits[MAX_TEST_BOXES];
+
+	uint32 nSeed = 0x2C9277B5;
+	int nRays = 0, nBoxHits = 0, nErrors = 0;
+	for ( int n = 0; n < nIterations; ++n )
+	{
+		int nBoxes = 1 + ( n % MAX_TEST_BOXES );
+		for ( int i = 0; i < nBoxes; ++i )
+		{
+			OBBTestRandomBox( nSeed, matrices[i], vecMins[i], vecMaxs[i] );
+			pMatrices[i] = &matrices[i];
+		}
+		PackOBBs( groups, nBoxes, pMatrices, vecMins, vecMaxs );
+
+		FourRays rays;
+		Vector vecStart[4], vecDelta[4];
+		for ( int r = 0; r < 4; ++r )
+		{
+			OBBTestRandomRay( nSeed, vecStart[r], vecDelta[r] );
+			rays.origin.X( r ) = vecStart[r].x;
+			rays.origin.Y( r ) = vecStart[r].y;
+			rays.origin.Z( r ) = vecStart[r].z;
+			rays.direction.X( r ) = vecDelta[r].x;
+			rays.direction.Y( r ) = vecDelta[r].y;
+			rays.direction.Z( r ) = vecDelta[r].z;
+		}
+
+		RayOBBHit_t closest[4];
+		IntersectFourRaysWithOBBs( rays, groups, nBoxes, closest );
+
+		for ( int r = 0; r < 4; ++r, ++nRays )
+		{
+			IntersectRayWithOBBs( vecStart[r], vecDelta[r], groups, nBoxes, hits );
+
+			int nClosest = -1;
+			float flClosest = FLT_MAX;
+			bool bClosestStartSolid = false;
+			for ( int i = 0; i < nBoxes; ++i )
+			{
+				CBaseTrace trace;
+				bool bHit = IntersectRayWithOBB( vecStart[r], vecDelta[r], matrices[i], vecMins[i], vecMaxs[i], 0.0f, &trace );
+				if ( bHit != ( hits[i].m_nBox == i ) || 
+					( bHit && ( !OBBTestSameFloat( trace.fraction, hits[i].m_flFraction ) || trace.startsolid != hits[i].m_bStartSolid ) ) )
+				{
+					if ( nErrors++ < 8 )
+					{
+						Warning( "IntersectRayWithOBBs: box %d of %d: hit %d/%d fraction %.9g/%.9g startsolid %d/%d\n", i, nBoxes,
+							bHit, hits[i].m_nBox == i, trace.fraction, hits[i].m_flFraction, trace.startsolid, hits[i].m_bStartSolid );
+					}
+				}
+
+				if ( bHit )
+				{
+					++nBoxHits;
+					if ( trace.fraction < flClosest )
+					{
+						nClosest = i;
+						flClosest = trace.fraction;
+						bClosestStartSolid = trace.startsolid;
+					}
+				}
+			}
+
+			if ( closest[r].m_nBox != nClosest || 
+				( nClosest >= 0 && ( !OBBTestSameFloat( closest[r].m_flFraction, flClosest ) || closest[r].m_bStartSolid != bClosestStartSolid ) ) )
+			{
+				if ( nErrors++ < 8 )
+				{
+					Warning( "IntersectFourRaysWithOBBs: ray %d: box %d/%d fraction %.9g/%.9g\n", r, 
+						nClosest, closest[r].m_nBox, flClosest, closest[r].m_flFraction );
+				}
+			}
+		}
+	}
+
+	Msg( "IntersectRayWithOBBs: %d rays, %d box hits, %d mismatches\n", nRays, nBoxHits, nErrors );
+	return nErrors == 0;
+}
+
+void IntersectRayWithOBBs_Benchmark( int nBoxes, int nRays )
+{
+	nBoxes = clamp( nBoxes, 1, 64 );
+	nRays = MAX( nRays & ~3, 4 );
+
+	FourOBBs_t groups[16];
+	matrix3x4_t matrices[64];
+	const matrix3x4_t *pMatrices[64];
+	Vector vecMins[64], vecMaxs[64];
+	RayOBBHit_t hits[64];
+
+	uint32 nSeed = 0x5EED1234;
+	for ( int i = 0; i < nBoxes; ++i )
+	{
+		OBBTestRandomBox( nSeed, matrices[i], vecMins[i], vecMaxs[i] );
+		pMatrices[i] = &matrices[i];
+	}
+
+	CUtlVector< Vector > starts, deltas;
+	starts.SetCount( nRays );
+	deltas.SetCount( nRays );
+	for ( int r = 0; r < nRays; ++r )
+	{
+		OBBTestRandomRay( nSeed, starts[r], deltas[r] );
+	}
+
+	int nScalarHits = 0;
+	double flStart = Plat_FloatTime();
+	for ( int r = 0; r < nRays; ++r )
+	{
+		for ( int i = 0; i < nBoxes; ++i )
+		{
+			CBaseTrace trace;
+			nScalarHits += IntersectRayWithOBB( starts[r], deltas[r], matrices[i], vecMins[i], vecMaxs[i], 0.0f, &trace ) ? 1 : 0;
+		}
+	}
+	double flScalar = Plat_FloatTime() - flStart;
+
+	// Packing is paid once per model, not per ray
+	int nHits = 0;
+	flStart = Plat_FloatTime();
+	PackOBBs( groups, nBoxes, pMatrices, vecMins, vecMaxs );
+	for ( int r = 0; r < nRays; ++r )
+	{
+		nHits += IntersectRayWithOBBs( starts[r], deltas[r], groups, nBoxes, hits );
+	}
+	double flBatched = Plat_FloatTime() - flStart;
+
+	flStart = Plat_FloatTime();
+	RayOBBHit_t closest[4];
+	for ( int r = 0; r < nRays; r += 4 )
+	{
+		FourRays rays;
+		rays.origin.LoadAndSwizzle( starts[r], starts[r+1], starts[r+2], starts[r+3] );
+		rays.direction.LoadAndSwizzle( deltas[r], deltas[r+1], deltas[r+2], deltas[r+3] );
+		IntersectFourRaysWithOBBs( rays, groups, nBoxes, closest );
+	}
+	double flPacket = Plat_FloatTime() - flStart;
+
+	Msg( "IntersectRayWithOBBs: %d rays x %d boxes, %d hits (%d scalar)\n", nRays, nBoxes, nHits, nScalarHits );
+	Msg( "  IntersectRayWithOBB:       %8.3f ms\n", flScalar * 1000.0 );
+	Msg( "  IntersectRayWithOBBs:      %8.3f ms, %.2fx\n", flBatched * 1000.0, flBatched > 0.0 ? flScalar / flBatched : 0.0 );
+	Msg( "  IntersectFourRaysWithOBBs: %8.3f ms, %.2fx\n", flPacket * 1000.0, flPacket > 0.0 ? flScalar / flPacket : 0.0 );
+}
+
+#endif // FASTPATH_TESTS
+
 	
 //-----------------------------------------------------------------------------
 //
@@ -45,6 +45,19 @@ float IntersectRayWithTriangle( const Ray_t& ray,
 		                        const Vector& v1, const Vector& v2, const Vector& v3, 
 								bool oneSided );
 
+//-----------------------------------------------------------------------------
+//
+// IntersectRayWithFourTriangles
+//
+// Intersects a ray with four triangles at once. The triangles are given as
+// v1 and the edges v2 - v1 and v3 - v1; each lane holds exactly what
+// IntersectRayWithTriangle returns for its triangle, -1 on a miss.
+//
+//-----------------------------------------------------------------------------
+fltx4 IntersectRayWithFourTriangles( const Ray_t& ray, 
+		const FourVectors& v1, const FourVectors& edge1, const FourVectors& edge2, 
+		bool oneSided );
+
 //-----------------------------------------------------------------------------
 //
 // ComputeIntersectionBarycentricCoordinates
@@ -166,6 +179,58 @@ bool IntersectRayWithOBB( const Vector &vecRayStart, const Vector &vecRayDelta,
 	const matrix3x4_t &matOBBToWorld, const Vector &vecOBBMins, const Vector &vecOBBMaxs, 
 	float flTolerance, BoxTraceInfo_t *pTrace );
 
+
+//-----------------------------------------------------------------------------
+// IntersectRayWithOBBs
+//
+// Purpose: Point rays against a set of OBBs (typically the hitboxes of a
+//			model), four boxes per SIMD iteration. Pack the boxes once into
+//			FourOBBs_t groups and reuse them for every ray fired at the model.
+//			Each box gives exactly what IntersectRayWithOBB( vecRayStart,
+//			vecRayDelta, matOBBToWorld, vecOBBMins, vecOBBMaxs, 0.0f, &trace )
+//			would: the same hit or miss, the same fraction and startsolid.
+//			Use the scalar call on the box that wins to get the trace plane.
+//-----------------------------------------------------------------------------
+class FourRays;
+
+struct ALIGN16 FourOBBs_t
+{
+	// Empties all four lanes
+	void Init();
+	void Set( int nLane, const matrix3x4_t &matOBBToWorld, const Vector &vecOBBMins, const Vector &vecOBBMaxs );
+
+	fltx4		m_Matrix[3][4];		// matOBBToWorld of each lane
+	FourVectors	m_Mins;
+	FourVectors	m_Maxs;
+	FourVectors	m_Center;			// world space center of each box
+	FourVectors	m_Extents;			// local space half size
+	fltx4		m_Used;				// ~0 in lanes holding a box
+} ALIGN16_POST;
+
+struct RayOBBHit_t
+{
+	int		m_nBox;					// -1 if nothing was hit
+	float	m_flFraction;
+	bool	m_bStartSolid;
+};
+
+// Packs nBoxes boxes into ( nBoxes + 3 ) / 4 groups
+void PackOBBs( FourOBBs_t *pGroups, int nBoxes, const matrix3x4_t * const *ppOBBToWorld, const Vector *pOBBMins, const Vector *pOBBMaxs );
+
+// Tests one ray against nBoxes packed boxes. pHits gets one entry per box; returns the number hit.
+int IntersectRayWithOBBs( const Vector &vecRayStart, const Vector &vecRayDelta, 
+	const FourOBBs_t *pGroups, int nBoxes, RayOBBHit_t *pHits );
+
+// Finds the closest box (the lowest index on ties) hit by each of four rays;
+// rays.direction holds the full ray delta. pHits gets one entry per ray.
+void IntersectFourRaysWithOBBs( const FourRays &rays, const FourOBBs_t *pGroups, int nBoxes, RayOBBHit_t *pHits );
+
+#if defined( FASTPATH_TESTS )
+// Compares both against IntersectRayWithOBB on random boxes and rays, then times them
+bool IntersectRayWithOBBs_Validate( int nIterations );
+void IntersectRayWithOBBs_Benchmark( int nBoxes, int nRays );
+#endif
+
 //-----------------------------------------------------------------------------
 // 
 // IsSphereIntersectingSphere
@@ -288,6 +288,59 @@ int FORCEINLINE CDispCollTree::BuildRayLeafList( int iNode, rayleaflist_t &list
 	return listIndex;
 }
 
+// Same walk as BuildRayLeafList, but stops at the bottom level nodes. Each one the ray
+// reaches is stored at the front of the list as ( packet node << 4 ) | mask of the leaves
+// it hits, so the leaves come out in the same order. Returns the number of entries.
+int FORCEINLINE CDispCollTree::BuildRayPacketList( int iNode, rayleaflist_t &list )
+{
+	list.nodeList[0] = iNode;
+	int listIndex = 0;
+	int nPackets = 0;
+	list.maxIndex = 0;
+	while ( listIndex <= list.maxIndex )
+	{
+		iNode = list.nodeList[listIndex];
+		listIndex++;
+		const CDispCollNode &node = m_nodes[iNode];
+		int mask = IntersectRayWithFourBoxes( list.rayStart, list.invDelta, list.rayExtents, node.m_mins, node.m_maxs );
+		if ( !mask )
+			continue;
+
+		if ( iNode >= m_iFirstPacketNode )
+		{
+			// never overtakes listIndex, so this only overwrites nodes already walked
+			list.nodeList[nPackets] = ( ( iNode - m_iFirstPacketNode ) << 4 ) | mask;
+			nPackets++;
+			continue;
+		}
+
+		int child = Nodes_GetChild( iNode, 0 );
+		if ( mask & 1 )
+		{
+			++list.maxIndex;
+			list.nodeList[list.maxIndex] = child;
+		}
+		if ( mask & 2 )
+		{
+			++list.maxIndex;
+			list.nodeList[list.maxIndex] = child+1;
+		}
+		if ( mask & 4 )
+		{
+			++list.maxIndex;
+			list.nodeList[list.maxIndex] = child+2;
+		}
+		if ( mask & 8 )
+		{
+			++list.maxIndex;
+			list.nodeList[list.maxIndex] = child+3;
+		}
+		Assert(list.maxIndex < MAX_AABB_LIST);
+	}
+
+	return nPackets;
+}
+
 
 //-----------------------------------------------------------------------------
 // Purpose: Create the AABB tree.
@@ -303,6 +356,9 @@ bool CDispCollTree::AABBTree_Create( CCoreDispInfo *pDisp )
 	// Setup/create the leaf nodes first so the recusion can use this data to stop.
 	AABBTree_CreateLeafs();
 
+	// Pack the triangles below each bottom level node for the ray tests.
+	AABBTree_CreateTriPackets();
+
 	// Create the bounding box of the displacement surface + the base face.
 	AABBTree_CalcBounds();
 
@@ -357,6 +413,7 @@ void CDispCollTree::AABBTree_CopyDispData( CCoreDispInfo *pDisp )
 #endif
 	m_nSize += sizeof(m_nodes[0]) * m_nodes.Count();
 	m_nSize += sizeof(m_leaves[0]) * m_leaves.Count();
+	m_nSize += sizeof(CDispCollTriPacket) * 2 * ( m_leaves.Count() / 4 );
 	m_nSize += sizeof( CDispCollTri* ) * DISPCOLL_TREETRI_SIZE;
 
 	// Copy vertex data.
@@ -429,6 +486,42 @@ void CDispCollTree::AABBTree_CreateLeafs( void )
 	}
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Gather the triangles of the four leaves below each bottom level node
+//          into SoA packets.
+//-----------------------------------------------------------------------------
+void CDispCollTree::AABBTree_CreateTriPackets( void )
+{
+	int nPacketNodes = m_leaves.Count() / 4;
+	m_iFirstPacketNode = m_nodes.Count() - nPacketNodes;
+
+	{
+	MEM_ALLOC_CREDIT();
+	m_triPackets.SetCount( nPacketNodes * 2 );
+	}
+
+	for ( int iPacketNode = 0; iPacketNode < nPacketNodes; ++iPacketNode )
+	{
+		int iFirstLeaf = Nodes_GetChild( m_iFirstPacketNode + iPacketNode, 0 ) - m_nodes.Count();
+		for ( int iTri = 0; iTri < 2; ++iTri )
+		{
+			Vector v0[4], edge1[4], edge2[4];
+			for ( int iLeaf = 0; iLeaf < 4; ++iLeaf )
+			{
+				const CDispCollTri &tri = m_aTris[m_leaves[iFirstLeaf + iLeaf].m_tris[iTri]];
+				v0[iLeaf] = m_aVerts[tri.GetVert( 0 )];
+				VectorSubtract( m_aVerts[tri.GetVert( 2 )], v0[iLeaf], edge1[iLeaf] );
+				VectorSubtract( m_aVerts[tri.GetVert( 1 )], v0[iLeaf], edge2[iLeaf] );
+			}
+
+			CDispCollTriPacket &packet = m_triPackets[iPacketNode * 2 + iTri];
+			packet.m_v0.LoadAndSwizzle( v0[0], v0[1], v0[2], v0[3] );
+			packet.m_edge1.LoadAndSwizzle( edge1[0], edge1[1], edge1[2], edge1[3] );
+			packet.m_edge2.LoadAndSwizzle( edge2[0], edge2[1], edge2[2], edge2[3] );
+		}
+	}
+}
+
 void CDispCollTree::AABBTree_GenerateBoxes_r( int nodeIndex, Vector *pMins, Vector *pMaxs )
 {
 	// leaf
@@ -689,8 +782,59 @@ void CDispCollTree::AABBTree_TreeTrisRayTest( const Ray_t &ray, const Vector &ve
 	list.rayStart.DuplicateVector(ray.m_Start);
 	Vector ext = ray.m_Extents + Vector(DISPCOLL_DIST_EPSILON,DISPCOLL_DIST_EPSILON,DISPCOLL_DIST_EPSILON);
 	list.rayExtents.DuplicateVector(ext);
-	int listIndex = BuildRayLeafList( iNode, list );
+	int nPackets = BuildRayPacketList( iNode, list );
+
+	for ( int iPacket = 0; iPacket < nPackets; iPacket++ )
+	{
+		int iPacketNode = list.nodeList[iPacket] >> 4;
+		int mask = list.nodeList[iPacket] & 0xf;
+		const CDispCollTriPacket *pPackets = &m_triPackets[iPacketNode * 2];
+		fltx4 flFrac0 = IntersectRayWithFourTriangles( ray, pPackets[0].m_v0, pPackets[0].m_edge1, pPackets[0].m_edge2, bSide );
+		fltx4 flFrac1 = IntersectRayWithFourTriangles( ray, pPackets[1].m_v0, pPackets[1].m_edge1, pPackets[1].m_edge2, bSide );
+
+		// Take the hits in leaf order, first triangle first, just like the leaf list does
+		int leafIndex = Nodes_GetChild( m_iFirstPacketNode + iPacketNode, 0 ) - m_nodes.Count();
+		for ( int iLeaf = 0; iLeaf < 4; iLeaf++ )
+		{
+			if ( !( mask & ( 1 << iLeaf ) ) )
+				continue;
+
+			float flFrac = SubFloat( flFrac0, iLeaf );
+			if( ( flFrac >= 0.0f ) && ( flFrac < pTrace->fraction ) )
+			{
+				pTrace->fraction = flFrac;
+				(*pImpactTri) = &m_aTris[m_leaves[leafIndex + iLeaf].m_tris[0]];
+			}
+
+			flFrac = SubFloat( flFrac1, iLeaf );
+			if( ( flFrac >= 0.0f ) && ( flFrac < pTrace->fraction ) )
+			{
+				pTrace->fraction = flFrac;
+				(*pImpactTri) = &m_aTris[m_leaves[leafIndex + iLeaf].m_tris[1]];
+			}
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: 
+//-----------------------------------------------------------------------------
+bool CDispCollTree::AABBTree_RayReference( const Ray_t &ray, const Vector &vecInvDelta, CBaseTrace *pTrace, bool bSide )
+{
+	if ( CheckFlags( CCoreDispInfo::SURF_NORAY_COLL ) )
+		return false;
+
+	if ( !( m_nContents & MASK_OPAQUE ) )
+		return false;
 
+	rayleaflist_t list;
+	list.invDelta.DuplicateVector(vecInvDelta);
+	list.rayStart.DuplicateVector(ray.m_Start);
+	Vector ext = ray.m_Extents + Vector(DISPCOLL_DIST_EPSILON,DISPCOLL_DIST_EPSILON,DISPCOLL_DIST_EPSILON);
+	list.rayExtents.DuplicateVector(ext);
+	int listIndex = BuildRayLeafList( DISPCOLL_ROOTNODE_INDEX, list );
+
+	CDispCollTri *pImpactTri = NULL;
 	for ( ;listIndex <= list.maxIndex; listIndex++ )
 	{
 		int leafIndex = list.nodeList[listIndex] - m_nodes.Count();
@@ -700,16 +844,26 @@ void CDispCollTree::AABBTree_TreeTrisRayTest( const Ray_t &ray, const Vector &ve
 		if( ( flFrac >= 0.0f ) && ( flFrac < pTrace->fraction ) )
 		{
 			pTrace->fraction = flFrac;
-			(*pImpactTri) = pTri0;
+			pImpactTri = pTri0;
 		}
 		
 		flFrac = IntersectRayWithTriangle( ray, m_aVerts[pTri1->GetVert( 0 )], m_aVerts[pTri1->GetVert( 2 )], m_aVerts[pTri1->GetVert( 1 )], bSide );
 		if( ( flFrac >= 0.0f ) && ( flFrac < pTrace->fraction ) )
 		{
 			pTrace->fraction = flFrac;
-			(*pImpactTri) = pTri1;
+			pImpactTri = pTri1;
 		}
 	}
+
+	if ( pImpactTri )
+	{
+		VectorCopy( pImpactTri->m_vecNormal, pTrace->plane.normal );
+		pTrace->plane.dist = pImpactTri->m_flDist;
+		pTrace->dispFlags = pImpactTri->m_uiFlags;
+		return true;
+	}
+
+	return false;
 }
 
 //-----------------------------------------------------------------------------
@@ -910,22 +1064,26 @@ bool CDispCollTree::AABBTree_SweepAABB( const Ray_t &ray, const Vector &vecInvDe
 	list.rayStart.DuplicateVector(ray.m_Start);
 	Vector ext = ray.m_Extents + g_Vec3DispCollEpsilons;
 	list.rayExtents.DuplicateVector(ext);
-	int listIndex = BuildRayLeafList( 0, list );
+	int nPackets = BuildRayPacketList( 0, list );
 
-	if ( listIndex <= list.maxIndex )
+	if ( nPackets )
 	{
 		VPROF( "DispHullTest_Tris" );
 		LockCache();
-		for ( ; listIndex <= list.maxIndex; listIndex++ )
+		for ( int iPacket = 0; iPacket < nPackets; iPacket++ )
 		{
-			int leafIndex = list.nodeList[listIndex] - m_nodes.Count();
-			int iTri0 = m_leaves[leafIndex].m_tris[0];
-			int iTri1 = m_leaves[leafIndex].m_tris[1];
-			CDispCollTri *pTri0 = &m_aTris[iTri0];
-			CDispCollTri *pTri1 = &m_aTris[iTri1];
-
-			SweepAABBTriIntersect( ray, rayDir, iTri0, pTri0, pTrace );
-			SweepAABBTriIntersect( ray, rayDir, iTri1, pTri1, pTrace );
+			int mask = list.nodeList[iPacket] & 0xf;
+			int leafIndex = Nodes_GetChild( m_iFirstPacketNode + ( list.nodeList[iPacket] >> 4 ), 0 ) - m_nodes.Count();
+			for ( int iLeaf = 0; iLeaf < 4; iLeaf++ )
+			{
+				if ( !( mask & ( 1 << iLeaf ) ) )
+					continue;
+
+				int iTri0 = m_leaves[leafIndex + iLeaf].m_tris[0];
+				int iTri1 = m_leaves[leafIndex + iLeaf].m_tris[1];
+				SweepAABBTriIntersect( ray, rayDir, iTri0, &m_aTris[iTri0], pTrace );
+				SweepAABBTriIntersect( ray, rayDir, iTri1, &m_aTris[iTri1], pTrace );
+			}
 		}
 		UnlockCache();
 	}
@@ -1416,6 +1574,7 @@ CDispCollTree::CDispCollTree()
 	m_maxs.Init( -FLT_MAX, -FLT_MAX, -FLT_MAX );
 
 	m_iCounter = 0;
+	m_iFirstPacketNode = 0;
 
 	m_aVerts.Purge();
 	m_aTris.Purge();
@@ -1436,6 +1595,7 @@ CDispCollTree::~CDispCollTree()
 #endif
 	m_aVerts.Purge();
 	m_aTris.Purge();
+	m_triPackets.Purge();
 	m_aEdgePlanes.Purge();
 }
 
@@ -1538,3 +1698,312 @@ void DispCollTrees_Free( CDispCollTree *pTrees )
 	}
 #endif
 }
+
+
+#if defined( FASTPATH_TESTS )
+
+#ifndef ENGINE_DLL
+//-----------------------------------------------------------------------------
+// Purpose: Points at a lump of a BSP file image, if it's there, in range and
+//          not compressed
+//-----------------------------------------------------------------------------
+template< class T >
+static const T *DispCollTrees_GetLump( const BSPHeader_t *pHeader, int nFileSize, int iLump, int *pCount )
+{
+	const lump_t &lump = pHeader->lumps[iLump];
+	*pCount = 0;
+	if ( ( lump.fileofs < 0 ) || ( lump.filelen < 0 ) || ( lump.fileofs > nFileSize - lump.filelen ) )
+		return NULL;
+	if ( lump.fourCC[0] || lump.fourCC[1] || lump.fourCC[2] || lump.fourCC[3] )
+		return NULL;
+
+	*pCount = lump.filelen / sizeof( T );
+	return (const T *)( (const byte *)pHeader + lump.fileofs );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Builds the trees of every displacement in a BSP file image. The
+//          collision flags aren't in the file, so every tree takes rays and hulls.
+//-----------------------------------------------------------------------------
+CDispCollTree *DispCollTrees_CreateFromBSP( const void *pFileData, int nFileSize, int *pTreeCount )
+{
+	*pTreeCount = 0;
+
+	const BSPHeader_t *pHeader = (const BSPHeader_t *)pFileData;
+	if ( ( nFileSize < (int)sizeof( BSPHeader_t ) ) || ( pHeader->ident != IDBSPHEADER ) )
+	{
+		Warning( "DispCollTrees_CreateFromBSP: not a BSP file\n" );
+		return NULL;
+	}
+	if ( ( pHeader->m_nVersion < MINBSPVERSION ) || ( pHeader->m_nVersion > BSPVERSION ) )
+	{
+		Warning( "DispCollTrees_CreateFromBSP: BSP version %d, expected %d to %d\n", pHeader->m_nVersion, MINBSPVERSION, BSPVERSION );
+		return NULL;
+	}
+
+	int nDispInfos, nDispVerts, nDispTris, nFaces, nVerts, nEdges, nSurfEdges;
+	const ddispinfo_t *pDispInfos = DispCollTrees_GetLump<ddispinfo_t>( pHeader, nFileSize, LUMP_DISPINFO, &nDispInfos );
+	const CDispVert *pDispVerts = DispCollTrees_GetLump<CDispVert>( pHeader, nFileSize, LUMP_DISP_VERTS, &nDispVerts );
+	const CDispTri *pDispTris = DispCollTrees_GetLump<CDispTri>( pHeader, nFileSize, LUMP_DISP_TRIS, &nDispTris );
+	const dface_t *pFaces = DispCollTrees_GetLump<dface_t>( pHeader, nFileSize, LUMP_FACES, &nFaces );
+	const dvertex_t *pVerts = DispCollTrees_GetLump<dvertex_t>( pHeader, nFileSize, LUMP_VERTEXES, &nVerts );
+	const dedge_t *pEdges = DispCollTrees_GetLump<dedge_t>( pHeader, nFileSize, LUMP_EDGES, &nEdges );
+	const int *pSurfEdges = DispCollTrees_GetLump<int>( pHeader, nFileSize, LUMP_SURFEDGES, &nSurfEdges );
+	if ( !nDispInfos || !pDispVerts || !pDispTris || !pFaces || !pVerts || !pEdges || !pSurfEdges )
+	{
+		Warning( "DispCollTrees_CreateFromBSP: no displacements, or compressed lumps\n" );
+		return NULL;
+	}
+
+	CDispCollTree *pTrees = new CDispCollTree[nDispInfos];
+	int nTrees = 0;
+	for ( int iDisp = 0; iDisp < nDispInfos; ++iDisp )
+	{
+		const ddispinfo_t &dispInfo = pDispInfos[iDisp];
+		if ( ( dispInfo.power < 1 ) || ( dispInfo.power > MAX_MAP_DISP_POWER ) ||
+			 ( dispInfo.m_iDispVertStart < 0 ) || ( dispInfo.m_iDispVertStart + dispInfo.NumVerts() > nDispVerts ) ||
+			 ( dispInfo.m_iDispTriStart < 0 ) || ( dispInfo.m_iDispTriStart + dispInfo.NumTris() > nDispTris ) ||
+			 ( dispInfo.m_iMapFace >= nFaces ) )
+			continue;
+
+		const dface_t &face = pFaces[dispInfo.m_iMapFace];
+		if ( ( face.numedges != 4 ) || ( face.firstedge < 0 ) || ( face.firstedge + 4 > nSurfEdges ) )
+			continue;
+
+		CCoreDispInfo coreDisp;
+		CCoreDispSurface *pDispSurf = coreDisp.GetSurface();
+		pDispSurf->SetPointStart( dispInfo.startPosition );
+		pDispSurf->SetContents( dispInfo.contents );
+		coreDisp.InitDispInfo( dispInfo.power, dispInfo.minTess, dispInfo.smoothingAngle,
+			&pDispVerts[dispInfo.m_iDispVertStart], &pDispTris[dispInfo.m_iDispTriStart], 0, NULL );
+
+		// The base face's points
+		bool bValid = true;
+		pDispSurf->SetPointCount( 4 );
+		for ( int iPoint = 0; iPoint < 4; ++iPoint )
+		{
+			int iEdge = pSurfEdges[face.firstedge + iPoint];
+			int iAbsEdge = ( iEdge < 0 ) ? -iEdge : iEdge;
+			if ( iAbsEdge >= nEdges )
+			{
+				bValid = false;
+				break;
+			}
+			int iVert = ( iEdge < 0 ) ? pEdges[iAbsEdge].v[1] : pEdges[iAbsEdge].v[0];
+			if ( iVert >= nVerts )
+			{
+				bValid = false;
+				break;
+			}
+			pDispSurf->SetPoint( iPoint, pVerts[iVert].point );
+		}
+		if ( !bValid )
+			continue;
+
+		pDispSurf->FindSurfPointStartIndex();
+		pDispSurf->AdjustSurfPointData();
+		if ( !coreDisp.CreateWithoutLOD() )
+			continue;
+
+		if ( pTrees[nTrees].Create( &coreDisp ) )
+		{
+			pTrees[nTrees].m_iCounter = nTrees;
+			++nTrees;
+		}
+	}
+
+	if ( !nTrees )
+	{
+		delete [] pTrees;
+		return NULL;
+	}
+
+	*pTreeCount = nTrees;
+	return pTrees;
+}
+#endif // !ENGINE_DLL
+
+//-----------------------------------------------------------------------------
+// Random rays and hulls through the bounds of a tree
+//-----------------------------------------------------------------------------
+static float DispTraceTestRandomFloat( uint32 &nSeed, float flMin, float flMax )
+{
+	nSeed = nSeed * 1664525 + 1013904223;
+	return flMin + ( flMax - flMin ) * ( ( nSeed >> 8 ) * ( 1.0f / 16777216.0f ) );
+}
+
+static void DispTraceTestRandomTrace( uint32 &nSeed, CDispCollTree &tree, bool bHull, Ray_t &ray )
+{
+	Vector vecMins, vecMaxs, vecStart, vecEnd;
+	tree.GetBounds( vecMins, vecMaxs );
+	for ( int i = 0; i < 3; ++i )
+	{
+		vecStart[i] = DispTraceTestRandomFloat( nSeed, vecMins[i] - 32.0f, vecMaxs[i] + 32.0f );
+		vecEnd[i] = DispTraceTestRandomFloat( nSeed, vecMins[i] - 32.0f, vecMaxs[i] + 32.0f );
+	}
+
+	if ( bHull )
+	{
+		Vector vecExtents( DispTraceTestRandomFloat( nSeed, 1.0f, 16.0f ), DispTraceTestRandomFloat( nSeed, 1.0f, 16.0f ), DispTraceTestRandomFloat( nSeed, 1.0f, 36.0f ) );
+		ray.Init( vecStart, vecEnd, -vecExtents, vecExtents );
+	}
+	else
+	{
+		ray.Init( vecStart, vecEnd );
+	}
+}
+
+static void DispTraceTestClear( CBaseTrace &trace )
+{
+	memset( &trace, 0, sizeof( trace ) );
+	trace.fraction = 1.0f;
+}
+
+static bool DispTraceTestMatches( const CBaseTrace &trace0, const CBaseTrace &trace1 )
+{
+	return !memcmp( &trace0.fraction, &trace1.fraction, sizeof( float ) ) &&
+		!memcmp( &trace0.plane.normal, &trace1.plane.normal, sizeof( Vector ) ) &&
+		!memcmp( &trace0.plane.dist, &trace1.plane.dist, sizeof( float ) ) &&
+		( trace0.dispFlags == trace1.dispFlags );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Every ray and swept box has to come out of the packet walk with the
+//          exact fraction, plane and flags the leaf by leaf walk finds
+//-----------------------------------------------------------------------------
+bool DispCollTrees_ValidateTraces( CDispCollTree *pTrees, int nTrees, int nTraces )
+{
+	if ( !nTrees )
+		return true;
+
+	uint32 nSeed = 0x5eed1e55;
+	int nErrors = 0;
+	int nHits = 0;
+	for ( int iTrace = 0; iTrace < nTraces; ++iTrace )
+	{
+		CDispCollTree &tree = pTrees[iTrace % nTrees];
+		bool bHull = ( iTrace & 1 ) != 0;
+		Ray_t ray;
+		DispTraceTestRandomTrace( nSeed, tree, bHull, ray );
+		Vector vecInvDelta = ray.InvDelta();
+
+		CBaseTrace trace, traceReference;
+		bool bSide = ( iTrace & 2 ) != 0;
+		DispTraceTestClear( trace );
+		DispTraceTestClear( traceReference );
+		bool bHit = tree.AABBTree_Ray( ray, vecInvDelta, &trace, bSide );
+		bool bHitReference = tree.AABBTree_RayReference( ray, vecInvDelta, &traceReference, bSide );
+		nHits += bHitReference;
+		if ( ( bHit != bHitReference ) || !DispTraceTestMatches( trace, traceReference ) )
+		{
+			if ( nErrors < 10 )
+			{
+				Warning( "DispCollTrees_ValidateTraces: ray %d on disp %d: hit %d/%d fraction %.9g/%.9g\n",
+					iTrace, tree.m_iCounter, bHit, bHitReference, trace.fraction, traceReference.fraction );
+			}
+			++nErrors;
+		}
+
+		if ( !bHull )
+			continue;
+
+		// Hull sweeps, against SweepAABBTriIntersect over the leaf list
+		DispTraceTestClear( trace );
+		DispTraceTestClear( traceReference );
+		tree.AABBTree_SweepAABB( ray, vecInvDelta, &trace );
+
+		Vector rayDir = ray.m_Delta;
+		VectorNormalize( rayDir );
+		rayleaflist_t list;
+		list.invDelta.DuplicateVector( vecInvDelta );
+		list.rayStart.DuplicateVector( ray.m_Start );
+		list.rayExtents.DuplicateVector( ray.m_Extents + g_Vec3DispCollEpsilons );
+		int listIndex = tree.BuildRayLeafList( 0, list );
+		tree.LockCache();
+		for ( ; listIndex <= list.maxIndex; listIndex++ )
+		{
+			int leafIndex = list.nodeList[listIndex] - tree.m_nodes.Count();
+			int iTri0 = tree.m_leaves[leafIndex].m_tris[0];
+			int iTri1 = tree.m_leaves[leafIndex].m_tris[1];
+			tree.SweepAABBTriIntersect( ray, rayDir, iTri0, &tree.m_aTris[iTri0], &traceReference );
+			tree.SweepAABBTriIntersect( ray, rayDir, iTri1, &tree.m_aTris[iTri1], &traceReference );
+		}
+		tree.UnlockCache();
+
+		if ( !DispTraceTestMatches( trace, traceReference ) )
+		{
+			if ( nErrors < 10 )
+			{
+				Warning( "DispCollTrees_ValidateTraces: sweep %d on disp %d: fraction %.9g/%.9g\n",
+					iTrace, tree.m_iCounter, trace.fraction, traceReference.fraction );
+			}
+			++nErrors;
+		}
+	}
+
+	Msg( "DispCollTrees_ValidateTraces: %d traces on %d displacements, %d ray hits, %d mismatches\n", nTraces, nTrees, nHits, nErrors );
+	return nErrors == 0;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Times the packet ray test against the leaf by leaf one, and the
+//          hull sweeps
+//-----------------------------------------------------------------------------
+void DispCollTrees_BenchmarkTraces( CDispCollTree *pTrees, int nTrees, int nTraces )
+{
+	if ( !nTrees || ( nTraces <= 0 ) )
+		return;
+
+	CUtlVector< Ray_t > rays;
+	CUtlVector< Ray_t > hulls;
+	rays.SetCount( nTraces );
+	hulls.SetCount( nTraces );
+	uint32 nSeed = 0x0b5e55ed;
+	for ( int i = 0; i < nTraces; ++i )
+	{
+		DispTraceTestRandomTrace( nSeed, pTrees[i % nTrees], false, rays[i] );
+		DispTraceTestRandomTrace( nSeed, pTrees[i % nTrees], true, hulls[i] );
+	}
+
+	// Fill the edge plane caches before timing anything
+	for ( int i = 0; i < nTrees; ++i )
+	{
+		pTrees[i].LockCache();
+		pTrees[i].UnlockCache();
+	}
+
+	CBaseTrace trace;
+	int nHits = 0;
+	double flStart = Plat_FloatTime();
+	for ( int i = 0; i < nTraces; ++i )
+	{
+		DispTraceTestClear( trace );
+		nHits += pTrees[i % nTrees].AABBTree_RayReference( rays[i], rays[i].InvDelta(), &trace );
+	}
+	double flReference = Plat_FloatTime() - flStart;
+
+	int nPacketHits = 0;
+	flStart = Plat_FloatTime();
+	for ( int i = 0; i < nTraces; ++i )
+	{
+		DispTraceTestClear( trace );
+		nPacketHits += pTrees[i % nTrees].AABBTree_Ray( rays[i], rays[i].InvDelta(), &trace );
+	}
+	double flPacket = Plat_FloatTime() - flStart;
+
+	int nHullHits = 0;
+	flStart = Plat_FloatTime();
+	for ( int i = 0; i < nTraces; ++i )
+	{
+		DispTraceTestClear( trace );
+		nHullHits += pTrees[i % nTrees].AABBTree_SweepAABB( hulls[i], hulls[i].InvDelta(), &trace );
+	}
+	double flHull = Plat_FloatTime() - flStart;
+
+	Msg( "DispCollTrees_BenchmarkTraces: %d traces on %d displacements, %d ray hits (%d reference), %d hull hits\n", nTraces, nTrees, nPacketHits, nHits, nHullHits );
+	Msg( "  AABBTree_RayReference: %8.3f ms\n", flReference * 1000.0 );
+	Msg( "  AABBTree_Ray:          %8.3f ms, %.2fx\n", flPacket * 1000.0, flPacket > 0.0 ? flReference / flPacket : 0.0 );
+	Msg( "  AABBTree_SweepAABB:    %8.3f ms\n", flHull * 1000.0 );
+}
+
+#endif // FASTPATH_TESTS
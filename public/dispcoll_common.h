@@ -135,6 +135,17 @@ public:
 	short	m_tris[2];
 };
 
+// The triangles of the four leaves below a bottom level node, one packet for
+// the first triangle of each leaf and one for the second. The edges are the
+// ones IntersectRayWithTriangle computes for ( v0, v2, v1 ).
+class CDispCollTriPacket
+{
+public:
+	FourVectors m_v0;
+	FourVectors m_edge1;	// v2 - v0
+	FourVectors m_edge2;	// v1 - v0
+};
+
 // a power 4 displacement can have 341 nodes, pad out to 344 for 16-byte alignment
 const int MAX_DISP_AABB_NODES = 341;
 const int MAX_AABB_LIST = 344;
@@ -167,6 +178,8 @@ public:
 	bool AABBTree_Ray( const Ray_t &ray, const Vector &invDelta, RayDispOutput_t &output );
 	// NOTE: Lower perf helper function, should not be used in the game runtime
 	bool AABBTree_Ray( const Ray_t &ray, RayDispOutput_t &output );
+	// NOTE: Tests leaf by leaf, one triangle at a time; only kept to validate the packet path against
+	bool AABBTree_RayReference( const Ray_t &ray, const Vector &invDelta, CBaseTrace *pTrace, bool bSide = true );
 
 	// Hull Sweeps.
 	// NOTE: These assume you've precalculated invDelta as well as culled to the bounds of this disp
@@ -208,6 +221,11 @@ public:
 	void GetVirtualMeshList( struct virtualmeshlist_t *pList );
 	int AABBTree_GetTrisInSphere( const Vector &center, float radius, unsigned short *pIndexOut, int indexMax );
 
+#if defined( FASTPATH_TESTS )
+	// Compares the packet walks against the leaf by leaf ones
+	friend bool DispCollTrees_ValidateTraces( CDispCollTree *pTrees, int nTrees, int nTraces );
+#endif
+
 public:
 
 	inline int Nodes_GetChild( int iNode, int nDirection );
@@ -256,6 +274,7 @@ protected:
 	bool AABBTree_Create( CCoreDispInfo *pDisp );
 	void AABBTree_CopyDispData( CCoreDispInfo *pDisp );
 	void AABBTree_CreateLeafs( void );
+	void AABBTree_CreateTriPackets( void );
 	void AABBTree_GenerateBoxes_r( int nodeIndex, Vector *pMins, Vector *pMaxs );
 	void AABBTree_CalcBounds( void );
 
@@ -265,6 +284,7 @@ protected:
 	void AABBTree_TreeTrisRayBarycentricTest( const Ray_t &ray, const Vector &vecInvDelta, int iNode, RayDispOutput_t &output, CDispCollTri **pImpactTri );
 
 	int FORCEINLINE BuildRayLeafList( int iNode, rayleaflist_t &list );
+	int FORCEINLINE BuildRayPacketList( int iNode, rayleaflist_t &list );
 
 	struct AABBTree_TreeTrisSweepTest_Args_t
 	{
@@ -325,6 +345,8 @@ protected:
 	CDispVector<CDispCollTri>		m_aTris;								// Displacement triangles.
 	CDispVector<CDispCollNode>		m_nodes;					// Nodes.
 	CDispVector<CDispCollLeaf>		m_leaves;								// Leaves.
+	CDispVector<CDispCollTriPacket>	m_triPackets;							// Two per bottom level node.
+	int								m_iFirstPacketNode;						// First bottom level node.
 	// Cache
 	CUtlVector<CDispCollTriCache>	m_aTrisCache;
 	CUtlVector<Vector> m_aEdgePlanes;
@@ -453,4 +475,18 @@ inline void CDispCollTree::CalcClosestExtents( const Vector &vecPlaneNormal, con
 CDispCollTree *DispCollTrees_Alloc( int count );
 void DispCollTrees_Free( CDispCollTree *pTrees );
 
+#if defined( FASTPATH_TESTS )
+#ifndef ENGINE_DLL
+// Builds the trees of every displacement in a BSP file image, the way the map
+// loader does, to feed the trace checks below. They come from new [], so
+// delete [] them.
+CDispCollTree *DispCollTrees_CreateFromBSP( const void *pFileData, int nFileSize, int *pTreeCount );
+#endif
+
+// Traces random rays and hulls through the trees, comparing the packet path
+// against the leaf by leaf one, then times both
+bool DispCollTrees_ValidateTraces( CDispCollTree *pTrees, int nTrees, int nTraces );
+void DispCollTrees_BenchmarkTraces( CDispCollTree *pTrees, int nTrees, int nTraces );
+#endif
+
 #endif // DISPCOLL_COMMON_H
@@ -42,68 +42,12 @@ char *VarArgs( const char *format, ... )
 }
 #endif
 
-//-----------------------------------------------------------------------------
-JiggleData *CJiggleBones::GetJiggleData( int bone, float currenttime, const Vector &initBasePos, const Vector &initTipPos )
-{
-	FOR_EACH_LL( m_jiggleBoneState, it )
-	{
-		if ( m_jiggleBoneState[it].bone == bone )
-		{
-			JiggleData *data = &m_jiggleBoneState[it];
-			if ( !IsFinite( data->lastUpdate ) )
-			{
-				Warning( "lastUpdate NaN\n" );
-			}
-			if ( !data->basePos.IsValid() )
-			{
-				Warning( "basePos NaN\n" );
-			}
-			if ( !data->baseLastPos.IsValid() )
-			{
-				Warning( "baseLastPos NaN\n" );
-			}
-			if ( !data->baseVel.IsValid() )
-			{
-				Warning( "baseVel NaN\n" );
-			}
-			if ( !data->baseAccel.IsValid() )
-			{
-				Warning( "baseAccel NaN\n" );
-			}
-			if ( !data->tipPos.IsValid() )
-			{
-				Warning( "tipPos NaN\n" );
-			}
-			if ( !data->tipVel.IsValid() )
-			{
-				Warning( "tipVel NaN\n" );
-			}
-			if ( !data->tipAccel.IsValid() )
-			{
-				Warning( "tipAccel NaN\n" );
-			}
-			return &m_jiggleBoneState[it];
-		}
-	}
-
-	JiggleData data;
-	data.Init( bone, currenttime, initBasePos, initTipPos );
-	data.id = s_id++;
-
-	int idx = m_jiggleBoneState.AddToHead( data );
-	if ( idx == m_jiggleBoneState.InvalidIndex() )
-		return NULL;
-
-	return &m_jiggleBoneState[idx];
-}
-
-
 //-----------------------------------------------------------------------------
 /**
  * Do spring physics calculations and update "jiggle bone" matrix
  * (Michael Booth, Turtle Rock Studios)
  */
-void CJiggleBones::BuildJiggleTransformations( int boneIndex, float currenttime, const mstudiojigglebone_t *jiggleInfo, const matrix3x4_t &goalMX, matrix3x4_t &boneMX )
+static void SimulateJiggleBone( JiggleData *data, int boneIndex, float currenttime, const mstudiojigglebone_t *jiggleInfo, const matrix3x4_t &goalMX, matrix3x4_t &boneMX )
 {
 	Vector goalBasePosition;
 	MatrixPosition( goalMX, goalBasePosition );
@@ -116,12 +60,6 @@ void CJiggleBones::BuildJiggleTransformations( int boneIndex, float currenttime,
 	// compute goal tip position
 	Vector goalTip = goalBasePosition + jiggleInfo->length * goalForward;
 
-	JiggleData *data = GetJiggleData( boneIndex, currenttime, goalBasePosition, goalTip );
-	if ( !data )
-	{
-		return;
-	}
-
 	if ( currenttime - data->lastUpdate > 0.5f )
 	{
 		data->Init( boneIndex, currenttime, goalBasePosition, goalTip );
@@ -641,3 +579,828 @@ void CJiggleBones::BuildJiggleTransformations( int boneIndex, float currenttime,
 	}
 }
 
+
+
+//-----------------------------------------------------------------------------
+// Batched jiggle bones
+//-----------------------------------------------------------------------------
+
+// A lane that has never been stepped; its first step initializes it
+#define JIGGLE_NEVER_UPDATED	(-FLT_MAX)
+
+CJiggleBones::CJiggleBones()
+{
+	m_nQueued = 0;
+}
+
+
+//-----------------------------------------------------------------------------
+int CJiggleBones::FindOrAddSlot( int boneIndex, int nLevel, const mstudiojigglebone_t *jiggleInfo )
+{
+	while ( m_BoneSlot.Count() <= boneIndex )
+	{
+		m_BoneSlot.AddToTail( -1 );
+	}
+
+	int nSlot = m_BoneSlot[boneIndex];
+	if ( nSlot >= 0 )
+	{
+		JiggleBoneGroup_t &group = m_Groups[ nSlot >> 2 ];
+		if ( group.pJiggleInfo[ nSlot & 3 ] != jiggleInfo )
+		{
+			SetLaneParams( group, nSlot & 3, jiggleInfo );
+		}
+		return nSlot;
+	}
+
+	int iGroup;
+	for ( iGroup = 0; iGroup < m_Groups.Count(); iGroup++ )
+	{
+		if ( m_Groups[iGroup].nLevel == nLevel && m_Groups[iGroup].nLanes < 4 )
+			break;
+	}
+
+	if ( iGroup == m_Groups.Count() )
+	{
+		iGroup = m_Groups.AddToTail();
+		JiggleBoneGroup_t &group = m_Groups[iGroup];
+		memset( &group, 0, sizeof( group ) );
+		group.state.lastUpdate = ReplicateX4( JIGGLE_NEVER_UPDATED );
+		group.nLevel = nLevel;
+	}
+
+	JiggleBoneGroup_t &group = m_Groups[iGroup];
+	int nLane = group.nLanes++;
+	group.bone[nLane] = boneIndex;
+	group.id[nLane] = s_id++;
+	SetLaneParams( group, nLane, jiggleInfo );
+
+	nSlot = iGroup * 4 + nLane;
+	m_BoneSlot[boneIndex] = nSlot;
+	return nSlot;
+}
+
+
+//-----------------------------------------------------------------------------
+void CJiggleBones::SetLaneParams( JiggleBoneGroup_t &group, int nLane, const mstudiojigglebone_t *jiggleInfo )
+{
+	group.pJiggleInfo[nLane] = jiggleInfo;
+
+	SubFloat( group.length, nLane ) = jiggleInfo->length;
+	SubFloat( group.tipMass, nLane ) = jiggleInfo->tipMass;
+	SubFloat( group.yawStiffness, nLane ) = jiggleInfo->yawStiffness;
+	SubFloat( group.yawDamping, nLane ) = jiggleInfo->yawDamping;
+	SubFloat( group.pitchStiffness, nLane ) = jiggleInfo->pitchStiffness;
+	SubFloat( group.pitchDamping, nLane ) = jiggleInfo->pitchDamping;
+	SubFloat( group.alongStiffness, nLane ) = jiggleInfo->alongStiffness;
+	SubFloat( group.alongDamping, nLane ) = jiggleInfo->alongDamping;
+	SubFloat( group.angleLimit, nLane ) = jiggleInfo->angleLimit;
+	SubFloat( group.maxBetween, nLane ) = jiggleInfo->length * sin( jiggleInfo->angleLimit );
+	SubFloat( group.baseMass, nLane ) = jiggleInfo->baseMass;
+	SubFloat( group.baseStiffness, nLane ) = jiggleInfo->baseStiffness;
+	SubFloat( group.baseDamping, nLane ) = jiggleInfo->baseDamping;
+	SubFloat( group.baseMinLeft, nLane ) = jiggleInfo->baseMinLeft;
+	SubFloat( group.baseMaxLeft, nLane ) = jiggleInfo->baseMaxLeft;
+	SubFloat( group.baseLeftFriction, nLane ) = jiggleInfo->baseLeftFriction;
+	SubFloat( group.baseMinUp, nLane ) = jiggleInfo->baseMinUp;
+	SubFloat( group.baseMaxUp, nLane ) = jiggleInfo->baseMaxUp;
+	SubFloat( group.baseUpFriction, nLane ) = jiggleInfo->baseUpFriction;
+	SubFloat( group.baseMinForward, nLane ) = jiggleInfo->baseMinForward;
+	SubFloat( group.baseMaxForward, nLane ) = jiggleInfo->baseMaxForward;
+	SubFloat( group.baseForwardFriction, nLane ) = jiggleInfo->baseForwardFriction;
+
+	int flags = jiggleInfo->flags;
+	SubInt( group.isTip, nLane ) = ( flags & ( JIGGLE_IS_FLEXIBLE | JIGGLE_IS_RIGID ) ) ? ~0 : 0;
+	SubInt( group.isFlexible, nLane ) = ( flags & JIGGLE_IS_FLEXIBLE ) ? ~0 : 0;
+	SubInt( group.hasAngleConstraint, nLane ) = ( flags & JIGGLE_HAS_ANGLE_CONSTRAINT ) ? ~0 : 0;
+	SubInt( group.hasLengthConstraint, nLane ) = ( flags & JIGGLE_HAS_LENGTH_CONSTRAINT ) ? ~0 : 0;
+	SubInt( group.hasBaseSpring, nLane ) = ( flags & JIGGLE_HAS_BASE_SPRING ) ? ~0 : 0;
+
+	// yaw and pitch limits clip against a rotated frame per bone
+	SubInt( group.isSIMD, nLane ) = ( flags & ( JIGGLE_HAS_YAW_CONSTRAINT | JIGGLE_HAS_PITCH_CONSTRAINT ) ) ? 0 : ~0;
+}
+
+
+//-----------------------------------------------------------------------------
+static FORCEINLINE void SetLaneVector( FourVectors &v, int nLane, const Vector &src )
+{
+	v.X( nLane ) = src.x;
+	v.Y( nLane ) = src.y;
+	v.Z( nLane ) = src.z;
+}
+
+void CJiggleBones::GetLaneData( const JiggleBoneGroup_t &group, int nLane, JiggleData &data )
+{
+	data.bone = group.bone[nLane];
+	data.id = group.id[nLane];
+	data.lastUpdate = SubFloat( group.state.lastUpdate, nLane );
+	data.basePos = group.state.basePos.Vec( nLane );
+	data.baseLastPos = group.state.baseLastPos.Vec( nLane );
+	data.baseVel = group.state.baseVel.Vec( nLane );
+	data.baseAccel = group.state.baseAccel.Vec( nLane );
+	data.tipPos = group.state.tipPos.Vec( nLane );
+	data.tipVel = group.state.tipVel.Vec( nLane );
+	data.tipAccel = group.state.tipAccel.Vec( nLane );
+}
+
+void CJiggleBones::SetLaneData( JiggleBoneGroup_t &group, int nLane, const JiggleData &data )
+{
+	SubFloat( group.state.lastUpdate, nLane ) = data.lastUpdate;
+	SetLaneVector( group.state.basePos, nLane, data.basePos );
+	SetLaneVector( group.state.baseLastPos, nLane, data.baseLastPos );
+	SetLaneVector( group.state.baseVel, nLane, data.baseVel );
+	SetLaneVector( group.state.baseAccel, nLane, data.baseAccel );
+	SetLaneVector( group.state.tipPos, nLane, data.tipPos );
+	SetLaneVector( group.state.tipVel, nLane, data.tipVel );
+	SetLaneVector( group.state.tipAccel, nLane, data.tipAccel );
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Step one jiggle bone right away
+ */
+void CJiggleBones::BuildJiggleTransformations( int boneIndex, float currenttime, const mstudiojigglebone_t *jiggleInfo, const matrix3x4_t &goalMX, matrix3x4_t &boneMX )
+{
+	int nSlot = FindOrAddSlot( boneIndex, 0, jiggleInfo );
+	JiggleBoneGroup_t &group = m_Groups[ nSlot >> 2 ];
+
+	JiggleData data;
+	GetLaneData( group, nSlot & 3, data );
+
+	if ( !IsFinite( data.lastUpdate ) )
+	{
+		Warning( "lastUpdate NaN\n" );
+	}
+	if ( !data.basePos.IsValid() )
+	{
+		Warning( "basePos NaN\n" );
+	}
+	if ( !data.baseLastPos.IsValid() )
+	{
+		Warning( "baseLastPos NaN\n" );
+	}
+	if ( !data.baseVel.IsValid() )
+	{
+		Warning( "baseVel NaN\n" );
+	}
+	if ( !data.baseAccel.IsValid() )
+	{
+		Warning( "baseAccel NaN\n" );
+	}
+	if ( !data.tipPos.IsValid() )
+	{
+		Warning( "tipPos NaN\n" );
+	}
+	if ( !data.tipVel.IsValid() )
+	{
+		Warning( "tipVel NaN\n" );
+	}
+	if ( !data.tipAccel.IsValid() )
+	{
+		Warning( "tipAccel NaN\n" );
+	}
+
+	SimulateJiggleBone( &data, boneIndex, currenttime, jiggleInfo, goalMX, boneMX );
+	SetLaneData( group, nSlot & 3, data );
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Queue a jiggle bone for the next StepQueuedJiggleTransformations(). The
+ * goal matrix is copied; pBoneMX is written by the step.
+ */
+void CJiggleBones::QueueJiggleTransformations( int boneIndex, int nLevel, const mstudiojigglebone_t *jiggleInfo, const matrix3x4_t &goalMX, matrix3x4_t *pBoneMX )
+{
+	int nSlot = FindOrAddSlot( boneIndex, nLevel, jiggleInfo );
+	JiggleBoneGroup_t &group = m_Groups[ nSlot >> 2 ];
+	int nLane = nSlot & 3;
+
+	Assert( !( group.nQueuedMask & ( 1 << nLane ) ) );
+	MatrixCopy( goalMX, group.goalMX[nLane] );
+	group.pBoneMX[nLane] = pBoneMX;
+	group.nQueuedMask |= 1 << nLane;
+	m_nQueued++;
+}
+
+
+//-----------------------------------------------------------------------------
+void CJiggleBones::StepQueuedJiggleTransformations( float currenttime )
+{
+	if ( !m_nQueued )
+		return;
+
+	// the debug display and the invert test only exist in the scalar solver
+	bool bScalarOnly = ( JiggleBoneDebug.GetInt() != 0 ) || JiggleBoneInvert.GetBool();
+
+	for ( int i = 0; i < m_Groups.Count(); i++ )
+	{
+		if ( m_Groups[i].nQueuedMask )
+		{
+			StepGroup( m_Groups[i], currenttime, bScalarOnly );
+		}
+	}
+
+	m_nQueued = 0;
+}
+
+void CJiggleBones::StepQueuedJiggleTransformations( CJiggleBones * const *ppJiggleBones, int nCount, float currenttime )
+{
+	for ( int i = 0; i < nCount; i++ )
+	{
+		ppJiggleBones[i]->StepQueuedJiggleTransformations( currenttime );
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+void CJiggleBones::StepGroup( JiggleBoneGroup_t &group, float currenttime, bool bScalarOnly )
+{
+	int nSIMDMask = bScalarOnly ? 0 : ( group.nQueuedMask & TestSignSIMD( group.isSIMD ) );
+	int nScalarMask = group.nQueuedMask & ~nSIMDMask;
+	group.nQueuedMask = 0;
+
+	if ( nSIMDMask )
+	{
+		StepGroupSIMD( group, nSIMDMask, currenttime );
+	}
+
+	for ( int nLane = 0; nScalarMask; nLane++, nScalarMask >>= 1 )
+	{
+		if ( !( nScalarMask & 1 ) )
+			continue;
+
+		JiggleData data;
+		GetLaneData( group, nLane, data );
+		SimulateJiggleBone( &data, group.bone[nLane], currenttime, group.pJiggleInfo[nLane], group.goalMX[nLane], *group.pBoneMX[nLane] );
+		SetLaneData( group, nLane, data );
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// fltx4 versions of the Vector operations SimulateJiggleBone() uses. Each one
+// does the same float operations in the same order, so the lanes come out
+// as the scalar solver would have them.
+//-----------------------------------------------------------------------------
+static FORCEINLINE FourVectors ScaleFourVectors( const FourVectors &v, const fltx4 &fl4Scale )
+{
+	FourVectors ret;
+	ret.x = MulSIMD( v.x, fl4Scale );
+	ret.y = MulSIMD( v.y, fl4Scale );
+	ret.z = MulSIMD( v.z, fl4Scale );
+	return ret;
+}
+
+static FORCEINLINE FourVectors AddFourVectors( const FourVectors &a, const FourVectors &b )
+{
+	FourVectors ret;
+	ret.x = AddSIMD( a.x, b.x );
+	ret.y = AddSIMD( a.y, b.y );
+	ret.z = AddSIMD( a.z, b.z );
+	return ret;
+}
+
+// DotProduct()
+static FORCEINLINE fltx4 DotFourVectors( const FourVectors &a, const FourVectors &b )
+{
+	return AddSIMD( AddSIMD( MulSIMD( a.x, b.x ), MulSIMD( a.y, b.y ) ), MulSIMD( a.z, b.z ) );
+}
+
+// NormalizeVector(): v / |v|, or ( 0, 0, 1 ) for a zero vector
+static FORCEINLINE void NormalizeFourVectors( FourVectors &v )
+{
+	fltx4 fl4Length = SqrtSIMD( DotFourVectors( v, v ) );
+	fltx4 fl4Zero = CmpEqSIMD( fl4Length, Four_Zeros );
+	fltx4 fl4Scale = DivSIMD( Four_Ones, fl4Length );
+	v.x = MaskedAssign( fl4Zero, Four_Zeros, MulSIMD( v.x, fl4Scale ) );
+	v.y = MaskedAssign( fl4Zero, Four_Zeros, MulSIMD( v.y, fl4Scale ) );
+	v.z = MaskedAssign( fl4Zero, Four_Ones, MulSIMD( v.z, fl4Scale ) );
+}
+
+// JiggleData::Init() on the lanes of fl4Mask
+static FORCEINLINE void InitFourJiggleData( FourJiggleData &data, const fltx4 &fl4Mask, const fltx4 &fl4Time, const FourVectors &basePos, const FourVectors &tipPos )
+{
+	FourVectors zero;
+	zero.DuplicateVector( vec3_origin );
+
+	data.lastUpdate = MaskedAssign( fl4Mask, fl4Time, data.lastUpdate );
+	data.basePos = MaskedAssign( fl4Mask, basePos, data.basePos );
+	data.baseLastPos = MaskedAssign( fl4Mask, basePos, data.baseLastPos );
+	data.baseVel = MaskedAssign( fl4Mask, zero, data.baseVel );
+	data.baseAccel = MaskedAssign( fl4Mask, zero, data.baseAccel );
+	data.tipPos = MaskedAssign( fl4Mask, tipPos, data.tipPos );
+	data.tipVel = MaskedAssign( fl4Mask, zero, data.tipVel );
+	data.tipAccel = MaskedAssign( fl4Mask, zero, data.tipAccel );
+}
+
+// One clamp of the base spring: the local error is pushed back inside
+// [ fl4Min, fl4Max ] and the lanes that hit a limit get the friction
+static FORCEINLINE fltx4 ClampBaseSpring( const fltx4 &fl4Error, const fltx4 &fl4Min, const fltx4 &fl4Max, const fltx4 &fl4Friction,
+	const FourVectors &frictionDir, FourVectors &baseAccel )
+{
+	fltx4 fl4Below = CmpLtSIMD( fl4Error, fl4Min );
+	fltx4 fl4Above = CmpGtSIMD( fl4Error, fl4Max );
+	fltx4 fl4AtLimit = OrSIMD( fl4Below, fl4Above );
+
+	FourVectors friction = ScaleFourVectors( frictionDir, fl4Friction );
+	baseAccel = MaskedAssign( fl4AtLimit, baseAccel - friction, baseAccel );
+
+	return MaskedAssign( fl4Below, fl4Min, MaskedAssign( fl4Above, fl4Max, fl4Error ) );
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * SimulateJiggleBone() on the lanes of nLaneMask at once, for bones without
+ * yaw or pitch constraints
+ */
+void CJiggleBones::StepGroupSIMD( JiggleBoneGroup_t &group, int nLaneMask, float currenttime )
+{
+	fltx4 fl4Active;
+	for ( int nLane = 0; nLane < 4; nLane++ )
+	{
+		SubInt( fl4Active, nLane ) = ( nLaneMask & ( 1 << nLane ) ) ? ~0 : 0;
+	}
+
+	// Row r of each goal matrix holds component r of its left, up, forward
+	// and origin columns, so transposing the rows of four matrices gives
+	// the columns of all four lanes
+	FourVectors goalLeft, goalUp, goalForward, goalBasePosition;
+	for ( int r = 0; r < 3; r++ )
+	{
+		fltx4 fl4Left = LoadUnalignedSIMD( group.goalMX[0][r] );
+		fltx4 fl4Up = LoadUnalignedSIMD( group.goalMX[1][r] );
+		fltx4 fl4Forward = LoadUnalignedSIMD( group.goalMX[2][r] );
+		fltx4 fl4Base = LoadUnalignedSIMD( group.goalMX[3][r] );
+		TransposeSIMD( fl4Left, fl4Up, fl4Forward, fl4Base );
+		goalLeft[r] = fl4Left;
+		goalUp[r] = fl4Up;
+		goalForward[r] = fl4Forward;
+		goalBasePosition[r] = fl4Base;
+	}
+
+	FourVectors zero;
+	zero.DuplicateVector( vec3_origin );
+
+	fltx4 fl4Time = ReplicateX4( currenttime );
+	FourVectors goalTip = AddFourVectors( goalBasePosition, ScaleFourVectors( goalForward, group.length ) );
+
+	FourJiggleData data = group.state;
+
+	fltx4 fl4Reset = CmpGtSIMD( SubSIMD( fl4Time, data.lastUpdate ), ReplicateX4( 0.5f ) );
+	InitFourJiggleData( data, fl4Reset, fl4Time, goalBasePosition, goalTip );
+
+	if ( JiggleBoneSanity.GetBool() )
+	{
+		FourVectors goalDir = goalTip - goalBasePosition;
+		NormalizeFourVectors( goalDir );
+		FourVectors dataDir = data.tipPos - goalBasePosition;
+		NormalizeFourVectors( dataDir );
+
+		fltx4 fl4Flipped = CmpLtSIMD( DotFourVectors( goalDir, dataDir ), ReplicateX4( -0.9f ) );
+		InitFourJiggleData( data, fl4Flipped, fl4Time, goalBasePosition, goalTip );
+	}
+
+	fltx4 fl4DeltaT = MinSIMD( MaxSIMD( SubSIMD( fl4Time, data.lastUpdate ), ReplicateX4( 0.001f ) ), ReplicateX4( 0.0333f ) );
+	data.lastUpdate = fl4Time;
+
+	//
+	// Bone tip flex
+	//
+	FourVectors left, up, forward;
+	{
+		FourVectors tipAccel = data.tipAccel;
+		tipAccel.z = SubSIMD( tipAccel.z, group.tipMass );
+
+		FourVectors error = goalTip - data.tipPos;
+		fltx4 fl4LocalErrorX = DotFourVectors( goalLeft, error );
+		fltx4 fl4LocalErrorY = DotFourVectors( goalUp, error );
+		fltx4 fl4LocalErrorZ = DotFourVectors( goalForward, error );
+		fltx4 fl4LocalVelX = DotFourVectors( goalLeft, data.tipVel );
+		fltx4 fl4LocalVelY = DotFourVectors( goalUp, data.tipVel );
+		fltx4 fl4LocalVelZ = DotFourVectors( goalForward, data.tipVel );
+
+		fltx4 fl4YawAccel = SubSIMD( MulSIMD( group.yawStiffness, fl4LocalErrorX ), MulSIMD( group.yawDamping, fl4LocalVelX ) );
+		fltx4 fl4PitchAccel = SubSIMD( MulSIMD( group.pitchStiffness, fl4LocalErrorY ), MulSIMD( group.pitchDamping, fl4LocalVelY ) );
+		fltx4 fl4AlongAccel = SubSIMD( MulSIMD( group.alongStiffness, fl4LocalErrorZ ), MulSIMD( group.alongDamping, fl4LocalVelZ ) );
+
+		FourVectors drive = AddFourVectors( ScaleFourVectors( goalLeft, fl4YawAccel ), ScaleFourVectors( goalUp, fl4PitchAccel ) );
+		FourVectors driveAlong = AddFourVectors( drive, ScaleFourVectors( goalForward, fl4AlongAccel ) );
+		drive = MaskedAssign( group.hasLengthConstraint, drive, driveAlong );
+		tipAccel = MaskedAssign( group.isFlexible, AddFourVectors( tipAccel, drive ), tipAccel );
+
+		// simple euler integration
+		FourVectors tipVel = AddFourVectors( data.tipVel, ScaleFourVectors( tipAccel, fl4DeltaT ) );
+		FourVectors tipPos = AddFourVectors( data.tipPos, ScaleFourVectors( tipVel, fl4DeltaT ) );
+
+		forward = tipPos - goalBasePosition;
+		NormalizeFourVectors( forward );
+
+		// angle constraint. The angle is taken per lane with acos() like the
+		// scalar solver does, since a tip pushed back to its limit sits right
+		// on it and a test on the cosine would decide some frames differently.
+		fltx4 fl4AtLimit = Four_Zeros;
+		int nAngleMask = nLaneMask & TestSignSIMD( AndSIMD( group.hasAngleConstraint, group.isTip ) );
+		if ( nAngleMask )
+		{
+			fltx4 fl4Dot = DotFourVectors( forward, goalForward );
+			for ( int nLane = 0; nLane < 4; nLane++ )
+			{
+				if ( !( nAngleMask & ( 1 << nLane ) ) )
+					continue;
+
+				float dot = SubFloat( fl4Dot, nLane );
+				float angleBetween = acos( dot );
+				if ( dot < 0.0f )
+				{
+					angleBetween = 2.0f * M_PI - angleBetween;
+				}
+				SubInt( fl4AtLimit, nLane ) = ( angleBetween > SubFloat( group.angleLimit, nLane ) ) ? ~0 : 0;
+			}
+		}
+
+		if ( !IsAllZeros( fl4AtLimit ) )
+		{
+			FourVectors delta = goalTip - tipPos;
+			NormalizeFourVectors( delta );
+
+			FourVectors limitPos = goalTip - ScaleFourVectors( delta, group.maxBetween );
+			FourVectors limitForward = limitPos - goalBasePosition;
+			NormalizeFourVectors( limitForward );
+
+			tipPos = MaskedAssign( fl4AtLimit, limitPos, tipPos );
+			forward = MaskedAssign( fl4AtLimit, limitForward, forward );
+		}
+
+		// length constraint
+		FourVectors lengthPos = AddFourVectors( goalBasePosition, ScaleFourVectors( forward, group.length ) );
+		FourVectors lengthVel = tipVel - ScaleFourVectors( forward, DotFourVectors( tipVel, forward ) );
+		tipPos = MaskedAssign( group.hasLengthConstraint, lengthPos, tipPos );
+		tipVel = MaskedAssign( group.hasLengthConstraint, lengthVel, tipVel );
+
+		// bone matrix aligned along the tip direction
+		left = goalUp ^ forward;
+		NormalizeFourVectors( left );
+		up = forward ^ left;
+
+		data.tipPos = MaskedAssign( group.isTip, tipPos, data.tipPos );
+		data.tipVel = MaskedAssign( group.isTip, tipVel, data.tipVel );
+		data.tipAccel = MaskedAssign( group.isTip, zero, data.tipAccel );
+	}
+
+	//
+	// Bone base flex
+	//
+	{
+		FourVectors baseAccel = data.baseAccel;
+		baseAccel.z = SubSIMD( baseAccel.z, group.baseMass );
+
+		// simple spring
+		FourVectors error = goalBasePosition - data.basePos;
+		baseAccel = AddFourVectors( baseAccel, ScaleFourVectors( error, group.baseStiffness ) - ScaleFourVectors( data.baseVel, group.baseDamping ) );
+
+		FourVectors baseVel = AddFourVectors( data.baseVel, ScaleFourVectors( baseAccel, fl4DeltaT ) );
+		FourVectors basePos = AddFourVectors( data.basePos, ScaleFourVectors( baseVel, fl4DeltaT ) );
+		baseAccel = zero;
+
+		// constrain to limits
+		error = basePos - goalBasePosition;
+		fltx4 fl4LocalErrorX = DotFourVectors( goalLeft, error );
+		fltx4 fl4LocalErrorY = DotFourVectors( goalUp, error );
+		fltx4 fl4LocalErrorZ = DotFourVectors( goalForward, error );
+		fltx4 fl4LocalVelX = DotFourVectors( goalLeft, baseVel );
+		fltx4 fl4LocalVelY = DotFourVectors( goalUp, baseVel );
+		fltx4 fl4LocalVelZ = DotFourVectors( goalForward, baseVel );
+
+		fl4LocalErrorX = ClampBaseSpring( fl4LocalErrorX, group.baseMinLeft, group.baseMaxLeft, group.baseLeftFriction,
+			AddFourVectors( ScaleFourVectors( goalUp, fl4LocalVelY ), ScaleFourVectors( goalForward, fl4LocalVelZ ) ), baseAccel );
+		fl4LocalErrorY = ClampBaseSpring( fl4LocalErrorY, group.baseMinUp, group.baseMaxUp, group.baseUpFriction,
+			AddFourVectors( ScaleFourVectors( goalLeft, fl4LocalVelX ), ScaleFourVectors( goalForward, fl4LocalVelZ ) ), baseAccel );
+		fl4LocalErrorZ = ClampBaseSpring( fl4LocalErrorZ, group.baseMinForward, group.baseMaxForward, group.baseForwardFriction,
+			AddFourVectors( ScaleFourVectors( goalLeft, fl4LocalVelX ), ScaleFourVectors( goalUp, fl4LocalVelY ) ), baseAccel );
+
+		basePos = AddFourVectors( AddFourVectors( AddFourVectors( goalBasePosition, ScaleFourVectors( goalLeft, fl4LocalErrorX ) ),
+			ScaleFourVectors( goalUp, fl4LocalErrorY ) ), ScaleFourVectors( goalForward, fl4LocalErrorZ ) );
+
+		// fix up velocity
+		baseVel = ScaleFourVectors( basePos - data.baseLastPos, DivSIMD( Four_Ones, fl4DeltaT ) );
+
+		data.basePos = MaskedAssign( group.hasBaseSpring, basePos, data.basePos );
+		data.baseLastPos = MaskedAssign( group.hasBaseSpring, basePos, data.baseLastPos );
+		data.baseVel = MaskedAssign( group.hasBaseSpring, baseVel, data.baseVel );
+		data.baseAccel = MaskedAssign( group.hasBaseSpring, baseAccel, data.baseAccel );
+	}
+
+	group.state.lastUpdate = MaskedAssign( fl4Active, data.lastUpdate, group.state.lastUpdate );
+	group.state.basePos = MaskedAssign( fl4Active, data.basePos, group.state.basePos );
+	group.state.baseLastPos = MaskedAssign( fl4Active, data.baseLastPos, group.state.baseLastPos );
+	group.state.baseVel = MaskedAssign( fl4Active, data.baseVel, group.state.baseVel );
+	group.state.baseAccel = MaskedAssign( fl4Active, data.baseAccel, group.state.baseAccel );
+	group.state.tipPos = MaskedAssign( fl4Active, data.tipPos, group.state.tipPos );
+	group.state.tipVel = MaskedAssign( fl4Active, data.tipVel, group.state.tipVel );
+	group.state.tipAccel = MaskedAssign( fl4Active, data.tipAccel, group.state.tipAccel );
+
+	// Bones with a tip are aligned along it, the rest keep the goal
+	// orientation; the base spring moves the origin
+	FourVectors columns[4];
+	columns[0] = MaskedAssign( group.isTip, left, goalLeft );
+	columns[1] = MaskedAssign( group.isTip, up, goalUp );
+	columns[2] = MaskedAssign( group.isTip, forward, goalForward );
+	columns[3] = MaskedAssign( group.hasBaseSpring, data.basePos, goalBasePosition );
+
+	for ( int r = 0; r < 3; r++ )
+	{
+		fltx4 fl4Rows[4] = { columns[0][r], columns[1][r], columns[2][r], columns[3][r] };
+		TransposeSIMD( fl4Rows[0], fl4Rows[1], fl4Rows[2], fl4Rows[3] );
+		for ( int nLane = 0; nLane < 4; nLane++ )
+		{
+			if ( nLaneMask & ( 1 << nLane ) )
+			{
+				StoreUnalignedSIMD( ( *group.pBoneMX[nLane] )[r], fl4Rows[nLane] );
+			}
+		}
+	}
+}
+
+
+#if defined( FASTPATH_TESTS )
+
+//-----------------------------------------------------------------------------
+// Tests
+//-----------------------------------------------------------------------------
+
+#define JIGGLE_TEST_CHAINS			4
+#define JIGGLE_TEST_CHAIN_LENGTH	4
+
+// Root bone, then chains of jiggle bones hanging off it, each ending in a
+// plain bone that has to wait for the last jiggle bone of its chain
+#define JIGGLE_TEST_BONES			( 1 + JIGGLE_TEST_CHAINS * ( JIGGLE_TEST_CHAIN_LENGTH + 1 ) )
+
+struct JiggleTestModel_t
+{
+	int							parent[JIGGLE_TEST_BONES];
+	const mstudiojigglebone_t	*pJiggleInfo[JIGGLE_TEST_BONES];
+	matrix3x4_t					local[JIGGLE_TEST_BONES];
+	matrix3x4_t					bones[JIGGLE_TEST_BONES];
+	CJiggleBones				jiggleBones;
+};
+
+static mstudiojigglebone_t s_JiggleTestInfo[6];
+
+static void JiggleTest_InitInfo()
+{
+	memset( s_JiggleTestInfo, 0, sizeof( s_JiggleTestInfo ) );
+	for ( int i = 0; i < ARRAYSIZE( s_JiggleTestInfo ); i++ )
+	{
+		mstudiojigglebone_t &info = s_JiggleTestInfo[i];
+		info.length = 8.0f + i;
+		info.tipMass = 10.0f * i;
+		info.yawStiffness = 100.0f + 20.0f * i;
+		info.yawDamping = 1.0f + i;
+		info.pitchStiffness = 120.0f - 10.0f * i;
+		info.pitchDamping = 2.0f;
+		info.alongStiffness = 80.0f;
+		info.alongDamping = 3.0f;
+		info.angleLimit = DEG2RAD( 20.0f + 10.0f * i );
+		info.minYaw = DEG2RAD( -15.0f );
+		info.maxYaw = DEG2RAD( 15.0f );
+		info.yawFriction = 0.5f;
+		info.minPitch = DEG2RAD( -10.0f );
+		info.maxPitch = DEG2RAD( 25.0f );
+		info.pitchFriction = 0.25f;
+		info.baseMass = 5.0f;
+		info.baseStiffness = 150.0f;
+		info.baseDamping = 4.0f;
+		info.baseMinLeft = -2.0f;
+		info.baseMaxLeft = 2.0f;
+		info.baseLeftFriction = 1.0f;
+		info.baseMinUp = -1.0f;
+		info.baseMaxUp = 3.0f;
+		info.baseUpFriction = 2.0f;
+		info.baseMinForward = -1.5f;
+		info.baseMaxForward = 1.5f;
+		info.baseForwardFriction = 0.5f;
+	}
+
+	s_JiggleTestInfo[0].flags = JIGGLE_IS_FLEXIBLE | JIGGLE_HAS_LENGTH_CONSTRAINT | JIGGLE_HAS_ANGLE_CONSTRAINT;
+	s_JiggleTestInfo[1].flags = JIGGLE_IS_FLEXIBLE | JIGGLE_HAS_ANGLE_CONSTRAINT;
+	s_JiggleTestInfo[2].flags = JIGGLE_IS_RIGID | JIGGLE_HAS_LENGTH_CONSTRAINT | JIGGLE_HAS_BASE_SPRING;
+	s_JiggleTestInfo[3].flags = JIGGLE_HAS_BASE_SPRING;
+	s_JiggleTestInfo[4].flags = JIGGLE_IS_FLEXIBLE | JIGGLE_HAS_LENGTH_CONSTRAINT;
+
+	// only the scalar solver handles these
+	s_JiggleTestInfo[5].flags = JIGGLE_IS_FLEXIBLE | JIGGLE_HAS_YAW_CONSTRAINT | JIGGLE_HAS_PITCH_CONSTRAINT | JIGGLE_HAS_LENGTH_CONSTRAINT;
+}
+
+static void JiggleTest_InitModel( JiggleTestModel_t &model, int nModel )
+{
+	unsigned int seed = 0x1234567 + nModel;
+
+	model.parent[0] = -1;
+	model.pJiggleInfo[0] = NULL;
+	SetIdentityMatrix( model.local[0] );
+
+	int iBone = 1;
+	for ( int c = 0; c < JIGGLE_TEST_CHAINS; c++ )
+	{
+		for ( int k = 0; k <= JIGGLE_TEST_CHAIN_LENGTH; k++, iBone++ )
+		{
+			seed = seed * 1664525 + 1013904223;
+			model.parent[iBone] = ( k == 0 ) ? 0 : iBone - 1;
+			model.pJiggleInfo[iBone] = ( k < JIGGLE_TEST_CHAIN_LENGTH ) ? &s_JiggleTestInfo[ ( seed >> 16 ) % ARRAYSIZE( s_JiggleTestInfo ) ] : NULL;
+
+			QAngle angles( 10.0f * k, 90.0f * c + ( seed >> 24 ), 5.0f * c );
+			Vector origin = ( k == 0 ) ? Vector( 0, 0, 10.0f * c ) : Vector( 0, 0, 6.0f );
+			AngleMatrix( angles, origin, model.local[iBone] );
+		}
+	}
+}
+
+// Sets up the bones of every model for one frame. The batched version
+// queues jiggle bones and holds back the bones below them the way
+// C_BaseAnimating::BuildTransformations() does.
+static void JiggleTest_SetupBones( JiggleTestModel_t *pModels, int nModels, float currenttime, bool bBatched )
+{
+	for ( int m = 0; m < nModels; m++ )
+	{
+		JiggleTestModel_t &model = pModels[m];
+
+		float t = currenttime + m;
+		QAngle rootAngles( 20.0f * sin( 3.0f * t ), 90.0f * t, 10.0f * cos( 2.0f * t ) );
+		Vector rootOrigin( 40.0f * sin( 2.0f * t ), 30.0f * cos( 1.5f * t ), 10.0f * sin( 5.0f * t ) );
+		matrix3x4_t rootMX;
+		AngleMatrix( rootAngles, rootOrigin, rootMX );
+		ConcatTransforms( rootMX, model.local[0], model.bones[0] );
+	}
+
+	if ( !bBatched )
+	{
+		for ( int m = 0; m < nModels; m++ )
+		{
+			JiggleTestModel_t &model = pModels[m];
+			for ( int i = 1; i < JIGGLE_TEST_BONES; i++ )
+			{
+				matrix3x4_t goalMX;
+				ConcatTransforms( model.bones[ model.parent[i] ], model.local[i], goalMX );
+				if ( model.pJiggleInfo[i] )
+				{
+					model.jiggleBones.BuildJiggleTransformations( i, currenttime, model.pJiggleInfo[i], goalMX, model.bones[i] );
+				}
+				else
+				{
+					MatrixCopy( goalMX, model.bones[i] );
+				}
+			}
+		}
+		return;
+	}
+
+	CUtlVector< CJiggleBones * > jiggleBones;
+	CUtlVector< int > boneList;
+	CUtlVector< int > boneListStart;
+	CUtlVector< int > boneListCount;
+	for ( int m = 0; m < nModels; m++ )
+	{
+		jiggleBones.AddToTail( &pModels[m].jiggleBones );
+		boneListStart.AddToTail( boneList.Count() );
+		boneListCount.AddToTail( JIGGLE_TEST_BONES - 1 );
+		for ( int i = 1; i < JIGGLE_TEST_BONES; i++ )
+		{
+			boneList.AddToTail( i );
+		}
+	}
+
+	bool bonePending[JIGGLE_TEST_BONES];
+	for ( int nPass = 0; ; nPass++ )
+	{
+		bool bAnyLeft = false;
+		for ( int m = 0; m < nModels; m++ )
+		{
+			JiggleTestModel_t &model = pModels[m];
+			int *pList = boneList.Base() + boneListStart[m];
+			int nLeft = 0;
+
+			memset( bonePending, 0, sizeof( bonePending ) );
+			for ( int k = 0; k < boneListCount[m]; k++ )
+			{
+				int i = pList[k];
+				if ( bonePending[ model.parent[i] ] )
+				{
+					pList[nLeft++] = i;
+					bonePending[i] = true;
+					continue;
+				}
+
+				matrix3x4_t goalMX;
+				ConcatTransforms( model.bones[ model.parent[i] ], model.local[i], goalMX );
+				if ( model.pJiggleInfo[i] )
+				{
+					model.jiggleBones.QueueJiggleTransformations( i, nPass, model.pJiggleInfo[i], goalMX, &model.bones[i] );
+					bonePending[i] = true;
+				}
+				else
+				{
+					MatrixCopy( goalMX, model.bones[i] );
+				}
+			}
+
+			boneListCount[m] = nLeft;
+			bAnyLeft = bAnyLeft || ( nLeft != 0 );
+		}
+
+		CJiggleBones::StepQueuedJiggleTransformations( jiggleBones.Base(), nModels, currenttime );
+
+		if ( !bAnyLeft )
+			break;
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+bool JiggleBones_Validate( int nModels, int nFrames )
+{
+	JiggleTest_InitInfo();
+
+	CUtlVector< JiggleTestModel_t > scalarModels;
+	CUtlVector< JiggleTestModel_t > batchedModels;
+	scalarModels.SetCount( nModels );
+	batchedModels.SetCount( nModels );
+	for ( int m = 0; m < nModels; m++ )
+	{
+		JiggleTest_InitModel( scalarModels[m], m );
+		JiggleTest_InitModel( batchedModels[m], m );
+	}
+
+	float flMaxError = 0.0f;
+	for ( int f = 0; f < nFrames; f++ )
+	{
+		// a hitch now and then to run the clamped time step and the reset
+		float currenttime = f * ( 1.0f / 60.0f ) + ( f / 100 ) * 0.6f;
+
+		JiggleTest_SetupBones( scalarModels.Base(), nModels, currenttime, false );
+		JiggleTest_SetupBones( batchedModels.Base(), nModels, currenttime, true );
+
+		for ( int m = 0; m < nModels; m++ )
+		{
+			for ( int i = 0; i < JIGGLE_TEST_BONES; i++ )
+			{
+				const float *pScalar = scalarModels[m].bones[i].Base();
+				const float *pBatched = batchedModels[m].bones[i].Base();
+				for ( int j = 0; j < 12; j++ )
+				{
+					flMaxError = MAX( flMaxError, fabs( pScalar[j] - pBatched[j] ) );
+				}
+			}
+		}
+	}
+
+	// the lanes do the scalar operations in the scalar order, so this should be 0
+	bool bOk = ( flMaxError < 1e-3f );
+	Msg( "jiggle bones: %d models, %d frames, max error %g: %s\n", nModels, nFrames, flMaxError, bOk ? "ok" : "FAILED" );
+	return bOk;
+}
+
+void JiggleBones_Benchmark( int nModels, int nFrames )
+{
+	JiggleTest_InitInfo();
+
+	double flTime[2];
+	for ( int nBatched = 0; nBatched < 2; nBatched++ )
+	{
+		CUtlVector< JiggleTestModel_t > models;
+		models.SetCount( nModels );
+		for ( int m = 0; m < nModels; m++ )
+		{
+			JiggleTest_InitModel( models[m], m );
+		}
+
+		double flStart = Plat_FloatTime();
+		for ( int f = 0; f < nFrames; f++ )
+		{
+			JiggleTest_SetupBones( models.Base(), nModels, f * ( 1.0f / 60.0f ), nBatched != 0 );
+		}
+		flTime[nBatched] = Plat_FloatTime() - flStart;
+	}
+
+	Msg( "jiggle bones: %d models x %d jiggle bones, %d frames: scalar %.2f ms, batched %.2f ms (%.2fx)\n",
+		nModels, JIGGLE_TEST_CHAINS * JIGGLE_TEST_CHAIN_LENGTH, nFrames,
+		flTime[0] * 1000.0, flTime[1] * 1000.0, ( flTime[1] > 0.0 ) ? flTime[0] / flTime[1] : 0.0 );
+}
+
+void CC_JiggleBoneTest( const CCommand &args )
+{
+	int nModels = ( args.ArgC() >= 2 ) ? atoi( args[1] ) : 64;
+	int nFrames = ( args.ArgC() >= 3 ) ? atoi( args[2] ) : 600;
+	nModels = MAX( nModels, 1 );
+	nFrames = MAX( nFrames, 1 );
+
+	if ( !JiggleBones_Validate( nModels, nFrames ) )
+		return;
+
+	JiggleBones_Benchmark( nModels, nFrames );
+}
+static ConCommand cl_jiggle_bone_test( "cl_jiggle_bone_test", CC_JiggleBoneTest, "Checks the batched jiggle bone solver against the scalar one, then times both. Usage: cl_jiggle_bone_test [models] [frames]", FCVAR_CHEAT );
+
+#endif // FASTPATH_TESTS
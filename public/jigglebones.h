@@ -14,7 +14,7 @@
 
 #include "studio.h"
 #include "UtlVector.h"
-#include "utllinkedlist.h"
+#include "mathlib/ssemath.h"
 
 //-----------------------------------------------------------------------------
 /**
@@ -53,16 +53,123 @@ struct JiggleData
 	Vector tipAccel;
 };
 
+//-----------------------------------------------------------------------------
+/**
+ * JiggleData of four jiggle bones, one per fltx4 lane
+ */
+struct FourJiggleData
+{
+	FourVectors basePos;
+	FourVectors baseLastPos;
+	FourVectors baseVel;
+	FourVectors baseAccel;
+
+	FourVectors tipPos;
+	FourVectors tipVel;
+	FourVectors tipAccel;
+
+	fltx4 lastUpdate;
+};
+
+//-----------------------------------------------------------------------------
+/**
+ * The jiggle bones of one model. State is kept four bones to a group, one
+ * bone per fltx4 lane, and found through a bone -> slot table.
+ *
+ * BuildJiggleTransformations() steps one bone right away. Queued bones are
+ * stepped together, a group at a time; bones queued together must not
+ * depend on each other, so a jiggle bone below another one has to wait for
+ * the next batch. nLevel is how many batches that bone waited for this
+ * frame; bones of one level share groups. Bones with yaw or pitch
+ * constraints, and every bone while the debug convars are on, go through
+ * the scalar solver.
+ */
 class CJiggleBones
 {
 public:
-	JiggleData * GetJiggleData( int bone, float currenttime, const Vector &initBasePos, const Vector &initTipPos );
-	void BuildJiggleTransformations( int boneIndex, float currentime, const mstudiojigglebone_t *jiggleParams, const matrix3x4_t &goalMX, matrix3x4_t &boneMX );
+	CJiggleBones();
+
+	void BuildJiggleTransformations( int boneIndex, float currentime, const mstudiojigglebone_t *jiggleInfo, const matrix3x4_t &goalMX, matrix3x4_t &boneMX );
+
+	void QueueJiggleTransformations( int boneIndex, int nLevel, const mstudiojigglebone_t *jiggleInfo, const matrix3x4_t &goalMX, matrix3x4_t *pBoneMX );
+	bool HasQueuedJiggleTransformations() const		{ return m_nQueued != 0; }
+	void StepQueuedJiggleTransformations( float currenttime );
 
-	CUtlLinkedList< JiggleData >	m_jiggleBoneState;
+	// Steps what several models have queued
+	static void StepQueuedJiggleTransformations( CJiggleBones * const *ppJiggleBones, int nCount, float currenttime );
+
+private:
+	struct JiggleBoneGroup_t
+	{
+		FourJiggleData	state;
+
+		// mstudiojigglebone_t of each lane
+		fltx4			length;
+		fltx4			tipMass;
+		fltx4			yawStiffness;
+		fltx4			yawDamping;
+		fltx4			pitchStiffness;
+		fltx4			pitchDamping;
+		fltx4			alongStiffness;
+		fltx4			alongDamping;
+		fltx4			angleLimit;
+		fltx4			maxBetween;			// length * sin( angleLimit )
+		fltx4			baseMass;
+		fltx4			baseStiffness;
+		fltx4			baseDamping;
+		fltx4			baseMinLeft;
+		fltx4			baseMaxLeft;
+		fltx4			baseLeftFriction;
+		fltx4			baseMinUp;
+		fltx4			baseMaxUp;
+		fltx4			baseUpFriction;
+		fltx4			baseMinForward;
+		fltx4			baseMaxForward;
+		fltx4			baseForwardFriction;
+
+		// lane masks of the flags
+		fltx4			isTip;				// JIGGLE_IS_FLEXIBLE | JIGGLE_IS_RIGID
+		fltx4			isFlexible;
+		fltx4			hasAngleConstraint;
+		fltx4			hasLengthConstraint;
+		fltx4			hasBaseSpring;
+		fltx4			isSIMD;				// lanes the fltx4 solver can step
+
+		const mstudiojigglebone_t *pJiggleInfo[4];
+		int				bone[4];
+		int				id[4];
+		int				nLanes;
+		int				nLevel;
+
+		// queued for the next step
+		matrix3x4_t		goalMX[4];
+		matrix3x4_t		*pBoneMX[4];
+		int				nQueuedMask;
+	};
+
+	int FindOrAddSlot( int boneIndex, int nLevel, const mstudiojigglebone_t *jiggleInfo );
+	static void SetLaneParams( JiggleBoneGroup_t &group, int nLane, const mstudiojigglebone_t *jiggleInfo );
+	static void GetLaneData( const JiggleBoneGroup_t &group, int nLane, JiggleData &data );
+	static void SetLaneData( JiggleBoneGroup_t &group, int nLane, const JiggleData &data );
+	static void StepGroup( JiggleBoneGroup_t &group, float currenttime, bool bScalarOnly );
+	static void StepGroupSIMD( JiggleBoneGroup_t &group, int nLaneMask, float currenttime );
+
+	CUtlVector< JiggleBoneGroup_t, CUtlMemoryAligned< JiggleBoneGroup_t, 16 > > m_Groups;
+	CUtlVector< short > m_BoneSlot;		// group * 4 + lane, -1 for bones without state
+	int m_nQueued;
 };
 
 
+#if defined( FASTPATH_TESTS )
+//-----------------------------------------------------------------------------
+// Steps the same synthetic jiggle chains through the scalar solver and the
+// batched one, checks they agree within tolerance, then times both
+//-----------------------------------------------------------------------------
+bool JiggleBones_Validate( int nModels, int nFrames );
+void JiggleBones_Benchmark( int nModels, int nFrames );
+#endif
+
+
 extern void DevMsgRT( char const* pMsg, ... );
 
 #endif // C_BASEANIMATING_H
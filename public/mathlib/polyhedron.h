@@ -63,11 +63,65 @@ private:
 	CPolyhedron_AllocByNew( void ) { }; //CPolyhedron_AllocByNew::Allocate() is the only way to create one of these.
 };
 
+class CPolyhedron_ContextMemory : public CPolyhedron
+{
+public:
+	virtual void Release( void ) { }; //owned by the CPolyhedronClipContext that made it
+};
+
+//-----------------------------------------------------------------------------
+// Working memory for clipping, so any number of threads can clip at once.
+// The linked points, lines and polygons of a clip are carved from blocks the
+// context keeps between calls, and a result made in context memory stays in
+// the context until its next call. Once warm, a context clips without
+// allocating. Use one per thread.
+//-----------------------------------------------------------------------------
+class CPolyhedronClipContext
+{
+public:
+	CPolyhedronClipContext( void *pInitialBuffer = NULL, int iInitialBufferSize = 0 ); //the optional buffer is used before any block gets allocated
+	~CPolyhedronClipContext( void );
+
+	void *Alloc( int iBytes ); //16 byte aligned, lives until the next Reset()
+	void Reset( void ); //rewinds to the first block, frees nothing
+
+	CPolyhedron *GetPolyhedron( unsigned short iVertices, unsigned short iLines, unsigned short iIndices, unsigned short iPolygons ); //the context's result polyhedron, resized
+	bool IsContextPolyhedron( const CPolyhedron *pPolyhedron ) const { return pPolyhedron == &m_Polyhedron; }
+
+private:
+	CPolyhedronClipContext( const CPolyhedronClipContext & ); //not copyable
+
+	struct Block_t
+	{
+		Block_t *pNext;
+		int iSize; //usable bytes
+		bool bOwned;
+	};
+
+	Block_t *m_pFirstBlock;
+	Block_t *m_pCurrentBlock;
+	int m_iCurrentBlockUsed;
+
+	CPolyhedron_ContextMemory m_Polyhedron;
+	unsigned char *m_pPolyhedronMemory;
+	int m_iPolyhedronMemorySize;
+};
+
 CPolyhedron *GeneratePolyhedronFromPlanes( const float *pOutwardFacingPlanes, int iPlaneCount, float fOnPlaneEpsilon, bool bUseTemporaryMemory = false ); //be sure to polyhedron->Release()
 CPolyhedron *ClipPolyhedron( const CPolyhedron *pExistingPolyhedron, const float *pOutwardFacingPlanes, int iPlaneCount, float fOnPlaneEpsilon, bool bUseTemporaryMemory = false ); //this does NOT modify/delete the existing polyhedron
 
+//Reentrant versions. With bUseContextMemory the result lives in the context until its next call, otherwise be sure to polyhedron->Release()
+CPolyhedron *GeneratePolyhedronFromPlanes( CPolyhedronClipContext *pContext, const float *pOutwardFacingPlanes, int iPlaneCount, float fOnPlaneEpsilon, bool bUseContextMemory = true );
+CPolyhedron *ClipPolyhedron( CPolyhedronClipContext *pContext, const CPolyhedron *pExistingPolyhedron, const float *pOutwardFacingPlanes, int iPlaneCount, float fOnPlaneEpsilon, bool bUseContextMemory = true ); //the existing polyhedron may be the context's own result
+
 CPolyhedron *GetTempPolyhedron( unsigned short iVertices, unsigned short iLines, unsigned short iIndices, unsigned short iPolygons ); //grab the temporary polyhedron. Avoids new/delete for quick work. Can only be in use by one chunk of code at a time
 
+#if defined( FASTPATH_TESTS )
+//Clips random convex shapes through both the context and the legacy entry points, checks they agree and that every vertex is inside its planes, then times them
+bool Polyhedron_ClipValidate( int iIterations );
+void Polyhedron_ClipBenchmark( int iIterations );
+#endif
+
 
 #endif //#ifndef POLYHEDRON_H_
 
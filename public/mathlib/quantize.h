@@ -54,10 +54,42 @@ struct Sample {
 	// variables.
 };
 
-void FreeQuantization(struct QuantizedValue *t);
+class IThreadPool;
+struct QuantizeContextData_t;
+
+//-----------------------------------------------------------------------------
+// Scratch memory for Quantize(), so several quantizations can run at once
+// (one context per thread). With a thread pool, the splits of the worst
+// leaves are computed ahead of time on the pool. The tree comes out the
+// same as a serial run because a split only depends on the node it splits.
+//-----------------------------------------------------------------------------
+class CQuantizeContext
+{
+public:
+	CQuantizeContext( IThreadPool *pThreadPool = NULL, int nMaxParallelSplits = 0 ); // 0 = one per pool thread, plus the caller
+	~CQuantizeContext();
+
+	QuantizeContextData_t *GetData() { return m_pData; }
+
+private:
+	CQuantizeContext( const CQuantizeContext & ); // not copyable
+
+	QuantizeContextData_t *m_pData;
+};
+
+void FreeQuantization(struct QuantizedValue *t);	// only for trees returned by Quantize(), which own all of their nodes
 
 struct QuantizedValue *Quantize(struct Sample *s, int nsamples, int ndims,
 								int nvalues, uint8 *weights, int value0=0);
+struct QuantizedValue *Quantize( CQuantizeContext *pContext, struct Sample *s, int nsamples, int ndims,
+								int nvalues, uint8 *weights, int value0=0 );
+
+#if defined( FASTPATH_TESTS )
+// Quantizes random clustered samples serially and through a context with the
+// given pool, checks both trees match node for node, then times them.
+bool Quantize_Validate( IThreadPool *pThreadPool, int nSamples, int nDims, int nValues );
+void Quantize_Benchmark( IThreadPool *pThreadPool, int nSamples, int nDims, int nValues );
+#endif
 
 int CompressSamples(struct Sample *s, int nsamples, int ndims);
 
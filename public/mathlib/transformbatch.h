@@ -0,0 +1,62 @@
+//===== Copyright (c) 1996-2005, Valve Corporation, All rights reserved. ======//
+//
+// Purpose: Array at a time versions of the matrix and transform routines.
+//
+//			Each function does what the scalar routine named in its comment
+//			does to every element, with the same operations in the same
+//			order, so the results match the scalar ones. The SIMD path is
+//			used when MathLib_Init() enabled SSE (always on the consoles),
+//			otherwise the scalar routines are called per element.
+//
+//			Points that are already SoA go through
+//			FourVectors::TransformManyBy() instead.
+//
+// $NoKeywords: $
+//===========================================================================//
+
+#ifndef TRANSFORMBATCH_H
+#define TRANSFORMBATCH_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include "mathlib/mathlib.h"
+
+
+//-----------------------------------------------------------------------------
+// pOut[i] = VectorTransform( pIn[i], transform ). pOut may be pIn.
+//-----------------------------------------------------------------------------
+void VectorTransformBatch( const matrix3x4_t &transform, const Vector *pIn, Vector *pOut, int nCount );
+
+//-----------------------------------------------------------------------------
+// pOut[i] = ConcatTransforms( pIn1[i], pIn2[i] ). pOut may be pIn1 or pIn2.
+//-----------------------------------------------------------------------------
+void ConcatTransformsBatch( const matrix3x4_t *pIn1, const matrix3x4_t *pIn2, matrix3x4_t *pOut, int nCount );
+
+//-----------------------------------------------------------------------------
+// Walks a hierarchy the way bone setup does:
+//	pOut[i] = ConcatTransforms( pParent[i] < 0 ? rootTransform : pOut[pParent[i]], pLocal[i] )
+// Parents must come before their children. pOut may be pLocal.
+//-----------------------------------------------------------------------------
+void ConcatTransformsHierarchy( const matrix3x4_t &rootTransform, const int *pParent, const matrix3x4_t *pLocal, matrix3x4_t *pOut, int nCount );
+
+//-----------------------------------------------------------------------------
+// TransformAABB( transform, pMinsIn[i], pMaxsIn[i], pMinsOut[i], pMaxsOut[i] ).
+// The second version transforms box i by pTransforms[pTransformIndex[i]]
+// (hitboxes by their bones), or by pTransforms[i] if pTransformIndex is NULL.
+// The outputs may be the inputs.
+//-----------------------------------------------------------------------------
+void TransformAABBBatch( const matrix3x4_t &transform, const Vector *pMinsIn, const Vector *pMaxsIn, Vector *pMinsOut, Vector *pMaxsOut, int nCount );
+void TransformAABBBatch( const matrix3x4_t *pTransforms, const int *pTransformIndex, const Vector *pMinsIn, const Vector *pMaxsIn, Vector *pMinsOut, Vector *pMaxsOut, int nCount );
+
+#if defined( FASTPATH_TESTS )
+//-----------------------------------------------------------------------------
+// Checks the SIMD path of every function above against the scalar routines
+// on random transforms, then times both
+//-----------------------------------------------------------------------------
+bool TransformBatch_Validate( int nCount );
+void TransformBatch_Benchmark( int nCount, int nIterations );
+#endif
+
+
+#endif // TRANSFORMBATCH_H
@@ -9,10 +9,21 @@
 
 #include "rope_physics.h"
 #include "tier0/dbg.h"
+#include "tier0/platform.h"
+#include "mathlib/ssemath.h"
+#include "vstdlib/jobthread.h"
+#include "rope_shared.h"
 
 // memdbgon must be the last include file in a .cpp file!!!
 #include "tier0/memdbgon.h"
 
+// Shared by CBaseRopePhysics and CRopePhysicsBatch
+static float g_flRopeEnergy = 0.98;
+
+// Iterate multiple times here. If we don't, then gravity tends to
+// win over the constraint solver and it's impossible to get straight ropes.
+static int g_nRopeSpringIterations = 3;
+
 CBaseRopePhysics::CBaseRopePhysics( CSimplePhysics::CNode *pNodes, int nNodes, CRopeSpring *pSprings, float *flSpringDistsSqr )
 {
 	m_pNodes = pNodes;
@@ -94,8 +105,7 @@ void CBaseRopePhysics::SetDelegate( CSimplePhysics::IHelper *pDelegate )
 
 void CBaseRopePhysics::Simulate( float dt )
 {
-	static float flEnergy = 0.98;
-	m_Physics.Simulate( m_pNodes, m_nNodes, this, dt, flEnergy );
+	m_Physics.Simulate( m_pNodes, m_nNodes, this, dt, g_flRopeEnergy );
 }
 
 
@@ -111,11 +121,7 @@ void CBaseRopePhysics::GetNodeForces( CSimplePhysics::CNode *pNodes, int iNode,
 void CBaseRopePhysics::ApplyConstraints( CSimplePhysics::CNode *pNodes, int nNodes )
 {
 	// Handle springs..
-	//
-	// Iterate multiple times here. If we don't, then gravity tends to
-	// win over the constraint solver and it's impossible to get straight ropes.
-	static int nIterations = 3;
-	for( int iIteration=0; iIteration < nIterations; iIteration++ )
+	for( int iIteration=0; iIteration < g_nRopeSpringIterations; iIteration++ )
 	{
 		for( int i=0; i < NumSprings(); i++ )
 		{
@@ -125,15 +131,7 @@ void CBaseRopePhysics::ApplyConstraints( CSimplePhysics::CNode *pNodes, int nNod
 
 			float flDistSqr = vTo.LengthSqr();
 
-			// If we don't have an overall spring distance, see if we have a per-node one
-			float flSpringDist = m_flSpringDistSqr;
-			if ( !flSpringDist )
-			{
-				// TODO: This still isn't enough. Ropes with different spring lengths
-				// per-node will oscillate forever.
-				flSpringDist = m_flNodeSpringDistsSqr[i];
-			}
-
+			float flSpringDist = GetSpringDistSqr( i );
 			if( flDistSqr > flSpringDist )
 			{
 				float flDist = (float)sqrt( flDistSqr );
@@ -150,3 +148,513 @@ void CBaseRopePhysics::ApplyConstraints( CSimplePhysics::CNode *pNodes, int nNod
 }
 
 
+//-----------------------------------------------------------------------------
+// CRopePhysicsBatch
+//-----------------------------------------------------------------------------
+
+// Packets with more nodes than fit this take their scratch memory from the heap
+#define ROPE_BATCH_MAX_STACK_SCRATCH	( 32 * 1024 )
+
+CRopePhysicsBatch::CRopePhysicsBatch()
+{
+	m_bPacketsDirty = false;
+}
+
+
+void CRopePhysicsBatch::AddRope( CBaseRopePhysics *pRope )
+{
+	m_Ropes.AddToTail( pRope );
+	m_bPacketsDirty = true;
+}
+
+
+void CRopePhysicsBatch::RemoveAll()
+{
+	m_Ropes.RemoveAll();
+	m_Packets.RemoveAll();
+	m_bPacketsDirty = false;
+}
+
+
+// Ropes with delegates first, then by node count
+static int __cdecl RopePacketCompare( CBaseRopePhysics * const *ppLeft, CBaseRopePhysics * const *ppRight )
+{
+	bool bLeftDelegate = ( (*ppLeft)->GetDelegate() != NULL );
+	bool bRightDelegate = ( (*ppRight)->GetDelegate() != NULL );
+	if ( bLeftDelegate != bRightDelegate )
+		return bLeftDelegate ? -1 : 1;
+
+	return (*ppLeft)->NumNodes() - (*ppRight)->NumNodes();
+}
+
+
+void CRopePhysicsBatch::BuildPackets()
+{
+	// Ropes that look alike share a packet, so fewer lanes idle and
+	// packets without delegates never leave SoA form
+	CUtlVector< CBaseRopePhysics * > ropes;
+	ropes.CopyArray( m_Ropes.Base(), m_Ropes.Count() );
+	ropes.Sort( RopePacketCompare );
+
+	int nPackets = ( ropes.Count() + 3 ) / 4;
+	m_Packets.SetCount( nPackets );
+	for ( int i = 0; i < nPackets; i++ )
+	{
+		Packet_t &packet = m_Packets[i];
+		packet.m_nRopes = MIN( 4, ropes.Count() - i * 4 );
+		for ( int j = 0; j < packet.m_nRopes; j++ )
+		{
+			packet.m_pRopes[j] = ropes[i * 4 + j];
+		}
+	}
+	m_bPacketsDirty = false;
+}
+
+
+void CRopePhysicsBatch::Simulate( float dt, IThreadPool *pThreadPool )
+{
+	if ( m_bPacketsDirty )
+	{
+		BuildPackets();
+	}
+
+	int nPackets = m_Packets.Count();
+	for ( int i = 0; i < nPackets; i++ )
+	{
+		m_Packets[i].m_flDt = dt;
+	}
+
+	if ( pThreadPool && nPackets > 1 )
+	{
+		ParallelProcess( pThreadPool, m_Packets.Base(), nPackets, &CRopePhysicsBatch::SimulatePacket );
+	}
+	else
+	{
+		for ( int i = 0; i < nPackets; i++ )
+		{
+			SimulatePacket( m_Packets[i] );
+		}
+	}
+}
+
+
+// Node iNode of every lane, or the lane's spare node past the end of its rope
+static inline void GetLaneNodes( CBaseRopePhysics * const *pRopes, CSimplePhysics::CNode *pSpare, int iNode, CSimplePhysics::CNode **ppNodes )
+{
+	for ( int l = 0; l < 4; l++ )
+	{
+		ppNodes[l] = ( pRopes[l] && iNode < pRopes[l]->NumNodes() ) ? pRopes[l]->GetNode( iNode ) : &pSpare[l];
+	}
+}
+
+
+static void GatherRopeNodes( CBaseRopePhysics * const *pRopes, CSimplePhysics::CNode *pSpare, int nNodes, FourVectors *pPos, FourVectors *pPrevPos )
+{
+	for ( int i = 0; i < nNodes; i++ )
+	{
+		CSimplePhysics::CNode *pNodes[4];
+		GetLaneNodes( pRopes, pSpare, i, pNodes );
+		pPos[i].LoadAndSwizzle( pNodes[0]->m_vPos, pNodes[1]->m_vPos, pNodes[2]->m_vPos, pNodes[3]->m_vPos );
+		pPrevPos[i].LoadAndSwizzle( pNodes[0]->m_vPrevPos, pNodes[1]->m_vPrevPos, pNodes[2]->m_vPrevPos, pNodes[3]->m_vPrevPos );
+	}
+}
+
+
+static void ScatterRopeNodes( CBaseRopePhysics * const *pRopes, CSimplePhysics::CNode *pSpare, int nNodes, const FourVectors *pPos, const FourVectors *pPrevPos )
+{
+	for ( int i = 0; i < nNodes; i++ )
+	{
+		CSimplePhysics::CNode *pNodes[4];
+		GetLaneNodes( pRopes, pSpare, i, pNodes );
+		pPos[i].StoreUnalignedVector3SIMD( &pNodes[0]->m_vPos, &pNodes[1]->m_vPos, &pNodes[2]->m_vPos, &pNodes[3]->m_vPos );
+		pPrevPos[i].StoreUnalignedVector3SIMD( &pNodes[0]->m_vPrevPos, &pNodes[1]->m_vPrevPos, &pNodes[2]->m_vPrevPos, &pNodes[3]->m_vPrevPos );
+	}
+}
+
+
+// The squared rest length and a mask of every spring, returns the spring distance of every lane
+static fltx4 LoadRopeSprings( CBaseRopePhysics * const *pRopes, int nNodes, fltx4 *pSpringDistSqr, fltx4 *pSpringMask )
+{
+	fltx4 fl4SpringDist = Four_Zeros;
+	for ( int l = 0; l < 4; l++ )
+	{
+		CBaseRopePhysics *pRope = pRopes[l];
+		int nSprings = pRope ? pRope->NumNodes() - 1 : 0;
+		if ( pRope )
+		{
+			SubFloat( fl4SpringDist, l ) = pRope->GetSpringLength();
+		}
+		for ( int i = 0; i < nNodes - 1; i++ )
+		{
+			SubFloat( pSpringDistSqr[i], l ) = ( i < nSprings ) ? pRope->GetSpringDistSqr( i ) : 0.0f;
+			SubFloat( pSpringMask[i], l ) = ( i < nSprings ) ? 1.0f : 0.0f;
+		}
+	}
+	for ( int i = 0; i < nNodes - 1; i++ )
+	{
+		pSpringMask[i] = CmpGtSIMD( pSpringMask[i], Four_Zeros );
+	}
+	return fl4SpringDist;
+}
+
+
+void CRopePhysicsBatch::SimulatePacket( Packet_t &packet )
+{
+	CBaseRopePhysics *pRopes[4];
+	int nTimeSteps[4];
+	int nMaxNodes = 0;
+	int nMaxTimeSteps = 0;
+	bool bDelegates = false;
+	fltx4 fl4TimeStepMul = Four_Zeros;
+	for ( int l = 0; l < 4; l++ )
+	{
+		CBaseRopePhysics *pRope = ( l < packet.m_nRopes ) ? packet.m_pRopes[l] : NULL;
+		pRopes[l] = pRope;
+		nTimeSteps[l] = 0;
+		if ( !pRope )
+			continue;
+
+		nTimeSteps[l] = pRope->m_Physics.StartSimulation( packet.m_flDt );
+		SubFloat( fl4TimeStepMul, l ) = pRope->m_Physics.GetTimeStepMul();
+		nMaxNodes = MAX( nMaxNodes, pRope->m_nNodes );
+		nMaxTimeSteps = MAX( nMaxTimeSteps, nTimeSteps[l] );
+		bDelegates |= ( pRope->m_pDelegate != NULL );
+	}
+
+	if ( nMaxNodes && nMaxTimeSteps > 0 )
+	{
+		CSimplePhysics::CNode spare[4];
+		for ( int l = 0; l < 4; l++ )
+		{
+			spare[l].Init( vec3_origin );
+		}
+
+		// SoA positions, the spring of each node to the next and the accelerations
+		// the delegates return, one lane per rope (+1 so LoadAndSwizzle can read past the last)
+		int nScratchSize = nMaxNodes * ( 2 * sizeof( FourVectors ) + 2 * sizeof( fltx4 ) + 4 * sizeof( Vector ) ) + sizeof( Vector ) + 15;
+		byte *pScratchAlloc = ( nScratchSize > ROPE_BATCH_MAX_STACK_SCRATCH ) ? (byte *)malloc( nScratchSize ) : (byte *)stackalloc( nScratchSize );
+		byte *pScratch = (byte *)( ( (uintp)pScratchAlloc + 15 ) & ~(uintp)15 );
+
+		FourVectors *pPos = (FourVectors *)pScratch;
+		FourVectors *pPrevPos = pPos + nMaxNodes;
+		fltx4 *pSpringDistSqr = (fltx4 *)( pPrevPos + nMaxNodes );
+		fltx4 *pSpringMask = pSpringDistSqr + nMaxNodes;
+		Vector *pAccels[4];
+		pAccels[0] = (Vector *)( pSpringMask + nMaxNodes );
+		for ( int l = 1; l < 4; l++ )
+		{
+			pAccels[l] = pAccels[l-1] + nMaxNodes;
+		}
+		memset( pAccels[0], 0, ( nMaxNodes * 4 + 1 ) * sizeof( Vector ) );
+
+		fltx4 fl4Damp = ReplicateX4( g_flRopeEnergy );
+		GatherRopeNodes( pRopes, spare, nMaxNodes, pPos, pPrevPos );
+		fltx4 fl4SpringDist = LoadRopeSprings( pRopes, nMaxNodes, pSpringDistSqr, pSpringMask );
+
+		for ( int iTimeStep = 0; iTimeStep < nMaxTimeSteps; iTimeStep++ )
+		{
+			bool bActive[4];
+			fltx4 fl4Active;
+			for ( int l = 0; l < 4; l++ )
+			{
+				bActive[l] = iTimeStep < nTimeSteps[l];
+				SubFloat( fl4Active, l ) = bActive[l] ? 1.0f : 0.0f;
+			}
+			fl4Active = CmpGtSIMD( fl4Active, Four_Zeros );
+
+			// Apply forces. Without a delegate there are none.
+			for ( int l = 0; l < 4; l++ )
+			{
+				CBaseRopePhysics *pRope = pRopes[l];
+				if ( bActive[l] && pRope->m_pDelegate )
+				{
+					for ( int iNode = 0; iNode < pRope->m_nNodes; iNode++ )
+					{
+						pRope->m_pDelegate->GetNodeForces( pRope->m_pNodes, iNode, &pAccels[l][iNode] );
+						Assert( pAccels[l][iNode].IsValid() );
+					}
+				}
+			}
+
+			// Verlet step
+			for ( int i = 0; i < nMaxNodes; i++ )
+			{
+				FourVectors accel;
+				accel.LoadAndSwizzle( pAccels[0][i], pAccels[1][i], pAccels[2][i], pAccels[3][i] );
+
+				FourVectors &pos = pPos[i];
+				FourVectors &prevPos = pPrevPos[i];
+				fltx4 x = AddSIMD( AddSIMD( pos.x, MulSIMD( SubSIMD( pos.x, prevPos.x ), fl4Damp ) ), MulSIMD( accel.x, fl4TimeStepMul ) );
+				fltx4 y = AddSIMD( AddSIMD( pos.y, MulSIMD( SubSIMD( pos.y, prevPos.y ), fl4Damp ) ), MulSIMD( accel.y, fl4TimeStepMul ) );
+				fltx4 z = AddSIMD( AddSIMD( pos.z, MulSIMD( SubSIMD( pos.z, prevPos.z ), fl4Damp ) ), MulSIMD( accel.z, fl4TimeStepMul ) );
+				prevPos.x = MaskedAssign( fl4Active, pos.x, prevPos.x );
+				prevPos.y = MaskedAssign( fl4Active, pos.y, prevPos.y );
+				prevPos.z = MaskedAssign( fl4Active, pos.z, prevPos.z );
+				pos.x = MaskedAssign( fl4Active, x, pos.x );
+				pos.y = MaskedAssign( fl4Active, y, pos.y );
+				pos.z = MaskedAssign( fl4Active, z, pos.z );
+			}
+
+			// Apply constraints, see CBaseRopePhysics::ApplyConstraints
+			for ( int iIteration = 0; iIteration < g_nRopeSpringIterations; iIteration++ )
+			{
+				for ( int i = 0; i < nMaxNodes - 1; i++ )
+				{
+					FourVectors &node1 = pPos[i];
+					FourVectors &node2 = pPos[i+1];
+
+					fltx4 toX = SubSIMD( node1.x, node2.x );
+					fltx4 toY = SubSIMD( node1.y, node2.y );
+					fltx4 toZ = SubSIMD( node1.z, node2.z );
+					fltx4 fl4DistSqr = AddSIMD( AddSIMD( MulSIMD( toX, toX ), MulSIMD( toY, toY ) ), MulSIMD( toZ, toZ ) );
+
+					fltx4 fl4Stretched = AndSIMD( AndSIMD( pSpringMask[i], fl4Active ), CmpGtSIMD( fl4DistSqr, pSpringDistSqr[i] ) );
+					if ( IsAllZeros( fl4Stretched ) )
+						continue;
+
+					fltx4 fl4Scale = SubSIMD( Four_Ones, DivSIMD( fl4SpringDist, SqrtSIMD( fl4DistSqr ) ) );
+					toX = MulSIMD( MulSIMD( toX, fl4Scale ), Four_PointFives );
+					toY = MulSIMD( MulSIMD( toY, fl4Scale ), Four_PointFives );
+					toZ = MulSIMD( MulSIMD( toZ, fl4Scale ), Four_PointFives );
+
+					node1.x = MaskedAssign( fl4Stretched, SubSIMD( node1.x, toX ), node1.x );
+					node1.y = MaskedAssign( fl4Stretched, SubSIMD( node1.y, toY ), node1.y );
+					node1.z = MaskedAssign( fl4Stretched, SubSIMD( node1.z, toZ ), node1.z );
+					node2.x = MaskedAssign( fl4Stretched, AddSIMD( node2.x, toX ), node2.x );
+					node2.y = MaskedAssign( fl4Stretched, AddSIMD( node2.y, toY ), node2.y );
+					node2.z = MaskedAssign( fl4Stretched, AddSIMD( node2.z, toZ ), node2.z );
+				}
+
+				if ( bDelegates )
+				{
+					ScatterRopeNodes( pRopes, spare, nMaxNodes, pPos, pPrevPos );
+					for ( int l = 0; l < 4; l++ )
+					{
+						CBaseRopePhysics *pRope = pRopes[l];
+						if ( bActive[l] && pRope->m_pDelegate )
+						{
+							pRope->m_pDelegate->ApplyConstraints( pRope->m_pNodes, pRope->m_nNodes );
+						}
+					}
+					GatherRopeNodes( pRopes, spare, nMaxNodes, pPos, pPrevPos );
+
+					// they may have changed the spring lengths too
+					fl4SpringDist = LoadRopeSprings( pRopes, nMaxNodes, pSpringDistSqr, pSpringMask );
+				}
+			}
+		}
+
+		if ( !bDelegates )
+		{
+			ScatterRopeNodes( pRopes, spare, nMaxNodes, pPos, pPrevPos );
+		}
+
+		if ( nScratchSize > ROPE_BATCH_MAX_STACK_SCRATCH )
+		{
+			free( pScratchAlloc );
+		}
+	}
+
+	for ( int l = 0; l < packet.m_nRopes; l++ )
+	{
+		CBaseRopePhysics *pRope = pRopes[l];
+		pRope->m_Physics.FinishSimulation( pRope->m_pNodes, pRope->m_nNodes );
+	}
+}
+
+
+#if defined( FASTPATH_TESTS )
+
+//-----------------------------------------------------------------------------
+// Validation and benchmark
+//-----------------------------------------------------------------------------
+class CRopeTestDelegate : public CSimplePhysics::IHelper
+{
+public:
+	virtual void GetNodeForces( CSimplePhysics::CNode *pNodes, int iNode, Vector *pAccel )
+	{
+		// Gravity and an impulse that decays with every node, like C_RopeKeyframe's
+		pAccel->Init( ROPE_GRAVITY );
+		*pAccel += m_vImpulse;
+		m_vImpulse *= 0.9f;
+	}
+
+	virtual void ApplyConstraints( CSimplePhysics::CNode *pNodes, int nNodes )
+	{
+		for ( int i = 0; i < nNodes; i++ )
+		{
+			if ( pNodes[i].m_vPos.z < m_flFloorZ )
+			{
+				pNodes[i].m_vPos = pNodes[i].m_vPrevPos;
+			}
+		}
+
+		pNodes[0].m_vPos = m_vEndPoints[0];
+		pNodes[nNodes-1].m_vPos = m_vEndPoints[1];
+	}
+
+	Vector	m_vEndPoints[2];
+	Vector	m_vImpulse;
+	float	m_flFloorZ;
+};
+
+struct RopeTest_t
+{
+	CRopePhysics< ROPE_MAX_SEGMENTS >	m_Rope;
+	CRopeTestDelegate					m_Delegate;
+};
+
+static float RopeTest_Random( unsigned int &nSeed, float flMin, float flMax )
+{
+	nSeed = nSeed * 1664525 + 1013904223;
+	return flMin + ( flMax - flMin ) * (float)( nSeed >> 8 ) * ( 1.0f / 16777216.0f );
+}
+
+// Half of the ropes get a delegate, every fourth one has per-node spring lengths
+static RopeTest_t *RopeTest_Build( int nRopes )
+{
+	RopeTest_t *pTests = new RopeTest_t[ nRopes ];
+	unsigned int nSeed = 0x2B0E;
+	for ( int i = 0; i < nRopes; i++ )
+	{
+		RopeTest_t &test = pTests[i];
+		CBaseRopePhysics &rope = test.m_Rope;
+
+		int nNodes = MIN( ROPE_MAX_SEGMENTS, 2 + (int)RopeTest_Random( nSeed, 0.0f, ROPE_MAX_SEGMENTS - 1 ) );
+		rope.SetNumNodes( nNodes );
+
+		Vector vStart( RopeTest_Random( nSeed, -1000.0f, 1000.0f ), RopeTest_Random( nSeed, -1000.0f, 1000.0f ), RopeTest_Random( nSeed, 0.0f, 500.0f ) );
+		Vector vEnd = vStart + Vector( RopeTest_Random( nSeed, -300.0f, 300.0f ), RopeTest_Random( nSeed, -300.0f, 300.0f ), RopeTest_Random( nSeed, -100.0f, 100.0f ) );
+		for ( int j = 0; j < nNodes; j++ )
+		{
+			Vector vPos;
+			VectorLerp( vStart, vEnd, (float)j / ( nNodes - 1 ), vPos );
+			rope.GetNode( j )->Init( vPos );
+			rope.GetNode( j )->m_vPrevPos -= Vector( RopeTest_Random( nSeed, -5.0f, 5.0f ), RopeTest_Random( nSeed, -5.0f, 5.0f ), RopeTest_Random( nSeed, -5.0f, 5.0f ) );
+		}
+
+		test.m_Delegate.m_vEndPoints[0] = vStart;
+		test.m_Delegate.m_vEndPoints[1] = vEnd;
+		test.m_Delegate.m_vImpulse.Init( RopeTest_Random( nSeed, -2000.0f, 2000.0f ), RopeTest_Random( nSeed, -2000.0f, 2000.0f ), 0 );
+		test.m_Delegate.m_flFloorZ = MIN( vStart.z, vEnd.z ) - RopeTest_Random( nSeed, 0.0f, 200.0f );
+
+		float flLength = ( vEnd - vStart ).Length() * RopeTest_Random( nSeed, 0.5f, 1.5f );
+		rope.SetupSimulation( flLength / ( nNodes - 1 ), ( i & 1 ) ? &test.m_Delegate : NULL );
+		if ( ( i & 3 ) == 2 )
+		{
+			rope.ResetSpringLength( 0 );
+			for ( int j = 0; j < nNodes - 1; j++ )
+			{
+				rope.ResetNodeSpringLength( j, RopeTest_Random( nSeed, 5.0f, 50.0f ) );
+			}
+		}
+		rope.Restart();
+	}
+	return pTests;
+}
+
+
+bool RopePhysicsBatch_Validate( int nRopes, IThreadPool *pThreadPool )
+{
+	RopeTest_t *pReference = RopeTest_Build( nRopes );
+	RopeTest_t *pBatched = RopeTest_Build( nRopes );
+
+	CRopePhysicsBatch batch;
+	for ( int i = 0; i < nRopes; i++ )
+	{
+		batch.AddRope( &pBatched[i].m_Rope );
+	}
+
+	unsigned int nSeed = 0x51AB;
+	for ( int iFrame = 0; iFrame < 200; iFrame++ )
+	{
+		float dt = RopeTest_Random( nSeed, 0.005f, 0.05f );
+		for ( int i = 0; i < nRopes; i++ )
+		{
+			pReference[i].m_Rope.Simulate( dt );
+		}
+		batch.Simulate( dt, pThreadPool );
+	}
+
+	int nNodes = 0;
+	int nExact = 0;
+	float flMaxError = 0.0f;
+	for ( int i = 0; i < nRopes; i++ )
+	{
+		CBaseRopePhysics &reference = pReference[i].m_Rope;
+		CBaseRopePhysics &batched = pBatched[i].m_Rope;
+		for ( int j = 0; j < reference.NumNodes(); j++ )
+		{
+			const CSimplePhysics::CNode *pRef = reference.GetNode( j );
+			const CSimplePhysics::CNode *pTest = batched.GetNode( j );
+			nNodes++;
+			if ( !memcmp( &pRef->m_vPos, &pTest->m_vPos, sizeof( Vector ) ) && !memcmp( &pRef->m_vPrevPos, &pTest->m_vPrevPos, sizeof( Vector ) ) &&
+				!memcmp( &pRef->m_vPredicted, &pTest->m_vPredicted, sizeof( Vector ) ) )
+			{
+				nExact++;
+				continue;
+			}
+
+			for ( int k = 0; k < 3; k++ )
+			{
+				flMaxError = MAX( flMaxError, fabs( pRef->m_vPos[k] - pTest->m_vPos[k] ) );
+				flMaxError = MAX( flMaxError, fabs( pRef->m_vPrevPos[k] - pTest->m_vPrevPos[k] ) );
+				flMaxError = MAX( flMaxError, fabs( pRef->m_vPredicted[k] - pTest->m_vPredicted[k] ) );
+			}
+			if ( !IsFinite( pTest->m_vPos.x ) || !IsFinite( pTest->m_vPos.y ) || !IsFinite( pTest->m_vPos.z ) )
+			{
+				flMaxError = FLT_MAX;
+			}
+		}
+	}
+
+	delete [] pReference;
+	delete [] pBatched;
+
+	bool bOk = ( flMaxError <= 0.01f );
+	Msg( "RopePhysicsBatch_Validate: %d ropes, %d nodes, %d exact, max error %g: %s\n", nRopes, nNodes, nExact, flMaxError, bOk ? "ok" : "FAILED" );
+	return bOk;
+}
+
+
+void RopePhysicsBatch_Benchmark( int nRopes, int nFrames, IThreadPool *pThreadPool )
+{
+	const float dt = 1.0f / 60.0f;
+
+	RopeTest_t *pTests = RopeTest_Build( nRopes );
+	double flStart = Plat_FloatTime();
+	for ( int iFrame = 0; iFrame < nFrames; iFrame++ )
+	{
+		for ( int i = 0; i < nRopes; i++ )
+		{
+			pTests[i].m_Rope.Simulate( dt );
+		}
+	}
+	double flRopes = Plat_FloatTime() - flStart;
+	delete [] pTests;
+
+	double flBatch[2];
+	for ( int iPass = 0; iPass < 2; iPass++ )
+	{
+		pTests = RopeTest_Build( nRopes );
+		CRopePhysicsBatch batch;
+		for ( int i = 0; i < nRopes; i++ )
+		{
+			batch.AddRope( &pTests[i].m_Rope );
+		}
+
+		flStart = Plat_FloatTime();
+		for ( int iFrame = 0; iFrame < nFrames; iFrame++ )
+		{
+			batch.Simulate( dt, iPass ? pThreadPool : NULL );
+		}
+		flBatch[iPass] = Plat_FloatTime() - flStart;
+		delete [] pTests;
+	}
+
+	Msg( "RopePhysicsBatch_Benchmark: %d ropes, %d frames: per rope %.2f ms, batch %.2f ms (%.2fx), batch on %s %.2f ms (%.2fx)\n",
+		nRopes, nFrames, flRopes * 1000.0, flBatch[0] * 1000.0, ( flBatch[0] > 0.0 ) ? ( flRopes / flBatch[0] ) : 0.0,
+		pThreadPool ? "thread pool" : "calling thread", flBatch[1] * 1000.0, ( flBatch[1] > 0.0 ) ? ( flRopes / flBatch[1] ) : 0.0 );
+}
+
+#endif // FASTPATH_TESTS
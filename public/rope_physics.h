@@ -14,6 +14,10 @@
 
 #include "simple_physics.h"
 #include "networkvar.h"
+#include "tier1/utlvector.h"
+
+
+class IThreadPool;
 
 
 class CRopeSpring
@@ -28,6 +32,7 @@ class CBaseRopePhysics : public CSimplePhysics::IHelper
 {
 public:
 	DECLARE_CLASS_NOBASE( CBaseRopePhysics );
+	friend class CRopePhysicsBatch;
 
 					CBaseRopePhysics( 
 						CSimplePhysics::CNode *pNodes, 
@@ -43,6 +48,7 @@ public:
 
 	void			ResetSpringLength(float flSpringDist );
 	float			GetSpringLength() const;
+	float			GetSpringDistSqr( int iSpring ) const;
 	void			ResetNodeSpringLength( int iStartNode, float flSpringDist );
 
 	// Set simulation parameters.
@@ -51,6 +57,7 @@ public:
 
 	// Set the physics delegate.
 	void			SetDelegate( CSimplePhysics::IHelper *pDelegate );
+	CSimplePhysics::IHelper *GetDelegate() const	{ return m_pDelegate; }
 
 	void			Simulate( float dt );
 	
@@ -94,6 +101,18 @@ protected:
 
 
 
+inline float CBaseRopePhysics::GetSpringDistSqr( int iSpring ) const
+{
+	// If we don't have an overall spring distance, see if we have a per-node one
+	if ( m_flSpringDistSqr )
+		return m_flSpringDistSqr;
+
+	// TODO: This still isn't enough. Ropes with different spring lengths
+	// per-node will oscillate forever.
+	return m_flNodeSpringDistsSqr[iSpring];
+}
+
+
 template< int NUM_NODES >
 class CRopePhysics : public CBaseRopePhysics
 {
@@ -114,4 +133,59 @@ CRopePhysics<NUM_NODES>::CRopePhysics() :
 }
 
 
+//-----------------------------------------------------------------------------
+// Simulates many ropes at once. Ropes are packed four to a packet, their
+// nodes are transposed into SoA arrays and every packet is stepped with fltx4
+// math: Verlet steps across the four ropes, then the springs relaxed in order
+// along each rope. The math is that of CBaseRopePhysics::Simulate() operation
+// for operation, so the results match it. The one difference is that a
+// delegate's GetNodeForces() is asked for all nodes of a time step before any
+// of them moves.
+//
+// Only ropes that keep CBaseRopePhysics's GetNodeForces() and
+// ApplyConstraints() can be batched; anything they need to do goes through
+// their delegate.
+//-----------------------------------------------------------------------------
+class CRopePhysicsBatch
+{
+public:
+					CRopePhysicsBatch();
+
+	// Packets are made when the ropes change. Re-add the ropes after
+	// changing their delegate or node count to keep the packets tight.
+	void			AddRope( CBaseRopePhysics *pRope );
+	void			RemoveAll();
+	int				Count() const	{ return m_Ropes.Count(); }
+
+	// Does what Simulate( dt ) does on every rope. With a thread pool the
+	// packets run on its threads, so the delegates must be thread safe then.
+	void			Simulate( float dt, IThreadPool *pThreadPool = NULL );
+
+private:
+	struct Packet_t
+	{
+		CBaseRopePhysics	*m_pRopes[4];
+		int					m_nRopes;
+		float				m_flDt;
+	};
+
+	void			BuildPackets();
+	static void		SimulatePacket( Packet_t &packet );
+
+	CUtlVector< CBaseRopePhysics * > m_Ropes;
+	CUtlVector< Packet_t > m_Packets;
+	bool			m_bPacketsDirty;
+};
+
+
+#if defined( FASTPATH_TESTS )
+//-----------------------------------------------------------------------------
+// Checks the batch against CBaseRopePhysics::Simulate() on random ropes, with
+// and without delegates, then times both
+//-----------------------------------------------------------------------------
+bool RopePhysicsBatch_Validate( int nRopes, IThreadPool *pThreadPool );
+void RopePhysicsBatch_Benchmark( int nRopes, int nFrames, IThreadPool *pThreadPool );
+#endif
+
+
 #endif // ROPE_PHYSICS_H
@@ -62,6 +62,14 @@ public:
 		float dt,
 		float flDamp );
 
+	// For callers that step the nodes themselves, the way Simulate() does (see
+	// CRopePhysicsBatch): advances the clock by dt and returns how many time
+	// steps to run. Call FinishSimulation() after running them to set up the
+	// predicted positions.
+	int			StartSimulation( float dt );
+	void		FinishSimulation( CNode *pNodes, int nNodes );
+	float		GetTimeStepMul() const	{ return m_flTimeStepMul; }
+
 
 private:
 
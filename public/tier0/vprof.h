@@ -18,6 +18,10 @@
 #if !( defined( _X360 ) && defined( _CERT ) )
 #define VPROF_ENABLED
 #endif
+#else
+// Linux doesn't build the node profiler, but budget scopes still feed a scope
+// recorder through VProfScopeHooks() (see CVProfTraceScope)
+#define VPROF_TRACE_ENABLED
 #endif
 
 #if defined(_X360) && defined(VPROF_ENABLED)
@@ -59,28 +63,26 @@
 
 #define MAXCOUNTERS 256
 
+//-----------------------------------------------------------------------------
+// Lets a recorder outside tier0 see every scope (tier1/vproftrace.h is one).
+// It fills in the functions and sets m_bActive while it records; the scopes
+// only call through them while m_bActive is set. One per module, like the
+// recorder that fills it in. Used by CVProfScope, or by CVProfTraceScope
+// where VPROF_ENABLED is off.
+//-----------------------------------------------------------------------------
+struct VProfScopeHooks_t
+{
+	volatile bool m_bActive;
+	void (*m_pfnEnterScope)( const tchar *pszName, const tchar *pszBudgetGroup );
+	void (*m_pfnExitScope)();
+	void (*m_pfnSignalSpike)();
+};
 
-#ifdef VPROF_ENABLED
-
-#define VPROF_VTUNE_GROUP
-
-#define	VPROF( name )						VPROF_(name, 1, VPROF_BUDGETGROUP_OTHER_UNACCOUNTED, false, 0)
-#define	VPROF_ASSERT_ACCOUNTED( name )		VPROF_(name, 1, VPROF_BUDGETGROUP_OTHER_UNACCOUNTED, true, 0)
-#define	VPROF_( name, detail, group, bAssertAccounted, budgetFlags )		VPROF_##detail(name,group, bAssertAccounted, budgetFlags)
-
-#define VPROF_BUDGET( name, group )					VPROF_BUDGET_FLAGS(name, group, BUDGETFLAG_OTHER)
-#define VPROF_BUDGET_FLAGS( name, group, flags )	VPROF_(name, 0, group, false, flags)
-
-#define VPROF_SCOPE_BEGIN( tag )	do { VPROF( tag )
-#define VPROF_SCOPE_END()			} while (0)
-
-#define VPROF_ONLY( expression )	expression
-
-#define VPROF_ENTER_SCOPE( name )			g_VProfCurrentProfile.EnterScope( name, 1, VPROF_BUDGETGROUP_OTHER_UNACCOUNTED, false, 0 )
-#define VPROF_EXIT_SCOPE()					g_VProfCurrentProfile.ExitScope()
-
-#define VPROF_BUDGET_GROUP_ID_UNACCOUNTED 0
-
+inline VProfScopeHooks_t &VProfScopeHooks()
+{
+	static VProfScopeHooks_t s_Hooks;
+	return s_Hooks;
+}
 
 // Budgetgroup flags. These are used with VPROF_BUDGET_FLAGS.
 // These control which budget panels the groups show up in.
@@ -133,7 +135,29 @@
 #define VPROF_BUDGETGROUP_CVAR_FIND					_T("Cvar_Find") 
 #define VPROF_BUDGETGROUP_CLIENTLEAFSYSTEM			_T("ClientLeafSystem")
 #define VPROF_BUDGETGROUP_JOBS_COROUTINES			_T("Jobs/Coroutines")
-	
+
+
+#ifdef VPROF_ENABLED
+
+#define VPROF_VTUNE_GROUP
+
+#define	VPROF( name )						VPROF_(name, 1, VPROF_BUDGETGROUP_OTHER_UNACCOUNTED, false, 0)
+#define	VPROF_ASSERT_ACCOUNTED( name )		VPROF_(name, 1, VPROF_BUDGETGROUP_OTHER_UNACCOUNTED, true, 0)
+#define	VPROF_( name, detail, group, bAssertAccounted, budgetFlags )		VPROF_##detail(name,group, bAssertAccounted, budgetFlags)
+
+#define VPROF_BUDGET( name, group )					VPROF_BUDGET_FLAGS(name, group, BUDGETFLAG_OTHER)
+#define VPROF_BUDGET_FLAGS( name, group, flags )	VPROF_(name, 0, group, false, flags)
+
+#define VPROF_SCOPE_BEGIN( tag )	do { VPROF( tag )
+#define VPROF_SCOPE_END()			} while (0)
+
+#define VPROF_ONLY( expression )	expression
+
+#define VPROF_ENTER_SCOPE( name )			g_VProfCurrentProfile.EnterScope( name, 1, VPROF_BUDGETGROUP_OTHER_UNACCOUNTED, false, 0 )
+#define VPROF_EXIT_SCOPE()					g_VProfCurrentProfile.ExitScope()
+
+#define VPROF_BUDGET_GROUP_ID_UNACCOUNTED 0
+
 #ifdef _X360
 // update flags
 #define VPROF_UPDATE_BUDGET				0x01	// send budget data every frame
@@ -201,6 +225,89 @@
 #define VPROF_INCREMENT_COUNTER(name,amount)			do { static CVProfCounter _counter( name ); _counter.Increment( amount ); } while( 0 )
 #define VPROF_INCREMENT_GROUP_COUNTER(name,group,amount)			do { static CVProfCounter _counter( name, group ); _counter.Increment( amount ); } while( 0 )
 
+#elif defined( VPROF_TRACE_ENABLED )
+
+//-----------------------------------------------------------------------------
+// Without the node profiler a scope only reports to the scope recorder, and
+// only pays for a flag test while nothing is recording
+//-----------------------------------------------------------------------------
+class CVProfTraceScope
+{
+public:
+	CVProfTraceScope( const tchar *pszName, const tchar *pBudgetGroupName )
+	{
+		VProfScopeHooks_t &hooks = VProfScopeHooks();
+		m_bTraced = hooks.m_bActive;
+		if ( m_bTraced )
+		{
+			hooks.m_pfnEnterScope( pszName, pBudgetGroupName );
+		}
+	}
+
+	~CVProfTraceScope()
+	{
+		if ( m_bTraced )
+		{
+			VProfScopeHooks().m_pfnExitScope();
+		}
+	}
+
+private:
+	bool m_bTraced;
+};
+
+#ifndef VPROF_LEVEL
+#define VPROF_LEVEL 0
+#endif
+
+#define	VPROF( name )						VPROF_(name, 1, VPROF_BUDGETGROUP_OTHER_UNACCOUNTED, false, 0)
+#define	VPROF_ASSERT_ACCOUNTED( name )		VPROF_(name, 1, VPROF_BUDGETGROUP_OTHER_UNACCOUNTED, true, 0)
+#define	VPROF_( name, detail, group, bAssertAccounted, budgetFlags )		VPROF_TRACE_##detail(name,group)
+
+#define VPROF_BUDGET( name, group )					VPROF_BUDGET_FLAGS(name, group, BUDGETFLAG_OTHER)
+#define VPROF_BUDGET_FLAGS( name, group, flags )	VPROF_(name, 0, group, false, flags)
+
+#define	VPROF_TRACE_0(name,group)	CVProfTraceScope VProfTrace_(name, group);
+
+#if VPROF_LEVEL > 0 
+#define	VPROF_TRACE_1(name,group)	CVProfTraceScope VProfTrace_(name, group);
+#else
+#define	VPROF_TRACE_1(name,group)	((void)0)
+#endif
+
+#if VPROF_LEVEL > 1 
+#define	VPROF_TRACE_2(name,group)	CVProfTraceScope VProfTrace_(name, group);
+#else
+#define	VPROF_TRACE_2(name,group)	((void)0)
+#endif
+
+#if VPROF_LEVEL > 2 
+#define	VPROF_TRACE_3(name,group)	CVProfTraceScope VProfTrace_(name, group);
+#else
+#define	VPROF_TRACE_3(name,group)	((void)0)
+#endif
+
+#if VPROF_LEVEL > 3 
+#define	VPROF_TRACE_4(name,group)	CVProfTraceScope VProfTrace_(name, group);
+#else
+#define	VPROF_TRACE_4(name,group)	((void)0)
+#endif
+
+#define VPROF_SCOPE_BEGIN( tag )	do { VPROF( tag )
+#define VPROF_SCOPE_END()			} while (0)
+
+#define VPROF_ONLY( expression )	((void)0)
+
+#define VPROF_ENTER_SCOPE( name )
+#define VPROF_EXIT_SCOPE()
+
+#define VPROF_INCREMENT_COUNTER(name,amount)			((void)0)
+#define VPROF_INCREMENT_GROUP_COUNTER(name,group,amount)	((void)0)
+
+#define VPROF_TEST_SPIKE( msec )	((void)0)
+
+#define VProfCode( code ) code
+
 #else
 
 #define	VPROF( name )									((void)0)
@@ -682,6 +789,10 @@ public:
 			if ( m_Timer.GetDuration().GetMillisecondsF() > m_spike )
 			{
 				g_VProfSignalSpike = true;
+				if ( VProfScopeHooks().m_pfnSignalSpike )
+				{
+					VProfScopeHooks().m_pfnSignalSpike();
+				}
 			}
 		}
 	}
@@ -740,6 +851,9 @@ class CVProfScope
 public:
 	CVProfScope( const tchar * pszName, int detailLevel, const tchar *pBudgetGroupName, bool bAssertAccounted, int budgetFlags );
 	~CVProfScope();
+
+private:
+	bool m_bTraced;	// entered while a scope recorder was running
 };
 
 //-----------------------------------------------------------------------------
@@ -1250,12 +1364,24 @@ inline unsigned int CVProfile::GetMultiTraceIndex()
 inline CVProfScope::CVProfScope( const tchar * pszName, int detailLevel, const tchar *pBudgetGroupName, bool bAssertAccounted, int budgetFlags )
 { 
 	g_VProfCurrentProfile.EnterScope( pszName, detailLevel, pBudgetGroupName, bAssertAccounted, budgetFlags ); 
+
+	// The node tree only tracks the target thread; a scope recorder sees every thread
+	VProfScopeHooks_t &hooks = VProfScopeHooks();
+	m_bTraced = hooks.m_bActive;
+	if ( m_bTraced )
+	{
+		hooks.m_pfnEnterScope( pszName, pBudgetGroupName );
+	}
 }
 
 //-------------------------------------
 
 inline CVProfScope::~CVProfScope()					
 { 
+	if ( m_bTraced )
+	{
+		VProfScopeHooks().m_pfnExitScope();
+	}
 	g_VProfCurrentProfile.ExitScope(); 
 }
 
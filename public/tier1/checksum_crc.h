@@ -17,6 +17,12 @@ void CRC32_ProcessBuffer( CRC32_t *pulCRC, const void *p, int len );
 void CRC32_Final( CRC32_t *pulCRC );
 CRC32_t	CRC32_GetTableEntry( unsigned int slot );
 
+#if defined( FASTPATH_TESTS )
+// Checks the sliced and PCLMULQDQ paths against the table version, and times them
+bool CRC32_ValidateImplementations( int nIterations );
+void CRC32_Benchmark( int nTotalBytes );
+#endif
+
 inline CRC32_t CRC32_ProcessSingleBuffer( const void *p, int len )
 {
 	CRC32_t crc;
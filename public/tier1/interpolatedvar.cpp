@@ -7,6 +7,7 @@
 #include "cbase.h"
 
 #include "tier1/interpolatedvar.h"
+#include "mathlib/ssemath.h"
 
 // memdbgon must be the last include file in a .cpp file!!!
 #include "tier0/memdbgon.h"
@@ -26,3 +27,386 @@ float g_flLastPacketTimestamp = 0;
 
 
 ConVar cl_extrapolate_amount( "cl_extrapolate_amount", "0.25", FCVAR_CHEAT, "Set how many seconds the client will extrapolate entities for." );
+
+
+//-----------------------------------------------------------------------------
+// CInterpolatedVarSIMD
+//-----------------------------------------------------------------------------
+COMPILE_TIME_ASSERT( sizeof( Vector ) == 3 * sizeof( float ) );
+
+bool CInterpolatedVarSIMD::GetHermiteFixup( float flPrevTime, float flStartTime, float flEndTime, float &flFixupLerp )
+{
+	float dt1 = flEndTime - flStartTime;
+	float dt2 = flStartTime - flPrevTime;
+	if ( fabs( dt1 - dt2 ) > 0.0001f && dt2 > 0.0001f )
+	{
+		float frac = dt1 / dt2;
+		flFixupLerp = 1 - frac;
+		return true;
+	}
+
+	flFixupLerp = 0.0f;
+	return false;
+}
+
+void CInterpolatedVarSIMD::InitLerpWeights( Weights_t &weights, float flFrac )
+{
+	weights.m_bHermite = false;
+	weights.m_bFixup = false;
+	weights.m_flFrac = flFrac;
+	weights.m_flFixupLerp = 0.0f;
+	weights.m_flBasis[0] = weights.m_flBasis[1] = weights.m_flBasis[2] = weights.m_flBasis[3] = 0.0f;
+}
+
+void CInterpolatedVarSIMD::InitHermiteWeights( Weights_t &weights, float flFrac, bool bFixup, float flFixupLerp )
+{
+	weights.m_bHermite = true;
+	weights.m_bFixup = bFixup;
+	weights.m_flFrac = flFrac;
+	weights.m_flFixupLerp = bFixup ? flFixupLerp : 0.0f;
+
+	float t = flFrac;
+	float tSqr = t*t;
+	float tCube = t*tSqr;
+	weights.m_flBasis[0] = 2*tCube-3*tSqr+1;
+	weights.m_flBasis[1] = -2*tCube+3*tSqr;
+	weights.m_flBasis[2] = tCube-2*tSqr+t;
+	weights.m_flBasis[3] = tCube-tSqr;
+}
+
+// The same operations in the same order as Lerp() and Lerp_Hermite() in lerp_functions.h
+void CInterpolatedVarSIMD::Interpolate( const Weights_t &weights, float *pOut, const float *pPrev, const float *pStart, const float *pEnd, int nFloats )
+{
+	int nGroups = nFloats & ~3;
+	if ( !weights.m_bHermite )
+	{
+		float flFrac = weights.m_flFrac;
+		fltx4 frac = ReplicateX4( flFrac );
+		int i;
+		for ( i = 0; i < nGroups; i += 4 )
+		{
+			fltx4 start = LoadUnalignedSIMD( pStart + i );
+			fltx4 end = LoadUnalignedSIMD( pEnd + i );
+			StoreUnalignedSIMD( pOut + i, AddSIMD( start, MulSIMD( SubSIMD( end, start ), frac ) ) );
+		}
+		for ( ; i < nFloats; ++i )
+		{
+			pOut[i] = pStart[i] + ( pEnd[i] - pStart[i] ) * flFrac;
+		}
+		return;
+	}
+
+	const float *b = weights.m_flBasis;
+	float flFixup = weights.m_flFixupLerp;
+	fltx4 b1 = ReplicateX4( b[0] );
+	fltx4 b2 = ReplicateX4( b[1] );
+	fltx4 b3 = ReplicateX4( b[2] );
+	fltx4 b4 = ReplicateX4( b[3] );
+	fltx4 fixup = ReplicateX4( flFixup );
+
+	int i;
+	for ( i = 0; i < nGroups; i += 4 )
+	{
+		fltx4 p0 = LoadUnalignedSIMD( pPrev + i );
+		fltx4 p1 = LoadUnalignedSIMD( pStart + i );
+		fltx4 p2 = LoadUnalignedSIMD( pEnd + i );
+		if ( weights.m_bFixup )
+		{
+			p0 = AddSIMD( p0, MulSIMD( SubSIMD( p1, p0 ), fixup ) );
+		}
+
+		fltx4 d1 = SubSIMD( p1, p0 );
+		fltx4 d2 = SubSIMD( p2, p1 );
+		fltx4 out = MulSIMD( p1, b1 );
+		out = AddSIMD( out, MulSIMD( p2, b2 ) );
+		out = AddSIMD( out, MulSIMD( d1, b3 ) );
+		out = AddSIMD( out, MulSIMD( d2, b4 ) );
+		StoreUnalignedSIMD( pOut + i, out );
+	}
+	for ( ; i < nFloats; ++i )
+	{
+		float p0 = pPrev[i];
+		float p1 = pStart[i];
+		float p2 = pEnd[i];
+		if ( weights.m_bFixup )
+		{
+			p0 = p0 + ( p1 - p0 ) * flFixup;
+		}
+
+		pOut[i] = p1*b[0] + p2*b[1] + ( p1 - p0 )*b[2] + ( p2 - p1 )*b[3];
+	}
+}
+
+
+#if defined( FASTPATH_TESTS )
+
+//-----------------------------------------------------------------------------
+// Tests. The test entities are noted at 64 ticks a second with some packets
+// dropped and interpolated at 100 fps, 0.1 seconds in the past.
+//-----------------------------------------------------------------------------
+#define INTERPOLATEDVAR_TEST_POSES		24
+#define INTERPOLATEDVAR_TEST_POINTS		4
+#define INTERPOLATEDVAR_TEST_VARS		5
+
+struct InterpolatedVarTestValues_t
+{
+	Vector	m_vecOrigin;
+	float	m_flValue;
+	float	m_flPoses[INTERPOLATEDVAR_TEST_POSES];
+	Vector	m_vecPoints[INTERPOLATEDVAR_TEST_POINTS];
+	QAngle	m_angRotation;
+};
+
+struct InterpolatedVarTestEntity_t : public InterpolatedVarTestValues_t
+{
+	InterpolatedVarTestEntity_t() :
+		m_iv_vecOrigin( "InterpolatedVarTestEntity_t::m_iv_vecOrigin" ),
+		m_iv_flValue( "InterpolatedVarTestEntity_t::m_iv_flValue" ),
+		m_iv_flPoses( "InterpolatedVarTestEntity_t::m_iv_flPoses" ),
+		m_iv_vecPoints( "InterpolatedVarTestEntity_t::m_iv_vecPoints" ),
+		m_iv_angRotation( "InterpolatedVarTestEntity_t::m_iv_angRotation" )
+	{
+		// Only the arrays take the SIMD path
+		m_pVars[0] = &m_iv_vecOrigin;
+		m_pVars[1] = &m_iv_flValue;
+		m_pVars[2] = &m_iv_flPoses;
+		m_pVars[3] = &m_iv_vecPoints;
+		m_pVars[4] = &m_iv_angRotation;
+	}
+
+	CInterpolatedVar< Vector > m_iv_vecOrigin;
+	CInterpolatedVar< float > m_iv_flValue;
+	CInterpolatedVarArray< float, INTERPOLATEDVAR_TEST_POSES > m_iv_flPoses;
+	CInterpolatedVarArray< Vector, INTERPOLATEDVAR_TEST_POINTS > m_iv_vecPoints;
+	CInterpolatedVar< QAngle > m_iv_angRotation;
+
+	IInterpolatedVar *m_pVars[INTERPOLATEDVAR_TEST_VARS];
+	int m_nSIMDTypes[INTERPOLATEDVAR_TEST_VARS];
+};
+
+static unsigned int s_nInterpolatedVarSeed;
+
+static float InterpolatedVarTest_Random( float flMin, float flMax )
+{
+	s_nInterpolatedVarSeed = s_nInterpolatedVarSeed * 1664525 + 1013904223;
+	return flMin + ( flMax - flMin ) * ( ( s_nInterpolatedVarSeed >> 8 ) & 0xFFFF ) * ( 1.0f / 65535.0f );
+}
+
+static void InterpolatedVarTest_Create( CUtlVector< InterpolatedVarTestEntity_t * > &entities, int nEntities )
+{
+	s_nInterpolatedVarSeed = 1234;
+	for ( int i = 0; i < nEntities; ++i )
+	{
+		InterpolatedVarTestEntity_t *pEntity = new InterpolatedVarTestEntity_t;
+		entities.AddToTail( pEntity );
+
+		pEntity->m_vecOrigin.Init( InterpolatedVarTest_Random( -1000, 1000 ), InterpolatedVarTest_Random( -1000, 1000 ), 0 );
+		pEntity->m_flValue = 0.0f;
+		for ( int j = 0; j < INTERPOLATEDVAR_TEST_POSES; ++j )
+		{
+			pEntity->m_flPoses[j] = InterpolatedVarTest_Random( 0, 1 );
+		}
+		for ( int j = 0; j < INTERPOLATEDVAR_TEST_POINTS; ++j )
+		{
+			pEntity->m_vecPoints[j] = pEntity->m_vecOrigin;
+		}
+		pEntity->m_angRotation.Init( 0, InterpolatedVarTest_Random( -180, 180 ), 0 );
+
+		// Some vars linear only, like the ones of entities that ask for it
+		int nLinear = ( i % 3 == 0 ) ? INTERPOLATE_LINEAR_ONLY : 0;
+		pEntity->m_iv_vecOrigin.Setup( &pEntity->m_vecOrigin, LATCH_SIMULATION_VAR | nLinear );
+		pEntity->m_iv_flValue.Setup( &pEntity->m_flValue, LATCH_SIMULATION_VAR );
+		pEntity->m_iv_flPoses.Setup( pEntity->m_flPoses, LATCH_ANIMATION_VAR );
+		pEntity->m_iv_vecPoints.Setup( pEntity->m_vecPoints, LATCH_SIMULATION_VAR | nLinear );
+		pEntity->m_iv_angRotation.Setup( &pEntity->m_angRotation, LATCH_SIMULATION_VAR );
+
+		// Looping pose parameters, like move_yaw
+		for ( int j = 0; j < INTERPOLATEDVAR_TEST_POSES; j += 5 )
+		{
+			pEntity->m_iv_flPoses.SetLooping( true, j );
+		}
+
+		for ( int j = 0; j < INTERPOLATEDVAR_TEST_VARS; ++j )
+		{
+			pEntity->m_pVars[j]->SetInterpolationAmount( 0.1f );
+			pEntity->m_pVars[j]->Reset( 0.0f );
+			pEntity->m_nSIMDTypes[j] = pEntity->m_pVars[j]->GetSIMDType();
+		}
+	}
+}
+
+// Moves the entities and notes the changes for the ticks up to flTime
+static void InterpolatedVarTest_Simulate( CUtlVector< InterpolatedVarTestEntity_t * > &entities, float &flLastTick, float flTime )
+{
+	const float flTickInterval = 1.0f / 64.0f;
+	while ( flLastTick + flTickInterval <= flTime )
+	{
+		flLastTick += flTickInterval;
+		for ( int i = 0; i < entities.Count(); ++i )
+		{
+			// Dropped packets leave uneven gaps between the samples
+			if ( InterpolatedVarTest_Random( 0, 1 ) < 0.1f )
+				continue;
+
+			InterpolatedVarTestEntity_t *pEntity = entities[i];
+			pEntity->m_vecOrigin += Vector( InterpolatedVarTest_Random( -4, 4 ), InterpolatedVarTest_Random( -4, 4 ), InterpolatedVarTest_Random( -1, 1 ) );
+			pEntity->m_flValue = InterpolatedVarTest_Random( -1, 1 );
+			for ( int j = 0; j < INTERPOLATEDVAR_TEST_POSES; ++j )
+			{
+				float flPose = pEntity->m_flPoses[j] + InterpolatedVarTest_Random( -0.1f, 0.1f );
+				pEntity->m_flPoses[j] = flPose - floor( flPose );
+			}
+			for ( int j = 0; j < INTERPOLATEDVAR_TEST_POINTS; ++j )
+			{
+				pEntity->m_vecPoints[j] = pEntity->m_vecOrigin + Vector( j * 8.0f, InterpolatedVarTest_Random( -2, 2 ), 0 );
+			}
+			pEntity->m_angRotation.y = AngleNormalize( pEntity->m_angRotation.y + InterpolatedVarTest_Random( -10, 10 ) );
+
+			// A stalled entity every so often, so some vars stop changing
+			if ( ( i % 7 ) == 0 && InterpolatedVarTest_Random( 0, 1 ) < 0.5f )
+				continue;
+
+			for ( int j = 0; j < INTERPOLATEDVAR_TEST_VARS; ++j )
+			{
+				pEntity->m_pVars[j]->NoteChanged( flTime, flLastTick, true );
+			}
+		}
+	}
+}
+
+static bool InterpolatedVarTest_Matches( const float *pA, const float *pB, int nFloats )
+{
+	for ( int i = 0; i < nFloats; ++i )
+	{
+		if ( fabs( pA[i] - pB[i] ) > 0.0001f * MAX( 1.0f, fabs( pA[i] ) ) )
+			return false;
+	}
+	return true;
+}
+
+bool InterpolatedVarSIMD_Validate( int nEntities, int nFrames )
+{
+	CUtlVector< InterpolatedVarTestEntity_t * > entities;
+	InterpolatedVarTest_Create( entities, nEntities );
+
+	float flLastTick = 0.0f;
+	int nFailures = 0;
+	int nVars = 0;
+	for ( int nFrame = 1; nFrame <= nFrames; ++nFrame )
+	{
+		float flTime = nFrame * 0.01f;
+		InterpolatedVarTest_Simulate( entities, flLastTick, flTime );
+
+		for ( int i = 0; i < entities.Count(); ++i )
+		{
+			InterpolatedVarTestEntity_t *pEntity = entities[i];
+
+			// Interpolate() first, then InterpolateSIMD() from the same histories at the same time
+			int nNoMoreChanges[INTERPOLATEDVAR_TEST_VARS];
+			for ( int j = 0; j < INTERPOLATEDVAR_TEST_VARS; ++j )
+			{
+				nNoMoreChanges[j] = pEntity->m_pVars[j]->Interpolate( flTime );
+			}
+
+			InterpolatedVarTestValues_t expected = *pEntity;
+
+			bool bNoMoreChangesMatch = true;
+			for ( int j = 0; j < INTERPOLATEDVAR_TEST_VARS; ++j )
+			{
+				if ( InterpolateSIMD( pEntity->m_pVars[j], pEntity->m_nSIMDTypes[j], flTime ) != nNoMoreChanges[j] )
+				{
+					bNoMoreChangesMatch = false;
+				}
+			}
+			nVars += INTERPOLATEDVAR_TEST_VARS;
+
+			bool bMatch = bNoMoreChangesMatch &&
+				InterpolatedVarTest_Matches( expected.m_vecOrigin.Base(), pEntity->m_vecOrigin.Base(), 3 ) &&
+				InterpolatedVarTest_Matches( &expected.m_flValue, &pEntity->m_flValue, 1 ) &&
+				InterpolatedVarTest_Matches( expected.m_flPoses, pEntity->m_flPoses, INTERPOLATEDVAR_TEST_POSES ) &&
+				InterpolatedVarTest_Matches( expected.m_vecPoints[0].Base(), pEntity->m_vecPoints[0].Base(), 3 * INTERPOLATEDVAR_TEST_POINTS ) &&
+				InterpolatedVarTest_Matches( expected.m_angRotation.Base(), pEntity->m_angRotation.Base(), 3 );
+			if ( !bMatch && ++nFailures <= 5 )
+			{
+				Warning( "interpolated var simd: entity %d differs at %.3f (origin %.4f %.4f %.4f, expected %.4f %.4f %.4f)\n", i, flTime,
+					pEntity->m_vecOrigin.x, pEntity->m_vecOrigin.y, pEntity->m_vecOrigin.z, expected.m_vecOrigin.x, expected.m_vecOrigin.y, expected.m_vecOrigin.z );
+			}
+		}
+	}
+
+	entities.PurgeAndDeleteElements();
+
+	if ( nFailures )
+	{
+		Warning( "interpolated var simd: %d mismatches\n", nFailures );
+		return false;
+	}
+
+	Msg( "interpolated var simd: %d entities, %d frames, %d vars OK\n", nEntities, nFrames, nVars );
+	return true;
+}
+
+void InterpolatedVarSIMD_Benchmark( int nEntities, int nFrames )
+{
+	// Both ways every frame, on their own entities, so neither gets the warm caches
+	CUtlVector< InterpolatedVarTestEntity_t * > entities[2];
+	float flLastTick[2];
+	double flTimes[2];
+	for ( int nMode = 0; nMode < 2; ++nMode )
+	{
+		InterpolatedVarTest_Create( entities[nMode], nEntities );
+		flLastTick[nMode] = 0.0f;
+		flTimes[nMode] = 0.0;
+	}
+
+	for ( int nFrame = 1; nFrame <= nFrames; ++nFrame )
+	{
+		float flTime = nFrame * 0.01f;
+		for ( int nMode = 0; nMode < 2; ++nMode )
+		{
+			InterpolatedVarTest_Simulate( entities[nMode], flLastTick[nMode], flTime );
+
+			double flStart = Plat_FloatTime();
+			for ( int i = 0; i < entities[nMode].Count(); ++i )
+			{
+				InterpolatedVarTestEntity_t *pEntity = entities[nMode][i];
+				if ( nMode == 0 )
+				{
+					for ( int j = 0; j < INTERPOLATEDVAR_TEST_VARS; ++j )
+					{
+						pEntity->m_pVars[j]->Interpolate( flTime );
+					}
+				}
+				else
+				{
+					for ( int j = 0; j < INTERPOLATEDVAR_TEST_VARS; ++j )
+					{
+						InterpolateSIMD( pEntity->m_pVars[j], pEntity->m_nSIMDTypes[j], flTime );
+					}
+				}
+			}
+			flTimes[nMode] += Plat_FloatTime() - flStart;
+		}
+	}
+
+	entities[0].PurgeAndDeleteElements();
+	entities[1].PurgeAndDeleteElements();
+
+	Msg( "interpolated var simd: %d entities, %d frames\n", nEntities, nFrames );
+	Msg( "  per var: %8.3f ms (%.3f us per frame)\n", flTimes[0] * 1000.0, flTimes[0] * 1000000.0 / nFrames );
+	Msg( "  simd:    %8.3f ms (%.3f us per frame), %.2fx\n", flTimes[1] * 1000.0, flTimes[1] * 1000000.0 / nFrames, flTimes[1] > 0.0 ? flTimes[0] / flTimes[1] : 0.0 );
+}
+
+void CC_InterpolatedVarSIMDTest( const CCommand &args )
+{
+	int nEntities = ( args.ArgC() >= 2 ) ? atoi( args[1] ) : 128;
+	int nFrames = ( args.ArgC() >= 3 ) ? atoi( args[2] ) : 1000;
+	if ( !InterpolatedVarSIMD_Validate( MIN( nEntities, 64 ), nFrames ) )
+		return;
+
+	InterpolatedVarSIMD_Benchmark( nEntities, nFrames );
+}
+
+static ConCommand interpolated_var_simd_test( "interpolated_var_simd_test", CC_InterpolatedVarSIMDTest, "Checks SIMD interpolation of float and Vector arrays against Interpolate() on test entities, then times both. Usage: interpolated_var_simd_test [entities] [frames]", FCVAR_CHEAT );
+
+#endif // FASTPATH_TESTS
@@ -143,6 +143,55 @@ inline QAngle ExtrapolateInterpolatedVarType( const QAngle &oldVal, const QAngle
 }
 
 
+// -------------------------------------------------------------------------------------------------------------- //
+// Arrays of floats and Vectors (pose parameters, bone controllers, attachment
+// points) are interpolated as one run of floats, four at a time, with the
+// weights worked out once for the whole array instead of per element.
+// -------------------------------------------------------------------------------------------------------------- //
+
+enum InterpolatedVarSIMDType_t
+{
+	INTERPOLATEDVAR_SIMD_NONE = 0,		// IInterpolatedVar::Interpolate() only
+	INTERPOLATEDVAR_SIMD_FLOAT_ARRAY,
+	INTERPOLATEDVAR_SIMD_VECTOR_ARRAY,
+};
+
+template< typename Type, bool IS_ARRAY >
+struct CInterpolatedVarSIMDType
+{
+	enum { TYPE = INTERPOLATEDVAR_SIMD_NONE, FLOATS = 0 };
+};
+
+template<> struct CInterpolatedVarSIMDType< float, true >	{ enum { TYPE = INTERPOLATEDVAR_SIMD_FLOAT_ARRAY, FLOATS = 1 }; };
+template<> struct CInterpolatedVarSIMDType< Vector, true >	{ enum { TYPE = INTERPOLATEDVAR_SIMD_VECTOR_ARRAY, FLOATS = 3 }; };
+
+// Arrays shorter than this go through Interpolate()
+#define INTERPOLATEDVAR_SIMD_MIN_FLOATS		4
+
+class CInterpolatedVarSIMD
+{
+public:
+	struct Weights_t
+	{
+		bool	m_bHermite;
+		bool	m_bFixup;
+		float	m_flFrac;
+		float	m_flFixupLerp;
+		float	m_flBasis[4];			// hermite weights of m_flFrac
+	};
+
+	static void InitLerpWeights( Weights_t &weights, float flFrac );
+	static void InitHermiteWeights( Weights_t &weights, float flFrac, bool bFixup, float flFixupLerp );
+
+	// The time fixup of CInterpolatedVarArrayBase::TimeFixup2_Hermite(): if it
+	// applies, the previous sample is moved to Lerp( flFixupLerp, prev, start )
+	static bool GetHermiteFixup( float flPrevTime, float flStartTime, float flEndTime, float &flFixupLerp );
+
+	// pPrev is only read with hermite weights
+	static void Interpolate( const Weights_t &weights, float *pOut, const float *pPrev, const float *pStart, const float *pEnd, int nFloats );
+};
+
+
 // -------------------------------------------------------------------------------------------------------------- //
 // IInterpolatedVar interface.
 // -------------------------------------------------------------------------------------------------------------- //
@@ -169,6 +218,9 @@ public:
 
 	virtual const char *GetDebugName() = 0;
 	virtual void SetDebugName( const char* pName )	= 0;
+
+	// InterpolatedVarSIMDType_t; tells InterpolateSIMD() what the var is
+	virtual int	 GetSIMDType() const = 0;
 };
 
 template< typename Type, bool IS_ARRAY >
@@ -451,6 +503,7 @@ public:
 	virtual void RestoreToLastNetworked();
 	virtual void Copy( IInterpolatedVar *pInSrc );
 	virtual const char *GetDebugName() { return m_pDebugName; }
+	virtual int GetSIMDType() const { return CInterpolatedVarSIMDType< Type, IS_ARRAY >::TYPE; }
 
 
 public:
@@ -459,6 +512,9 @@ public:
 	bool NoteChanged( float flCurrentTime, float flChangeTime, float interpolation_amount, bool bUpdateLastNetworkedValue );
 	int Interpolate( float currentTime, float interpolation_amount );
 
+	// Same result as Interpolate( currentTime ), see CInterpolatedVarSIMD
+	int InterpolateSIMD( float currentTime );
+
 	void DebugInterpolate( Type *pOut, float currentTime );
 
 	void GetDerivative( Type *pOut, float currentTime );
@@ -1132,6 +1188,67 @@ inline int CInterpolatedVarArrayBase<Type, IS_ARRAY>::Interpolate( float current
 	return Interpolate( currentTime, m_InterpolationAmount );
 }
 
+template< typename Type, bool IS_ARRAY >
+inline int CInterpolatedVarArrayBase<Type, IS_ARRAY>::InterpolateSIMD( float currentTime )
+{
+	const int nElementFloats = CInterpolatedVarSIMDType< Type, IS_ARRAY >::FLOATS;
+	float interpolation_amount = m_InterpolationAmount;
+	int nFloats = m_nMaxCount * nElementFloats;
+	if ( nFloats < INTERPOLATEDVAR_SIMD_MIN_FLOATS )
+		return Interpolate( currentTime, interpolation_amount );
+
+	int noMoreChanges = 0;
+
+	CInterpolationInfo info;
+	if (!GetInterpolationInfo( &info, currentTime, interpolation_amount, &noMoreChanges ))
+		return noMoreChanges;
+
+	// Out of samples; this is where Interpolate() may extrapolate
+	if ( info.newer == info.older )
+		return Interpolate( currentTime, interpolation_amount );
+
+	CVarHistory &history = m_VarHistory;
+	const Type *pEnd = history[info.newer].GetValue();
+	const Type *pStart = history[info.older].GetValue();
+	const Type *pPrev = NULL;
+	bool bFixup = false;
+	float flFixupLerp = 0.0f;
+
+	CInterpolatedVarSIMD::Weights_t weights;
+	if ( info.m_bHermite )
+	{
+		pPrev = history[info.oldest].GetValue();
+		bFixup = CInterpolatedVarSIMD::GetHermiteFixup( history[info.oldest].flChangeTime, history[info.older].flChangeTime, history[info.newer].flChangeTime, flFixupLerp );
+		CInterpolatedVarSIMD::InitHermiteWeights( weights, info.frac, bFixup, flFixupLerp );
+	}
+	else
+	{
+		CInterpolatedVarSIMD::InitLerpWeights( weights, info.frac );
+	}
+
+	CInterpolatedVarSIMD::Interpolate( weights, (float *)m_pValue, (const float *)pPrev, (const float *)pStart, (const float *)pEnd, nFloats );
+
+	// The looping elements are redone over the whole array
+	for ( int i = 0; i < m_nMaxCount; i++ )
+	{
+		if ( !m_bLooping[ i ] )
+			continue;
+
+		if ( info.m_bHermite )
+		{
+			Type prev = bFixup ? LoopingLerp( flFixupLerp, pPrev[i], pStart[i] ) : pPrev[i];
+			m_pValue[ i ] = LoopingLerp_Hermite( m_pValue[ i ], info.frac, prev, pStart[i], pEnd[i] );
+		}
+		else
+		{
+			m_pValue[ i ] = LoopingLerp( info.frac, pStart[i], pEnd[i] );
+		}
+	}
+
+	RemoveEntriesPreviousTo( currentTime - interpolation_amount - EXTRA_INTERPOLATION_HISTORY_STORED );
+	return noMoreChanges;
+}
+
 template< typename Type, bool IS_ARRAY >
 inline void CInterpolatedVarArrayBase<Type, IS_ARRAY>::Copy( IInterpolatedVar *pInSrc )
 {
@@ -1556,6 +1673,40 @@ public:
 	}
 };
 
+
+//-----------------------------------------------------------------------------
+// Interpolates pVar with CInterpolatedVarSIMD if its type allows it.
+// nSIMDType is what pVar->GetSIMDType() returned, so callers can keep it
+// with the var and skip the virtual call.
+//-----------------------------------------------------------------------------
+inline int InterpolateSIMD( IInterpolatedVar *pVar, int nSIMDType, float currentTime )
+{
+	Assert( nSIMDType == pVar->GetSIMDType() );
+
+#ifndef INTERPOLATEDVAR_PARANOID_MEASUREMENT
+	switch ( nSIMDType )
+	{
+	case INTERPOLATEDVAR_SIMD_FLOAT_ARRAY:
+		return static_cast< CInterpolatedVarArrayBase< float, true > * >( pVar )->InterpolateSIMD( currentTime );
+	case INTERPOLATEDVAR_SIMD_VECTOR_ARRAY:
+		return static_cast< CInterpolatedVarArrayBase< Vector, true > * >( pVar )->InterpolateSIMD( currentTime );
+	}
+#endif
+
+	return pVar->Interpolate( currentTime );
+}
+
+
+#if defined( FASTPATH_TESTS )
+//-----------------------------------------------------------------------------
+// Checks InterpolateSIMD() against Interpolate() on test entities with float
+// and Vector arrays (some elements looping, some vars linear only) next to
+// the vars it leaves alone, then times both
+//-----------------------------------------------------------------------------
+bool InterpolatedVarSIMD_Validate( int nEntities, int nFrames );
+void InterpolatedVarSIMD_Benchmark( int nEntities, int nFrames );
+#endif
+
 #include "tier0/memdbgoff.h"
 
 #endif // INTERPOLATEDVAR_H
@@ -8,5 +8,7 @@
 bool CheckMMXTechnology(void);
 bool CheckSSETechnology(void);
 bool CheckSSE2Technology(void);
+bool CheckSSE42Technology(void);
+bool CheckPCLMULQDQTechnology(void);
 bool Check3DNowTechnology(void);
 
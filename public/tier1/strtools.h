@@ -138,6 +138,12 @@ const char *StringAfterPrefixCaseSensitive(const char *str, const char *prefix);
 inline bool	StringHasPrefix(const char *str, const char *prefix) { return StringAfterPrefix(str, prefix) != NULL; }
 inline bool	StringHasPrefixCaseSensitive(const char *str, const char *prefix) { return StringAfterPrefixCaseSensitive(str, prefix) != NULL; }
 
+#if defined( FASTPATH_TESTS )
+// Checks the SSE2/SSE4.2 string kernels against their scalar versions, and times them
+bool		V_ValidateStringKernels();
+void		V_BenchmarkStringKernels( int nIterations );
+#endif
+
 
 // Normalizes a float string in place.  
 // (removes leading zeros, trailing zeros after the decimal point, and the decimal point itself where possible)
@@ -1119,6 +1119,9 @@ inline bool CUtlBuffer::WasLastCharacterCR()
 {
 	if ( !IsText() || (TellPut() == 0) )
 		return false;
+	// Windowed buffers (CUtlSegmentedBuffer) may not have the previous character mapped
+	if ( ( m_Put - 1 < m_nOffset ) || ( m_Put - 1 >= m_nOffset + Size() ) )
+		return false;
 	return ( *( const char * )PeekPut( -1 ) == '\n' );
 }
 
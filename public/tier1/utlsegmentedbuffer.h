@@ -0,0 +1,131 @@
+//===== Copyright (c) 1996-2005, Valve Corporation, All rights reserved. ======//
+//
+// Purpose: CUtlBuffer that stores its contents in a chain of fixed size pages
+//			instead of one contiguous allocation. Growing never copies what
+//			was already written, and the pages can be handed straight to
+//			vectored writes.
+//
+//			The Put*/Get* API works unchanged: the buffer window (Base(),
+//			Size()) always maps the page holding the put or get position.
+//			Reads that cross a page boundary go through a small bounce copy;
+//			writes that cross one (only possible after seeking back) merge
+//			the pages they touch. Base()/Size() therefore only describe the
+//			current page: use GetSegments() or CopyTo() for the whole contents.
+//
+//			Detach(), AssumeMemory(), SetExternalBuffer(), EnsureCapacity()
+//			and AccessForDirectRead() are not supported on segmented buffers.
+//
+// $NoKeywords: $
+//===========================================================================//
+
+#ifndef UTLSEGMENTEDBUFFER_H
+#define UTLSEGMENTEDBUFFER_H
+
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include "tier1/utlbuffer.h"
+#include "tier1/utlvector.h"
+
+
+//-----------------------------------------------------------------------------
+// One contiguous piece of the buffer contents, iovec style
+//-----------------------------------------------------------------------------
+struct UtlBufferSegment_t
+{
+	const void	*m_pData;
+	int			m_nLength;
+};
+
+
+class CUtlSegmentedBuffer : public CUtlBuffer
+{
+	typedef CUtlBuffer BaseClass;
+
+public:
+	enum
+	{
+		// Pages of this size are recycled through a shared pool
+		DEFAULT_PAGE_SIZE = 64 * 1024,
+	};
+
+	// See CUtlBuffer::BufferFlags_t for flags. READ_ONLY and EXTERNAL_GROWABLE don't apply.
+	CUtlSegmentedBuffer( int nFlags = 0, int nPageSize = DEFAULT_PAGE_SIZE );
+	~CUtlSegmentedBuffer();
+
+	// Hide the CUtlBuffer versions, which don't know about the page list.
+	// Clear() keeps the first page; Purge() releases everything.
+	void Clear();
+	void Purge();
+
+	int GetPageSize() const;
+
+	// Number of pieces TellMaxPut() bytes are currently stored in
+	int GetSegmentCount() const;
+
+	// Fills out up to nMaxSegments pieces describing the contents from
+	// nStartOffset to TellMaxPut(). Returns the number written. The pointers
+	// stay valid until the next put, Clear() or Purge().
+	int GetSegments( UtlBufferSegment_t *pSegments, int nMaxSegments, int nStartOffset = 0 ) const;
+
+	// Copies nBytes starting at nStartOffset into pDest. Returns the number of bytes copied.
+	int CopyTo( void *pDest, int nStartOffset, int nBytes ) const;
+
+	// Appends the whole contents to a regular buffer, for code that needs Base()
+	void CopyTo( CUtlBuffer &dest ) const;
+
+private:
+	struct Segment_t
+	{
+		unsigned char	*m_pData;
+		int				m_nOffset;		// position of m_pData[0] in the stream
+		int				m_nCapacity;
+	};
+
+	// Overflow functions
+	bool SegmentPutOverflow( int nSize );
+	bool SegmentGetOverflow( int nSize );
+
+	// Index of the segment holding nOffset (or the last one), -1 when empty
+	int FindSegment( int nOffset ) const;
+
+	// Same, merging pages where needed for a put at nOffset
+	int PutSegment( int nOffset );
+
+	// End of the bytes stored in a segment
+	int SegmentEnd( int nSegment ) const;
+	int DataEnd() const;
+
+	// Points the CUtlBuffer window at a segment
+	void MapSegment( int nSegment );
+
+	// Starts a new last page able to hold the bytes [nStart, nEnd)
+	void AddPage( int nStart, int nEnd );
+
+	// Replaces segments nFirst..nLast with one allocation at least nMinCapacity long
+	int MergeSegments( int nFirst, int nLast, int nMinCapacity );
+
+	// Releases pages past the end of the data (after a CUtlBuffer::Clear())
+	void TrimSegments();
+
+	unsigned char *AllocPage( int nCapacity );
+	void FreePage( unsigned char *pData, int nCapacity );
+
+	CUtlVector< Segment_t > m_Segments;
+	CUtlMemory< unsigned char > m_Bounce;
+	int m_nPageSize;
+};
+
+
+#if defined( FASTPATH_TESTS )
+//-----------------------------------------------------------------------------
+// Checks the segmented buffer against a regular CUtlBuffer across page
+// boundaries, and times both on multi-megabyte serialization
+//-----------------------------------------------------------------------------
+bool UtlSegmentedBuffer_Validate( int nIterations );
+void UtlSegmentedBuffer_Benchmark( int nMegabytes );
+#endif
+
+
+#endif // UTLSEGMENTEDBUFFER_H
@@ -0,0 +1,103 @@
+//========= Copyright (c) 1996-2005, Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Per-thread VProf scope event recorder.
+//
+//			Every thread that enters a VPROF scope while recording is active
+//			gets its own fixed size ring buffer of enter/exit events. The
+//			owning thread is the only writer so recording never takes a lock;
+//			dumps snapshot the rings and discard anything the writer lapped
+//			while it was being copied. A thread's ring is freed at the first
+//			tick boundary after the thread exits. The recorded window can be
+//			exported as Chrome trace JSON (chrome://tracing) or a compact
+//			binary format.
+//
+// $NoKeywords: $
+//=============================================================================//
+
+#ifndef VPROFTRACE_H
+#define VPROFTRACE_H
+
+#if defined( _WIN32 )
+#pragma once
+#endif
+
+#include "tier0/platform.h"
+
+class CUtlBuffer;
+
+//-----------------------------------------------------------------------------
+// Recorded events
+//-----------------------------------------------------------------------------
+enum VProfTraceEventType_t
+{
+	VPROF_TRACE_ENTER = 0,
+	VPROF_TRACE_EXIT,
+	VPROF_TRACE_TICK,
+};
+
+struct VProfTraceEvent_t
+{
+	uint64			m_nCycles;
+	const tchar		*m_pszName;			// scope name; NULL for exit events
+	const tchar		*m_pszBudgetGroup;
+	int				m_nTick;
+	int				m_nType;			// VProfTraceEventType_t
+};
+
+// Events per thread ring, must be a power of two
+#define VPROF_TRACE_BUFFER_SIZE		32768
+
+#define VPROF_TRACE_BINARY_ID		MAKEID( 'V', 'P', 'T', 'R' )
+#define VPROF_TRACE_BINARY_VERSION	1
+
+struct CVProfTraceThreadBuffer;
+
+//-----------------------------------------------------------------------------
+// The recorder. Fed by CVProfScope, or CVProfTraceScope where the node profiler
+// is compiled out, through VProfScopeHooks() (tier0/vprof.h) and ticked by the
+// server.
+//-----------------------------------------------------------------------------
+class CVProfTraceRecorder
+{
+public:
+	CVProfTraceRecorder();
+	~CVProfTraceRecorder();
+
+	// Recording is off by default; when off the VPROF macros only pay for a flag test
+	void Start();
+	void Stop();
+	bool IsRecording() const { return m_bRecording; }
+
+	void EnterScope( const tchar *pszName, const tchar *pszBudgetGroup );
+	void ExitScope();
+
+	// Tick boundaries delimit the window that can be dumped. Call from the
+	// thread that dumps; rings of exited threads are released here.
+	void MarkTick( int nTick );
+	int GetCurrentTick() const { return m_nCurrentTick; }
+
+	// Requests a dump at the next tick boundary (see CVProfSpikeDetector)
+	void SignalSpike() { m_bSpikePending = true; }
+	bool ConsumeSpike();
+
+	// Export the events of the last nTicks ticks on all threads
+	void DumpChromeTrace( CUtlBuffer &buf, int nTicks );
+	void DumpBinary( CUtlBuffer &buf, int nTicks );
+
+	int GetThreadCount() const;
+
+private:
+	CVProfTraceThreadBuffer *GetThreadBuffer();
+	void ReleaseExitedThreads();
+	int SnapshotThread( CVProfTraceThreadBuffer *pBuffer, VProfTraceEvent_t *pOut, int nMinTick );
+
+	CVProfTraceThreadBuffer * volatile m_pBuffers;
+	volatile bool	m_bRecording;
+	volatile bool	m_bSpikePending;
+	volatile int	m_nCurrentTick;
+	uint64			m_nStartCycles;
+};
+
+extern CVProfTraceRecorder g_VProfTraceRecorder;
+
+#endif // VPROFTRACE_H
@@ -7,6 +7,21 @@
 #include "basetypes.h"
 #include "commonmacros.h"
 #include "checksum_crc.h"
+#include "tier0/dbg.h"
+#include "tier0/fasttimer.h"
+#include "tier0/threadtools.h"
+#include "tier1/processor_detect.h"
+
+#if ( defined( _M_IX86 ) || defined( _M_X64 ) || defined( __i386__ ) || defined( __x86_64__ ) ) && !defined( _X360 ) && !( defined( _MSC_VER ) && _MSC_VER < 1500 )
+#define CRC32_PCLMUL
+#include <emmintrin.h>
+#include <wmmintrin.h>
+#ifdef _WIN32
+#define CRC32_PCLMUL_FUNC
+#else
+#define CRC32_PCLMUL_FUNC	__attribute__(( target( "pclmul" ) ))
+#endif
+#endif
 
 // memdbgon must be the last include file in a .cpp file!!!
 #include "tier0/memdbgon.h"
@@ -98,7 +113,11 @@ CRC32_t	CRC32_GetTableEntry( unsigned int slot )
 	return pulCRCTable[(unsigned char)slot];
 }
 
-void CRC32_ProcessBuffer(CRC32_t *pulCRC, const void *pBuffer, int nBuffer)
+//-----------------------------------------------------------------------------
+// Table-driven version, one table lookup per byte. This is the reference the
+// faster paths below are checked against.
+//-----------------------------------------------------------------------------
+static void CRC32_ProcessBuffer_Table(CRC32_t *pulCRC, const void *pBuffer, int nBuffer)
 {
 	CRC32_t ulCrc = *pulCRC;
 	unsigned char *pb = (unsigned char *)pBuffer;
@@ -119,7 +138,7 @@ JustAfew:
         ulCrc  = pulCRCTable[*pb++ ^ (unsigned char)ulCrc] ^ (ulCrc >> 8);
 
     case 4:
-        ulCrc ^= LittleLong( *(CRC32_t *)pb );
+        ulCrc ^= LittleLong( *(uint32 *)pb );
         ulCrc  = pulCRCTable[(unsigned char)ulCrc] ^ (ulCrc >> 8);
         ulCrc  = pulCRCTable[(unsigned char)ulCrc] ^ (ulCrc >> 8);
         ulCrc  = pulCRCTable[(unsigned char)ulCrc] ^ (ulCrc >> 8);
@@ -147,7 +166,7 @@ JustAfew:
     // The low-order two bits of pb and nBuffer in total control the
     // upfront work.
     //
-    nFront = ((unsigned int)pb) & 3;
+    nFront = ((uintp)pb) & 3;
     nBuffer -= nFront;
     switch (nFront)
     {
@@ -162,12 +181,12 @@ JustAfew:
     nMain = nBuffer >> 3;
     while (nMain--)
     {
-        ulCrc ^= LittleLong( *(CRC32_t *)pb );
+        ulCrc ^= LittleLong( *(uint32 *)pb );
         ulCrc  = pulCRCTable[(unsigned char)ulCrc] ^ (ulCrc >> 8);
         ulCrc  = pulCRCTable[(unsigned char)ulCrc] ^ (ulCrc >> 8);
         ulCrc  = pulCRCTable[(unsigned char)ulCrc] ^ (ulCrc >> 8);
         ulCrc  = pulCRCTable[(unsigned char)ulCrc] ^ (ulCrc >> 8);
-        ulCrc ^= LittleLong( *(CRC32_t *)(pb + 4) );
+        ulCrc ^= LittleLong( *(uint32 *)(pb + 4) );
         ulCrc  = pulCRCTable[(unsigned char)ulCrc] ^ (ulCrc >> 8);
         ulCrc  = pulCRCTable[(unsigned char)ulCrc] ^ (ulCrc >> 8);
         ulCrc  = pulCRCTable[(unsigned char)ulCrc] ^ (ulCrc >> 8);
@@ -178,3 +197,366 @@ JustAfew:
     nBuffer &= 7;
     goto JustAfew;
 }
+
+
+//-----------------------------------------------------------------------------
+// Slicing-by-8/16. Table k holds the CRC of a byte followed by k zero bytes,
+// so 8 or 16 input bytes fold into the CRC with independent lookups.
+// Built from pulCRCTable on first use.
+//-----------------------------------------------------------------------------
+#define CRC32_NUM_SLICES	16
+
+static uint32 s_CRCSliceTable[CRC32_NUM_SLICES][NUM_BYTES];
+static volatile bool s_bCRCSliceTableBuilt = false;
+
+static void CRC32_BuildSliceTables()
+{
+	// Threads that race in here all write identical values
+	for ( int i = 0; i < NUM_BYTES; ++i )
+	{
+		uint32 nCRC = (uint32)pulCRCTable[i];
+		s_CRCSliceTable[0][i] = nCRC;
+		for ( int k = 1; k < CRC32_NUM_SLICES; ++k )
+		{
+			nCRC = (uint32)pulCRCTable[ nCRC & 0xFF ] ^ ( nCRC >> 8 );
+			s_CRCSliceTable[k][i] = nCRC;
+		}
+	}
+
+	// The tables have to be visible before the flag is, or a thread on a
+	// weakly ordered CPU (360) could see the flag and read stale entries
+	ThreadMemoryBarrier();
+	s_bCRCSliceTableBuilt = true;
+}
+
+static inline uint32 CRC32_Bytes( uint32 nCRC, const unsigned char *pb, int nBytes )
+{
+	while ( nBytes-- > 0 )
+	{
+		nCRC = (uint32)pulCRCTable[ *pb++ ^ (unsigned char)nCRC ] ^ ( nCRC >> 8 );
+	}
+	return nCRC;
+}
+
+#define CRC32_SLICE4( nWord, nFirst ) \
+	( s_CRCSliceTable[nFirst][ (nWord) & 0xFF ] ^ s_CRCSliceTable[nFirst - 1][ ( (nWord) >> 8 ) & 0xFF ] ^ \
+	  s_CRCSliceTable[nFirst - 2][ ( (nWord) >> 16 ) & 0xFF ] ^ s_CRCSliceTable[nFirst - 3][ (nWord) >> 24 ] )
+
+static uint32 CRC32_Slice8( uint32 nCRC, const unsigned char *pb, int nBuffer )
+{
+	// Align to 4 so the word loads are aligned on every platform
+	int nFront = MIN( nBuffer, (int)( ( 4 - ( (uintp)pb & 3 ) ) & 3 ) );
+	nCRC = CRC32_Bytes( nCRC, pb, nFront );
+	pb += nFront;
+	nBuffer -= nFront;
+
+	for ( ; nBuffer >= 8; nBuffer -= 8, pb += 8 )
+	{
+		uint32 nWord0 = nCRC ^ LittleLong( *(const uint32 *)pb );
+		uint32 nWord1 = LittleLong( *(const uint32 *)( pb + 4 ) );
+		nCRC = CRC32_SLICE4( nWord0, 7 ) ^ CRC32_SLICE4( nWord1, 3 );
+	}
+
+	return CRC32_Bytes( nCRC, pb, nBuffer );
+}
+
+static uint32 CRC32_Slice16( uint32 nCRC, const unsigned char *pb, int nBuffer )
+{
+	int nFront = MIN( nBuffer, (int)( ( 4 - ( (uintp)pb & 3 ) ) & 3 ) );
+	nCRC = CRC32_Bytes( nCRC, pb, nFront );
+	pb += nFront;
+	nBuffer -= nFront;
+
+	for ( ; nBuffer >= 16; nBuffer -= 16, pb += 16 )
+	{
+		uint32 nWord0 = nCRC ^ LittleLong( *(const uint32 *)pb );
+		uint32 nWord1 = LittleLong( *(const uint32 *)( pb + 4 ) );
+		uint32 nWord2 = LittleLong( *(const uint32 *)( pb + 8 ) );
+		uint32 nWord3 = LittleLong( *(const uint32 *)( pb + 12 ) );
+		nCRC = CRC32_SLICE4( nWord0, 15 ) ^ CRC32_SLICE4( nWord1, 11 ) ^ CRC32_SLICE4( nWord2, 7 ) ^ CRC32_SLICE4( nWord3, 3 );
+	}
+
+	return CRC32_Slice8( nCRC, pb, nBuffer );
+}
+
+
+#ifdef CRC32_PCLMUL
+//-----------------------------------------------------------------------------
+// Carry-less multiply folding ("Fast CRC Computation for Generic Polynomials
+// Using PCLMULQDQ Instruction", Gopal et al., Intel 2009), with the
+// bit-reflected constants for the IEEE polynomial 0xEDB88320.
+// Requires nBuffer >= 64 and a multiple of 16.
+//-----------------------------------------------------------------------------
+CRC32_PCLMUL_FUNC static uint32 CRC32_Fold_PCLMUL( uint32 nCRC, const unsigned char *pb, int nBuffer )
+{
+	const __m128i k1k2 = _mm_set_epi32( 0x00000001, 0xc6e41596, 0x00000001, 0x54442bd4 );	// x^(4*128+32), x^(4*128-32)
+	const __m128i k3k4 = _mm_set_epi32( 0x00000000, 0xccaa009e, 0x00000001, 0x751997d0 );	// x^(128+32), x^(128-32)
+	const __m128i k5k0 = _mm_set_epi32( 0x00000000, 0x00000000, 0x00000001, 0x63cd6124 );	// x^64
+	const __m128i poly = _mm_set_epi32( 0x00000001, 0xf7011641, 0x00000001, 0xdb710641 );	// P(x)', mu
+	const __m128i mask32 = _mm_set_epi32( 0, ~0, 0, ~0 );
+
+	Assert( nBuffer >= 64 && ( nBuffer & 15 ) == 0 );
+
+	__m128i x1 = _mm_xor_si128( _mm_loadu_si128( (const __m128i *)( pb + 0x00 ) ), _mm_cvtsi32_si128( (int)nCRC ) );
+	__m128i x2 = _mm_loadu_si128( (const __m128i *)( pb + 0x10 ) );
+	__m128i x3 = _mm_loadu_si128( (const __m128i *)( pb + 0x20 ) );
+	__m128i x4 = _mm_loadu_si128( (const __m128i *)( pb + 0x30 ) );
+	pb += 64;
+	nBuffer -= 64;
+
+	// Fold four 128 bit lanes in parallel
+	while ( nBuffer >= 64 )
+	{
+		__m128i x5 = _mm_clmulepi64_si128( x1, k1k2, 0x00 );
+		__m128i x6 = _mm_clmulepi64_si128( x2, k1k2, 0x00 );
+		__m128i x7 = _mm_clmulepi64_si128( x3, k1k2, 0x00 );
+		__m128i x8 = _mm_clmulepi64_si128( x4, k1k2, 0x00 );
+
+		x1 = _mm_clmulepi64_si128( x1, k1k2, 0x11 );
+		x2 = _mm_clmulepi64_si128( x2, k1k2, 0x11 );
+		x3 = _mm_clmulepi64_si128( x3, k1k2, 0x11 );
+		x4 = _mm_clmulepi64_si128( x4, k1k2, 0x11 );
+
+		x1 = _mm_xor_si128( _mm_xor_si128( x1, x5 ), _mm_loadu_si128( (const __m128i *)( pb + 0x00 ) ) );
+		x2 = _mm_xor_si128( _mm_xor_si128( x2, x6 ), _mm_loadu_si128( (const __m128i *)( pb + 0x10 ) ) );
+		x3 = _mm_xor_si128( _mm_xor_si128( x3, x7 ), _mm_loadu_si128( (const __m128i *)( pb + 0x20 ) ) );
+		x4 = _mm_xor_si128( _mm_xor_si128( x4, x8 ), _mm_loadu_si128( (const __m128i *)( pb + 0x30 ) ) );
+
+		pb += 64;
+		nBuffer -= 64;
+	}
+
+	// Fold the four lanes into one
+	__m128i x5 = _mm_clmulepi64_si128( x1, k3k4, 0x00 );
+	x1 = _mm_xor_si128( _mm_xor_si128( _mm_clmulepi64_si128( x1, k3k4, 0x11 ), x2 ), x5 );
+	x5 = _mm_clmulepi64_si128( x1, k3k4, 0x00 );
+	x1 = _mm_xor_si128( _mm_xor_si128( _mm_clmulepi64_si128( x1, k3k4, 0x11 ), x3 ), x5 );
+	x5 = _mm_clmulepi64_si128( x1, k3k4, 0x00 );
+	x1 = _mm_xor_si128( _mm_xor_si128( _mm_clmulepi64_si128( x1, k3k4, 0x11 ), x4 ), x5 );
+
+	// Remaining 16 byte blocks
+	while ( nBuffer >= 16 )
+	{
+		x5 = _mm_clmulepi64_si128( x1, k3k4, 0x00 );
+		x1 = _mm_clmulepi64_si128( x1, k3k4, 0x11 );
+		x1 = _mm_xor_si128( _mm_xor_si128( x1, x5 ), _mm_loadu_si128( (const __m128i *)pb ) );
+		pb += 16;
+		nBuffer -= 16;
+	}
+
+	// 128 -> 64 bits
+	x2 = _mm_clmulepi64_si128( x1, k3k4, 0x10 );
+	x1 = _mm_xor_si128( _mm_srli_si128( x1, 8 ), x2 );
+	x2 = _mm_srli_si128( x1, 4 );
+	x1 = _mm_and_si128( x1, mask32 );
+	x1 = _mm_xor_si128( _mm_clmulepi64_si128( x1, k5k0, 0x00 ), x2 );
+
+	// Barrett reduction to 32 bits
+	x2 = _mm_and_si128( x1, mask32 );
+	x2 = _mm_clmulepi64_si128( x2, poly, 0x10 );
+	x2 = _mm_and_si128( x2, mask32 );
+	x2 = _mm_clmulepi64_si128( x2, poly, 0x00 );
+	x1 = _mm_xor_si128( x1, x2 );
+
+	return (uint32)_mm_cvtsi128_si32( _mm_srli_si128( x1, 4 ) );
+}
+#endif // CRC32_PCLMUL
+
+
+//-----------------------------------------------------------------------------
+// Runtime selection
+//-----------------------------------------------------------------------------
+enum CRC32Impl_t
+{
+	CRC32_IMPL_UNKNOWN = -1,
+	CRC32_IMPL_TABLE = 0,
+	CRC32_IMPL_SLICE8,
+	CRC32_IMPL_SLICE16,
+	CRC32_IMPL_PCLMUL,
+
+	CRC32_IMPL_COUNT
+};
+
+static CRC32Impl_t s_nCRC32BestImpl = CRC32_IMPL_UNKNOWN;
+
+// Shorter buffers don't fill a 16 byte slice
+#define CRC32_SLICE16_MIN_BYTES		32
+#define CRC32_PCLMUL_MIN_BYTES		64
+
+static uint32 CRC32_Process( CRC32Impl_t nImpl, uint32 nCRC, const unsigned char *pb, int nBuffer )
+{
+	if ( nImpl == CRC32_IMPL_TABLE )
+	{
+		CRC32_t ulCRC = nCRC;
+		CRC32_ProcessBuffer_Table( &ulCRC, pb, nBuffer );
+		return (uint32)ulCRC;
+	}
+
+	// Pairs with the barrier in CRC32_BuildSliceTables
+	bool bSliceTableBuilt = s_bCRCSliceTableBuilt;
+	ThreadMemoryBarrier();
+	if ( !bSliceTableBuilt )
+	{
+		CRC32_BuildSliceTables();
+	}
+
+#ifdef CRC32_PCLMUL
+	if ( nImpl == CRC32_IMPL_PCLMUL && nBuffer >= CRC32_PCLMUL_MIN_BYTES )
+	{
+		int nFold = nBuffer & ~15;
+		nCRC = CRC32_Fold_PCLMUL( nCRC, pb, nFold );
+		return CRC32_Slice8( nCRC, pb + nFold, nBuffer - nFold );
+	}
+#endif
+
+	if ( nImpl >= CRC32_IMPL_SLICE16 && nBuffer >= CRC32_SLICE16_MIN_BYTES )
+		return CRC32_Slice16( nCRC, pb, nBuffer );
+
+	return CRC32_Slice8( nCRC, pb, nBuffer );
+}
+
+static CRC32Impl_t CRC32_BestImpl()
+{
+	if ( s_nCRC32BestImpl == CRC32_IMPL_UNKNOWN )
+	{
+#ifdef CRC32_PCLMUL
+		s_nCRC32BestImpl = ( CheckPCLMULQDQTechnology() && CheckSSE2Technology() ) ? CRC32_IMPL_PCLMUL : CRC32_IMPL_SLICE16;
+#else
+		s_nCRC32BestImpl = CRC32_IMPL_SLICE16;
+#endif
+	}
+	return s_nCRC32BestImpl;
+}
+
+void CRC32_ProcessBuffer(CRC32_t *pulCRC, const void *pBuffer, int nBuffer)
+{
+	if ( nBuffer < 8 )
+	{
+		CRC32_ProcessBuffer_Table( pulCRC, pBuffer, nBuffer );
+		return;
+	}
+
+	*pulCRC = CRC32_Process( CRC32_BestImpl(), (uint32)*pulCRC, (const unsigned char *)pBuffer, nBuffer );
+}
+
+
+#if defined( FASTPATH_TESTS )
+
+//-----------------------------------------------------------------------------
+// Randomized check of every implementation against the table version,
+// including buffers fed in several pieces and at every alignment
+//-----------------------------------------------------------------------------
+static const char *s_pCRC32ImplNames[CRC32_IMPL_COUNT] = { "table", "slice-by-8", "slice-by-16", "pclmulqdq" };
+
+static uint32 CRC32_TestRandom( uint32 &nSeed )
+{
+	nSeed = nSeed * 1664525 + 1013904223;
+	return nSeed >> 8;
+}
+
+bool CRC32_ValidateImplementations( int nIterations )
+{
+	const int nMaxBytes = 4096;
+	unsigned char *pData = new unsigned char[ nMaxBytes + 16 ];
+	uint32 nSeed = 0x1234567;
+	int nFailures = 0;
+
+	CRC32Impl_t nBest = CRC32_BestImpl();
+	for ( int i = 0; i < nIterations; ++i )
+	{
+		int nAlign = CRC32_TestRandom( nSeed ) & 15;
+		int nBytes = ( i < nMaxBytes ) ? i : (int)( CRC32_TestRandom( nSeed ) % nMaxBytes );
+		unsigned char *pb = pData + nAlign;
+		for ( int j = 0; j < nBytes; ++j )
+		{
+			pb[j] = (unsigned char)CRC32_TestRandom( nSeed );
+		}
+
+		CRC32_t ulExpected;
+		CRC32_Init( &ulExpected );
+		CRC32_ProcessBuffer_Table( &ulExpected, pb, nBytes );
+		CRC32_Final( &ulExpected );
+
+		for ( int nImpl = CRC32_IMPL_SLICE8; nImpl <= nBest; ++nImpl )
+		{
+			uint32 nCRC = CRC32_Process( (CRC32Impl_t)nImpl, CRC32_INIT_VALUE, pb, nBytes ) ^ CRC32_XOR_VALUE;
+			if ( nCRC != (uint32)ulExpected )
+			{
+				Warning( "CRC32 %s mismatch: %d bytes at alignment %d\n", s_pCRC32ImplNames[nImpl], nBytes, nAlign );
+				++nFailures;
+			}
+		}
+
+		// Streamed in random pieces through the public entry point
+		CRC32_t ulStreamed;
+		CRC32_Init( &ulStreamed );
+		for ( int nDone = 0; nDone < nBytes; )
+		{
+			int nPiece = (int)( CRC32_TestRandom( nSeed ) % 300 );
+			nPiece = MIN( nPiece, nBytes - nDone );
+			CRC32_ProcessBuffer( &ulStreamed, pb + nDone, nPiece );
+			nDone += nPiece;
+		}
+		CRC32_Final( &ulStreamed );
+		if ( ulStreamed != ulExpected )
+		{
+			Warning( "CRC32 streamed mismatch: %d bytes at alignment %d\n", nBytes, nAlign );
+			++nFailures;
+		}
+	}
+
+	delete[] pData;
+
+	if ( nFailures )
+	{
+		Warning( "CRC32: %d of %d buffers FAILED\n", nFailures, nIterations );
+	}
+	else
+	{
+		Msg( "CRC32: %d random buffers match (best implementation: %s)\n", nIterations, s_pCRC32ImplNames[nBest] );
+	}
+	return nFailures == 0;
+}
+
+
+//-----------------------------------------------------------------------------
+// Bytes per cycle of each implementation over a few buffer sizes
+//-----------------------------------------------------------------------------
+void CRC32_Benchmark( int nTotalBytes )
+{
+	static const int s_nSizes[] = { 16, 64, 256, 1400, 65536 };
+	const int nMaxBytes = 65536;
+	unsigned char *pData = new unsigned char[ nMaxBytes ];
+	uint32 nSeed = 0xC0FFEE;
+	for ( int i = 0; i < nMaxBytes; ++i )
+	{
+		pData[i] = (unsigned char)CRC32_TestRandom( nSeed );
+	}
+
+	volatile uint32 nSink = 0;
+	CRC32Impl_t nBest = CRC32_BestImpl();
+	for ( int nSize = 0; nSize < (int)ARRAYSIZE( s_nSizes ); ++nSize )
+	{
+		int nBytes = s_nSizes[nSize];
+		int nPasses = MAX( 1, nTotalBytes / nBytes );
+		Msg( "%6d bytes:", nBytes );
+		for ( int nImpl = CRC32_IMPL_TABLE; nImpl <= nBest; ++nImpl )
+		{
+			CFastTimer timer;
+			timer.Start();
+			for ( int nPass = 0; nPass < nPasses; ++nPass )
+			{
+				nSink += CRC32_Process( (CRC32Impl_t)nImpl, CRC32_INIT_VALUE, pData, nBytes );
+			}
+			timer.End();
+
+			uint64 nCycles = MAX( timer.GetDuration().GetLongCycles(), (uint64)1 );
+			Msg( "  %s %.2f bytes/cycle", s_pCRC32ImplNames[nImpl], (double)nBytes * nPasses / (double)nCycles );
+		}
+		Msg( "\n" );
+	}
+
+	delete[] pData;
+}
+
+#endif // FASTPATH_TESTS
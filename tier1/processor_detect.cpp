@@ -15,6 +15,8 @@
 bool CheckMMXTechnology(void) { return false; }
 bool CheckSSETechnology(void) { return false; }
 bool CheckSSE2Technology(void) { return false; }
+bool CheckSSE42Technology(void) { return false; }
+bool CheckPCLMULQDQTechnology(void) { return false; }
 bool Check3DNowTechnology(void) { return false; }
 
 #elif defined( _WIN32 ) && !defined( _X360 )
@@ -210,6 +212,85 @@ bool CheckSSE2Technology(void)
     return retval;
 }
 
+bool CheckSSE42Technology(void)
+{
+    int retval = true;
+    unsigned int RegECX = 0;
+
+#ifdef CPUID
+	_asm pushad;
+#endif
+
+	// Do we have support for the CPUID function?
+    __try
+	{
+        _asm
+		{
+#ifdef CPUID
+			xor ecx, ecx			// Clue the compiler that ECX is about to be used.
+#endif
+            mov eax, 1				// set up CPUID to return processor version and features
+									//      0 = vendor string, 1 = version info, 2 = cache info
+            CPUID					// code bytes = 0fh,  0a2h
+            mov RegECX, ecx			// extended features returned in ecx
+		}
+    } 
+	__except(EXCEPTION_EXECUTE_HANDLER) 
+	{ 
+		retval = false; 
+	}
+
+	// SSE4.2 needs SSE2 to be usable in the first place
+    if ( retval )
+	{
+		retval = ( RegECX & 0x00100000 ) && CheckSSE2Technology();	// bit 20 is set for SSE4.2
+	}
+
+#ifdef CPUID
+	_asm popad;
+#endif
+
+    return retval;
+}
+
+bool CheckPCLMULQDQTechnology(void)
+{
+    int retval = true;
+    unsigned int RegECX = 0;
+
+#ifdef CPUID
+	_asm pushad;
+#endif
+
+    __try
+	{
+        _asm
+		{
+#ifdef CPUID
+			xor ecx, ecx			// Clue the compiler that ECX is about to be used.
+#endif
+            mov eax, 1				// set up CPUID to return processor version and features
+            CPUID					// code bytes = 0fh,  0a2h
+            mov RegECX, ecx			// extended features returned in ecx
+		}
+    } 
+	__except(EXCEPTION_EXECUTE_HANDLER) 
+	{ 
+		retval = false; 
+	}
+
+    if ( retval )
+	{
+		retval = ( RegECX & 0x00000002 ) != 0;	// bit 1 is set for PCLMULQDQ
+	}
+
+#ifdef CPUID
+	_asm popad;
+#endif
+
+    return retval;
+}
+
 bool Check3DNowTechnology(void)
 {
     int retval = true;
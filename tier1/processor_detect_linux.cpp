@@ -33,6 +33,22 @@ bool CheckSSE2Technology(void)
     return edx & 0x04000000;
 }
 
+bool CheckSSE42Technology(void)
+{
+    unsigned long eax,ebx,ecx,edx;
+    cpuid(1,eax,ebx,ecx,edx);
+
+    return ecx & 0x00100000;
+}
+
+bool CheckPCLMULQDQTechnology(void)
+{
+    unsigned long eax,ebx,ecx,edx;
+    cpuid(1,eax,ebx,ecx,edx);
+
+    return ecx & 0x00000002;
+}
+
 bool Check3DNowTechnology(void)
 {
     unsigned long eax, unused;
@@ -70,6 +70,7 @@
 #include <stdlib.h>
 #include "tier0/basetypes.h"
 #include "tier1/utldict.h"
+#include "strtools_simd.h"
 #if defined( _X360 )
 #include "xbox/xbox_win32stubs.h"
 #endif
@@ -113,7 +114,7 @@ int _V_memcmp (const void *m1, const void *m2, int count)
 int	_V_strlen(const char *str)
 {
 	_AssertValidStringPtr(str);
-	return strlen( str );
+	return StrTools_StrLen( str );
 }
 
 void _V_strcpy (char *dest, const char *src)
@@ -132,11 +133,7 @@ int	_V_wcslen(const wchar_t *pwch)
 char *_V_strrchr(const char *s, char c)
 {
 	_AssertValidStringPtr( s );
-    int len = V_strlen(s);
-    s += len;
-    while (len--)
-	if (*--s == c) return (char *)s;
-    return 0;
+	return (char *)StrTools_StrRChr( s, c );
 }
 
 int _V_strcmp (const char *s1, const char *s2)
@@ -171,7 +168,10 @@ int	_V_stricmp( const char *s1, const char *s2 )
 	_AssertValidStringPtr( s1 );
 	_AssertValidStringPtr( s2 );
 
-	return stricmp( s1, s2 );
+	// Skip the part that matches under case folding 16 bytes at a time, the
+	// CRT only has to order the remainder
+	int nPrefix = StrTools_CaseFoldPrefix( s1, s2, INT_MAX );
+	return stricmp( s1 + nPrefix, s2 + nPrefix );
 }
 
 
@@ -251,6 +251,11 @@ int V_strncasecmp (const char *s1, const char *s2, int n)
 	Assert( n >= 0 );
 	_AssertValidStringPtr( s1 );
 	_AssertValidStringPtr( s2 );
+
+	int nPrefix = StrTools_CaseFoldPrefix( s1, s2, n );
+	s1 += nPrefix;
+	s2 += nPrefix;
+	n -= nPrefix;
 	
 	while ( n-- > 0 )
 	{
@@ -278,7 +283,8 @@ int V_strcasecmp( const char *s1, const char *s2 )
 	_AssertValidStringPtr( s1 );
 	_AssertValidStringPtr( s2 );
 
-	return stricmp( s1, s2 );
+	int nPrefix = StrTools_CaseFoldPrefix( s1, s2, INT_MAX );
+	return stricmp( s1 + nPrefix, s2 + nPrefix );
 }
 
 int V_strnicmp (const char *s1, const char *s2, int n)
@@ -598,17 +604,7 @@ char const* V_strnistr( char const* pStr, char const* pSearch, int n )
 
 const char* V_strnchr( const char* pStr, char c, int n )
 {
-	char const* pLetter = pStr;
-	char const* pLast = pStr + n;
-
-	// Check the entire string
-	while ( (pLetter < pLast) && (*pLetter != 0) )
-	{
-		if (*pLetter == c)
-			return pLetter;
-		++pLetter;
-	}
-	return NULL;
+	return StrTools_StrNChr( pStr, c, n );
 }
 
 void V_strncpy( char *pDest, char const *pSrc, int maxLen )
@@ -617,7 +613,13 @@ void V_strncpy( char *pDest, char const *pSrc, int maxLen )
 	AssertValidWritePtr( pDest, maxLen );
 	_AssertValidStringPtr( pSrc );
 
-	strncpy( pDest, pSrc, maxLen );
+	// Same result as strncpy, including the zero fill
+	int nLen = StrTools_StrNLen( pSrc, maxLen );
+	memcpy( pDest, pSrc, nLen );
+	if ( nLen < maxLen )
+	{
+		memset( pDest + nLen, 0, maxLen - nLen );
+	}
 	if ( maxLen > 0 )
 	{
 		pDest[maxLen-1] = 0;
@@ -1263,14 +1265,7 @@ void  V_StripFilename (char *path)
 //-----------------------------------------------------------------------------
 void V_FixSlashes( char *pname, char separator /* = CORRECT_PATH_SEPARATOR */ )
 {
-	while ( *pname )
-	{
-		if ( *pname == INCORRECT_PATH_SEPARATOR || *pname == CORRECT_PATH_SEPARATOR )
-		{
-			*pname = separator;
-		}
-		pname++;
-	}
+	StrTools_FixSlashes( pname, separator );
 }
 
 
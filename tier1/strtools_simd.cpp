@@ -0,0 +1,666 @@
+//===== Copyright (c) 1996-2005, Valve Corporation, All rights reserved. ======//
+//
+// Purpose: SSE2/SSE4.2 string kernels, chosen at runtime with processor_detect
+//
+// Loads are either 16 byte aligned, which can never cross into an unmapped
+// page, or unaligned but checked to stay inside the current page. Bytes past
+// the terminator can therefore be read but are always masked out.
+//
+//===========================================================================//
+
+#include "tier0/dbg.h"
+#include "tier0/platform.h"
+#include "tier1/strtools.h"
+#include "tier1/processor_detect.h"
+#include "strtools_simd.h"
+
+#if ( defined( _M_IX86 ) || defined( _M_X64 ) || defined( __i386__ ) || defined( __x86_64__ ) ) && !defined( _X360 )
+#define STRTOOLS_SIMD
+#include <emmintrin.h>
+#include <nmmintrin.h>
+#ifdef _WIN32
+#include <intrin.h>
+#pragma intrinsic( _BitScanForward )
+#pragma intrinsic( _BitScanReverse )
+#define STRTOOLS_SSE42_FUNC
+#else
+#define STRTOOLS_SSE42_FUNC	__attribute__(( target( "sse4.2" ) ))
+#endif
+
+// The kernels read past the terminator on purpose, so AddressSanitizer
+// builds must leave them uninstrumented
+#if defined( _MSC_VER ) && _MSC_VER >= 1928
+#define STRTOOLS_NO_ASAN	__declspec( no_sanitize_address )
+#elif defined( __GNUC__ )
+#define STRTOOLS_NO_ASAN	__attribute__(( no_sanitize_address ))
+#else
+#define STRTOOLS_NO_ASAN
+#endif
+#endif
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+#define STRTOOLS_PAGE_SIZE	4096
+
+
+//-----------------------------------------------------------------------------
+// Scalar versions. These define the behavior the SIMD paths must match.
+//-----------------------------------------------------------------------------
+static inline int FoldCaseChar( unsigned char c )
+{
+	return ( c >= 'A' && c <= 'Z' ) ? c + ( 'a' - 'A' ) : c;
+}
+
+int StrTools_CaseFoldPrefix_Scalar( const char *s1, const char *s2, int n )
+{
+	int i;
+	for ( i = 0; i < n; ++i )
+	{
+		unsigned char c1 = s1[i];
+		if ( c1 == 0 || FoldCaseChar( c1 ) != FoldCaseChar( s2[i] ) )
+			break;
+	}
+	return i;
+}
+
+int StrTools_StrLen_Scalar( const char *pStr )
+{
+	const char *p = pStr;
+	while ( *p )
+	{
+		++p;
+	}
+	return p - pStr;
+}
+
+int StrTools_StrNLen_Scalar( const char *pStr, int nMax )
+{
+	int i = 0;
+	while ( i < nMax && pStr[i] )
+	{
+		++i;
+	}
+	return i;
+}
+
+const char *StrTools_StrRChr_Scalar( const char *pStr, char c )
+{
+	int len = StrTools_StrLen_Scalar( pStr );
+	pStr += len;
+	while ( len-- )
+	{
+		if ( *--pStr == c )
+			return pStr;
+	}
+	return NULL;
+}
+
+const char *StrTools_StrNChr_Scalar( const char *pStr, char c, int n )
+{
+	const char *pLast = pStr + n;
+	while ( pStr < pLast && *pStr != 0 )
+	{
+		if ( *pStr == c )
+			return pStr;
+		++pStr;
+	}
+	return NULL;
+}
+
+void StrTools_FixSlashes_Scalar( char *pStr, char separator )
+{
+	while ( *pStr )
+	{
+		if ( *pStr == INCORRECT_PATH_SEPARATOR || *pStr == CORRECT_PATH_SEPARATOR )
+		{
+			*pStr = separator;
+		}
+		pStr++;
+	}
+}
+
+
+#ifdef STRTOOLS_SIMD
+
+//-----------------------------------------------------------------------------
+// Helpers
+//-----------------------------------------------------------------------------
+static inline int FirstBitSet( unsigned int nMask )
+{
+	Assert( nMask );
+#ifdef _WIN32
+	unsigned long nIndex;
+	_BitScanForward( &nIndex, nMask );
+	return (int)nIndex;
+#else
+	return __builtin_ctz( nMask );
+#endif
+}
+
+static inline int LastBitSet( unsigned int nMask )
+{
+	Assert( nMask );
+#ifdef _WIN32
+	unsigned long nIndex;
+	_BitScanReverse( &nIndex, nMask );
+	return (int)nIndex;
+#else
+	return 31 - __builtin_clz( nMask );
+#endif
+}
+
+// True if a 16 byte load at p stays inside p's page
+static inline bool CanLoad16( const void *p )
+{
+	return ( (uintp)p & ( STRTOOLS_PAGE_SIZE - 1 ) ) <= STRTOOLS_PAGE_SIZE - 16;
+}
+
+// Maps 'A'..'Z' to 'a'..'z'. Bytes >= 0x80 compare as negative and are left alone.
+static inline __m128i FoldCase( __m128i v )
+{
+	__m128i upper = _mm_and_si128( _mm_cmpgt_epi8( v, _mm_set1_epi8( 'A' - 1 ) ), _mm_cmplt_epi8( v, _mm_set1_epi8( 'Z' + 1 ) ) );
+	return _mm_or_si128( v, _mm_and_si128( upper, _mm_set1_epi8( 0x20 ) ) );
+}
+
+static inline unsigned int NulMask( __m128i v )
+{
+	return _mm_movemask_epi8( _mm_cmpeq_epi8( v, _mm_setzero_si128() ) );
+}
+
+// Mask with the low nCount bits set, nCount in [0,16]
+static inline unsigned int LowBits( int nCount )
+{
+	return ( 1u << nCount ) - 1;
+}
+
+
+//-----------------------------------------------------------------------------
+// Case-insensitive common prefix
+//-----------------------------------------------------------------------------
+STRTOOLS_NO_ASAN static int CaseFoldPrefix_SSE2( const char *s1, const char *s2, int n )
+{
+	int i = 0;
+	while ( i < n )
+	{
+		if ( !CanLoad16( s1 + i ) || !CanLoad16( s2 + i ) )
+		{
+			// Step a byte at a time to the page boundary
+			unsigned char c1 = s1[i];
+			if ( c1 == 0 || FoldCaseChar( c1 ) != FoldCaseChar( s2[i] ) )
+				return i;
+			++i;
+			continue;
+		}
+
+		__m128i a = _mm_loadu_si128( (const __m128i *)( s1 + i ) );
+		__m128i b = _mm_loadu_si128( (const __m128i *)( s2 + i ) );
+		unsigned int nEqual = _mm_movemask_epi8( _mm_cmpeq_epi8( FoldCase( a ), FoldCase( b ) ) );
+		unsigned int nStop = ( nEqual ^ 0xFFFF ) | NulMask( a );
+		if ( nStop )
+			return MIN( i + FirstBitSet( nStop ), n );
+		i += 16;
+	}
+	return n;
+}
+
+STRTOOLS_NO_ASAN STRTOOLS_SSE42_FUNC static int CaseFoldPrefix_SSE42( const char *s1, const char *s2, int n )
+{
+	int i = 0;
+	while ( i < n )
+	{
+		if ( !CanLoad16( s1 + i ) || !CanLoad16( s2 + i ) )
+		{
+			unsigned char c1 = s1[i];
+			if ( c1 == 0 || FoldCaseChar( c1 ) != FoldCaseChar( s2[i] ) )
+				return i;
+			++i;
+			continue;
+		}
+
+		__m128i a = FoldCase( _mm_loadu_si128( (const __m128i *)( s1 + i ) ) );
+		__m128i b = FoldCase( _mm_loadu_si128( (const __m128i *)( s2 + i ) ) );
+
+		// First byte that differs, or where exactly one of the strings has ended
+		const int nMode = _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_EACH | _SIDD_NEGATIVE_POLARITY | _SIDD_LEAST_SIGNIFICANT;
+		int nIndex = _mm_cmpistri( a, b, nMode );
+		if ( nIndex < 16 )
+			return MIN( i + nIndex, n );
+
+		// Both strings ended at the same byte
+		if ( _mm_cmpistrs( a, b, nMode ) )
+			return MIN( i + FirstBitSet( NulMask( a ) ), n );
+
+		i += 16;
+	}
+	return n;
+}
+
+
+//-----------------------------------------------------------------------------
+// Length
+//-----------------------------------------------------------------------------
+STRTOOLS_NO_ASAN static int StrLen_SSE2( const char *pStr )
+{
+	const char *pBlock = (const char *)( (uintp)pStr & ~(uintp)15 );
+	unsigned int nMask = NulMask( _mm_load_si128( (const __m128i *)pBlock ) ) >> ( pStr - pBlock );
+	if ( nMask )
+		return FirstBitSet( nMask );
+
+	for ( ;; )
+	{
+		pBlock += 16;
+		nMask = NulMask( _mm_load_si128( (const __m128i *)pBlock ) );
+		if ( nMask )
+			return ( pBlock - pStr ) + FirstBitSet( nMask );
+	}
+}
+
+STRTOOLS_NO_ASAN static int StrNLen_SSE2( const char *pStr, int nMax )
+{
+	if ( nMax <= 0 )
+		return 0;
+
+	const char *pBlock = (const char *)( (uintp)pStr & ~(uintp)15 );
+	unsigned int nMask = NulMask( _mm_load_si128( (const __m128i *)pBlock ) ) >> ( pStr - pBlock );
+	if ( nMask )
+		return MIN( FirstBitSet( nMask ), nMax );
+
+	for ( ;; )
+	{
+		pBlock += 16;
+		if ( pBlock - pStr >= nMax )
+			return nMax;
+
+		nMask = NulMask( _mm_load_si128( (const __m128i *)pBlock ) );
+		if ( nMask )
+			return MIN( (int)( pBlock - pStr ) + FirstBitSet( nMask ), nMax );
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Character search
+//-----------------------------------------------------------------------------
+STRTOOLS_NO_ASAN static const char *StrRChr_SSE2( const char *pStr, char c )
+{
+	const __m128i chr = _mm_set1_epi8( c );
+	const char *pBlock = (const char *)( (uintp)pStr & ~(uintp)15 );
+	unsigned int nIgnore = LowBits( pStr - pBlock );
+	const char *pFound = NULL;
+	for ( ;; )
+	{
+		__m128i v = _mm_load_si128( (const __m128i *)pBlock );
+		unsigned int nNul = NulMask( v ) & ~nIgnore;
+		unsigned int nChr = _mm_movemask_epi8( _mm_cmpeq_epi8( v, chr ) ) & ~nIgnore;
+		if ( nNul )
+		{
+			// Only matches before the terminator count
+			nChr &= ( nNul & ( 0 - nNul ) ) - 1;
+			if ( nChr )
+			{
+				pFound = pBlock + LastBitSet( nChr );
+			}
+			return pFound;
+		}
+		if ( nChr )
+		{
+			pFound = pBlock + LastBitSet( nChr );
+		}
+		pBlock += 16;
+		nIgnore = 0;
+	}
+}
+
+STRTOOLS_NO_ASAN static const char *StrNChr_SSE2( const char *pStr, char c, int n )
+{
+	if ( n <= 0 )
+		return NULL;
+
+	const __m128i chr = _mm_set1_epi8( c );
+	const char *pBlock = (const char *)( (uintp)pStr & ~(uintp)15 );
+	unsigned int nIgnore = LowBits( pStr - pBlock );
+	for ( ;; )
+	{
+		__m128i v = _mm_load_si128( (const __m128i *)pBlock );
+		unsigned int nNul = NulMask( v ) & ~nIgnore;
+		unsigned int nChr = _mm_movemask_epi8( _mm_cmpeq_epi8( v, chr ) ) & ~nIgnore;
+		if ( nNul | nChr )
+		{
+			int nIndex = FirstBitSet( nNul | nChr );
+			const char *pHit = pBlock + nIndex;
+			if ( pHit - pStr >= n || ( nNul & ( 1u << nIndex ) ) )
+				return NULL;
+			return pHit;
+		}
+		pBlock += 16;
+		if ( pBlock - pStr >= n )
+			return NULL;
+		nIgnore = 0;
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Slash normalization. The scan is vectorized; only bytes that actually hold
+// a slash are written, so nothing outside the string is ever stored to.
+//-----------------------------------------------------------------------------
+STRTOOLS_NO_ASAN static void FixSlashes_SSE2( char *pStr, char separator )
+{
+	const __m128i fwd = _mm_set1_epi8( '/' );
+	const __m128i back = _mm_set1_epi8( '\\' );
+	char *pBlock = (char *)( (uintp)pStr & ~(uintp)15 );
+	unsigned int nIgnore = LowBits( pStr - pBlock );
+	for ( ;; )
+	{
+		__m128i v = _mm_load_si128( (const __m128i *)pBlock );
+		unsigned int nNul = NulMask( v ) & ~nIgnore;
+		unsigned int nSlash = _mm_movemask_epi8( _mm_or_si128( _mm_cmpeq_epi8( v, fwd ), _mm_cmpeq_epi8( v, back ) ) ) & ~nIgnore;
+		if ( nNul )
+		{
+			nSlash &= ( nNul & ( 0 - nNul ) ) - 1;
+		}
+		while ( nSlash )
+		{
+			pBlock[ FirstBitSet( nSlash ) ] = separator;
+			nSlash &= nSlash - 1;
+		}
+		if ( nNul )
+			return;
+		pBlock += 16;
+		nIgnore = 0;
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Runtime selection
+//-----------------------------------------------------------------------------
+enum StrToolsSIMDLevel_t
+{
+	STRTOOLS_SIMD_UNKNOWN = -1,
+	STRTOOLS_SIMD_NONE = 0,
+	STRTOOLS_SIMD_SSE2,
+	STRTOOLS_SIMD_SSE42,
+};
+
+static StrToolsSIMDLevel_t s_nSIMDLevel = STRTOOLS_SIMD_UNKNOWN;
+
+static inline StrToolsSIMDLevel_t GetSIMDLevel()
+{
+	if ( s_nSIMDLevel == STRTOOLS_SIMD_UNKNOWN )
+	{
+		// Benign race: every thread computes the same answer
+		if ( CheckSSE42Technology() )
+		{
+			s_nSIMDLevel = STRTOOLS_SIMD_SSE42;
+		}
+		else if ( CheckSSE2Technology() )
+		{
+			s_nSIMDLevel = STRTOOLS_SIMD_SSE2;
+		}
+		else
+		{
+			s_nSIMDLevel = STRTOOLS_SIMD_NONE;
+		}
+	}
+	return s_nSIMDLevel;
+}
+
+int StrTools_CaseFoldPrefix( const char *s1, const char *s2, int n )
+{
+	switch ( GetSIMDLevel() )
+	{
+	case STRTOOLS_SIMD_SSE42:	return CaseFoldPrefix_SSE42( s1, s2, n );
+	case STRTOOLS_SIMD_SSE2:	return CaseFoldPrefix_SSE2( s1, s2, n );
+	default:					return StrTools_CaseFoldPrefix_Scalar( s1, s2, n );
+	}
+}
+
+int StrTools_StrLen( const char *pStr )
+{
+	return GetSIMDLevel() >= STRTOOLS_SIMD_SSE2 ? StrLen_SSE2( pStr ) : StrTools_StrLen_Scalar( pStr );
+}
+
+int StrTools_StrNLen( const char *pStr, int nMax )
+{
+	return GetSIMDLevel() >= STRTOOLS_SIMD_SSE2 ? StrNLen_SSE2( pStr, nMax ) : StrTools_StrNLen_Scalar( pStr, nMax );
+}
+
+const char *StrTools_StrRChr( const char *pStr, char c )
+{
+	return GetSIMDLevel() >= STRTOOLS_SIMD_SSE2 ? StrRChr_SSE2( pStr, c ) : StrTools_StrRChr_Scalar( pStr, c );
+}
+
+const char *StrTools_StrNChr( const char *pStr, char c, int n )
+{
+	return GetSIMDLevel() >= STRTOOLS_SIMD_SSE2 ? StrNChr_SSE2( pStr, c, n ) : StrTools_StrNChr_Scalar( pStr, c, n );
+}
+
+void StrTools_FixSlashes( char *pStr, char separator )
+{
+	if ( GetSIMDLevel() >= STRTOOLS_SIMD_SSE2 )
+	{
+		FixSlashes_SSE2( pStr, separator );
+	}
+	else
+	{
+		StrTools_FixSlashes_Scalar( pStr, separator );
+	}
+}
+
+#else // !STRTOOLS_SIMD
+
+int StrTools_CaseFoldPrefix( const char *s1, const char *s2, int n )	{ return StrTools_CaseFoldPrefix_Scalar( s1, s2, n ); }
+int StrTools_StrLen( const char *pStr )									{ return StrTools_StrLen_Scalar( pStr ); }
+int StrTools_StrNLen( const char *pStr, int nMax )						{ return StrTools_StrNLen_Scalar( pStr, nMax ); }
+const char *StrTools_StrRChr( const char *pStr, char c )				{ return StrTools_StrRChr_Scalar( pStr, c ); }
+const char *StrTools_StrNChr( const char *pStr, char c, int n )			{ return StrTools_StrNChr_Scalar( pStr, c, n ); }
+void StrTools_FixSlashes( char *pStr, char separator )					{ StrTools_FixSlashes_Scalar( pStr, separator ); }
+
+#endif // STRTOOLS_SIMD
+
+
+#if defined( FASTPATH_TESTS )
+
+//-----------------------------------------------------------------------------
+// Equivalence test. Every kernel is run against its scalar version for all
+// 16 alignments of each argument, every length up to a few blocks, every
+// position of the interesting byte, and strings that end right at a page
+// boundary so the byte-stepping fallback is covered too.
+//-----------------------------------------------------------------------------
+#define STRTEST_MAX_LEN		80
+#define STRTEST_BUFFER_SIZE	( STRTOOLS_PAGE_SIZE * 2 )
+
+static const char s_TestAlphabet[] = { 'a', 'Z', 'z', 'A', '@', '[', '`', '{', '/', '\\', '_', '0', (char)0xC1, (char)0xE1, (char)0x80, (char)0xFF };
+
+static void FillTestString( char *pDest, int nLen, int nSeed )
+{
+	for ( int i = 0; i < nLen; ++i )
+	{
+		pDest[i] = s_TestAlphabet[ ( nSeed + i * 7 ) % ARRAYSIZE( s_TestAlphabet ) ];
+	}
+	pDest[nLen] = 0;
+}
+
+static int CompareSign( int n )
+{
+	return ( n > 0 ) - ( n < 0 );
+}
+
+// The byte loop V_strncasecmp used before it was given a vectorized prefix scan
+static int StrNCaseCmp_Reference( const char *s1, const char *s2, int n )
+{
+	while ( n-- > 0 )
+	{
+		int c1 = *s1++;
+		int c2 = *s2++;
+
+		if ( c1 != c2 )
+		{
+			if ( c1 >= 'a' && c1 <= 'z' )
+				c1 -= ( 'a' - 'A' );
+			if ( c2 >= 'a' && c2 <= 'z' )
+				c2 -= ( 'a' - 'A' );
+			if ( c1 != c2 )
+				return c1 < c2 ? -1 : 1;
+		}
+		if ( c1 == '\0' )
+			return 0;
+	}
+	return 0;
+}
+
+bool V_ValidateStringKernels()
+{
+	char *pBuffer1 = new char[ STRTEST_BUFFER_SIZE + 16 ];
+	char *pBuffer2 = new char[ STRTEST_BUFFER_SIZE + 16 ];
+	char *pPage1 = (char *)( ( (uintp)pBuffer1 + STRTOOLS_PAGE_SIZE - 1 ) & ~(uintp)( STRTOOLS_PAGE_SIZE - 1 ) );
+	char *pPage2 = (char *)( ( (uintp)pBuffer2 + STRTOOLS_PAGE_SIZE - 1 ) & ~(uintp)( STRTOOLS_PAGE_SIZE - 1 ) );
+	int nFailures = 0;
+	int nTests = 0;
+
+	for ( int nPlacement = 0; nPlacement < 2; ++nPlacement )
+	{
+		for ( int nLen = 0; nLen <= STRTEST_MAX_LEN; ++nLen )
+		{
+			for ( int nAlign = 0; nAlign < 16; ++nAlign )
+			{
+				// Either near the start of a page, or with the terminator on its last byte
+				int nOffset1 = nPlacement ? STRTOOLS_PAGE_SIZE - 1 - nLen - nAlign : nAlign;
+				char *s1 = pPage1 + MAX( nOffset1, 0 );
+				FillTestString( s1, nLen, nLen + nAlign );
+
+				nTests += 5;
+				if ( StrTools_StrLen( s1 ) != StrTools_StrLen_Scalar( s1 ) )
+					++nFailures;
+
+				for ( int nMax = 0; nMax <= nLen + 17; nMax += 3 )
+				{
+					++nTests;
+					if ( StrTools_StrNLen( s1, nMax ) != StrTools_StrNLen_Scalar( s1, nMax ) )
+						++nFailures;
+				}
+
+				for ( int nChar = 0; nChar < (int)ARRAYSIZE( s_TestAlphabet ); ++nChar )
+				{
+					char c = s_TestAlphabet[nChar];
+					if ( StrTools_StrRChr( s1, c ) != StrTools_StrRChr_Scalar( s1, c ) )
+						++nFailures;
+					for ( int n = 0; n <= nLen + 1; n += 5 )
+					{
+						++nTests;
+						if ( StrTools_StrNChr( s1, c, n ) != StrTools_StrNChr_Scalar( s1, c, n ) )
+							++nFailures;
+					}
+				}
+				if ( StrTools_StrRChr( s1, 0 ) != StrTools_StrRChr_Scalar( s1, 0 ) )
+					++nFailures;
+
+				// Fix slashes in a copy and compare the whole neighbourhood, including bytes past the end
+				char fixed1[ STRTEST_MAX_LEN + 32 ], fixed2[ STRTEST_MAX_LEN + 32 ];
+				V_memset( fixed1, 0x5A, sizeof( fixed1 ) );
+				V_memcpy( fixed1 + nAlign, s1, nLen + 1 );
+				V_memcpy( fixed2, fixed1, sizeof( fixed1 ) );
+				StrTools_FixSlashes( fixed1 + nAlign, '#' );
+				StrTools_FixSlashes_Scalar( fixed2 + nAlign, '#' );
+				if ( V_memcmp( fixed1, fixed2, sizeof( fixed1 ) ) )
+					++nFailures;
+
+				// Case folding: second string is a case-flipped copy with a single difference planted at every position
+				for ( int nAlign2 = 0; nAlign2 < 16; ++nAlign2 )
+				{
+					int nOffset2 = nPlacement ? STRTOOLS_PAGE_SIZE - 1 - nLen - nAlign2 : nAlign2;
+					char *s2 = pPage2 + MAX( nOffset2, 0 );
+					for ( int nDiff = -1; nDiff <= nLen; ++nDiff )
+					{
+						for ( int i = 0; i <= nLen; ++i )
+						{
+							char c = s1[i];
+							s2[i] = ( c >= 'a' && c <= 'z' ) ? c - 32 : ( ( c >= 'A' && c <= 'Z' ) ? c + 32 : c );
+						}
+						if ( nDiff >= 0 )
+						{
+							s2[nDiff] = ( nDiff == nLen ) ? '_' : ( s2[nDiff] == '_' ? 0 : '_' );
+							if ( nDiff == nLen )
+							{
+								s2[nDiff + 1] = 0;
+							}
+						}
+
+						for ( int n = 0; n <= nLen + 2; n += ( nLen > 20 ) ? 7 : 1 )
+						{
+							nTests += 3;
+							if ( StrTools_CaseFoldPrefix( s1, s2, n ) != StrTools_CaseFoldPrefix_Scalar( s1, s2, n ) )
+								++nFailures;
+							if ( V_strncasecmp( s1, s2, n ) != StrNCaseCmp_Reference( s1, s2, n ) )
+								++nFailures;
+						}
+						if ( CompareSign( V_stricmp( s1, s2 ) ) != CompareSign( stricmp( s1, s2 ) ) )
+							++nFailures;
+					}
+				}
+			}
+		}
+	}
+
+	delete[] pBuffer1;
+	delete[] pBuffer2;
+
+	if ( nFailures )
+	{
+		Warning( "String kernels: %d of %d checks FAILED\n", nFailures, nTests );
+	}
+	else
+	{
+		Msg( "String kernels: all %d checks passed\n", nTests );
+	}
+	return nFailures == 0;
+}
+
+
+//-----------------------------------------------------------------------------
+// Microbenchmark over path-like strings of typical lengths
+//-----------------------------------------------------------------------------
+void V_BenchmarkStringKernels( int nIterations )
+{
+	static const char *s_pTestStrings[] =
+	{
+		"models/player/custom_player/legacy/ctm_sas_variantA.mdl",
+		"MODELS/PLAYER/CUSTOM_PLAYER/LEGACY/CTM_SAS_VARIANTA.MDL",
+		"materials\\models\\weapons\\v_models\\arms\\glove_hardknuckle\\glove_hardknuckle_black.vmt",
+		"weapon_ak47",
+		"player_hurt",
+		"sound/weapons/ak47/ak47_01.wav",
+	};
+	const int nStrings = ARRAYSIZE( s_pTestStrings );
+	char fixBuffer[MAX_PATH];
+	volatile int nSink = 0;
+
+	for ( int nPath = 0; nPath < 2; ++nPath )
+	{
+		bool bScalar = ( nPath == 0 );
+		double flStart = Plat_FloatTime();
+		for ( int i = 0; i < nIterations; ++i )
+		{
+			const char *s1 = s_pTestStrings[ i % nStrings ];
+			const char *s2 = s_pTestStrings[ ( i + 1 ) % nStrings ];
+			nSink += bScalar ? StrTools_CaseFoldPrefix_Scalar( s1, s_pTestStrings[1], INT_MAX ) : StrTools_CaseFoldPrefix( s1, s_pTestStrings[1], INT_MAX );
+			nSink += bScalar ? StrTools_StrLen_Scalar( s2 ) : StrTools_StrLen( s2 );
+			nSink += ( bScalar ? StrTools_StrRChr_Scalar( s1, '/' ) : StrTools_StrRChr( s1, '/' ) ) != NULL;
+			V_strncpy( fixBuffer, s2, sizeof( fixBuffer ) );
+			if ( bScalar )
+			{
+				StrTools_FixSlashes_Scalar( fixBuffer, '/' );
+			}
+			else
+			{
+				StrTools_FixSlashes( fixBuffer, '/' );
+			}
+		}
+		double flElapsed = Plat_FloatTime() - flStart;
+		Msg( "%s: %d iterations in %.2f ms (%.1f ns/iteration)\n", bScalar ? "scalar" : "simd  ", nIterations, flElapsed * 1000.0, flElapsed * 1e9 / MAX( nIterations, 1 ) );
+	}
+}
+
+#endif // FASTPATH_TESTS
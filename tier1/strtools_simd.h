@@ -0,0 +1,40 @@
+//===== Copyright (c) 1996-2005, Valve Corporation, All rights reserved. ======//
+//
+// Purpose: SSE2/SSE4.2 kernels behind the tier1 string tools. The scalar
+//			versions are kept alongside so the fast paths can be checked
+//			against them.
+//
+//===========================================================================//
+
+#ifndef STRTOOLS_SIMD_H
+#define STRTOOLS_SIMD_H
+
+#ifdef _WIN32
+#pragma once
+#endif
+
+// Number of leading bytes of s1 and s2 that match under ASCII case folding,
+// stopping at the first NUL in s1 or after n bytes
+int StrTools_CaseFoldPrefix( const char *s1, const char *s2, int n );
+int StrTools_CaseFoldPrefix_Scalar( const char *s1, const char *s2, int n );
+
+int StrTools_StrLen( const char *pStr );
+int StrTools_StrLen_Scalar( const char *pStr );
+
+// Length of pStr, or nMax if there is no NUL in the first nMax bytes
+int StrTools_StrNLen( const char *pStr, int nMax );
+int StrTools_StrNLen_Scalar( const char *pStr, int nMax );
+
+// Last occurrence of c before the terminator
+const char *StrTools_StrRChr( const char *pStr, char c );
+const char *StrTools_StrRChr_Scalar( const char *pStr, char c );
+
+// First occurrence of c in the first n bytes, before the terminator
+const char *StrTools_StrNChr( const char *pStr, char c, int n );
+const char *StrTools_StrNChr_Scalar( const char *pStr, char c, int n );
+
+// Replaces every '/' and '\' with separator
+void StrTools_FixSlashes( char *pStr, char separator );
+void StrTools_FixSlashes_Scalar( char *pStr, char separator );
+
+#endif // STRTOOLS_SIMD_H
@@ -0,0 +1,751 @@
+//===== Copyright (c) 1996-2005, Valve Corporation, All rights reserved. ======//
+//
+// Purpose: CUtlBuffer stored as a chain of pages
+//
+// $NoKeywords: $
+//===========================================================================//
+
+#include "tier1/utlsegmentedbuffer.h"
+#include "tier0/dbg.h"
+#include "tier0/platform.h"
+#include "tier0/threadtools.h"
+#include "tier1/strtools.h"
+#include <stdlib.h>
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+
+//-----------------------------------------------------------------------------
+// Recycles default sized pages between buffers. Big serializers run back to
+// back (autosave, nav save, demo flushes), so a few megabytes of pages are
+// kept around instead of going back to the allocator every time.
+//-----------------------------------------------------------------------------
+#define MAX_POOLED_PAGES	64
+
+class CSegmentPagePool
+{
+public:
+	~CSegmentPagePool()
+	{
+		for ( int i = 0; i < m_FreePages.Count(); ++i )
+		{
+			free( m_FreePages[i] );
+		}
+	}
+
+	unsigned char *Alloc()
+	{
+		{
+			AUTO_LOCK( m_Mutex );
+			if ( m_FreePages.Count() )
+			{
+				unsigned char *pPage = m_FreePages.Tail();
+				m_FreePages.RemoveMultipleFromTail( 1 );
+				return pPage;
+			}
+		}
+
+		MEM_ALLOC_CREDIT_( "CUtlSegmentedBuffer pages" );
+		return (unsigned char *)malloc( CUtlSegmentedBuffer::DEFAULT_PAGE_SIZE );
+	}
+
+	void Free( unsigned char *pPage )
+	{
+		{
+			AUTO_LOCK( m_Mutex );
+			if ( m_FreePages.Count() < MAX_POOLED_PAGES )
+			{
+				m_FreePages.AddToTail( pPage );
+				return;
+			}
+		}
+
+		free( pPage );
+	}
+
+private:
+	CUtlVector< unsigned char * > m_FreePages;
+	CThreadFastMutex m_Mutex;
+};
+
+static CSegmentPagePool s_PagePool;
+
+
+//-----------------------------------------------------------------------------
+// constructor, destructor
+//-----------------------------------------------------------------------------
+CUtlSegmentedBuffer::CUtlSegmentedBuffer( int nFlags, int nPageSize ) : BaseClass( 0, 0, nFlags & ~( READ_ONLY | EXTERNAL_GROWABLE ) )
+{
+	Assert( nPageSize > 1 );
+	m_nPageSize = MAX( nPageSize, 2 );
+	SetUtlBufferOverflowFuncs( &CUtlSegmentedBuffer::SegmentGetOverflow, &CUtlSegmentedBuffer::SegmentPutOverflow );
+}
+
+CUtlSegmentedBuffer::~CUtlSegmentedBuffer()
+{
+	Purge();
+}
+
+
+//-----------------------------------------------------------------------------
+// Page allocation
+//-----------------------------------------------------------------------------
+unsigned char *CUtlSegmentedBuffer::AllocPage( int nCapacity )
+{
+	if ( nCapacity == DEFAULT_PAGE_SIZE )
+		return s_PagePool.Alloc();
+
+	MEM_ALLOC_CREDIT_( "CUtlSegmentedBuffer pages" );
+	return (unsigned char *)malloc( nCapacity );
+}
+
+void CUtlSegmentedBuffer::FreePage( unsigned char *pData, int nCapacity )
+{
+	if ( nCapacity == DEFAULT_PAGE_SIZE )
+	{
+		s_PagePool.Free( pData );
+	}
+	else
+	{
+		free( pData );
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Clears out the buffer
+//-----------------------------------------------------------------------------
+void CUtlSegmentedBuffer::Clear()
+{
+	while ( m_Segments.Count() > 1 )
+	{
+		FreePage( m_Segments.Tail().m_pData, m_Segments.Tail().m_nCapacity );
+		m_Segments.RemoveMultipleFromTail( 1 );
+	}
+
+	if ( m_Segments.Count() )
+	{
+		MapSegment( 0 );
+	}
+
+	BaseClass::Clear();
+}
+
+void CUtlSegmentedBuffer::Purge()
+{
+	for ( int i = 0; i < m_Segments.Count(); ++i )
+	{
+		FreePage( m_Segments[i].m_pData, m_Segments[i].m_nCapacity );
+	}
+	m_Segments.Purge();
+	m_Bounce.Purge();
+
+	m_Memory.SetExternalBuffer( (unsigned char *)NULL, 0 );
+	BaseClass::Purge();
+}
+
+int CUtlSegmentedBuffer::GetPageSize() const
+{
+	return m_nPageSize;
+}
+
+
+//-----------------------------------------------------------------------------
+// Segment lookup
+//-----------------------------------------------------------------------------
+int CUtlSegmentedBuffer::FindSegment( int nOffset ) const
+{
+	// Last segment starting at or before nOffset
+	int nLow = 0;
+	int nHigh = m_Segments.Count() - 1;
+	if ( nHigh < 0 )
+		return -1;
+
+	while ( nLow < nHigh )
+	{
+		int nMid = ( nLow + nHigh + 1 ) >> 1;
+		if ( m_Segments[nMid].m_nOffset <= nOffset )
+		{
+			nLow = nMid;
+		}
+		else
+		{
+			nHigh = nMid - 1;
+		}
+	}
+	return nLow;
+}
+
+int CUtlSegmentedBuffer::DataEnd() const
+{
+	// While a put is being null terminated m_Put is briefly past m_nMaxPut
+	return MAX( m_nMaxPut, m_Put );
+}
+
+int CUtlSegmentedBuffer::SegmentEnd( int nSegment ) const
+{
+	if ( nSegment + 1 < m_Segments.Count() )
+		return m_Segments[ nSegment + 1 ].m_nOffset;
+
+	const Segment_t &segment = m_Segments[ nSegment ];
+	return clamp( DataEnd(), segment.m_nOffset, segment.m_nOffset + segment.m_nCapacity );
+}
+
+int CUtlSegmentedBuffer::GetSegmentCount() const
+{
+	int nEnd = DataEnd();
+	int nCount = m_Segments.Count();
+	while ( nCount > 0 && m_Segments[ nCount - 1 ].m_nOffset >= nEnd )
+	{
+		--nCount;
+	}
+	return nCount;
+}
+
+
+//-----------------------------------------------------------------------------
+// Points the CUtlBuffer window at a segment. Only the last segment exposes
+// its spare capacity, so puts into earlier ones can't run into the next.
+//-----------------------------------------------------------------------------
+void CUtlSegmentedBuffer::MapSegment( int nSegment )
+{
+	const Segment_t &segment = m_Segments[ nSegment ];
+	int nSize = ( nSegment == m_Segments.Count() - 1 ) ? segment.m_nCapacity : SegmentEnd( nSegment ) - segment.m_nOffset;
+	m_Memory.SetExternalBuffer( segment.m_pData, nSize );
+	m_nOffset = segment.m_nOffset;
+}
+
+void CUtlSegmentedBuffer::AddPage( int nStart, int nEnd )
+{
+	int nCapacity = MAX( m_nPageSize, nEnd - nStart );
+
+	int i = m_Segments.AddToTail();
+	m_Segments[i].m_pData = AllocPage( nCapacity );
+	m_Segments[i].m_nOffset = nStart;
+	m_Segments[i].m_nCapacity = nCapacity;
+}
+
+int CUtlSegmentedBuffer::MergeSegments( int nFirst, int nLast, int nMinCapacity )
+{
+	// Keep room for the null terminator when merging the last page;
+	// text parsing relies on it to stop
+	bool bTail = ( nLast == m_Segments.Count() - 1 );
+	int nStart = m_Segments[nFirst].m_nOffset;
+	int nDataEnd = SegmentEnd( nLast );
+	int nCapacity = MAX( nDataEnd - nStart + ( bTail ? 1 : 0 ), nMinCapacity );
+	unsigned char *pData = AllocPage( nCapacity );
+
+	for ( int i = nFirst; i <= nLast; ++i )
+	{
+		memcpy( pData + m_Segments[i].m_nOffset - nStart, m_Segments[i].m_pData, SegmentEnd( i ) - m_Segments[i].m_nOffset );
+	}
+	for ( int i = nFirst; i <= nLast; ++i )
+	{
+		FreePage( m_Segments[i].m_pData, m_Segments[i].m_nCapacity );
+	}
+
+	if ( bTail )
+	{
+		pData[ nDataEnd - nStart ] = 0;
+	}
+
+	m_Segments.RemoveMultiple( nFirst + 1, nLast - nFirst );
+
+	m_Segments[nFirst].m_pData = pData;
+	m_Segments[nFirst].m_nCapacity = nCapacity;
+	return nFirst;
+}
+
+//-----------------------------------------------------------------------------
+// Segment to map for a put at nOffset. Text buffers look at the character
+// before the put (CUtlBuffer::WasLastCharacterCR), so a put at the very start
+// of a page merges it with the one before.
+//-----------------------------------------------------------------------------
+int CUtlSegmentedBuffer::PutSegment( int nOffset )
+{
+	int nSegment = FindSegment( nOffset );
+	if ( IsText() && nSegment > 0 && nOffset == m_Segments[nSegment].m_nOffset )
+	{
+		nSegment = MergeSegments( nSegment - 1, nSegment, 0 );
+	}
+	return nSegment;
+}
+
+void CUtlSegmentedBuffer::TrimSegments()
+{
+	int nEnd = DataEnd();
+	while ( m_Segments.Count() > 1 && m_Segments.Tail().m_nOffset >= nEnd )
+	{
+		FreePage( m_Segments.Tail().m_pData, m_Segments.Tail().m_nCapacity );
+		m_Segments.RemoveMultipleFromTail( 1 );
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Overflow functions
+//-----------------------------------------------------------------------------
+bool CUtlSegmentedBuffer::SegmentPutOverflow( int nSize )
+{
+	TrimSegments();
+
+	if ( nSize < 0 )
+	{
+		// SeekPut. Anything skipped past the end of the data gets zero filled
+		// pages so the next put knows where it lives.
+		int nNextPut = -nSize - 1;
+		int nEnd = DataEnd();
+		while ( nEnd < nNextPut )
+		{
+			if ( !m_Segments.Count() || nEnd == m_Segments.Tail().m_nOffset + m_Segments.Tail().m_nCapacity )
+			{
+				AddPage( nEnd, nEnd + m_nPageSize );
+			}
+
+			Segment_t &last = m_Segments.Tail();
+			int nFill = MIN( nNextPut, last.m_nOffset + last.m_nCapacity ) - nEnd;
+			memset( last.m_pData + nEnd - last.m_nOffset, 0, nFill );
+			nEnd += nFill;
+		}
+
+		// Also gets the window off a bounce copy, which must never be written to
+		if ( m_Segments.Count() )
+		{
+			MapSegment( PutSegment( nNextPut ) );
+		}
+		return true;
+	}
+
+	int nStart = m_Put;
+	int nLast = m_Put + nSize;
+	if ( !m_Segments.Count() )
+	{
+		Assert( nStart == 0 );
+		AddPage( 0, nLast + 1 );
+		MapSegment( 0 );
+		return true;
+	}
+
+	int nSegment = PutSegment( nStart );
+	int nTail = m_Segments.Count() - 1;
+	if ( nSegment == nTail )
+	{
+		Segment_t &last = m_Segments[nTail];
+		if ( nLast > last.m_nOffset + last.m_nCapacity )
+		{
+			// Start a new page. It begins one byte before the put so PeekPut( -1 )
+			// (text mode tab tracking) stays inside the window; that byte and
+			// anything after it that's being overwritten move to the new page.
+			int nNewStart = MAX( nStart - 1, last.m_nOffset );
+			int nCarry = DataEnd() - nNewStart;
+			if ( nNewStart == last.m_nOffset )
+			{
+				// Nothing left in the old one
+				unsigned char *pOld = last.m_pData;
+				int nOldCapacity = last.m_nCapacity;
+				last.m_nCapacity = MAX( m_nPageSize, nLast - nNewStart + 1 );
+				last.m_pData = AllocPage( last.m_nCapacity );
+				memcpy( last.m_pData, pOld, nCarry );
+				FreePage( pOld, nOldCapacity );
+			}
+			else
+			{
+				const unsigned char *pCarry = last.m_pData + nNewStart - last.m_nOffset;
+				AddPage( nNewStart, nLast + 1 );
+				memcpy( m_Segments.Tail().m_pData, pCarry, nCarry );
+			}
+		}
+
+		MapSegment( m_Segments.Count() - 1 );
+		return true;
+	}
+
+	// Writing over earlier data; a put spanning pages merges them
+	if ( nLast > SegmentEnd( nSegment ) )
+	{
+		nSegment = MergeSegments( nSegment, FindSegment( nLast - 1 ), nLast + 1 - m_Segments[nSegment].m_nOffset );
+	}
+	MapSegment( nSegment );
+	return true;
+}
+
+bool CUtlSegmentedBuffer::SegmentGetOverflow( int nSize )
+{
+	int nSegment = FindSegment( m_Get );
+	if ( nSegment < 0 )
+		return false;
+
+	if ( nSize < 0 )
+	{
+		// SeekGet
+		MapSegment( nSegment );
+		return true;
+	}
+
+	int nLast = m_Get + nSize;
+	int nWindowEnd = ( nSegment == m_Segments.Count() - 1 ) ? m_Segments[nSegment].m_nOffset + m_Segments[nSegment].m_nCapacity : SegmentEnd( nSegment );
+	if ( nLast <= nWindowEnd )
+	{
+		MapSegment( nSegment );
+		return true;
+	}
+
+	if ( m_Put >= m_Get && m_Put < nLast )
+	{
+		// The bounce copy can't be written to, and the put position is inside it
+		nSegment = MergeSegments( nSegment, FindSegment( nLast - 1 ), nLast - m_Segments[nSegment].m_nOffset );
+		MapSegment( nSegment );
+		return true;
+	}
+
+	// Read spanning pages: copy it out. Any put will be outside this window
+	// and remap it first. Terminated like the real buffer for text parsing.
+	m_Bounce.EnsureCapacity( nSize + 1 );
+	CopyTo( m_Bounce.Base(), m_Get, nSize );
+	m_Bounce[nSize] = 0;
+	m_Memory.SetExternalBuffer( m_Bounce.Base(), nSize );
+	m_nOffset = m_Get;
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Access to the contents
+//-----------------------------------------------------------------------------
+int CUtlSegmentedBuffer::GetSegments( UtlBufferSegment_t *pSegments, int nMaxSegments, int nStartOffset ) const
+{
+	int nEnd = DataEnd();
+	int nCount = 0;
+	for ( int i = MAX( FindSegment( nStartOffset ), 0 ); i < m_Segments.Count() && nCount < nMaxSegments; ++i )
+	{
+		int nFrom = MAX( nStartOffset, m_Segments[i].m_nOffset );
+		int nTo = MIN( SegmentEnd( i ), nEnd );
+		if ( nTo <= nFrom )
+			break;
+
+		pSegments[nCount].m_pData = m_Segments[i].m_pData + nFrom - m_Segments[i].m_nOffset;
+		pSegments[nCount].m_nLength = nTo - nFrom;
+		++nCount;
+	}
+	return nCount;
+}
+
+int CUtlSegmentedBuffer::CopyTo( void *pDest, int nStartOffset, int nBytes ) const
+{
+	unsigned char *pOut = (unsigned char *)pDest;
+	int nEnd = MIN( DataEnd(), nStartOffset + nBytes );
+	int nCopied = 0;
+	for ( int i = MAX( FindSegment( nStartOffset ), 0 ); i < m_Segments.Count(); ++i )
+	{
+		int nFrom = MAX( nStartOffset, m_Segments[i].m_nOffset );
+		int nTo = MIN( SegmentEnd( i ), nEnd );
+		if ( nTo <= nFrom )
+			break;
+
+		memcpy( pOut + nCopied, m_Segments[i].m_pData + nFrom - m_Segments[i].m_nOffset, nTo - nFrom );
+		nCopied += nTo - nFrom;
+	}
+	return nCopied;
+}
+
+void CUtlSegmentedBuffer::CopyTo( CUtlBuffer &dest ) const
+{
+	int nEnd = DataEnd();
+	for ( int i = 0; i < m_Segments.Count(); ++i )
+	{
+		int nTo = MIN( SegmentEnd( i ), nEnd );
+		if ( nTo <= m_Segments[i].m_nOffset )
+			break;
+
+		dest.Put( m_Segments[i].m_pData, nTo - m_Segments[i].m_nOffset );
+	}
+}
+
+
+#if defined( FASTPATH_TESTS )
+
+//-----------------------------------------------------------------------------
+// Self test: the same random sequence of puts, patches, seeks and gets on a
+// regular CUtlBuffer and on segmented buffers with awkward page sizes has to
+// produce the same reads and the same bytes.
+//-----------------------------------------------------------------------------
+static uint32 SegmentedBufferRandom( uint32 &nSeed )
+{
+	nSeed = nSeed * 1664525 + 1013904223;
+	return nSeed >> 8;
+}
+
+static bool SegmentedBufferCompare( CUtlBuffer &reference, CUtlSegmentedBuffer &segmented, const char *pContext )
+{
+	if ( reference.TellPut() != segmented.TellPut() || reference.TellMaxPut() != segmented.TellMaxPut() ||
+		 reference.TellGet() != segmented.TellGet() || reference.IsValid() != segmented.IsValid() )
+	{
+		Warning( "CUtlSegmentedBuffer: %s: state mismatch (put %d/%d, maxput %d/%d, get %d/%d)\n", pContext,
+			reference.TellPut(), segmented.TellPut(), reference.TellMaxPut(), segmented.TellMaxPut(), reference.TellGet(), segmented.TellGet() );
+		return false;
+	}
+
+	int nBytes = reference.TellMaxPut();
+	unsigned char *pCopy = (unsigned char *)malloc( nBytes + 1 );
+	bool bMatch = ( segmented.CopyTo( pCopy, 0, nBytes ) == nBytes ) && !memcmp( pCopy, reference.Base(), nBytes );
+	free( pCopy );
+
+	if ( !bMatch )
+	{
+		Warning( "CUtlSegmentedBuffer: %s: contents differ (%d bytes in %d segments)\n", pContext, nBytes, segmented.GetSegmentCount() );
+	}
+	return bMatch;
+}
+
+static bool SegmentedBufferRandomOps( int nFlags, int nPageSize, int nOps, uint32 nSeed )
+{
+	CUtlBuffer reference( 0, 0, nFlags );
+	CUtlSegmentedBuffer segmented( nFlags, nPageSize );
+	CUtlBuffer *pBuffers[2] = { &reference, &segmented };
+	bool bText = ( nFlags & CUtlBuffer::TEXT_BUFFER ) != 0;
+
+	unsigned char pBlob[1024];
+	unsigned char pRead[2][1024];
+	int nResult[2];
+	char pString[128];
+
+	for ( int nOp = 0; nOp < nOps; ++nOp )
+	{
+		uint32 nValue = SegmentedBufferRandom( nSeed );
+
+		int nLength = SegmentedBufferRandom( nSeed ) % 40;
+		for ( int i = 0; i < nLength; ++i )
+		{
+			pString[i] = 'a' + SegmentedBufferRandom( nSeed ) % 26;
+		}
+		pString[nLength] = 0;
+
+		int nBlob = SegmentedBufferRandom( nSeed ) % ( MIN( nPageSize * 3, (int)sizeof( pBlob ) ) + 1 );
+		for ( int i = 0; i < nBlob; ++i )
+		{
+			pBlob[i] = (unsigned char)SegmentedBufferRandom( nSeed );
+		}
+
+		int nSeekPut = reference.TellMaxPut() ? SegmentedBufferRandom( nSeed ) % reference.TellMaxPut() : 0;
+		int nSeekGet = reference.TellMaxPut() ? SegmentedBufferRandom( nSeed ) % reference.TellMaxPut() : 0;
+		int nGet = SegmentedBufferRandom( nSeed ) % ( MIN( nPageSize * 2, (int)sizeof( pRead[0] ) ) + 1 );
+		int nChoice = SegmentedBufferRandom( nSeed ) % 16;
+
+		// Text auto tabs only see the previous character while the put page
+		// is mapped, so text buffers are written first and read back after
+		if ( bText )
+		{
+			nChoice = ( nOp < nOps / 2 ) ? ( ( nChoice == 15 ) ? 15 : nChoice % 9 ) : 9 + nChoice % 6;
+		}
+
+		if ( nChoice == 15 )
+		{
+			if ( ( nValue & 127 ) == 0 )
+			{
+				reference.Clear();
+				segmented.Clear();
+			}
+			continue;
+		}
+
+		memset( pRead, 0, sizeof( pRead ) );
+		for ( int b = 0; b < 2; ++b )
+		{
+			CUtlBuffer &buf = *pBuffers[b];
+			nResult[b] = 0;
+			switch ( nChoice )
+			{
+			case 0: buf.PutChar( (char)( bText ? 'a' + nValue % 26 : nValue ) ); break;
+			case 1: buf.PutShort( (short)nValue ); break;
+			case 2: buf.PutInt( (int)nValue ); break;
+			case 3: buf.PutInt64( ( (int64)nValue << 32 ) | nValue ); break;
+			case 4: buf.PutFloat( (float)nValue * 0.25f ); break;
+			case 5: buf.PutString( pString ); break;
+			case 6:
+				if ( bText )
+				{
+					buf.Printf( "%s %u\n", pString, nValue );
+				}
+				else
+				{
+					buf.Put( pBlob, nBlob );
+				}
+				break;
+			case 7:
+				if ( bText )
+				{
+					if ( nValue & 1 )
+					{
+						buf.PushTab();
+					}
+					else
+					{
+						buf.PopTab();
+					}
+					buf.PutChar( '\n' );
+				}
+				else
+				{
+					buf.PutDouble( (double)nValue / 3.0 );
+				}
+				break;
+
+			case 8:
+				// Patch earlier data, then go back to appending
+				buf.SeekPut( CUtlBuffer::SEEK_HEAD, nSeekPut );
+				buf.PutInt( (int)nValue );
+				buf.SeekPut( CUtlBuffer::SEEK_TAIL, 0 );
+				break;
+
+			case 9:
+				buf.SeekGet( CUtlBuffer::SEEK_HEAD, nSeekGet );
+				break;
+
+			case 10:
+				nResult[b] = buf.GetUpTo( pRead[b], nGet );
+				break;
+
+			case 11:
+				nResult[b] = buf.GetInt();
+				break;
+
+			case 12:
+				buf.GetString( (char *)pRead[b], sizeof( pRead[b] ) );
+				break;
+
+			case 13:
+				*(float *)pRead[b] = buf.GetFloat();
+				break;
+
+			case 14:
+				nResult[b] = buf.PeekStringLength();
+				pRead[b][0] = (unsigned char)buf.GetChar();
+				break;
+			}
+
+			// GetTypeText() assumes numbers are < 128 characters, so keep text tokens apart
+			if ( bText && nChoice < 8 )
+			{
+				buf.PutChar( ' ' );
+			}
+
+			// Failed reads leave GET_OVERFLOW set on both; clear it to keep going
+			if ( !buf.IsValid() )
+			{
+				buf.SeekGet( CUtlBuffer::SEEK_HEAD, 0 );
+			}
+		}
+
+		if ( nResult[0] != nResult[1] || memcmp( pRead[0], pRead[1], sizeof( pRead[0] ) ) )
+		{
+			Warning( "CUtlSegmentedBuffer: read %d differs at op %d (page size %d)\n", nChoice, nOp, nPageSize );
+			return false;
+		}
+
+		if ( ( nOp & 63 ) == 0 || nOp == nOps - 1 )
+		{
+			if ( !SegmentedBufferCompare( reference, segmented, bText ? "text" : "binary" ) )
+				return false;
+		}
+	}
+
+	return true;
+}
+
+bool UtlSegmentedBuffer_Validate( int nIterations )
+{
+	static const int s_nPageSizes[] = { 2, 3, 7, 16, 61, 256, 4099, CUtlSegmentedBuffer::DEFAULT_PAGE_SIZE };
+
+	int nFailures = 0;
+	for ( int i = 0; i < (int)ARRAYSIZE( s_nPageSizes ); ++i )
+	{
+		for ( int nText = 0; nText < 2; ++nText )
+		{
+			int nFlags = nText ? CUtlBuffer::TEXT_BUFFER : 0;
+			if ( !SegmentedBufferRandomOps( nFlags, s_nPageSizes[i], nIterations, 0x5EED + i * 2 + nText ) )
+			{
+				++nFailures;
+			}
+		}
+	}
+
+	if ( nFailures )
+	{
+		Warning( "CUtlSegmentedBuffer: %d of %d runs FAILED\n", nFailures, 2 * (int)ARRAYSIZE( s_nPageSizes ) );
+	}
+	else
+	{
+		Msg( "CUtlSegmentedBuffer: %d runs of %d ops match CUtlBuffer\n", 2 * ARRAYSIZE( s_nPageSizes ), nIterations );
+	}
+	return nFailures == 0;
+}
+
+
+//-----------------------------------------------------------------------------
+// Serializes nMegabytes of save-game-like records into a regular and a
+// segmented buffer, then hands the result to a fake file write
+//-----------------------------------------------------------------------------
+static void SegmentedBufferSerialize( CUtlBuffer &buf, int nBytes )
+{
+	static const char s_pKeys[][16] = { "classname", "origin", "angles", "targetname", "health", "model" };
+	unsigned char pRecord[48];
+	memset( pRecord, 0x5A, sizeof( pRecord ) );
+
+	for ( int i = 0; buf.TellPut() < nBytes; ++i )
+	{
+		buf.PutInt( i );
+		buf.PutString( s_pKeys[ i % ARRAYSIZE( s_pKeys ) ] );
+		buf.PutFloat( (float)i );
+		buf.PutFloat( (float)-i );
+		buf.PutShort( (short)i );
+		buf.Put( pRecord, sizeof( pRecord ) );
+	}
+}
+
+void UtlSegmentedBuffer_Benchmark( int nMegabytes )
+{
+	int nBytes = MAX( nMegabytes, 1 ) << 20;
+	unsigned char *pSink = (unsigned char *)malloc( nBytes + 1024 );
+
+	for ( int nPass = 0; nPass < 2; ++nPass )
+	{
+		// Second pass runs with a warm page pool
+		double flStart = Plat_FloatTime();
+		int nCapacity;
+		{
+			CUtlBuffer buf;
+			SegmentedBufferSerialize( buf, nBytes );
+			memcpy( pSink, buf.Base(), buf.TellPut() );
+			nCapacity = buf.Size();
+		}
+		double flLinear = Plat_FloatTime() - flStart;
+
+		flStart = Plat_FloatTime();
+		int nSegments;
+		{
+			CUtlSegmentedBuffer buf;
+			SegmentedBufferSerialize( buf, nBytes );
+
+			UtlBufferSegment_t segments[64];
+			int nOffset = 0;
+			for ( int nCount; ( nCount = buf.GetSegments( segments, ARRAYSIZE( segments ), nOffset ) ) != 0; )
+			{
+				for ( int i = 0; i < nCount; ++i )
+				{
+					memcpy( pSink + nOffset, segments[i].m_pData, segments[i].m_nLength );
+					nOffset += segments[i].m_nLength;
+				}
+			}
+			nSegments = buf.GetSegmentCount();
+		}
+		double flSegmented = Plat_FloatTime() - flStart;
+
+		Msg( "%d MB serialize+write: CUtlBuffer %.2f ms (%d KB allocated), CUtlSegmentedBuffer %.2f ms (%d pages)%s\n",
+			nBytes >> 20, flLinear * 1000.0, nCapacity >> 10, flSegmented * 1000.0, nSegments, nPass ? " [warm pool]" : "" );
+	}
+
+	free( pSink );
+}
+
+#endif // FASTPATH_TESTS
@@ -0,0 +1,492 @@
+//========= Copyright (c) 1996-2005, Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Per-thread VProf scope event recorder
+//
+// $NoKeywords: $
+//=============================================================================//
+
+#if defined( _WIN32 ) && !defined( _X360 )
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#elif defined( POSIX )
+#include <pthread.h>
+#endif
+
+#include "tier1/vproftrace.h"
+#include "tier0/dbg.h"
+#include "tier0/vprof.h"
+#include "tier0/fasttimer.h"
+#include "tier0/threadtools.h"
+#include "tier1/utlbuffer.h"
+#include "tier1/utlmap.h"
+#include "tier1/utlvector.h"
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+#define VPROF_TRACE_BUFFER_MASK		( VPROF_TRACE_BUFFER_SIZE - 1 )
+
+//-----------------------------------------------------------------------------
+// A single thread's ring. Only the owning thread writes m_Events and
+// m_nWritten; readers copy out and validate against m_nWritten afterwards.
+//-----------------------------------------------------------------------------
+struct CVProfTraceThreadBuffer
+{
+	VProfTraceEvent_t			m_Events[VPROF_TRACE_BUFFER_SIZE];
+	uint32 volatile				m_nWritten;
+	ThreadId_t					m_ThreadId;
+	int							m_nDepth;
+	CVProfTraceThreadBuffer		*m_pNext;
+#if defined( _WIN32 ) && !defined( _X360 )
+	HANDLE						m_hThread;		// signalled once the thread exits
+#endif
+	bool volatile				m_bThreadExited;
+};
+
+static CTHREADLOCALPTR( CVProfTraceThreadBuffer ) s_pThreadTraceBuffer;
+
+#if defined( POSIX )
+// Tells the recorder when a thread that owns a ring exits
+static pthread_key_t s_ThreadExitKey;
+
+static void VProfTrace_ThreadExit( void *pBuffer )
+{
+	ThreadMemoryBarrier();
+	((CVProfTraceThreadBuffer *)pBuffer)->m_bThreadExited = true;
+}
+#endif
+
+CVProfTraceRecorder g_VProfTraceRecorder;
+
+
+//-----------------------------------------------------------------------------
+// What CVProfScope calls through VProfScopeHooks()
+//-----------------------------------------------------------------------------
+static void VProfTrace_EnterScope( const tchar *pszName, const tchar *pszBudgetGroup )
+{
+	g_VProfTraceRecorder.EnterScope( pszName, pszBudgetGroup );
+}
+
+static void VProfTrace_ExitScope()
+{
+	g_VProfTraceRecorder.ExitScope();
+}
+
+static void VProfTrace_SignalSpike()
+{
+	g_VProfTraceRecorder.SignalSpike();
+}
+
+
+//-----------------------------------------------------------------------------
+// Thread exit. The 360 has no way to ask, but its threads live as long as the
+// process does.
+//-----------------------------------------------------------------------------
+static bool HasThreadExited( CVProfTraceThreadBuffer *pBuffer )
+{
+#if defined( _WIN32 ) && !defined( _X360 )
+	return pBuffer->m_hThread && WaitForSingleObject( pBuffer->m_hThread, 0 ) == WAIT_OBJECT_0;
+#else
+	return pBuffer->m_bThreadExited;
+#endif
+}
+
+static void FreeThreadBuffer( CVProfTraceThreadBuffer *pBuffer )
+{
+#if defined( _WIN32 ) && !defined( _X360 )
+	if ( pBuffer->m_hThread )
+	{
+		CloseHandle( pBuffer->m_hThread );
+	}
+#endif
+	delete pBuffer;
+}
+
+
+//-----------------------------------------------------------------------------
+// Constructor, destructor
+//-----------------------------------------------------------------------------
+CVProfTraceRecorder::CVProfTraceRecorder()
+{
+	m_pBuffers = NULL;
+	m_bRecording = false;
+	m_bSpikePending = false;
+	m_nCurrentTick = 0;
+	m_nStartCycles = 0;
+
+#if defined( POSIX )
+	pthread_key_create( &s_ThreadExitKey, VProfTrace_ThreadExit );
+#endif
+
+	// The functions stay installed; scopes that entered while recording
+	// still exit through them after Stop()
+	VProfScopeHooks_t &hooks = VProfScopeHooks();
+	hooks.m_pfnEnterScope = VProfTrace_EnterScope;
+	hooks.m_pfnExitScope = VProfTrace_ExitScope;
+	hooks.m_pfnSignalSpike = VProfTrace_SignalSpike;
+}
+
+CVProfTraceRecorder::~CVProfTraceRecorder()
+{
+	// Thread locals may still point at the buffers during shutdown, so stop
+	// recording before they go away
+	m_bRecording = false;
+	VProfScopeHooks().m_bActive = false;
+#if defined( POSIX )
+	pthread_key_delete( s_ThreadExitKey );
+#endif
+	CVProfTraceThreadBuffer *pBuffer = m_pBuffers;
+	m_pBuffers = NULL;
+	while ( pBuffer )
+	{
+		CVProfTraceThreadBuffer *pNext = pBuffer->m_pNext;
+		FreeThreadBuffer( pBuffer );
+		pBuffer = pNext;
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Start, stop
+//-----------------------------------------------------------------------------
+void CVProfTraceRecorder::Start()
+{
+	if ( m_bRecording )
+		return;
+
+	m_nStartCycles = CCycleCount::GetTimestamp();
+	m_bRecording = true;
+	VProfScopeHooks().m_bActive = true;
+}
+
+void CVProfTraceRecorder::Stop()
+{
+	m_bRecording = false;
+	VProfScopeHooks().m_bActive = false;
+}
+
+
+//-----------------------------------------------------------------------------
+// Finds or creates the calling thread's ring. New rings are pushed onto the
+// list with a CAS so threads never wait on each other.
+//-----------------------------------------------------------------------------
+CVProfTraceThreadBuffer *CVProfTraceRecorder::GetThreadBuffer()
+{
+	CVProfTraceThreadBuffer *pBuffer = GETLOCAL( s_pThreadTraceBuffer );
+	if ( pBuffer )
+		return pBuffer;
+
+	pBuffer = new CVProfTraceThreadBuffer;
+	pBuffer->m_nWritten = 0;
+	pBuffer->m_ThreadId = ThreadGetCurrentId();
+	pBuffer->m_nDepth = 0;
+	pBuffer->m_bThreadExited = false;
+#if defined( _WIN32 ) && !defined( _X360 )
+	pBuffer->m_hThread = OpenThread( SYNCHRONIZE, FALSE, GetCurrentThreadId() );
+#elif defined( POSIX )
+	pthread_setspecific( s_ThreadExitKey, pBuffer );
+#endif
+
+	for ( ;; )
+	{
+		CVProfTraceThreadBuffer *pHead = m_pBuffers;
+		pBuffer->m_pNext = pHead;
+		if ( ThreadInterlockedCompareExchangePointer( (void * volatile *)&m_pBuffers, pBuffer, pHead ) == pHead )
+			break;
+	}
+
+	s_pThreadTraceBuffer = pBuffer;
+	return pBuffer;
+}
+
+//-----------------------------------------------------------------------------
+// Frees the rings of threads that have exited. Runs on the thread that ticks
+// and dumps, so nothing else reads the rings; other threads only push onto the
+// head, so everything behind it can be unlinked without a CAS.
+//-----------------------------------------------------------------------------
+void CVProfTraceRecorder::ReleaseExitedThreads()
+{
+	CVProfTraceThreadBuffer *pPrev = NULL;
+	CVProfTraceThreadBuffer *pBuffer = m_pBuffers;
+	while ( pBuffer )
+	{
+		CVProfTraceThreadBuffer *pNext = pBuffer->m_pNext;
+		if ( !HasThreadExited( pBuffer ) )
+		{
+			pPrev = pBuffer;
+		}
+		else if ( pPrev )
+		{
+			pPrev->m_pNext = pNext;
+			FreeThreadBuffer( pBuffer );
+		}
+		else if ( ThreadInterlockedCompareExchangePointer( (void * volatile *)&m_pBuffers, pNext, pBuffer ) == pBuffer )
+		{
+			FreeThreadBuffer( pBuffer );
+		}
+		else
+		{
+			// A new ring went in front of it, free it next tick
+			pPrev = pBuffer;
+		}
+		pBuffer = pNext;
+	}
+}
+
+int CVProfTraceRecorder::GetThreadCount() const
+{
+	int nCount = 0;
+	for ( CVProfTraceThreadBuffer *pBuffer = m_pBuffers; pBuffer; pBuffer = pBuffer->m_pNext )
+	{
+		++nCount;
+	}
+	return nCount;
+}
+
+
+//-----------------------------------------------------------------------------
+// Event recording
+//-----------------------------------------------------------------------------
+static inline void AppendEvent( CVProfTraceThreadBuffer *pBuffer, int nType, const tchar *pszName, const tchar *pszBudgetGroup, int nTick )
+{
+	uint32 nIndex = pBuffer->m_nWritten;
+	VProfTraceEvent_t &event = pBuffer->m_Events[ nIndex & VPROF_TRACE_BUFFER_MASK ];
+	event.m_nCycles = CCycleCount::GetTimestamp();
+	event.m_pszName = pszName;
+	event.m_pszBudgetGroup = pszBudgetGroup;
+	event.m_nTick = nTick;
+	event.m_nType = nType;
+
+	// Publish only after the event is fully written
+	ThreadMemoryBarrier();
+	pBuffer->m_nWritten = nIndex + 1;
+}
+
+void CVProfTraceRecorder::EnterScope( const tchar *pszName, const tchar *pszBudgetGroup )
+{
+	CVProfTraceThreadBuffer *pBuffer = GetThreadBuffer();
+	++pBuffer->m_nDepth;
+	AppendEvent( pBuffer, VPROF_TRACE_ENTER, pszName, pszBudgetGroup, m_nCurrentTick );
+}
+
+void CVProfTraceRecorder::ExitScope()
+{
+	CVProfTraceThreadBuffer *pBuffer = GetThreadBuffer();
+	if ( pBuffer->m_nDepth <= 0 )
+		return;
+
+	--pBuffer->m_nDepth;
+	AppendEvent( pBuffer, VPROF_TRACE_EXIT, NULL, NULL, m_nCurrentTick );
+}
+
+void CVProfTraceRecorder::MarkTick( int nTick )
+{
+	m_nCurrentTick = nTick;
+	if ( m_bRecording )
+	{
+		AppendEvent( GetThreadBuffer(), VPROF_TRACE_TICK, NULL, NULL, nTick );
+	}
+
+	// Any dump of the last tick has been written by now
+	ReleaseExitedThreads();
+}
+
+bool CVProfTraceRecorder::ConsumeSpike()
+{
+	if ( !m_bSpikePending )
+		return false;
+
+	m_bSpikePending = false;
+	return m_bRecording;
+}
+
+
+//-----------------------------------------------------------------------------
+// Copies the part of one ring that falls in the dump window. pOut must hold
+// VPROF_TRACE_BUFFER_SIZE events. Returns the number of events copied.
+//-----------------------------------------------------------------------------
+int CVProfTraceRecorder::SnapshotThread( CVProfTraceThreadBuffer *pBuffer, VProfTraceEvent_t *pOut, int nMinTick )
+{
+	uint32 nEnd = pBuffer->m_nWritten;
+	ThreadMemoryBarrier();
+	uint32 nStart = ( nEnd > VPROF_TRACE_BUFFER_SIZE ) ? nEnd - VPROF_TRACE_BUFFER_SIZE : 0;
+	for ( uint32 i = nStart; i != nEnd; ++i )
+	{
+		pOut[ i - nStart ] = pBuffer->m_Events[ i & VPROF_TRACE_BUFFER_MASK ];
+	}
+
+	// Anything the writer may have overwritten while we copied is unreliable
+	ThreadMemoryBarrier();
+	uint32 nEndAfter = pBuffer->m_nWritten;
+	uint32 nSafeStart = ( nEndAfter > VPROF_TRACE_BUFFER_SIZE ) ? nEndAfter - VPROF_TRACE_BUFFER_SIZE : 0;
+	uint32 nSkip = ( nSafeStart > nStart ) ? MIN( nSafeStart - nStart, nEnd - nStart ) : 0;
+
+	// Drop events older than the window, and exits whose enter fell outside it
+	int nCount = 0;
+	int nDepth = 0;
+	for ( uint32 i = nSkip; i < nEnd - nStart; ++i )
+	{
+		const VProfTraceEvent_t &event = pOut[i];
+		if ( event.m_nTick < nMinTick )
+			continue;
+
+		if ( event.m_nType == VPROF_TRACE_ENTER )
+		{
+			++nDepth;
+		}
+		else if ( event.m_nType == VPROF_TRACE_EXIT )
+		{
+			if ( nDepth == 0 )
+				continue;
+			--nDepth;
+		}
+		pOut[ nCount++ ] = event;
+	}
+	return nCount;
+}
+
+
+//-----------------------------------------------------------------------------
+// Chrome trace event format, viewable in chrome://tracing
+//-----------------------------------------------------------------------------
+static void PutJSONString( CUtlBuffer &buf, const tchar *pString )
+{
+	buf.PutChar( '"' );
+	for ( const tchar *p = pString ? pString : ""; *p; ++p )
+	{
+		if ( *p == '"' || *p == '\\' )
+		{
+			buf.PutChar( '\\' );
+		}
+		if ( (unsigned char)*p >= ' ' )
+		{
+			buf.PutChar( *p );
+		}
+	}
+	buf.PutChar( '"' );
+}
+
+void CVProfTraceRecorder::DumpChromeTrace( CUtlBuffer &buf, int nTicks )
+{
+	int nMinTick = m_nCurrentTick - MAX( nTicks, 1 ) + 1;
+	double flMicroseconds = g_ClockSpeedMicrosecondsMultiplier;
+
+	VProfTraceEvent_t *pEvents = new VProfTraceEvent_t[ VPROF_TRACE_BUFFER_SIZE ];
+
+	buf.PutString( "{\"traceEvents\":[\n" );
+	bool bFirst = true;
+	for ( CVProfTraceThreadBuffer *pBuffer = m_pBuffers; pBuffer; pBuffer = pBuffer->m_pNext )
+	{
+		int nCount = SnapshotThread( pBuffer, pEvents, nMinTick );
+		for ( int i = 0; i < nCount; ++i )
+		{
+			const VProfTraceEvent_t &event = pEvents[i];
+			double flTime = (double)(int64)( event.m_nCycles - m_nStartCycles ) * flMicroseconds;
+
+			if ( !bFirst )
+			{
+				buf.PutString( ",\n" );
+			}
+			bFirst = false;
+
+			switch ( event.m_nType )
+			{
+			case VPROF_TRACE_ENTER:
+				buf.PutString( "{\"ph\":\"B\",\"name\":" );
+				PutJSONString( buf, event.m_pszName );
+				buf.PutString( ",\"cat\":" );
+				PutJSONString( buf, event.m_pszBudgetGroup );
+				break;
+
+			case VPROF_TRACE_EXIT:
+				buf.PutString( "{\"ph\":\"E\"" );
+				break;
+
+			default:
+				buf.Printf( "{\"ph\":\"i\",\"s\":\"p\",\"name\":\"tick %d\"", event.m_nTick );
+				break;
+			}
+			buf.Printf( ",\"ts\":%.3f,\"pid\":0,\"tid\":%u,\"args\":{\"tick\":%d}}", flTime, (uint32)pBuffer->m_ThreadId, event.m_nTick );
+		}
+	}
+	buf.PutString( "\n]}\n" );
+
+	delete[] pEvents;
+}
+
+
+//-----------------------------------------------------------------------------
+// Compact binary format:
+//	int id, int version, int64 clock speed, int string count, strings (0-terminated),
+//	int thread count, per thread: uint thread id, int event count, per event:
+//	uint64 cycles since start, uint16 name string, uint16 budget group string,
+//	int tick, uint8 type. String 0 is the empty string.
+//-----------------------------------------------------------------------------
+static bool VProfTraceNameLess( const tchar * const &pLeft, const tchar * const &pRight )
+{
+	return pLeft < pRight;
+}
+
+void CVProfTraceRecorder::DumpBinary( CUtlBuffer &buf, int nTicks )
+{
+	int nMinTick = m_nCurrentTick - MAX( nTicks, 1 ) + 1;
+
+	// Scope names are string literals, so pointer identity is enough to pool them
+	CUtlMap< const tchar *, unsigned short > stringIndex( VProfTraceNameLess );
+	CUtlVector< const tchar * > strings;
+	strings.AddToTail( "" );
+	stringIndex.Insert( NULL, 0 );
+
+	CUtlVector< ThreadId_t > threadIds;
+	CUtlVector< CUtlVector< VProfTraceEvent_t > > threadEvents;
+
+	VProfTraceEvent_t *pEvents = new VProfTraceEvent_t[ VPROF_TRACE_BUFFER_SIZE ];
+	for ( CVProfTraceThreadBuffer *pBuffer = m_pBuffers; pBuffer; pBuffer = pBuffer->m_pNext )
+	{
+		int nCount = SnapshotThread( pBuffer, pEvents, nMinTick );
+		threadIds.AddToTail( pBuffer->m_ThreadId );
+		CUtlVector< VProfTraceEvent_t > &events = threadEvents[ threadEvents.AddToTail() ];
+		events.CopyArray( pEvents, nCount );
+
+		for ( int i = 0; i < nCount; ++i )
+		{
+			const tchar *pNames[2] = { pEvents[i].m_pszName, pEvents[i].m_pszBudgetGroup };
+			for ( int j = 0; j < 2; ++j )
+			{
+				if ( stringIndex.Find( pNames[j] ) == stringIndex.InvalidIndex() && strings.Count() < 65536 )
+				{
+					stringIndex.Insert( pNames[j], strings.AddToTail( pNames[j] ) );
+				}
+			}
+		}
+	}
+	delete[] pEvents;
+
+	buf.PutInt( VPROF_TRACE_BINARY_ID );
+	buf.PutInt( VPROF_TRACE_BINARY_VERSION );
+	buf.PutInt64( (int64)g_ClockSpeed );
+	buf.PutInt( strings.Count() );
+	for ( int i = 0; i < strings.Count(); ++i )
+	{
+		buf.PutString( strings[i] );
+	}
+
+	buf.PutInt( threadIds.Count() );
+	for ( int i = 0; i < threadIds.Count(); ++i )
+	{
+		const CUtlVector< VProfTraceEvent_t > &events = threadEvents[i];
+		buf.PutUnsignedInt( (uint32)threadIds[i] );
+		buf.PutInt( events.Count() );
+		for ( int j = 0; j < events.Count(); ++j )
+		{
+			const VProfTraceEvent_t &event = events[j];
+			unsigned short nName = stringIndex.Find( event.m_pszName );
+			unsigned short nGroup = stringIndex.Find( event.m_pszBudgetGroup );
+			buf.PutInt64( (int64)( event.m_nCycles - m_nStartCycles ) );
+			buf.PutUnsignedShort( stringIndex.IsValidIndex( nName ) ? stringIndex[nName] : 0 );
+			buf.PutUnsignedShort( stringIndex.IsValidIndex( nGroup ) ? stringIndex[nGroup] : 0 );
+			buf.PutInt( event.m_nTick );
+			buf.PutUnsignedChar( (unsigned char)event.m_nType );
+		}
+	}
+}